@@ -1,8 +1,11 @@
 #include <os.h>
 
 extern "C" {
+
+	/* protege le heap noyau (chunks et kern_heap) */
+	static spinlock_t kmalloc_lock = SPINLOCK_INIT;
 		
-	/* change memory segment size */
+	/* change memory segment size (kmalloc_lock pris) */
 	void *ksbrk(int n)
 	{
 		struct kmalloc_header *chunk;
@@ -47,6 +50,7 @@ extern "C" {
 			
 		unsigned long realsize;	/* taille totale de l'enregistrement */
 		struct kmalloc_header *chunk, *other;
+		u32 flags;
 
 		if ((realsize =
 		     sizeof(struct kmalloc_header) + size) < KMALLOC_MINSIZE)
@@ -56,6 +60,7 @@ extern "C" {
 		 * On recherche un bloc libre de 'size' octets en parcourant le HEAP
 		 * kernel a partir du debut
 		 */
+		flags = spin_lock_irqsave(&kmalloc_lock);
 		chunk = (struct kmalloc_header *) KERN_HEAP;
 		while (chunk->used || chunk->size < realsize) {
 			if (chunk->size == 0) {
@@ -64,6 +69,7 @@ extern "C" {
 				     chunk, kern_heap);
 					 //error
 					 asm("hlt");
+					 spin_unlock_irqrestore(&kmalloc_lock, flags);
 					 return 0;
 			}
 
@@ -76,6 +82,7 @@ extern "C" {
 					io.print
 					    ("\nPANIC: kmalloc(): no memory left for kernel !\nSystem halted\n");
 					 asm("hlt");
+					spin_unlock_irqrestore(&kmalloc_lock, flags);
 					return 0;
 				}
 			} else if (chunk > (struct kmalloc_header *) kern_heap) {
@@ -83,6 +90,7 @@ extern "C" {
 				    ("\nPANIC: kmalloc(): chunk on %x while heap limit is on %x !\nSystem halted\n",
 				     chunk, kern_heap);
 				 asm("hlt");
+				spin_unlock_irqrestore(&kmalloc_lock, flags);
 				return 0;
 			}
 		}
@@ -104,6 +112,7 @@ extern "C" {
 		}
 
 		kmalloc_used += realsize;
+		spin_unlock_irqrestore(&kmalloc_lock, flags);
 
 		/* Return a pointer to the memory area */
 		return (char *) chunk + sizeof(struct kmalloc_header);
@@ -116,8 +125,10 @@ extern "C" {
 			return;
 			
 		struct kmalloc_header *chunk, *other;
+		u32 flags;
 
 		/* On libere le bloc alloue */
+		flags = spin_lock_irqsave(&kmalloc_lock);
 		chunk =
 		    (struct kmalloc_header *) ((u32)v_addr -
 					       sizeof(struct kmalloc_header));
@@ -133,5 +144,7 @@ extern "C" {
 		       && other < (struct kmalloc_header *) kern_heap
 		       && other->used == 0)
 			chunk->size += other->size;
+
+		spin_unlock_irqrestore(&kmalloc_lock, flags);
 	}
 }
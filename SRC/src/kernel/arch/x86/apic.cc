@@ -0,0 +1,192 @@
+#include <os.h>
+#include <x86.h>
+#include <apic.h>
+
+/*
+ *	APIC local. Les registres sont projetes une seule fois (ioremap) : ils
+ *	sont a la meme adresse physique pour tous les processeurs, chacun
+ *	accede au sien.
+ */
+
+static volatile u32*	lapic = NULL;
+static u32				lapic_timer_count = 0;	/* ticks pour 1/APIC_TIMER_HZ s */
+
+static volatile u32*	ioapic = NULL;
+static u32				ioapic_gsi_base = 0;
+static u32				ioapic_nr_pins = 0;
+static spinlock_t		ioapic_lock = SPINLOCK_INIT;	/* IOREGSEL/IOWIN */
+
+static inline u32 lapic_read(u32 reg)
+{
+	return lapic[reg / 4];
+}
+
+static inline void lapic_write(u32 reg, u32 v)
+{
+	lapic[reg / 4] = v;
+	(void) lapic[LAPIC_ID / 4];		/* attend la fin de l'ecriture */
+}
+
+/* Acces indirect : registre dans IOREGSEL puis donnee dans IOWIN */
+static u32 ioapic_read(u32 reg)
+{
+	ioapic[IOAPIC_REGSEL / 4] = reg;
+	return ioapic[IOAPIC_WIN / 4];
+}
+
+static void ioapic_write(u32 reg, u32 v)
+{
+	ioapic[IOAPIC_REGSEL / 4] = reg;
+	ioapic[IOAPIC_WIN / 4] = v;
+}
+
+extern "C" {
+
+	int lapic_init(u32 phys)
+	{
+		if (lapic != NULL)
+			return RETURN_OK;
+		lapic = (volatile u32*) ioremap(phys, PAGESIZE);
+		if (lapic == NULL)
+			return ERROR_MEMORY;
+		return RETURN_OK;
+	}
+
+	int lapic_present(void)
+	{
+		return lapic != NULL;
+	}
+
+	/* Active l'APIC du processeur courant, les LINT gardent la config. du BIOS */
+	void lapic_enable(void)
+	{
+		lapic_write(LAPIC_TPR, 0);
+		lapic_write(LAPIC_LVT_ERR, LAPIC_LVT_MASKED);
+		lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | SPURIOUS_VECTOR);
+		lapic_write(LAPIC_ESR, 0);
+		lapic_write(LAPIC_EOI, 0);
+	}
+
+	u32 lapic_id(void)
+	{
+		return lapic_read(LAPIC_ID) >> 24;
+	}
+
+	void lapic_eoi(void)
+	{
+		lapic_write(LAPIC_EOI, 0);
+	}
+
+	void lapic_send_ipi(u32 apic_id, u32 icr)
+	{
+		lapic_write(LAPIC_ICR_HI, apic_id << 24);
+		lapic_write(LAPIC_ICR_LO, icr);
+		while (lapic_read(LAPIC_ICR_LO) & ICR_PENDING)
+			asm("pause");
+	}
+
+	/*
+	 * Attente active sur le canal 2 du PIT (1193182 Hz) en mode 0 : OUT2
+	 * (bit 5 du port 0x61) passe a 1 en fin de comptage. Les tranches de
+	 * 50 ms tiennent dans le compteur 16 bits.
+	 */
+	void udelay(u32 us)
+	{
+		u32 n, count;
+		u8 v;
+
+		while (us > 0) {
+			n = (us > 50000) ? 50000 : us;
+			us -= n;
+			count = (n * 1193) / 1000 + 1;
+
+			v = io.inb(0x61);
+			io.outb(0x61, (v & ~0x02) & ~0x01);		/* gate off, haut-parleur coupe */
+			io.outb(0x43, 0xB0);					/* canal 2, lsb/msb, mode 0 */
+			io.outb(0x42, count & 0xFF);
+			io.outb(0x42, (count >> 8) & 0xFF);
+			io.outb(0x61, (v & ~0x02) | 0x01);		/* gate on : le comptage demarre */
+			while (!(io.inb(0x61) & 0x20))
+				asm("pause");
+		}
+	}
+
+	/* Mesure la frequence du timer de l'APIC (diviseur 16) sur 10 ms */
+	void lapic_timer_calibrate(void)
+	{
+		u32 elapsed;
+
+		lapic_write(LAPIC_TIMER_DCR, 0x3);
+		lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | APIC_TIMER_VECTOR);
+		lapic_write(LAPIC_TIMER_ICR, 0xFFFFFFFF);
+		udelay(10000);
+		elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CCR);
+		lapic_write(LAPIC_TIMER_ICR, 0);
+
+		lapic_timer_count = (elapsed * 100) / APIC_TIMER_HZ;
+		if (lapic_timer_count == 0)
+			lapic_timer_count = 100000;
+	}
+
+	/* Horloge periodique du processeur courant (tick du scheduler) */
+	void lapic_timer_start(void)
+	{
+		lapic_write(LAPIC_TIMER_DCR, 0x3);
+		lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | APIC_TIMER_VECTOR);
+		lapic_write(LAPIC_TIMER_ICR, lapic_timer_count);
+	}
+
+	/* Projette un IOAPIC, ses entrees sont masquees jusqu'a ioapic_route */
+	int ioapic_init(u32 phys, u32 gsi_base)
+	{
+		u32 pin;
+
+		if (ioapic != NULL)
+			return RETURN_OK;		/* un seul IOAPIC gere */
+		ioapic = (volatile u32*) ioremap(phys, PAGESIZE);
+		if (ioapic == NULL)
+			return ERROR_MEMORY;
+		ioapic_gsi_base = gsi_base;
+		ioapic_nr_pins = ((ioapic_read(IOAPIC_VER) >> 16) & 0xFF) + 1;
+		for (pin = 0; pin < ioapic_nr_pins; pin++)
+			ioapic_write(IOAPIC_REDTBL(pin), IOAPIC_MASKED);
+		return RETURN_OK;
+	}
+
+	int ioapic_present(void)
+	{
+		return ioapic != NULL;
+	}
+
+	/* Livre l'entree gsi au vecteur vector du processeur apic_id (mode fixe) */
+	void ioapic_route(u32 gsi, u32 vector, u32 flags, u32 apic_id)
+	{
+		u32 pin = gsi - ioapic_gsi_base;
+		u32 f;
+
+		if (ioapic == NULL || gsi < ioapic_gsi_base || pin >= ioapic_nr_pins)
+			return;
+		f = spin_lock_irqsave(&ioapic_lock);
+		ioapic_write(IOAPIC_REDTBL(pin), IOAPIC_MASKED);
+		ioapic_write(IOAPIC_REDTBL(pin) + 1, apic_id << 24);
+		ioapic_write(IOAPIC_REDTBL(pin), vector | flags);
+		spin_unlock_irqrestore(&ioapic_lock, f);
+	}
+
+	void ioapic_mask(u32 gsi, int masked)
+	{
+		u32 pin = gsi - ioapic_gsi_base;
+		u32 v, f;
+
+		if (ioapic == NULL || gsi < ioapic_gsi_base || pin >= ioapic_nr_pins)
+			return;
+		f = spin_lock_irqsave(&ioapic_lock);
+		v = ioapic_read(IOAPIC_REDTBL(pin));
+		if (masked)
+			v |= IOAPIC_MASKED;
+		else
+			v &= ~IOAPIC_MASKED;
+		ioapic_write(IOAPIC_REDTBL(pin), v);
+		spin_unlock_irqrestore(&ioapic_lock, f);
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <runtime/types.h>
+
+/*
+ *	APIC local : identifiant du processeur, IPI de demarrage des AP,
+ *	horloge des processeurs et acquittement des interruptions (une
+ *	ecriture MMIO). IOAPIC : routage des IRQ ISA quand il remplace le
+ *	PIC 8259 (voir irq.cc).
+ */
+
+#define LAPIC_DEFAULT_BASE	0xFEE00000
+
+#define LAPIC_ID			0x020
+#define LAPIC_VER			0x030
+#define LAPIC_TPR			0x080
+#define LAPIC_EOI			0x0B0
+#define LAPIC_SVR			0x0F0
+#define LAPIC_ESR			0x280
+#define LAPIC_ICR_LO		0x300
+#define LAPIC_ICR_HI		0x310
+#define LAPIC_LVT_TIMER		0x320
+#define LAPIC_LVT_LINT0		0x350
+#define LAPIC_LVT_LINT1		0x360
+#define LAPIC_LVT_ERR		0x370
+#define LAPIC_TIMER_ICR		0x380
+#define LAPIC_TIMER_CCR		0x390
+#define LAPIC_TIMER_DCR		0x3E0
+
+#define LAPIC_SVR_ENABLE	0x100
+#define LAPIC_LVT_MASKED	0x10000
+#define LAPIC_TIMER_PERIODIC	0x20000
+
+#define ICR_INIT			0x00000500
+#define ICR_STARTUP			0x00000600
+#define ICR_LEVEL_ASSERT	0x00004000
+#define ICR_LEVEL_TRIGGER	0x00008000
+#define ICR_PENDING			0x00001000
+
+#define APIC_TIMER_VECTOR	0x40
+#define SPURIOUS_VECTOR		0xEF	/* < IDTSIZE, bits 0-3 a 1 */
+
+#define APIC_TIMER_HZ		HZ		/* meme tick que le PIT (x86.h) */
+
+#define IOAPIC_REGSEL		0x00
+#define IOAPIC_WIN			0x10
+#define IOAPIC_VER			0x01
+#define IOAPIC_REDTBL(pin)	(0x10 + 2 * (pin))
+
+#define IOAPIC_MASKED		0x10000
+#define IOAPIC_LEVEL		0x08000
+#define IOAPIC_ACTIVE_LOW	0x02000
+
+/* flags MPS des tables MP et ACPI : polarite bits 0-1, declenchement bits 2-3 */
+#define MPS_POLARITY_LOW	0x3
+#define MPS_TRIGGER_LEVEL	0xC
+
+#define CPUID_APIC			0x00000200	/* cpuid(1).edx */
+
+extern "C" {
+	int		lapic_init(u32 phys);		/* projette les registres (BSP) */
+	int		lapic_present(void);
+	void	lapic_enable(void);			/* active l'APIC du processeur courant */
+	u32		lapic_id(void);
+	void	lapic_eoi(void);
+	void	lapic_send_ipi(u32 apic_id, u32 icr);
+	void	lapic_timer_calibrate(void);
+	void	lapic_timer_start(void);
+	void	udelay(u32 us);				/* attente active sur le PIT (canal 2) */
+
+	int		ioapic_init(u32 phys, u32 gsi_base);
+	int		ioapic_present(void);
+	void	ioapic_route(u32 gsi, u32 vector, u32 flags, u32 apic_id);
+	void	ioapic_mask(u32 gsi, int masked);
+}
+
+#endif
@@ -1,12 +1,26 @@
 #include <os.h>
 #include <x86.h>
-
-/* Stack pointer */
-extern u32 *		stack_ptr;
+#include <pci.h>
 
 /* Current cpu name */
 static char cpu_name[512] = "x86-noname";
 
+/*
+ * Load average: exponentially damped average of the number of runnable
+ * processes, sampled every 5 seconds (fixed point, 11 bits of fraction).
+ */
+#define LOAD_FREQ	(5*HZ)
+#define FSHIFT		11
+#define FIXED_1		(1<<FSHIFT)
+#define EXP_1		1884		/* FIXED_1/exp(5s/1min) */
+#define EXP_5		2014		/* FIXED_1/exp(5s/5min) */
+#define EXP_15		2037		/* FIXED_1/exp(5s/15min) */
+
+static u32 avenrun[3];
+static volatile u32 sys_ticks=0;	/* ticks of the system clock since boot */
+
+static void sched_tick(u32 irq,void* data);
+
 
 /* Detect the type of processor */
 char* Architecture::detect(){
@@ -30,13 +44,122 @@ void Architecture::init(){
 		
 	 io.print("Configure PIC \n");
 		 init_pic();
+		 init_pit();
+		 init_irq();
+		 install_irq(0,sched_tick,NULL);
+		 install_irq(1,isr_kbd_int,NULL);
+
+	 io.print("Calibrate TSC \n");
+		 init_tsc();
+
+	 io.print("Configure FPU \n");
+		 init_fpu();
+
+	 io.print("Configure sysenter \n");
+		 init_sysenter();
+
+	 io.print("Scanning PCI bus \n");
+		 pci_init();
 	 
 	 io.print("Loading Task Register \n");
 		 asm("	movw $0x38, %ax; ltr %ax");	 
 }
 
+static u32 calc_load(u32 load,u32 exp,u32 n){
+	return (load*exp + n*FIXED_1*(FIXED_1-exp)) >> FSHIFT;
+}
+
+/* Number of runnable processes, the idle threads excluded */
+static u32 count_runnable(){
+	Process* p;
+	u32 n=0,i;
+	
+	spin_lock(&arch.proc_lock);
+	for (p=arch.plist;p!=NULL;p=p->getPNext()){
+		if (!p->isRunnable())
+			continue;
+		for (i=0;i<smp_ncpu;i++)
+			if (cpus[i].idle==p)
+				break;
+		if (i==smp_ncpu)
+			n++;
+	}
+	spin_unlock(&arch.proc_lock);
+	return n;
+}
+
+/* Handler of the system clock (IRQ 0, or the APIC timer of the BSP) */
+static void sched_tick(u32 irq,void* data){
+	u32 n;
+	
+	timer_tick();
+	if (++sys_ticks % LOAD_FREQ != 0)
+		return;
+	n=count_runnable();
+	avenrun[0]=calc_load(avenrun[0],EXP_1,n);
+	avenrun[1]=calc_load(avenrun[1],EXP_5,n);
+	avenrun[2]=calc_load(avenrun[2],EXP_15,n);
+}
+
+/* Load average over 1, 5 and 15 minutes (i=0,1,2), multiplied by 100 */
+u32 Architecture::getLoadAvg(u32 i){
+	if (i>2)
+		return 0;
+	return (avenrun[i]*100) >> FSHIFT;
+}
+
+/* Ticks of the system clock since boot (HZ per second) */
+u32 Architecture::getTicks(){
+	return sys_ticks;
+}
+
+/* Cycle counter of the cpu time accounting */
+u64 Architecture::getCycles(){
+	return cpu_cycles();
+}
+
+/* Frequency of the cycle counter in kHz, 0 without TSC */
+u32 Architecture::getCyclesKhz(){
+	return tsc_khz;
+}
+
+/* Start the sampling of the profiler (PROF_SRC_*), return its frequency */
+int Architecture::startProfiler(u32 source){
+	return prof_start(source);
+}
+
+/* Stop the sampling of the profiler */
+void Architecture::stopProfiler(){
+	prof_stop();
+}
+
+/* Idle thread: wait for the next interruption */
+static void idle_loop(void* arg){
+	for (;;)
+		asm("sti; hlt");
+}
+
+/* Return address of the kernel threads */
+static void kthread_exit(){
+	arch.pcurrent->exit();
+	for (;;)
+		arch.yield();
+}
+
 /* Initialise the list of processus */
 void Architecture::initProc(){
+	int i;
+	spin_lock_init(&proc_lock);
+	for (i=0;i<PID_HASH_SIZE;i++)
+		pid_hash[i]=NULL;
+	plist=NULL;
+	pcurrent=NULL;
+	for (i=0;i<(int)smp_ncpu;i++){
+		INIT_LIST_HEAD(&cpus[i].rq);
+		cpus[i].nr_tasks=0;
+		cpus[i].idle=NULL;
+	}
+	
 	firstProc= new Process("kernel");
 	firstProc->setState(ZOMBIE);
 	firstProc->addFile(fsm.path("/dev/tty"),0);
@@ -44,11 +167,64 @@ void Architecture::initProc(){
 	firstProc->addFile(fsm.path("/dev/tty"),0);
 	
 	
-	plist=firstProc;
 	pcurrent=firstProc; 
-	pcurrent->setPNext(NULL);
 	process_st* current=pcurrent->getPInfo();
 	current->regs.cr3 = (u32) pd0;
+	current->running = 1;
+	
+	createIdle(cpu_self());
+}
+
+/*
+ * Create the idle thread of a processor: it is in no run queue and never
+ * migrates, the stack of an AP idle thread is its boot stack.
+ */
+void Architecture::createIdle(cpu_info* c){
+	Process* p=new Process("idle");
+	rq_del(p);		//before it is runnable, nobody may steal it
+	p->kcreate(idle_loop,NULL);
+	c->idle=p;
+}
+
+/* Switch to the APICs and start the other processors (after initProc, see smp.cc) */
+void Architecture::initSmp(){
+	smp_init();
+}
+
+/* Number of running processors */
+u32 Architecture::getCpuCount(){
+	return smp_ncpu;
+}
+
+/* The kernel process, father of the orphans */
+Process* Architecture::getKernelProc(){
+	return firstProc;
+}
+
+/* Give the processor to another process (int 0x81 -> schedule) */
+void Architecture::yield(){
+	if (pcurrent==NULL)
+		return;
+	asm("int %0"::"i"(YIELD_VECTOR));
+}
+
+/*
+ * The next schedule of this processor elects pid if it is runnable, without
+ * waiting its turn in the run queue (direct switch of the synchronous IPC).
+ * A pid and not a Process : it may exit before the schedule.
+ */
+void Architecture::handoff(u32 pid){
+	u32 flags=local_irq_save();		//no migration between cpu_self() and the write
+	cpu_self()->handoff=pid;
+	local_irq_restore(flags);
+}
+
+/* The irqs stay off until the yield : the schedule runs on the processor of the hint */
+void Architecture::yieldTo(u32 pid){
+	u32 flags=local_irq_save();
+	cpu_self()->handoff=pid;
+	yield();
+	local_irq_restore(flags);
 }
 
 /* Reboot the computer */
@@ -64,32 +240,264 @@ void Architecture::shutdown(){
 	// todo
 }
 
-/* Install a interruption handler */
-void Architecture::install_irq(int_handler h){
-	// todo
+/*
+ * Add a handler on an irq line, several handlers can share a line. The
+ * handlers run with the interruptions disabled and have to be short:
+ * the long work is deferred with raise_softirq() or tasklet_schedule().
+ */
+int Architecture::install_irq(u32 irq,irq_handler h,void* data){
+	return irq_install(irq,h,data);
+}
+
+/* Remove a handler of an irq line */
+int Architecture::remove_irq(u32 irq,irq_handler h,void* data){
+	return irq_remove(irq,h,data);
+}
+
+/* Number of interruptions received on a line */
+u32 Architecture::getIrqCount(u32 irq){
+	return irq_count(irq);
+}
+
+/* Add p to the run queue of c */
+void Architecture::rq_add(Process* p,cpu_info* c){
+	process_st* info=p->getPInfo();
+	u32 flags=spin_lock_irqsave(&c->rq_lock);
+	list_add(&info->rq_list,c->rq.prev);
+	info->cpu=c->id;
+	c->nr_tasks++;
+	spin_unlock_irqrestore(&c->rq_lock,flags);
+}
+
+/* Remove p from the run queue of its processor */
+void Architecture::rq_del(Process* p){
+	process_st* info=p->getPInfo();
+	cpu_info* c;
+	u32 flags;
+	
+	for (;;){
+		c=&cpus[info->cpu];
+		flags=spin_lock_irqsave(&c->rq_lock);
+		if (info->cpu==c->id)
+			break;
+		spin_unlock_irqrestore(&c->rq_lock,flags);	//migrated meanwhile
+	}
+	list_del(&info->rq_list);
+	c->nr_tasks--;
+	spin_unlock_irqrestore(&c->rq_lock,flags);
+}
+
+/*
+ * Round robin in the run queue of c (rq_lock held): the first runnable
+ * process which is not on another processor goes to the tail
+ */
+Process* Architecture::rq_pick(cpu_info* c,Process* prev){
+	process_st* info;
+	Process* p;
+	
+	list_for_each_entry(info,&c->rq,rq_list){
+		p=(Process*)info->vinfo;
+		if (p->isRunnable() && (!info->running || p==prev)){
+			list_del(&info->rq_list);
+			list_add(&info->rq_list,c->rq.prev);
+			info->running=1;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Take a waiting process from the run queue of another processor. Only
+ * one run queue lock is held at a time.
+ */
+Process* Architecture::rq_steal(cpu_info* c){
+	process_st* info;
+	Process* p;
+	cpu_info* v;
+	u32 i;
+	
+	for (i=1;i<smp_ncpu;i++){
+		v=&cpus[(c->id+i)%smp_ncpu];
+		spin_lock(&v->rq_lock);
+		list_for_each_entry(info,&v->rq,rq_list){
+			p=(Process*)info->vinfo;
+			if (p->isRunnable() && !info->running){
+				info->running=1;
+				list_del(&info->rq_list);
+				v->nr_tasks--;
+				spin_unlock(&v->rq_lock);
+				
+				spin_lock(&c->rq_lock);
+				list_add(&info->rq_list,c->rq.prev);
+				info->cpu=c->id;
+				c->nr_tasks++;
+				spin_unlock(&c->rq_lock);
+				return p;
+			}
+		}
+		spin_unlock(&v->rq_lock);
+	}
+	return NULL;
+}
+
+/*
+ * Take p for c if it waits in a run queue, moved to the tail of the run
+ * queue of c. Only one run queue lock is held at a time. The caller keeps
+ * p alive (proc_lock held for a handoff).
+ */
+Process* Architecture::rq_take(cpu_info* c,Process* p){
+	process_st* info=p->getPInfo();
+	cpu_info* v=&cpus[info->cpu];
+	
+	spin_lock(&v->rq_lock);
+	if (info->cpu!=v->id || !p->isRunnable() || info->running){
+		spin_unlock(&v->rq_lock);
+		return NULL;
+	}
+	info->running=1;
+	list_del(&info->rq_list);
+	if (v==c){
+		list_add(&info->rq_list,c->rq.prev);
+		spin_unlock(&c->rq_lock);
+		return p;
+	}
+	v->nr_tasks--;
+	spin_unlock(&v->rq_lock);
+	
+	spin_lock(&c->rq_lock);
+	list_add(&info->rq_list,c->rq.prev);
+	info->cpu=c->id;
+	c->nr_tasks++;
+	spin_unlock(&c->rq_lock);
+	return p;
+}
+
+/*
+ * Choose the next process of the running processor (interruptions
+ * disabled): the process handed off to it, its own run queue, then the
+ * waiting processes of the other processors, then its idle thread.
+ */
+Process* Architecture::pickNext(Process* prev){
+	cpu_info* c=cpu_self();
+	Process* n=NULL;
+	
+	if (c->handoff!=0){
+		//proc_lock held until p is taken : kworker can not free it meanwhile
+		spin_lock(&proc_lock);
+		n=pid_lookup(c->handoff);
+		c->handoff=0;
+		if (n!=NULL && n!=prev)
+			n=rq_take(c,n);
+		else
+			n=NULL;
+		spin_unlock(&proc_lock);
+	}
+	
+	if (n==NULL){
+		spin_lock(&c->rq_lock);
+		n=rq_pick(c,prev);
+		spin_unlock(&c->rq_lock);
+	}
+	
+	if (n==NULL)
+		n=rq_steal(c);
+	if (n==NULL){
+		n=(c->idle!=NULL) ? c->idle : prev;
+		n->getPInfo()->running=1;
+	}
+	
+	c->current=n;
+	return n;
 }
 
-/* Add a process to the scheduler */
+/* Add a process to the scheduler, the pid hash and the childs of its father */
 void Architecture::addProcess(Process* p){
+	Process* father=p->getPParent();
+	u32 h=pid_hashfn(p->getPid());
+	cpu_info* c=&cpus[0];
+	u32 i;
+	
+	//the least loaded processor, idle processors steal the others
+	for (i=1;i<smp_ncpu;i++)
+		if (cpus[i].nr_tasks<c->nr_tasks)
+			c=&cpus[i];
+	rq_add(p,c);
+	
+	u32 flags=spin_lock_irqsave(&proc_lock);
+	
+	p->setPPrev(NULL);
 	p->setPNext(plist);
+	if (plist!=NULL)
+		plist->setPPrev(p);
 	plist=p;
+	
+	p->setPHash(pid_hash[h]);
+	pid_hash[h]=p;
+	
+	p->setPChild(NULL);
+	p->setPSibling(NULL);
+	if (father!=NULL){
+		p->setPSibling(father->getPChild());
+		father->setPChild(p);
+	}
+	spin_unlock_irqrestore(&proc_lock,flags);
+}
+
+/* Find a process by its pid */
+Process* Architecture::findProcess(u32 pid){
+	u32 flags=spin_lock_irqsave(&proc_lock);
+	Process* p=pid_lookup(pid);
+	spin_unlock_irqrestore(&proc_lock,flags);
+	return p;
+}
+
+/* Find a process in the pid hash (proc_lock held) */
+Process* Architecture::pid_lookup(u32 pid){
+	Process* p=pid_hash[pid_hashfn(pid)];
+	while (p!=NULL && p->getPid()!=pid)
+		p=p->getPHash();
+	return p;
+}
+
+/* Remove a process from the childs of its father (proc_lock held) */
+void Architecture::unlink_child(Process* p){
+	Process* father=p->getPParent();
+	Process* c;
+	if (father==NULL)
+		return;
+		
+	if (father->getPChild()==p){
+		father->setPChild(p->getPSibling());
+	}
+	else{
+		c=father->getPChild();
+		while (c!=NULL && c->getPSibling()!=p)
+			c=c->getPSibling();
+		if (c!=NULL)
+			c->setPSibling(p->getPSibling());
+	}
+	p->setPSibling(NULL);
 }
 
 /* Fork a process */
 int Architecture::fork(process_st* info,process_st* father){
 	memcpy((char*)info,(char*)father,sizeof(process_st));
 	info->pd = pd_copy(father->pd);
+	fpu_copy(info,father);
 }
 
 /* Initialise a new process */
-int Architecture::createProc(process_st* info, char* file, int argc, char** argv){
+int Architecture::createProc(process_st* info, char* file, File* fp, int argc, char** argv){
 	page *kstack;
 	process_st *previous;
-	process_st *current;
+	list_head *p, *n;
+	page *pg;
 
-	char **param, **uparam;
-	u32 stackp;
+	char *args = NULL;
+	u32 stackp, argsize, strsize, len;
 	u32 e_entry; 
+	u32 prev_cr3;
 
 	
 	int pid;
@@ -99,13 +507,20 @@ int Architecture::createProc(process_st* info, char* file, int argc, char** argv
 
 	info->pid = pid;
 	
+	/*
+	 * Les chaines de argv ne sont plus visibles apres le changement de
+	 * cr3 : elles sont copiees a la suite dans un seul bloc noyau.
+	 */
+	strsize = 0;
+	for (i=0 ; i<argc ; i++)
+		strsize += strlen(argv[i]) + 1;
+	argsize = 16 + strsize + (argc + 3) * sizeof(char*) + 16;
 	if (argc) {
-		param = (char**) kmalloc(sizeof(char*) * (argc+1));
-		for (i=0 ; i<argc ; i++) {
-			param[i] = (char*) kmalloc(strlen(argv[i]) + 1);
-			strcpy(param[i], argv[i]);
+		args = (char*) kmalloc(strsize);
+		for (i=0, len=0 ; i<argc ; i++) {
+			strcpy(args + len, argv[i]);
+			len += strlen(argv[i]) + 1;
 		}
-		param[i] = 0;
 	}
 	
 	info->pd = pd_create();
@@ -114,47 +529,59 @@ int Architecture::createProc(process_st* info, char* file, int argc, char** argv
 	INIT_LIST_HEAD(&(info->pglist));
 
 
+	/*
+	 * Le chargement se fait dans l'espace d'adressage du nouveau processus
+	 * avec les interruptions actives : le cr3 sauve du processus courant est
+	 * modifie en premier pour qu'une preemption dans cette fenetre reprenne
+	 * sur le bon repertoire. Les pages sont allouees explicitement
+	 * (pd_alloc_user), un #PF les affecterait au processus courant.
+	 */
 	previous = arch.pcurrent->getPInfo();
-	current=info;
-	
+	prev_cr3 = previous->regs.cr3;
+	previous->regs.cr3 = (u32) info->pd->base->p_addr;
 	asm("mov %0, %%eax; mov %%eax, %%cr3"::"m"((info->pd)->base->p_addr));
 	
-	e_entry = (u32) load_elf(file,info);
+	if (fp != NULL)
+		e_entry = load_elf_file(fp, info);	/* segments lus dans l'espace du processus */
+	else
+		e_entry = (u32) load_elf(file,info);
+	if (e_entry != 0 && pd_alloc_user(info, (char*) (USER_STACK - argsize), (char*) USER_STACK) < 0)
+		e_entry = 0;
 
 	if (e_entry == 0) {	
-		for (i=0 ; i<argc ; i++) 
-			kfree(param[i]);
-		kfree(param);
-		arch.pcurrent = (Process*) previous->vinfo;
-		current=arch.pcurrent->getPInfo();
-		asm("mov %0, %%eax ;mov %%eax, %%cr3"::"m" (current->regs.cr3));
+		if (args != NULL)
+			kfree(args);
+		previous->regs.cr3 = prev_cr3;
+		asm("mov %0, %%eax ;mov %%eax, %%cr3"::"m" (previous->regs.cr3));
+		list_for_each_safe(p, n, &info->pglist) {
+			pg = list_entry(p, struct page, list);
+			release_page_frame(pg->p_addr);
+			list_del(p);
+			kfree(pg);
+		}
 		pd_destroy(info->pd);
+		info->pd = NULL;
 		return -1;
 	}
 
-
 	stackp = USER_STACK - 16;
 
 
 	if (argc) {
-		uparam = (char**) kmalloc(sizeof(char*) * argc);
-
-		for (i=0 ; i<argc ; i++) {
-			stackp -= (strlen(param[i]) + 1);
-			strcpy((char*) stackp, param[i]);
-			uparam[i] = (char*) stackp;
-		}
+		/* le bloc des chaines en une copie, argv[] pointe dedans */
+		stackp -= strsize;
+		memcpy((char*) stackp, args, strsize);
+		len = stackp;
 
 		stackp &= 0xFFFFFFF0;	
 
 		// Creation des arguments de main() : argc, argv[]... 
-		stackp -= sizeof(char*);
-		*((char**) stackp) = 0;
-
-		for (i=argc-1 ; i>=0 ; i--) {		
-			stackp -= sizeof(char*);
-			*((char**) stackp) = uparam[i]; 
+		stackp -= sizeof(char*) * (argc + 1);
+		for (i=0 ; i<argc ; i++) {
+			((char**) stackp)[i] = (char*) len;
+			len += strlen((char*) len) + 1;
 		}
+		((char**) stackp)[argc] = 0;
 
 		stackp -= sizeof(char*);	
 		*((char**) stackp) = (char*) (stackp + 4); 
@@ -164,11 +591,7 @@ int Architecture::createProc(process_st* info, char* file, int argc, char** argv
 
 		stackp -= sizeof(char*);
 
-		for (i=0 ; i<argc ; i++) 
-			kfree(param[i]);
-
-		kfree(param);
-		kfree(uparam);
+		kfree(args);
 	}
 
 	
@@ -206,30 +629,66 @@ int Architecture::createProc(process_st* info, char* file, int argc, char** argv
 	for(i=0 ; i<32 ; i++)
 		info->sigfn[i] = (char*) SIG_DFL;
 
-	arch.pcurrent = (Process*) previous->vinfo;
-	current=arch.pcurrent->getPInfo();
-	asm("mov %0, %%eax ;mov %%eax, %%cr3":: "m"(current->regs.cr3));
+	info->fpu_state = NULL;
+
+	previous->regs.cr3 = prev_cr3;
+	asm("mov %0, %%eax ;mov %%eax, %%cr3":: "m"(previous->regs.cr3));
 	
 	return 1;
 }
 
 
-// Destroy a process
-void Architecture::destroy_process(Process* pp){
-	disable_interrupt();
+/*
+ * Initialise a kernel thread: no user space (cr3=pd0), ring 0 segments and
+ * a kernel stack page. fn(arg) returns into kthread_exit.
+ */
+int Architecture::createKThread(process_st* info,kthread_fn fn,void* arg){
+	page *kstack;
+	u32 *sp;
+	int i;
 	
-	u16 kss;
-	u32 kesp;
-	u32 accr3;
-	list_head *p, *n;
-	page *pg;
-	process_st *proccurrent=(arch.pcurrent)->getPInfo();
-	process_st *pidproc=pp->getPInfo();
+	kstack = get_page_from_heap();
+	sp = (u32*) (kstack->v_addr + PAGESIZE - 16);
+	*(--sp) = (u32) arg;
+	*(--sp) = (u32) kthread_exit;
+	
+	INIT_LIST_HEAD(&(info->pglist));
+	info->pd = NULL;
+	
+	info->regs.ss = 0x18;
+	info->regs.esp = (u32) sp;
+	info->regs.eflags = 0x200;
+	info->regs.cs = 0x08;
+	info->regs.eip = (u32) fn;
+	info->regs.ds = 0x10;
+	info->regs.es = 0x10;
+	info->regs.fs = 0x10;
+	info->regs.gs = PERCPU_SEL;
+	info->regs.cr3 = (u32) pd0;
+	
+	info->kstack.ss0 = 0x18;
+	info->kstack.esp0 = (u32) kstack->v_addr + PAGESIZE - 16;
+	kfree(kstack);
 	
+	info->signal = 0;
+	for(i=0 ; i<32 ; i++)
+		info->sigfn[i] = (char*) SIG_DFL;
+	info->fpu_state = NULL;
 	
-	// Switch page to the process to destroy
-	asm("mov %0, %%eax ;mov %%eax, %%cr3"::"m" (pidproc->regs.cr3));
+	return 1;
+}
 
+
+/*
+ * Destroy a process. The memory is freed with the interruptions enabled:
+ * the pages tables of the kernel space are shared by all the pages
+ * directories, there is no need to switch to the destroyed process.
+ */
+void Architecture::destroy_process(Process* pp){
+	list_head *p, *n;
+	page *pg;
+	process_st *pidproc=pp->getPInfo();
+	u32 flags;
 	
 	// Free process memory:
 	//  - pages used by the executable code
@@ -245,72 +704,95 @@ void Architecture::destroy_process(Process* pp){
 		kfree(pg);
 	}
 	
-	release_page_from_heap((char *) ((u32)pidproc->kstack.esp0 & 0xFFFFF000));
+	if (pidproc->kstack.esp0 != 0)
+		release_page_from_heap((char *) ((u32)pidproc->kstack.esp0 & 0xFFFFF000));
 
-	// Free pages directory
-	asm("mov %0, %%eax; mov %%eax, %%cr3"::"m"(pd0));
-
-	pd_destroy(pidproc->pd);
+	fpu_release(pidproc);
 
-	asm("mov %0, %%eax ;mov %%eax, %%cr3"::"m" (proccurrent->regs.cr3));
+	// Free pages directory
+	if (pidproc->pd != NULL)
+		pd_destroy(pidproc->pd);
+	pidproc->pd = NULL;
+	
+	rq_del(pp);
+	
+	flags=spin_lock_irqsave(&proc_lock);
 	
 	// Remove from the list
-	if (plist==pp){
+	if (pp->getPPrev()!=NULL)
+		pp->getPPrev()->setPNext(pp->getPNext());
+	else
 		plist=pp->getPNext();
-	}
-	else{
-		Process* l=plist;
-		Process*ol=plist;
-		while (l!=NULL){
-			
-			if (l==pp){
-				ol->setPNext(pp->getPNext());
-			}
-			
-			ol=l;
-			l=l->getPNext();
-		}
-	}
+	if (pp->getPNext()!=NULL)
+		pp->getPNext()->setPPrev(pp->getPPrev());
 	
-	enable_interrupt();
+	// Remove from the pid hash
+	Process** h=&pid_hash[pid_hashfn(pp->getPid())];
+	while (*h!=NULL && *h!=pp)
+		h=(*h)->getPHashRef();
+	if (*h!=NULL)
+		*h=pp->getPHash();
+	
+	// Remove from the childs of the father
+	unlink_child(pp);
+	
+	spin_unlock_irqrestore(&proc_lock,flags);
 }
 
 
+/*
+ * Give the childs of pe to pere, the orphans are adopted by the kernel
+ * process and the zombies among them are released (it never waits)
+ */
 void Architecture::change_process_father(Process* pe, Process* pere){
-	Process* p=plist;
-	Process* pn=NULL;
+	Process* p;
+	Process* last=NULL;
+	u32 flags=spin_lock_irqsave(&proc_lock);
+	
+	if (pere==NULL || pere==pe)
+		pere=firstProc;
+	
+	p=pe->getPChild();
 	while (p!=NULL){
-		pn=p->getPNext();
-		if (p->getPParent()==pe){
-			p->setPParent(pere);
-		}
-		
-		p=pn;
+		p->setPParent(pere);
+		if (pere==firstProc && p->getState()==ZOMBIE)
+			p->release();
+		last=p;
+		p=p->getPSibling();
 	}
-}
-
-
-void Architecture::destroy_all_zombie(){
-	Process* p=plist;
-	Process* pn=NULL;
-	while (p!=NULL){
-		pn=p->getPNext();
-		if (p->getState()==ZOMBIE && p->getPid()!=1){
-			destroy_process(p);
-			delete p;
-		}
-		
-		p=pn;
+	
+	if (last!=NULL){
+		last->setPSibling(pere->getPChild());
+		pere->setPChild(pe->getPChild());
 	}
+	pe->setPChild(NULL);
+	spin_unlock_irqrestore(&proc_lock,flags);
 }
 
-/* Set the syscall arguments */
-void Architecture::setParam(u32 ret, u32 ret1, u32 ret2, u32 ret3,u32 ret4){
-	ret_reg[0]=ret;
-	ret_reg[1]=ret1;
-	ret_reg[2]=ret2;
-	ret_reg[3]=ret3;
-	ret_reg[4]=ret4;
+/* 
+ * Unlink the first zombie child of parent matching pid (any child if
+ * pid<=0) and queue its teardown to kworker. Return its pid or 0, the
+ * other zombies stay linked for the next wait().
+ */
+u32 Architecture::reap_zombies(Process* parent,int pid){
+	Process* p;
+	u32 ret=0;
+	u32 flags=spin_lock_irqsave(&proc_lock);
+	
+	for (p=parent->getPChild();p!=NULL;p=p->getPSibling()){
+		if (p->getState()!=ZOMBIE || p==firstProc)
+			continue;
+		if (pid>0 && p->getPid()!=(u32)pid)
+			continue;
+		ret=p->getPid();
+		unlink_child(p);
+		p->setPParent(NULL);
+		p->release();
+		break;
+	}
+	
+	spin_unlock_irqrestore(&proc_lock,flags);
+	return ret;
 }
 
 /* Enable the interruption */
@@ -325,13 +807,30 @@ void Architecture::disable_interrupt(){
 
 /* Get a syscall argument */
 u32	Architecture::getArg(u32 n){
-	if (n<5)
-		return ret_reg[n];
-	else
-		return 0;
+	syscall_frame* frame=pcurrent->getPInfo()->sframe;
+	switch (n){
+		case 0:	return frame->ebx;
+		case 1:	return frame->ecx;
+		case 2:	return frame->edx;
+		case 3:	return frame->edi;
+		case 4:	return frame->esi;
+		default: return 0;
+	}
+}
+
+/* Set a register of the syscall frame, ebx edi and esi survive sysexit */
+void Architecture::setArg(u32 n,u32 v){
+	syscall_frame* frame=pcurrent->getPInfo()->sframe;
+	switch (n){
+		case 0:	frame->ebx=v; break;
+		case 1:	frame->ecx=v; break;
+		case 2:	frame->edx=v; break;
+		case 3:	frame->edi=v; break;
+		case 4:	frame->esi=v; break;
+	}
 }
 
 /* Set the return value of syscall */
 void Architecture::setRet(u32 ret){
-	stack_ptr[14] = ret;
+	pcurrent->getPInfo()->sframe->eax = ret;
 }
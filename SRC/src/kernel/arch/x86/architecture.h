@@ -3,8 +3,21 @@
 
 #include <runtime/types.h>
 
+#include <spinlock.h>
+#include <smp.h>
 #include <process.h>
 
+#define PID_HASH_SIZE	64		/* power of 2 */
+#define pid_hashfn(pid)	((pid) & (PID_HASH_SIZE - 1))
+
+/** current process of the running processor (cpu_info.current) **/
+class CurrentProcess
+{
+	public:
+		operator Process*()		{ return cpu_self()->current; }
+		Process* operator->()	{ return cpu_self()->current; }
+		CurrentProcess& operator=(Process* p)	{ cpu_self()->current=p; return *this; }
+};
 
 /** Processor architecture class **/
 class Architecture
@@ -15,30 +28,57 @@ class Architecture
 		void	reboot();		/* reboot the computer */
 		void	shutdown();		/* shutdown the computer */
 		char*	detect();		/* detect the type of processor */
-		void	install_irq(int_handler h);	/* install a interruption handler */
+		int		install_irq(u32 irq,irq_handler h,void* data);	/* add a handler on an irq line */
+		int		remove_irq(u32 irq,irq_handler h,void* data);	/* remove a handler of an irq line */
+		u32		getIrqCount(u32 irq);	/* number of interruptions received on a line */
 		void	addProcess(Process* p);		/* add a process to the scheduler */
+		Process*	pickNext(Process* prev);	/* choose the next process of the running processor */
+		void	createIdle(cpu_info* c);	/* create the idle thread of a processor */
+		Process*	findProcess(u32 pid);	/* find a process by its pid */
+		Process*	pid_lookup(u32 pid);	/* the same, proc_lock held */
 		void	enable_interrupt();		/* enable the interruption */
 		void	disable_interrupt();	/* disable the interruption */
-		int 	createProc(process_st* info,char* file,int argc,char** argv);	/* initialise a process */
-		void	setParam(u32 ret,u32 ret1,u32 ret2, u32 ret3,u32 ret4);		/* set the syscall arguments */
+		int 	createProc(process_st* info,char* file,File* fp,int argc,char** argv);	/* initialise a process from an image or a file */
+		int		createKThread(process_st* info,kthread_fn fn,void* arg);	/* initialise a kernel thread */
+		void	yield();			/* give the processor to another process */
+		void	handoff(u32 pid);	/* pid runs next on this processor */
+		void	yieldTo(u32 pid);	/* give the processor to pid */
 		u32		getArg(u32 n);		/* get a syscall argument */
+		void	setArg(u32 n,u32 v);	/* set a syscall register returned to user */
 		void	setRet(u32 ret);	/* set the return value of syscall */
 		void 	initProc();			/* initialise the list of processus */
+		void	initSmp();			/* switch to the APICs, start the other processors */
+		u32		getCpuCount();		/* number of running processors */
+		u32		getLoadAvg(u32 i);	/* load average x100 over 1, 5, 15 minutes */
+		u32		getTicks();			/* ticks of the system clock since boot */
+		u64		getCycles();		/* cycle counter of the cpu time accounting */
+		u32		getCyclesKhz();		/* its frequency in kHz */
+		int		startProfiler(u32 source);	/* start the sampling, return its frequency */
+		void	stopProfiler();		/* stop the sampling */
 		void	destroy_process(Process* pp);	/* destroy a processus */
-		void	destroy_all_zombie();
+		u32		reap_zombies(Process* parent,int pid);	/* release one zombie child */
 		void	change_process_father(Process* p,Process* pere);
 		int		fork(process_st* info,process_st* father);	/* fork a process */
+		Process*	getKernelProc();	/* the kernel process, father of the orphans */
 		
 		
 		/** architecture public class attributes */
-		Process*	pcurrent;		/* the current processus */
+		CurrentProcess	pcurrent;	/* the current processus */
 		Process*	plist;			/* the chain list of processus */
+		spinlock_t	proc_lock;		/* protect plist, the pid hash and the childs lists */
 		
 		
 	private:
 		/** architecture private attributes **/
-		u32			ret_reg[5];
 		Process* 	firstProc;
+		Process*	pid_hash[PID_HASH_SIZE];	/* processus indexed by pid */
+		
+		void	unlink_child(Process* p);
+		void	rq_add(Process* p,cpu_info* c);
+		void	rq_del(Process* p);
+		Process*	rq_pick(cpu_info* c,Process* prev);
+		Process*	rq_steal(cpu_info* c);
+		Process*	rq_take(cpu_info* c,Process* p);
 		
 };
 
@@ -5,6 +5,8 @@
 
 extern "C" {
 
+struct syscall_frame;
+
 #define KERNELMODE	0
 #define USERMODE	1
 
@@ -41,6 +43,26 @@ extern "C" {
 		void* sigfn[32];
 
 		void*	vinfo;
+
+		/* FPU/SSE context, allocated on the first FPU use (see isr_NM_exc) */
+		char*	fpu_state;
+
+		/* registers of the syscall in progress */
+		struct syscall_frame*	sframe;
+
+		/* run queue of the processor cpu (see smp.h) */
+		list_head		rq_list;
+		u32				cpu;
+		volatile u32	running;	/* on a processor, or its stack still in use */
+
+		/* cpu time accounting in rdtsc cycles (see acct_charge in x86.cc) */
+		u64		utime;			/* user mode */
+		u64		stime;			/* kernel mode, syscalls and interruptions */
+		u64		wtime;			/* runnable but waiting in a run queue */
+		u64		acct_stamp;		/* last time charged */
+		u64		wait_stamp;		/* start of the run queue wait, 0 if none */
+		u32		nvcsw;			/* voluntary context switches (blocked) */
+		u32		nivcsw;			/* involuntary (preempted) */
 		
 	} __attribute__ ((packed));
 }
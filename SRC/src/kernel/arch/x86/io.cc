@@ -47,6 +47,23 @@ u32	Io::inl(u32 ad){
 	return _v;
 }
 
+/* transferts de chaines : une instruction pour tout le buffer */
+void Io::insw(u32 ad,void* buf,u32 count){
+	asmv("cld; rep insw" : "+D" (buf), "+c" (count) : "d" (ad) : "memory");
+}
+
+void Io::outsw(u32 ad,const void* buf,u32 count){
+	asmv("cld; rep outsw" : "+S" (buf), "+c" (count) : "d" (ad));
+}
+
+void Io::insl(u32 ad,void* buf,u32 count){
+	asmv("cld; rep insl" : "+D" (buf), "+c" (count) : "d" (ad) : "memory");
+}
+
+void Io::outsl(u32 ad,const void* buf,u32 count){
+	asmv("cld; rep outsl" : "+S" (buf), "+c" (count) : "d" (ad));
+}
+
 /* renvoie la position x du curseur */
 u32	Io::getX(){
 	return (u32)x;
@@ -282,10 +299,8 @@ u32 Io::read(char* buf,u32 count){
 	else{	//getchar
 		keystate=GETCHAR;
 	}
-	asm("sti");
 	inlock=1;
 	while (inlock == 1);
-	asm("cli");
 	strncpy(buf,inbuf,count);
 	return strlen(buf);
 }
\ No newline at end of file
@@ -48,6 +48,11 @@ class Io
 		u16		inw(u32 ad);			/* input word */
 		u32		inl(u32 ad);			/* input word */
 		
+		void	insw(u32 ad,void* buf,u32 count);		/* input count words (rep insw) */
+		void	outsw(u32 ad,const void* buf,u32 count);	/* output count words (rep outsw) */
+		void	insl(u32 ad,void* buf,u32 count);		/* input count dwords (rep insl) */
+		void	outsl(u32 ad,const void* buf,u32 count);	/* output count dwords (rep outsl) */
+		
 		void	putctty(char c);		/* put a byte on the console */
 		
 		u32 	read(char* buf,u32 count);	/* read a string in the console */
@@ -0,0 +1,273 @@
+#include <os.h>
+#include <x86.h>
+#include <apic.h>
+
+/*
+ *	Gestion des lignes IRQ : plusieurs handlers par ligne, compteurs et
+ *	acquittement (EOI). Les lignes passent par le PIC 8259 ou, quand
+ *	smp_init() trouve un IOAPIC, par l'IOAPIC avec un EOI a l'APIC local.
+ *	Le travail long est differe dans les softirqs/tasklets
+ *	(core/softirq.cc) executes en sortie d'IRQ.
+ */
+
+#define IRQ_MAX_ACTIONS		32		/* installable avant l'init du heap */
+
+struct irq_action {
+	irq_handler		handler;
+	void*			data;
+	irq_action*		next;
+};
+
+struct irq_desc {
+	irq_action*		action;
+	u32				count;		/* interruptions recues */
+	u32				unhandled;	/* sans handler installe */
+	u32				spurious;
+	spinlock_t		lock;
+};
+
+static irq_desc 	irq_table[NR_IRQS];
+static irq_action	irq_actions[IRQ_MAX_ACTIONS];
+static spinlock_t	irq_actions_lock = SPINLOCK_INIT;
+
+/* Masque du PIC, l'IRQ 2 (cascade) reste toujours active */
+static u16 pic_mask = 0xFFFF & ~(1 << 2);
+
+/* Routage IOAPIC : entree (GSI) et polarite/declenchement de chaque IRQ ISA */
+static int	irq_ioapic = 0;
+static u32	irq_gsi[NR_IRQS];
+static u32	irq_flags[NR_IRQS];
+
+static void pic_set_mask(void)
+{
+	io.outb(0x21, (u8) pic_mask);
+	io.outb(0xA1, (u8) (pic_mask >> 8));
+}
+
+extern "C" {
+
+	/* Demasque / masque une ligne IRQ */
+	void irq_enable_line(u32 irq)
+	{
+		u32 flags = local_irq_save();
+		pic_mask &= ~(1 << irq);
+		if (irq_ioapic)
+			ioapic_mask(irq_gsi[irq], 0);
+		else
+			pic_set_mask();
+		local_irq_restore(flags);
+	}
+
+	void irq_disable_line(u32 irq)
+	{
+		u32 flags = local_irq_save();
+		if (irq != 2)
+			pic_mask |= (1 << irq);
+		if (irq_ioapic)
+			ioapic_mask(irq_gsi[irq], 1);
+		else
+			pic_set_mask();
+		local_irq_restore(flags);
+	}
+
+	/*
+	 * Acquitte une IRQ : une ecriture dans l'APIC local, ou le maitre
+	 * toujours et l'esclave pour les IRQ 8-15
+	 */
+	void irq_eoi(u32 irq)
+	{
+		if (irq_ioapic) {
+			lapic_eoi();
+			return;
+		}
+		if (irq >= 8)
+			io.outb(0xA0, 0x20);
+		io.outb(0x20, 0x20);
+	}
+
+	/*
+	 * Les IRQ 7 et 15 peuvent etre fausses (ligne retombee avant
+	 * l'INTA) : le bit correspondant du registre ISR n'est alors pas mis
+	 * et il ne faut pas acquitter le PIC concerne.
+	 */
+	static int irq_is_spurious(u32 irq)
+	{
+		if (irq_ioapic)
+			return 0;		/* vecteur SPURIOUS_VECTOR a part */
+		if (irq == 7) {
+			io.outb(0x20, 0x0B);
+			return !(io.inb(0x20) & 0x80);
+		}
+		if (irq == 15) {
+			io.outb(0xA0, 0x0B);
+			if (!(io.inb(0xA0) & 0x80)) {
+				io.outb(0x20, 0x20);	/* le maitre a bien vu l'IRQ 2 */
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	/* Appelle les handlers d'une ligne, interruptions masquees */
+	void irq_handle(u32 irq)
+	{
+		irq_desc* d = &irq_table[irq];
+		irq_action* a;
+
+		d->count++;
+		trace(TRACE_IRQ_ENTER, irq, 0, 0);
+		spin_lock(&d->lock);
+		if (d->action == NULL)
+			d->unhandled++;
+		for (a = d->action; a != NULL; a = a->next)
+			a->handler(irq, a->data);
+		spin_unlock(&d->lock);
+		trace(TRACE_IRQ_EXIT, irq, 0, 0);
+	}
+
+	/* Point d'entree commun des IRQ 1 a 15 (voir INTERRUPT dans x86int.asm) */
+	void do_irq(int irq)
+	{
+		if (irq_is_spurious(irq)) {
+			irq_table[irq].spurious++;
+			return;
+		}
+		/* cadre de SAVE_REGS apres l'argument irq */
+		cpu_self()->irq_regs = (syscall_frame*) ((u32*) __builtin_frame_address(0) + 3);
+		irq_handle(irq);
+		irq_eoi(irq);
+		irq_exit();
+	}
+
+	/* Ajoute un handler sur une ligne et la demasque */
+	int irq_install(u32 irq, irq_handler h, void* data)
+	{
+		irq_action* a = NULL;
+		u32 flags;
+		int i;
+
+		if (irq >= NR_IRQS || h == NULL)
+			return ERROR_PARAM;
+
+		flags = spin_lock_irqsave(&irq_actions_lock);
+		for (i = 0; i < IRQ_MAX_ACTIONS; i++)
+			if (irq_actions[i].handler == NULL) {
+				a = &irq_actions[i];
+				a->handler = h;
+				break;
+			}
+		spin_unlock_irqrestore(&irq_actions_lock, flags);
+		if (a == NULL)
+			return ERROR_MEMORY;
+
+		a->data = data;
+		flags = spin_lock_irqsave(&irq_table[irq].lock);
+		a->next = irq_table[irq].action;
+		irq_table[irq].action = a;
+		spin_unlock_irqrestore(&irq_table[irq].lock, flags);
+
+		irq_enable_line(irq);
+		return RETURN_OK;
+	}
+
+	/* Retire un handler, la ligne est masquee quand il n'en reste plus */
+	int irq_remove(u32 irq, irq_handler h, void* data)
+	{
+		irq_action** pa;
+		irq_action* a = NULL;
+		u32 flags;
+
+		if (irq >= NR_IRQS)
+			return ERROR_PARAM;
+
+		flags = spin_lock_irqsave(&irq_table[irq].lock);
+		for (pa = &irq_table[irq].action; *pa != NULL; pa = &(*pa)->next)
+			if ((*pa)->handler == h && (*pa)->data == data) {
+				a = *pa;
+				*pa = a->next;
+				break;
+			}
+		if (irq_table[irq].action == NULL && irq != 0)
+			irq_disable_line(irq);
+		spin_unlock_irqrestore(&irq_table[irq].lock, flags);
+
+		if (a == NULL)
+			return ERROR_PARAM;
+
+		flags = spin_lock_irqsave(&irq_actions_lock);
+		a->handler = NULL;
+		spin_unlock_irqrestore(&irq_actions_lock, flags);
+		return RETURN_OK;
+	}
+
+	/* Nombre d'interruptions recues sur une ligne */
+	u32 irq_count(u32 irq)
+	{
+		if (irq >= NR_IRQS)
+			return 0;
+		return irq_table[irq].count;
+	}
+
+	/* IRQ ISA raccordee a une autre entree de l'IOAPIC (tables MP/ACPI) */
+	void irq_set_override(u32 irq, u32 gsi, u32 mps_flags)
+	{
+		if (irq >= NR_IRQS)
+			return;
+		irq_gsi[irq] = gsi;
+		irq_flags[irq] = 0;
+		if ((mps_flags & MPS_POLARITY_LOW) == MPS_POLARITY_LOW)
+			irq_flags[irq] |= IOAPIC_ACTIVE_LOW;
+		if ((mps_flags & MPS_TRIGGER_LEVEL) == MPS_TRIGGER_LEVEL)
+			irq_flags[irq] |= IOAPIC_LEVEL;
+	}
+
+	/*
+	 * Passe les IRQ sur l'IOAPIC, livrees au processeur apic_id aux memes
+	 * vecteurs qu'avec le PIC, qui est entierement masque. Les lignes
+	 * actives le restent, sauf l'IRQ 0 : le tick vient alors du timer de
+	 * l'APIC local. Interruptions masquees.
+	 */
+	void irq_use_ioapic(u32 apic_id)
+	{
+		u32 irq;
+
+		for (irq = 0; irq < NR_IRQS; irq++) {
+			if (irq == 2)
+				continue;		/* cascade du PIC */
+			ioapic_route(irq_gsi[irq], IRQ_VECTOR(irq), irq_flags[irq] | IOAPIC_MASKED, apic_id);
+		}
+
+		io.outb(0x21, 0xFF);
+		io.outb(0xA1, 0xFF);
+		irq_ioapic = 1;
+
+		for (irq = 1; irq < NR_IRQS; irq++)
+			if (irq != 2 && !(pic_mask & (1 << irq)))
+				ioapic_mask(irq_gsi[irq], 0);
+	}
+
+	int irq_using_ioapic(void)
+	{
+		return irq_ioapic;
+	}
+
+	/* Initialise la table, seules l'horloge et la cascade sont demasquees */
+	void init_irq(void)
+	{
+		int i;
+		for (i = 0; i < NR_IRQS; i++) {
+			irq_gsi[i] = i;			/* identite sauf override */
+			irq_flags[i] = 0;		/* ISA : front montant */
+			irq_table[i].action = NULL;
+			irq_table[i].count = 0;
+			irq_table[i].unhandled = 0;
+			irq_table[i].spurious = 0;
+			spin_lock_init(&irq_table[i].lock);
+		}
+		for (i = 0; i < IRQ_MAX_ACTIONS; i++)
+			irq_actions[i].handler = NULL;
+
+		pic_mask = 0xFFFF & ~((1 << 0) | (1 << 2));
+		pic_set_mask();
+	}
+}
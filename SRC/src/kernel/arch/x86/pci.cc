@@ -0,0 +1,313 @@
+#include <os.h>
+#include <x86.h>
+#include <pci.h>
+#include <apic.h>
+
+/*
+ *	Bus PCI. L'enumeration est faite une fois au demarrage (bus 0 a 255,
+ *	fonctions 1 a 7 seulement pour les peripheriques multi-fonctions),
+ *	ensuite seul l'espace de configuration est relu.
+ */
+
+static pci_dev		pci_devices[PCI_MAX_DEVICES];
+static u32			pci_ndevices = 0;
+static spinlock_t	pci_lock = SPINLOCK_INIT;	/* paire CONFIG_ADDR / CONFIG_DATA */
+
+/* Peripheriques avec un handler (pci_install_irq) */
+struct pci_irq {
+	pci_dev*	dev;
+	pci_msi_fn	setup;
+	void*		data;
+	u32			mode;
+};
+
+static pci_irq		pci_irqs[PCI_MAX_DEVICES];
+static u32			pci_nirqs = 0;
+
+static inline u32 pci_addr(u32 bus, u32 slot, u32 func, u32 off)
+{
+	return 0x80000000 | (bus << 16) | (slot << 11) | (func << 8) | (off & 0xFC);
+}
+
+static u32 pci_conf_read(u32 bus, u32 slot, u32 func, u32 off)
+{
+	u32 v, flags;
+
+	flags = spin_lock_irqsave(&pci_lock);
+	io.outl(PCI_CONFIG_ADDR, pci_addr(bus, slot, func, off));
+	v = io.inl(PCI_CONFIG_DATA);
+	spin_unlock_irqrestore(&pci_lock, flags);
+	return v;
+}
+
+static void pci_conf_write(u32 bus, u32 slot, u32 func, u32 off, u32 v)
+{
+	u32 flags;
+
+	flags = spin_lock_irqsave(&pci_lock);
+	io.outl(PCI_CONFIG_ADDR, pci_addr(bus, slot, func, off));
+	io.outl(PCI_CONFIG_DATA, v);
+	spin_unlock_irqrestore(&pci_lock, flags);
+}
+
+static void pci_probe(u32 bus, u32 slot, u32 func)
+{
+	pci_dev* d;
+	u32 id, cls;
+
+	id = pci_conf_read(bus, slot, func, PCI_VENDOR_ID);
+	if ((id & 0xFFFF) == 0xFFFF || pci_ndevices == PCI_MAX_DEVICES)
+		return;
+	cls = pci_conf_read(bus, slot, func, PCI_CLASS_REVISION);
+
+	d = &pci_devices[pci_ndevices++];
+	d->bus = bus;
+	d->slot = slot;
+	d->func = func;
+	d->vendor = id & 0xFFFF;
+	d->device = id >> 16;
+	d->class_code = cls >> 24;
+	d->subclass = (cls >> 16) & 0xFF;
+	d->prog_if = (cls >> 8) & 0xFF;
+	d->revision = cls & 0xFF;
+	d->irq = pci_conf_read(bus, slot, func, PCI_INTERRUPT_LINE) & 0xFF;
+}
+
+extern "C" {
+
+	void pci_init(void)
+	{
+		u32 bus, slot, func, hdr;
+
+		pci_ndevices = 0;
+		for (bus = 0; bus < 256; bus++)
+			for (slot = 0; slot < 32; slot++) {
+				if ((pci_conf_read(bus, slot, 0, PCI_VENDOR_ID) & 0xFFFF) == 0xFFFF)
+					continue;
+				hdr = (pci_conf_read(bus, slot, 0, PCI_HEADER_TYPE & 0xFC) >> 16) & 0xFF;
+				for (func = 0; func < ((hdr & PCI_HEADER_MULTI) ? 8 : 1); func++)
+					pci_probe(bus, slot, func);
+			}
+	}
+
+	u32 pci_count(void)
+	{
+		return pci_ndevices;
+	}
+
+	pci_dev* pci_get(u32 index)
+	{
+		if (index >= pci_ndevices)
+			return NULL;
+		return &pci_devices[index];
+	}
+
+	u32 pci_read32(pci_dev* d, u32 off)
+	{
+		return pci_conf_read(d->bus, d->slot, d->func, off);
+	}
+
+	u16 pci_read16(pci_dev* d, u32 off)
+	{
+		return pci_conf_read(d->bus, d->slot, d->func, off) >> ((off & 2) * 8);
+	}
+
+	u8 pci_read8(pci_dev* d, u32 off)
+	{
+		return pci_conf_read(d->bus, d->slot, d->func, off) >> ((off & 3) * 8);
+	}
+
+	void pci_write32(pci_dev* d, u32 off, u32 v)
+	{
+		pci_conf_write(d->bus, d->slot, d->func, off, v);
+	}
+
+	/* Lecture-modification-ecriture du mot de 32 bits qui contient off */
+	void pci_write16(pci_dev* d, u32 off, u16 v)
+	{
+		u32 shift = (off & 2) * 8;
+		u32 old = pci_read32(d, off);
+
+		old &= ~(0xFFFF << shift);
+		pci_write32(d, off, old | ((u32) v << shift));
+	}
+
+	pci_dev* pci_find_class(u8 class_code, u8 subclass, u32 index)
+	{
+		u32 i;
+
+		for (i = 0; i < pci_ndevices; i++)
+			if (pci_devices[i].class_code == class_code
+				&& pci_devices[i].subclass == subclass
+				&& index-- == 0)
+				return &pci_devices[i];
+		return NULL;
+	}
+
+	pci_dev* pci_find_device(u16 vendor, u16 device, u32 index)
+	{
+		u32 i;
+
+		for (i = 0; i < pci_ndevices; i++)
+			if (pci_devices[i].vendor == vendor
+				&& pci_devices[i].device == device
+				&& index-- == 0)
+				return &pci_devices[i];
+		return NULL;
+	}
+
+	u32 pci_bar(pci_dev* d, u32 n)
+	{
+		u32 v;
+
+		if (n >= PCI_NR_BARS)
+			return 0;
+		v = pci_read32(d, PCI_BAR0 + 4 * n);
+		if (v & PCI_BAR_IO)
+			return v & ~0x3;
+		return v & ~0xF;
+	}
+
+	int pci_bar_is_io(pci_dev* d, u32 n)
+	{
+		if (n >= PCI_NR_BARS)
+			return 0;
+		return pci_read32(d, PCI_BAR0 + 4 * n) & PCI_BAR_IO;
+	}
+
+	void pci_set_master(pci_dev* d)
+	{
+		pci_set_command(d, PCI_COMMAND_MASTER);
+	}
+
+	void pci_set_command(pci_dev* d, u16 bits)
+	{
+		u16 cmd = pci_read16(d, PCI_COMMAND);
+
+		pci_write16(d, PCI_COMMAND, cmd | bits);
+	}
+
+	u32 pci_find_capability(pci_dev* d, u8 id)
+	{
+		u32 pos, n;
+
+		if (!(pci_read16(d, PCI_STATUS) & PCI_STATUS_CAP_LIST))
+			return 0;
+		pos = pci_read8(d, PCI_CAPABILITY_LIST) & 0xFC;
+		for (n = 0; pos != 0 && n < 48; n++) {	/* 48 : liste bouclee */
+			if (pci_read8(d, pos) == id)
+				return pos;
+			pos = pci_read8(d, pos + 1) & 0xFC;
+		}
+		return 0;
+	}
+
+	/*
+	 *	Le peripherique ecrit vector a l'APIC local apic_id (front,
+	 *	livraison fixe) au lieu d'activer sa ligne INTx.
+	 */
+	int pci_enable_msi(pci_dev* d, u32 apic_id, u32 vector)
+	{
+		u32 pos = pci_find_capability(d, PCI_CAP_ID_MSI);
+		u16 ctrl;
+
+		if (pos == 0)
+			return NOT_DEFINED;
+		ctrl = pci_read16(d, pos + PCI_MSI_FLAGS);
+		pci_write32(d, pos + PCI_MSI_ADDRESS_LO, MSI_ADDRESS_BASE | (apic_id << 12));
+		if (ctrl & PCI_MSI_FLAGS_64BIT) {
+			pci_write32(d, pos + PCI_MSI_ADDRESS_HI, 0);
+			pci_write16(d, pos + PCI_MSI_DATA_64, vector & 0xFF);
+		}
+		else
+			pci_write16(d, pos + PCI_MSI_DATA_32, vector & 0xFF);
+		ctrl &= ~PCI_MSI_FLAGS_QSIZE;
+		pci_write16(d, pos + PCI_MSI_FLAGS, ctrl | PCI_MSI_FLAGS_ENABLE);
+		pci_set_command(d, PCI_COMMAND_INTX_DISABLE);
+		return RETURN_OK;
+	}
+
+	/*
+	 *	MSI-X, pour un peripherique sans MSI : l'entree 0 de la table (dans
+	 *	un BAR memoire) ecrit vector a l'APIC local apic_id, les autres
+	 *	entrees restent masquees. La ligne INTx est coupee.
+	 */
+	int pci_enable_msix(pci_dev* d, u32 apic_id, u32 vector)
+	{
+		u32 pos = pci_find_capability(d, PCI_CAP_ID_MSIX);
+		u32 table, bar;
+		char* entry;
+		u16 ctrl;
+
+		if (pos == 0)
+			return NOT_DEFINED;
+		table = pci_read32(d, pos + PCI_MSIX_TABLE);
+		if (pci_bar_is_io(d, table & PCI_MSIX_BIR))
+			return NOT_DEFINED;
+		bar = pci_bar(d, table & PCI_MSIX_BIR);
+		if (bar == 0)
+			return NOT_DEFINED;
+		pci_set_command(d, PCI_COMMAND_MEMORY);		//la table est lue par le decodage memoire
+		entry = ioremap(bar + (table & ~PCI_MSIX_BIR), MSIX_ENTRY_SIZE);
+		if (entry == NULL)
+			return ERROR_MEMORY;
+
+		ctrl = pci_read16(d, pos + PCI_MSIX_FLAGS);
+		pci_write16(d, pos + PCI_MSIX_FLAGS, ctrl | PCI_MSIX_FLAGS_MASKALL);
+		*(volatile u32*) (entry + MSIX_ENTRY_ADDR_LO) = MSI_ADDRESS_BASE | (apic_id << 12);
+		*(volatile u32*) (entry + MSIX_ENTRY_ADDR_HI) = 0;
+		*(volatile u32*) (entry + MSIX_ENTRY_DATA) = vector & 0xFF;
+		*(volatile u32*) (entry + MSIX_ENTRY_CTRL) &= ~MSIX_ENTRY_MASKED;
+		iounmap(entry, MSIX_ENTRY_SIZE);
+		pci_write16(d, pos + PCI_MSIX_FLAGS, (ctrl | PCI_MSIX_FLAGS_ENABLE) & ~PCI_MSIX_FLAGS_MASKALL);
+		pci_set_command(d, PCI_COMMAND_INTX_DISABLE);
+		return RETURN_OK;
+	}
+
+	static void pci_route_msi(pci_irq* e, u32 apic_id)
+	{
+		pci_dev* d = e->dev;
+		u32 vector = IRQ_VECTOR(d->irq);
+
+		if (e->mode != PCI_IRQ_INTX)
+			return;
+		if (pci_enable_msi(d, apic_id, vector) == RETURN_OK)
+			e->mode = PCI_IRQ_MSI;
+		else if (pci_enable_msix(d, apic_id, vector) == RETURN_OK)
+			e->mode = PCI_IRQ_MSIX;
+		else {
+			io.print("pci: %x:%x has no MSI, irq %d may be lost \n", d->vendor, d->device, d->irq);
+			return;
+		}
+		if (e->setup != NULL)
+			e->setup(d, e->mode, e->data);
+	}
+
+	int pci_install_irq(pci_dev* d, irq_handler h, void* data, pci_msi_fn setup)
+	{
+		pci_irq* e;
+		int ret;
+
+		if (d->irq >= NR_IRQS || pci_nirqs == PCI_MAX_DEVICES)
+			return ERROR_PARAM;
+		ret = irq_install(d->irq, h, data);
+		if (ret != RETURN_OK)
+			return ret;
+		e = &pci_irqs[pci_nirqs++];
+		e->dev = d;
+		e->setup = setup;
+		e->data = data;
+		e->mode = PCI_IRQ_INTX;
+		if (irq_using_ioapic())
+			pci_route_msi(e, lapic_id());
+		return RETURN_OK;
+	}
+
+	void pci_msi_switch(u32 apic_id)
+	{
+		u32 i;
+
+		for (i = 0; i < pci_nirqs; i++)
+			pci_route_msi(&pci_irqs[i], apic_id);
+	}
+}
@@ -0,0 +1,124 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <runtime/types.h>
+
+/*
+ *	Bus PCI : acces a l'espace de configuration par le mecanisme 1
+ *	(ports 0xCF8/0xCFC) et table des fonctions trouvees au demarrage,
+ *	les pilotes y cherchent leur controleur par classe ou par identifiant.
+ */
+
+#define PCI_CONFIG_ADDR		0xCF8
+#define PCI_CONFIG_DATA		0xCFC
+
+#define PCI_VENDOR_ID		0x00
+#define PCI_DEVICE_ID		0x02
+#define PCI_COMMAND			0x04
+#define PCI_STATUS			0x06
+#define PCI_CLASS_REVISION	0x08	/* classe 31-24, sous-classe 23-16, prog-if 15-8 */
+#define PCI_HEADER_TYPE		0x0E
+#define PCI_BAR0			0x10
+#define PCI_CAPABILITY_LIST	0x34
+#define PCI_INTERRUPT_LINE	0x3C
+
+#define PCI_COMMAND_IO		0x0001
+#define PCI_COMMAND_MEMORY	0x0002
+#define PCI_COMMAND_MASTER	0x0004
+#define PCI_COMMAND_INTX_DISABLE	0x0400
+#define PCI_STATUS_CAP_LIST	0x0010
+
+/* Capacite MSI (liste chainee depuis PCI_CAPABILITY_LIST) */
+#define PCI_CAP_ID_MSI		0x05
+#define PCI_MSI_FLAGS		0x02
+#define PCI_MSI_ADDRESS_LO	0x04
+#define PCI_MSI_ADDRESS_HI	0x08
+#define PCI_MSI_DATA_32		0x08
+#define PCI_MSI_DATA_64		0x0C
+#define PCI_MSI_FLAGS_ENABLE	0x0001
+#define PCI_MSI_FLAGS_QMASK		0x000E
+#define PCI_MSI_FLAGS_QSIZE		0x0070
+#define PCI_MSI_FLAGS_64BIT		0x0080
+#define MSI_ADDRESS_BASE	0xFEE00000	/* + apic id << 12, livraison fixe */
+
+/* Capacite MSI-X : table des messages dans un BAR memoire */
+#define PCI_CAP_ID_MSIX		0x11
+#define PCI_MSIX_FLAGS		0x02
+#define PCI_MSIX_TABLE		0x04	/* BIR bits 0-2, position */
+#define PCI_MSIX_FLAGS_MASKALL	0x4000
+#define PCI_MSIX_FLAGS_ENABLE	0x8000
+#define PCI_MSIX_BIR		0x7
+#define MSIX_ENTRY_SIZE		16
+#define MSIX_ENTRY_ADDR_LO	0x0
+#define MSIX_ENTRY_ADDR_HI	0x4
+#define MSIX_ENTRY_DATA		0x8
+#define MSIX_ENTRY_CTRL		0xC
+#define MSIX_ENTRY_MASKED	0x1
+
+/* Mode d'interruption d'un peripherique (pci_install_irq) */
+#define PCI_IRQ_INTX		0
+#define PCI_IRQ_MSI			1
+#define PCI_IRQ_MSIX		2
+
+#define PCI_HEADER_MULTI	0x80
+#define PCI_BAR_IO			0x1
+#define PCI_NR_BARS			6
+
+#define PCI_CLASS_STORAGE	0x01
+#define PCI_SUBCLASS_IDE	0x01
+#define PCI_SUBCLASS_SATA	0x06
+#define PCI_PROGIF_AHCI		0x01
+
+#define PCI_MAX_DEVICES		32
+
+struct pci_dev {
+	u8		bus;
+	u8		slot;
+	u8		func;
+	u8		irq;			/* ligne d'interruption donnee par le BIOS */
+	u16		vendor;
+	u16		device;
+	u8		class_code;
+	u8		subclass;
+	u8		prog_if;
+	u8		revision;
+};
+
+/* Appele quand le peripherique passe en MSI / MSI-X (registres propres au pilote) */
+typedef void (*pci_msi_fn)(pci_dev* d, u32 mode, void* data);
+
+extern "C" {
+	void		pci_init(void);			/* enumere les bus */
+	u32			pci_count(void);
+	pci_dev*	pci_get(u32 index);
+
+	u32		pci_read32(pci_dev* d, u32 off);
+	u16		pci_read16(pci_dev* d, u32 off);
+	u8		pci_read8(pci_dev* d, u32 off);
+	void	pci_write32(pci_dev* d, u32 off, u32 v);
+	void	pci_write16(pci_dev* d, u32 off, u16 v);
+
+	/* index-ieme fonction d'une classe / d'un identifiant, NULL sinon */
+	pci_dev*	pci_find_class(u8 class_code, u8 subclass, u32 index);
+	pci_dev*	pci_find_device(u16 vendor, u16 device, u32 index);
+
+	u32		pci_bar(pci_dev* d, u32 n);	/* adresse sans les bits de type */
+	int		pci_bar_is_io(pci_dev* d, u32 n);
+	void	pci_set_master(pci_dev* d);		/* active le bus mastering (DMA) */
+	void	pci_set_command(pci_dev* d, u16 bits);	/* ajoute des bits au registre COMMAND */
+
+	u32		pci_find_capability(pci_dev* d, u8 id);	/* position de la capacite, 0 sinon */
+	int		pci_enable_msi(pci_dev* d, u32 apic_id, u32 vector);	/* un seul message, INTx coupe */
+	int		pci_enable_msix(pci_dev* d, u32 apic_id, u32 vector);	/* entree 0 seulement */
+
+	/*
+	 *	Handler sur la ligne du BIOS ; quand l'IOAPIC route les IRQ (les
+	 *	lignes INTx PCI n'y ont pas d'entree) le peripherique envoie un
+	 *	MSI ou MSI-X vers le vecteur de cette ligne. pci_msi_switch() est
+	 *	appele par smp_init() apres irq_use_ioapic().
+	 */
+	int		pci_install_irq(pci_dev* d, irq_handler h, void* data, pci_msi_fn setup);
+	void	pci_msi_switch(u32 apic_id);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include <os.h>
+#include <x86.h>
+
+/*
+ *	Prelevement des echantillons du profileur : eip et cs interrompus puis
+ *	remontee de la chaine des ebp (noyau compile avec les frame pointers).
+ *	Une adresse de la chaine n'est lue que si sa page est presente, le
+ *	#PF ne doit pas arriver en contexte IRQ.
+ */
+
+static u32 prof_src = PROF_SRC_TIMER;
+
+/* La page qui contient [addr, addr + 8[ est-elle projetee ? */
+static int prof_readable(u32 addr)
+{
+	if (addr & 3)
+		return 0;
+	if (addr + 8 <= KERN_PG_1_LIM)		/* noyau, pages de 4 Mo */
+		return 1;
+	if (addr < KERN_PG_1_LIM)
+		return 0;
+	return get_p_addr((char *) addr) != 0 && get_p_addr((char *) addr + 7) != 0;
+}
+
+static void prof_sample_frame(syscall_frame* f)
+{
+	Process* p = arch.pcurrent;
+	u32 pc[PROF_MAX_DEPTH];
+	u32 depth = 1, ebp, prev, pid, user;
+
+	if (p == NULL || f == NULL)
+		return;
+	pid = p->getPid();
+	if (!prof_wanted(pid))
+		return;
+
+	user = f->cs & 3;
+	pc[0] = f->eip;
+	ebp = f->ebp;
+	prev = user ? 0 : f->esp;
+	while (depth < PROF_MAX_DEPTH && ebp > prev && prof_readable(ebp)) {
+		if (user ? (ebp < USER_OFFSET || ebp >= USER_STACK) : (ebp >= USER_OFFSET))
+			break;
+		pc[depth] = ((u32 *) ebp)[1];
+		if (pc[depth] == 0)
+			break;
+		depth++;
+		prev = ebp;
+		ebp = ((u32 *) ebp)[0];
+	}
+	prof_record(pid, user, pc, depth);
+}
+
+extern "C" {
+
+	/* Tick du scheduler (PIT ou APIC timer), f : registres interrompus */
+	void prof_tick(syscall_frame* f)
+	{
+		if (prof_src == PROF_SRC_TIMER)
+			prof_sample_frame(f);
+	}
+
+	/* IRQ 8 : acquitte le RTC (lecture du registre C) puis echantillonne */
+	static void prof_rtc_irq(u32 irq, void* data)
+	{
+		io.outb(0x70, 0x0C);
+		io.inb(0x71);
+		prof_sample_frame(cpu_self()->irq_regs);
+	}
+
+	/* Lance l'echantillonnage, retourne sa frequence */
+	int prof_start(u32 source)
+	{
+		u32 flags;
+		u8 v;
+
+		switch (source) {
+		case PROF_SRC_TIMER:
+			prof_src = source;
+			return HZ;
+
+		case PROF_SRC_RTC:
+			prof_src = source;
+			irq_install(8, prof_rtc_irq, NULL);
+			flags = local_irq_save();
+			io.outb(0x70, 0x8A);			/* registre A, NMI masquee */
+			v = io.inb(0x71);
+			io.outb(0x70, 0x8A);
+			io.outb(0x71, (v & 0xF0) | 0x06);	/* 32768 >> (6 - 1) = 1024 Hz */
+			io.outb(0x70, 0x8B);			/* registre B : interruption periodique */
+			v = io.inb(0x71);
+			io.outb(0x70, 0x8B);
+			io.outb(0x71, v | 0x40);
+			io.outb(0x70, 0x0C);
+			io.inb(0x71);
+			local_irq_restore(flags);
+			return PROF_RTC_HZ;
+
+		default:
+			return ERROR_PARAM;
+		}
+	}
+
+	void prof_stop(void)
+	{
+		u32 flags;
+		u8 v;
+
+		if (prof_src == PROF_SRC_RTC) {
+			flags = local_irq_save();
+			io.outb(0x70, 0x8B);
+			v = io.inb(0x71);
+			io.outb(0x70, 0x8B);
+			io.outb(0x71, v & ~0x40);
+			io.outb(0x70, 0x0C);
+			io.inb(0x71);
+			local_irq_restore(flags);
+			irq_remove(8, prof_rtc_irq, NULL);
+		}
+		prof_src = PROF_SRC_TIMER;
+	}
+}
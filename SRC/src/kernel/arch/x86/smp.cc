@@ -0,0 +1,378 @@
+#include <os.h>
+#include <x86.h>
+#include <apic.h>
+#include <pci.h>
+
+/*
+ *	Demarrage des processeurs secondaires (AP). Les processeurs et
+ *	l'IOAPIC sont enumeres par la table MADT de l'ACPI, ou a defaut par la
+ *	table MP d'Intel ; les IRQ passent alors du PIC 8259 a l'IOAPIC et le
+ *	tick du BSP au timer de son APIC local. Les AP sont reveilles par la
+ *	sequence INIT-SIPI-SIPI : un AP demarre en mode reel sur le trampoline
+ *	(smpboot.asm) copie en AP_TRAMPOLINE et arrive dans ap_main() en mode
+ *	protege, pagine, sur la pile de son thread idle.
+ */
+
+cpu_info	cpus[CPU_MAX];
+u32			smp_ncpu = 1;
+
+static u32	apic_ids[CPU_MAX];			/* processeurs trouves dans les tables */
+static u32	nr_apic_ids = 0;
+static u32	lapic_phys = LAPIC_DEFAULT_BASE;
+static u32	ioapic_phys = 0;				/* premier IOAPIC, 0 si absent */
+static u32	ioapic_gsi = 0;
+static int	imcr_present = 0;				/* PIC relie au BSP par l'IMCR */
+
+extern "C" char	ap_trampoline[], ap_trampoline_end[];
+extern "C" char	ap_gdtr[], ap_stack[], ap_cpu[];
+extern gdtdesc	kgdt[];
+extern gdtr		kgdtr;
+
+#define TRAMPOLINE_VAR(v)	((char *) AP_TRAMPOLINE + ((v) - ap_trampoline))
+
+/* Structures des tables du BIOS */
+struct acpi_rsdp {
+	char	signature[8];		/* "RSD PTR " */
+	u8		checksum;
+	char	oem[6];
+	u8		revision;
+	u32		rsdt;
+} __attribute__ ((packed));
+
+struct acpi_header {
+	char	signature[4];
+	u32		length;
+	u8		revision;
+	u8		checksum;
+	char	oem[6];
+	char	oem_table[8];
+	u32		oem_revision;
+	u32		creator;
+	u32		creator_revision;
+} __attribute__ ((packed));
+
+struct acpi_madt {
+	acpi_header	header;			/* "APIC" */
+	u32		lapic;
+	u32		flags;
+} __attribute__ ((packed));
+
+#define MADT_LAPIC			0
+#define MADT_IOAPIC			1
+#define MADT_OVERRIDE		2
+#define MADT_LAPIC_ENABLED	0x1
+
+struct mp_fps {
+	char	signature[4];		/* "_MP_" */
+	u32		config;
+	u8		length;
+	u8		revision;
+	u8		checksum;
+	u8		feature1;
+	u32		features;
+} __attribute__ ((packed));
+
+struct mp_config {
+	char	signature[4];		/* "PCMP" */
+	u16		length;
+	u8		revision;
+	u8		checksum;
+	char	oem[8];
+	char	product[12];
+	u32		oem_table;
+	u16		oem_size;
+	u16		count;
+	u32		lapic;
+	u16		ext_length;
+	u8		ext_checksum;
+	u8		reserved;
+} __attribute__ ((packed));
+
+#define MP_PROCESSOR		0
+#define MP_BUS				1
+#define MP_IOAPIC			2
+#define MP_IOINTR			3
+#define MP_PROC_ENABLED		0x1
+#define MP_IOAPIC_ENABLED	0x1
+#define MP_INTR_INT			0
+#define MP_FEATURE_IMCR		0x80
+
+static u8 bios_checksum(char* p, u32 len)
+{
+	u8 sum = 0;
+	while (len--)
+		sum += (u8) *p++;
+	return sum;
+}
+
+/* Recherche une structure alignee sur 16 octets dans le premier Mo */
+static char* bios_scan(u32 base, u32 len, char* sig, u32 siglen, u32 size)
+{
+	u32 p;
+	for (p = base; p + size <= base + len; p += 16)
+		if (strncmp((char*) p, sig, siglen) == 0 && bios_checksum((char*) p, size) == 0)
+			return (char*) p;
+	return NULL;
+}
+
+static void add_apic_id(u32 id)
+{
+	if (nr_apic_ids < CPU_MAX)
+		apic_ids[nr_apic_ids++] = id;
+}
+
+/*
+ * Zone de l'EBDA puis ROM du BIOS. Le pointeur de l'EBDA (0x40E) n'est
+ * plus lisible : l'IDT en 0x0 recouvre la zone de donnees du BIOS.
+ */
+static char* bios_find(char* sig, u32 siglen, u32 size)
+{
+	char* p = bios_scan(0x80000, 0x20000, sig, siglen, size);
+	if (p == NULL)
+		p = bios_scan(0xE0000, 0x20000, sig, siglen, size);
+	return p;
+}
+
+/* Processeurs de la MADT (ACPI), les tables sont projetees avec ioremap */
+static int acpi_parse(void)
+{
+	acpi_rsdp* rsdp;
+	acpi_header* rsdt;
+	acpi_header* h;
+	acpi_madt* madt = NULL;
+	u32 i, n, len;
+	u8* e;
+
+	rsdp = (acpi_rsdp*) bios_find("RSD PTR ", 8, sizeof(acpi_rsdp));
+	if (rsdp == NULL)
+		return 0;
+
+	rsdt = (acpi_header*) ioremap(rsdp->rsdt, sizeof(acpi_header));
+	if (rsdt == NULL)
+		return 0;
+	len = rsdt->length;
+	iounmap((char*) rsdt, sizeof(acpi_header));
+	rsdt = (acpi_header*) ioremap(rsdp->rsdt, len);
+	if (rsdt == NULL)
+		return 0;
+
+	n = (len - sizeof(acpi_header)) / 4;
+	for (i = 0; i < n && madt == NULL; i++) {
+		u32 phys = ((u32*) (rsdt + 1))[i];
+		h = (acpi_header*) ioremap(phys, sizeof(acpi_header));
+		if (h == NULL)
+			continue;
+		if (strncmp(h->signature, "APIC", 4) == 0) {
+			u32 mlen = h->length;
+			iounmap((char*) h, sizeof(acpi_header));
+			madt = (acpi_madt*) ioremap(phys, mlen);
+		}
+		else
+			iounmap((char*) h, sizeof(acpi_header));
+	}
+	iounmap((char*) rsdt, len);
+	if (madt == NULL)
+		return 0;
+
+	lapic_phys = madt->lapic;
+	len = madt->header.length;
+	for (e = (u8*) (madt + 1); e < (u8*) madt + len && e[1] != 0; e += e[1]) {
+		if (e[0] == MADT_LAPIC && (*(u32*) (e + 4) & MADT_LAPIC_ENABLED))
+			add_apic_id(e[3]);
+		else if (e[0] == MADT_IOAPIC && ioapic_phys == 0) {
+			ioapic_phys = *(u32*) (e + 4);
+			ioapic_gsi = *(u32*) (e + 8);
+		}
+		else if (e[0] == MADT_OVERRIDE && e[2] == 0)	/* bus ISA */
+			irq_set_override(e[3], *(u32*) (e + 4), *(u16*) (e + 8));
+	}
+	iounmap((char*) madt, len);
+	return nr_apic_ids;
+}
+
+/* Processeurs de la table MP (Intel MultiProcessor Specification 1.4) */
+static int mp_parse(void)
+{
+	mp_fps* fps;
+	mp_config* conf;
+	u32 len, i;
+	u32 isa_buses = 0;
+	u8* e;
+
+	fps = (mp_fps*) bios_find("_MP_", 4, sizeof(mp_fps));
+	if (fps == NULL || fps->config == 0)
+		return 0;		/* configurations par defaut non gerees */
+	imcr_present = (fps->feature1 & MP_FEATURE_IMCR) != 0;
+
+	conf = (mp_config*) ioremap(fps->config, sizeof(mp_config));
+	if (conf == NULL)
+		return 0;
+	len = conf->length;
+	iounmap((char*) conf, sizeof(mp_config));
+	conf = (mp_config*) ioremap(fps->config, len);
+	if (conf == NULL)
+		return 0;
+
+	if (strncmp(conf->signature, "PCMP", 4) == 0 && bios_checksum((char*) conf, len) == 0) {
+		lapic_phys = conf->lapic;
+		e = (u8*) (conf + 1);
+		for (i = 0; i < conf->count && e < (u8*) conf + len; i++) {
+			if (e[0] == MP_PROCESSOR) {
+				if (e[3] & MP_PROC_ENABLED)
+					add_apic_id(e[1]);
+				e += 20;
+				continue;
+			}
+			if (e[0] == MP_BUS && e[1] < 32 && strncmp((char*) e + 2, "ISA", 3) == 0)
+				isa_buses |= 1 << e[1];
+			else if (e[0] == MP_IOAPIC && (e[3] & MP_IOAPIC_ENABLED) && ioapic_phys == 0)
+				ioapic_phys = *(u32*) (e + 4);
+			else if (e[0] == MP_IOINTR && e[1] == MP_INTR_INT && e[4] < 32 && (isa_buses & (1 << e[4])))
+				irq_set_override(e[5], e[7], *(u16*) (e + 2));
+			e += 8;
+		}
+	}
+	iounmap((char*) conf, len);
+	return nr_apic_ids;
+}
+
+extern "C" {
+
+	/*
+	 * Prepare la structure d'un processeur et ses deux descripteurs
+	 * propres dans gdt : le TSS (0x38) et le segment per-cpu (PERCPU_SEL).
+	 */
+	void cpu_init(cpu_info* c, u32 id, gdtdesc* gdt)
+	{
+		c->self = c;
+		c->id = id;
+
+		c->cpu_tss.debug_flag = 0x00;
+		c->cpu_tss.io_map = 0x00;
+		c->cpu_tss.esp0 = 0x1FFF0;
+		c->cpu_tss.ss0 = 0x18;
+
+		spin_lock_init(&c->rq_lock);
+		INIT_LIST_HEAD(&c->rq);
+
+		init_gdt_desc((u32) &c->cpu_tss, 0x67, 0xE9, 0x00, &gdt[7]);
+		init_gdt_desc((u32) c, sizeof(cpu_info) - 1, 0x93, 0x04, &gdt[PERCPU_SEL / 8]);
+	}
+
+	/* Point d'entree C d'un AP (smpboot.asm), interruptions masquees */
+	void ap_main(cpu_info* c)
+	{
+		asm("lgdtl %0"::"m"(c->cpu_gdtr));
+		asm("	movw $0x10, %%ax	\n \
+				movw %%ax, %%ds	\n \
+				movw %%ax, %%es	\n \
+				movw %%ax, %%fs	\n \
+				movw %0, %%ax	\n \
+				movw %%ax, %%gs	\n \
+				ljmp $0x08, $ap_next	\n \
+				ap_next:		\n"::"i"(PERCPU_SEL):"eax");
+		asm("	movw $0x38, %ax; ltr %ax");
+		asm("lidtl (kidtr)");
+
+		init_fpu();
+		init_sysenter();
+		lapic_enable();
+		lapic_timer_start();
+
+		c->current = c->idle;
+		c->idle->getPInfo()->running = 1;
+		c->started = 1;
+
+		/* thread idle du processeur */
+		for (;;)
+			asm("sti; hlt");
+	}
+
+	/* Demarre un AP : INIT, attente de 10 ms puis deux SIPI */
+	static int smp_boot_ap(u32 apic_id)
+	{
+		cpu_info* c = &cpus[smp_ncpu];
+		int i;
+
+		memcpy((char*) c->gdt, (char*) kgdt, sizeof(c->gdt));
+		cpu_init(c, smp_ncpu, c->gdt);
+		c->apic_id = apic_id;
+		c->cpu_gdtr.limite = sizeof(c->gdt);
+		c->cpu_gdtr.base = (u32) c->gdt;
+		arch.createIdle(c);
+
+		*(u32*) TRAMPOLINE_VAR(ap_stack) = c->idle->getPInfo()->kstack.esp0;
+		*(u32*) TRAMPOLINE_VAR(ap_cpu) = (u32) c;
+
+		lapic_send_ipi(apic_id, ICR_INIT | ICR_LEVEL_ASSERT | ICR_LEVEL_TRIGGER);
+		udelay(200);
+		lapic_send_ipi(apic_id, ICR_INIT | ICR_LEVEL_TRIGGER);
+		udelay(10000);
+
+		for (i = 0; i < 2 && !c->started; i++) {
+			lapic_send_ipi(apic_id, ICR_STARTUP | (AP_TRAMPOLINE >> 12));
+			udelay(200);
+		}
+		for (i = 0; i < 100 && !c->started; i++)
+			udelay(1000);
+
+		if (!c->started) {
+			io.print("SMP: cpu (apic %d) does not answer \n", apic_id);
+			/* le slot est reutilise par l'AP suivant */
+			arch.destroy_process(c->idle);
+			delete c->idle;
+			c->idle = NULL;
+			return ERROR_PARAM;
+		}
+		smp_ncpu++;
+		return RETURN_OK;
+	}
+
+	/*
+	 * Enumere les processeurs, passe les IRQ sur l'IOAPIC et demarre les
+	 * AP. Sans table ni APIC local le systeme reste monoprocesseur avec le
+	 * PIC et le PIT ; sans IOAPIC le BSP garde le PIC et le PIT.
+	 */
+	void smp_init(void)
+	{
+		u32 i, bsp;
+
+		if (!(cpu_cpuid(0x01).edx & CPUID_APIC)) {
+			io.print("SMP: no local APIC, uniprocessor \n");
+			return;
+		}
+		if (acpi_parse() == 0 && mp_parse() == 0) {
+			io.print("SMP: no MP/ACPI table, uniprocessor \n");
+			return;
+		}
+		if (lapic_init(lapic_phys) != RETURN_OK)
+			return;
+
+		lapic_enable();
+		bsp = lapic_id();
+		cpus[0].apic_id = bsp;
+		lapic_timer_calibrate();
+
+		if (ioapic_phys != 0 && ioapic_init(ioapic_phys, ioapic_gsi) == RETURN_OK) {
+			if (imcr_present) {
+				io.outb(0x22, 0x70);	/* IMCR : mode symetrique */
+				io.outb(0x23, 0x01);
+			}
+			irq_use_ioapic(bsp);
+			pci_msi_switch(bsp);
+			lapic_timer_start();
+			io.print("APIC: irqs routed by the IOAPIC at %x \n", ioapic_phys);
+		}
+		else
+			io.print("APIC: no IOAPIC, keep the 8259 PIC \n");
+
+		memcpy((char*) AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+		memcpy(TRAMPOLINE_VAR(ap_gdtr), (char*) &kgdtr, sizeof(gdtr));
+
+		for (i = 0; i < nr_apic_ids && smp_ncpu < CPU_MAX; i++)
+			if (apic_ids[i] != bsp)
+				smp_boot_ap(apic_ids[i]);
+
+		io.print("SMP: %d cpu(s) started \n", smp_ncpu);
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <runtime/types.h>
+#include <runtime/list.h>
+#include <x86.h>
+#include <spinlock.h>
+
+/*
+ *	Multiprocesseur : une structure cpu_info par processeur, adressee par
+ *	le segment %gs du noyau (PERCPU_SEL, charge par SAVE_REGS). Chaque
+ *	processeur a sa GDT (TSS et segment per-cpu), son thread idle, son
+ *	proprietaire du FPU et sa file de processus (run queue).
+ */
+
+#define CPU_MAX			8
+#define CPU_GDT_SIZE	16		/* descripteurs copies de kgdt pour les AP */
+#define PERCPU_SEL		0x60	/* kgdt[12], base = cpu_info du processeur */
+
+#define AP_TRAMPOLINE	0x8000	/* code de demarrage des AP (vecteur SIPI 0x08) */
+
+class Process;
+struct process_st;
+
+struct cpu_info {
+	cpu_info*		self;			/* %gs:0 */
+	Process*		current;		/* %gs:4, processus courant */
+	volatile u32*	prev_running;	/* %gs:8, remis a 0 par do_switch */
+	u32				id;
+	u32				apic_id;
+	volatile u32	started;
+
+	tss				cpu_tss;
+	gdtdesc			gdt[CPU_GDT_SIZE];
+	gdtr			cpu_gdtr;
+
+	Process*		idle;			/* hors run queue, jamais migre */
+	process_st*		fpu_owner;		/* contexte present dans le FPU */
+
+	spinlock_t		rq_lock;
+	list_head		rq;				/* processus affectes au processeur */
+	u32				nr_tasks;
+	u32				ticks;			/* horloge locale (APIC timer) */
+	syscall_frame*	irq_regs;		/* registres interrompus par l'IRQ en cours */
+	u32				handoff;		/* pid elu en premier au prochain schedule (IPC) */
+} __attribute__ ((aligned(16)));
+
+extern cpu_info	cpus[CPU_MAX];
+extern u32		smp_ncpu;			/* processeurs demarres */
+
+/* Structure du processeur courant */
+static inline cpu_info* cpu_self(void)
+{
+	cpu_info* c;
+	__asm__ __volatile__("movl %%gs:0, %0" : "=r"(c));
+	return c;
+}
+
+static inline u32 smp_processor_id(void)
+{
+	return cpu_self()->id;
+}
+
+extern "C" {
+	void	cpu_init(cpu_info* c, u32 id, gdtdesc* gdt);
+	void	smp_init(void);
+	void	ap_main(cpu_info* c);
+}
+
+#endif
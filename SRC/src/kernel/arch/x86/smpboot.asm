@@ -0,0 +1,56 @@
+;; Trampoline de demarrage des AP, copie en AP_TRAMPOLINE (0x8000) par
+;; smp_init() : le SIPI demarre l'AP en mode reel en 0x0800:0000.
+;; Passage en mode protege avec la GDT du BSP, pagination avec pd0 puis
+;; appel de ap_main(cpu) sur la pile de son thread idle.
+
+extern ap_main
+global ap_trampoline, ap_trampoline_end, ap_gdtr, ap_stack, ap_cpu
+
+AP_BASE		equ 0x8000
+%define TRAMP(x)	(AP_BASE + (x) - ap_trampoline)
+
+[BITS 16]
+ap_trampoline:
+	cli
+	cld
+	xor ax, ax
+	mov ds, ax
+	lgdt [TRAMP(ap_gdtr)]
+	mov eax, cr0
+	or eax, 1
+	mov cr0, eax
+	jmp dword 0x08:TRAMP(ap_pmode)
+
+[BITS 32]
+ap_pmode:
+	mov ax, 0x10
+	mov ds, ax
+	mov es, ax
+	mov fs, ax
+	mov gs, ax
+	mov ax, 0x18
+	mov ss, ax
+
+	mov eax, 0x1000		; KERN_PDIR
+	mov cr3, eax
+	mov eax, cr4
+	or eax, 0x10		; PSE
+	mov cr4, eax
+	mov eax, cr0
+	or eax, 0x80000000	; PG
+	mov cr0, eax
+
+	mov esp, [TRAMP(ap_stack)]
+	push dword [TRAMP(ap_cpu)]
+	mov eax, ap_main
+	call eax
+.halt:
+	hlt
+	jmp .halt
+
+align 4
+ap_gdtr:	dw 0		; copie de kgdtr
+			dd 0
+ap_stack:	dd 0		; pile du thread idle
+ap_cpu:		dd 0		; cpu_info de l'AP
+ap_trampoline_end:
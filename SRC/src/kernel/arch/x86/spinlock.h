@@ -0,0 +1,80 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <runtime/types.h>
+
+/*
+ * Spinlocks x86. Les versions irqsave coupent les interruptions locales
+ * pendant la section critique : un handler d'interruption ne peut donc
+ * pas boucler sur un verrou pris par le code qu'il a interrompu.
+ * Les sections critiques doivent rester courtes, elles bornent la latence
+ * des interruptions.
+ */
+
+#define EFLAGS_IF	0x200
+
+typedef struct {
+	volatile u32 lock;
+} spinlock_t;
+
+#define SPINLOCK_INIT	{ 0 }
+
+static inline void spin_lock_init(spinlock_t* l)
+{
+	l->lock = 0;
+}
+
+static inline void spin_lock(spinlock_t* l)
+{
+	u32 v;
+	for (;;) {
+		v = 1;
+		__asm__ __volatile__("xchgl %0, %1" : "+r"(v), "+m"(l->lock) :: "memory");
+		if (v == 0)
+			return;
+		while (l->lock)
+			__asm__ __volatile__("pause");
+	}
+}
+
+static inline void spin_unlock(spinlock_t* l)
+{
+	__asm__ __volatile__("" ::: "memory");
+	l->lock = 0;
+}
+
+/* Addition atomique sans verrou, retourne l'ancienne valeur */
+static inline u32 atomic_xadd(volatile u32* p, u32 v)
+{
+	__asm__ __volatile__("lock; xaddl %0, %1" : "+r"(v), "+m"(*p) :: "memory");
+	return v;
+}
+
+/* Coupe les interruptions et retourne l'ancien eflags */
+static inline u32 local_irq_save(void)
+{
+	u32 flags;
+	__asm__ __volatile__("pushfl; popl %0; cli" : "=r"(flags) :: "memory");
+	return flags;
+}
+
+static inline void local_irq_restore(u32 flags)
+{
+	if (flags & EFLAGS_IF)
+		__asm__ __volatile__("sti" ::: "memory");
+}
+
+static inline u32 spin_lock_irqsave(spinlock_t* l)
+{
+	u32 flags = local_irq_save();
+	spin_lock(l);
+	return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t* l, u32 flags)
+{
+	spin_unlock(l);
+	local_irq_restore(flags);
+}
+
+#endif
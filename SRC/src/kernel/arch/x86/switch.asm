@@ -1,11 +1,22 @@
 
 global do_switch
 
+CPU_PREV_RUNNING	equ 8	; cpu_info.prev_running (voir smp.h)
+
 do_switch:
 	; recuper l'adresse de *current 
 	mov esi, [esp]
 	pop eax			; depile @current
 
+	; la tache quittee n'utilise plus sa pile, un autre processeur
+	; peut maintenant la reprendre
+	mov eax, [gs:CPU_PREV_RUNNING]
+	test eax, eax
+	jz .prev_done
+	mov dword [eax], 0
+	mov dword [gs:CPU_PREV_RUNNING], 0
+.prev_done:
+
 	; prepare les registres
 	push dword [esi+4]	; eax
 	push dword [esi+8]	; ecx
@@ -19,10 +30,6 @@ do_switch:
 	push dword [esi+52]	; fs
 	push dword [esi+54]	; gs
 
-	; enleve le mask du PIC
-	mov al, 0x20
-	out 0x20, al
-
 	; charge table des pages
 	mov eax, [esi+56]
 	mov cr3, eax
@@ -11,6 +11,26 @@ extern "C" {
 
 	u32 kmalloc_used = 0;
 	
+	/*
+	 * Ordre de prise des verrous :
+	 *   pd->lock -> kvm_lock -> kmalloc_lock (alloc.cc) -> frame_lock
+	 */
+	static spinlock_t frame_lock = SPINLOCK_INIT;	/* mem_bitmap */
+	static spinlock_t kvm_lock = SPINLOCK_INIT;		/* kern_free_vm */
+	
+	void set_page_frame_used(u32 page)
+	{
+		u32 flags = spin_lock_irqsave(&frame_lock);
+		__set_page_frame_used(page);
+		spin_unlock_irqrestore(&frame_lock, flags);
+	}
+
+	void release_page_frame(char *p_addr)
+	{
+		u32 flags = spin_lock_irqsave(&frame_lock);
+		__release_page_frame(p_addr);
+		spin_unlock_irqrestore(&frame_lock, flags);
+	}
 	
 	/*
 	 * Parcours le bitmap a la recherche d'une page libre et la marque
@@ -20,15 +40,18 @@ extern "C" {
 	{
 		int byte, bit;
 		int page = -1;
+		u32 flags = spin_lock_irqsave(&frame_lock);
 
 		for (byte = 0; byte < RAM_MAXPAGE / 8; byte++)
 			if (mem_bitmap[byte] != 0xFF)
 				for (bit = 0; bit < 8; bit++)
 					if (!(mem_bitmap[byte] & (1 << bit))) {
 						page = 8 * byte + bit;
-						set_page_frame_used(page);
+						__set_page_frame_used(page);
+						spin_unlock_irqrestore(&frame_lock, flags);
 						return (char *) (page * PAGESIZE);
 					}
+		spin_unlock_irqrestore(&frame_lock, flags);
 		return (char *) -1;
 	}
 
@@ -44,6 +67,10 @@ extern "C" {
 		page *pg;
 		vm_area *area;
 		char *v_addr, *p_addr;
+		u32 flags;
+
+		/* Alloue le descripteur avant de prendre kvm_lock */
+		pg = (page*) kmalloc(sizeof(page));
 
 		/* Prend une page physique libre */
 		p_addr = get_page_frame();
@@ -51,6 +78,8 @@ extern "C" {
 			io.print ("PANIC: get_page_from_heap(): no page frame available. System halted !\n");
 		}
 
+		flags = spin_lock_irqsave(&kvm_lock);
+
 		/* Verifie si il y a une page virtuelle libre */
 		if (list_empty(&kern_free_vm)) {
 			io.print ("PANIC: get_page_from_heap(): not memory left in page heap. System halted !\n");
@@ -62,16 +91,18 @@ extern "C" {
 
 		/* Met a jour la liste de pages libres dans l'espace virtuel du noyau */
 		area->vm_start += PAGESIZE;
-		if (area->vm_start == area->vm_end) {
+		if (area->vm_start == area->vm_end)
 			list_del(&area->list);
-			kfree(area);
-		}
+		else
+			area = NULL;
 
 		/* Met a jour l'espace d'adressage du noyau */
 		pd0_add_page(v_addr, p_addr, 0);
 
+		spin_unlock_irqrestore(&kvm_lock, flags);
+		kfree(area);
+
 		/* Renvoie la page */
-		pg = (page*) kmalloc(sizeof(page));
 		pg->v_addr = v_addr;
 		pg->p_addr = p_addr;
 		pg->list.next = 0;
@@ -80,20 +111,20 @@ extern "C" {
 		return pg;
 	}
 
-	int release_page_from_heap(char *v_addr)
+	/*
+	 * Enleve la page virtuelle v_addr de l'espace du noyau et la rend a la
+	 * liste des pages virtuelles libres. La page physique n'est pas liberee.
+	 */
+	static void kvm_release_page(char *v_addr)
 	{
-		struct vm_area *next_area, *prev_area, *new_area;
-		char *p_addr;
+		struct vm_area *next_area, *prev_area, *new_area, *old_area;
+		u32 flags;
 
-		/* Retrouve la page frame associee a v_addr et la libere */
-		p_addr = get_p_addr(v_addr);
-		if (p_addr) {
-			release_page_frame(p_addr);
-		}
-		else {
-			io.print("WARNING: release_page_from_heap(): no page frame associated with v_addr %x\n", v_addr);
-			return 1;
-		}
+		/* Les allocations se font hors de kvm_lock */
+		new_area = (struct vm_area*) kmalloc(sizeof(struct vm_area));
+		old_area = NULL;
+
+		flags = spin_lock_irqsave(&kvm_lock);
 
 		/* Met a jour le repertoire de pages */
 		pd_remove_page(v_addr);
@@ -111,26 +142,194 @@ extern "C" {
 			if (prev_area->vm_end == next_area->vm_start) {
 				prev_area->vm_end = next_area->vm_end;
 				list_del(&next_area->list);
-				kfree(next_area);
+				old_area = next_area;
 			}
 		}
 		else if (next_area->vm_start == v_addr + PAGESIZE) {
 			next_area->vm_start = v_addr;
 		}
 		else if (next_area->vm_start > v_addr + PAGESIZE) {
-			new_area = (struct vm_area*) kmalloc(sizeof(struct vm_area));
 			new_area->vm_start = v_addr;
 			new_area->vm_end = v_addr + PAGESIZE;
 			list_add(&new_area->list, &prev_area->list);
+			new_area = NULL;
 		}
 		else {
 			io.print ("\nPANIC: release_page_from_heap(): corrupted linked list. System halted !\n");
 			asm("hlt");
 		}
 
+		spin_unlock_irqrestore(&kvm_lock, flags);
+		kfree(new_area);
+		kfree(old_area);
+	}
+
+	int release_page_from_heap(char *v_addr)
+	{
+		char *p_addr;
+
+		/* Retrouve la page frame associee a v_addr et la libere */
+		p_addr = get_p_addr(v_addr);
+		if (p_addr) {
+			release_page_frame(p_addr);
+		}
+		else {
+			io.print("WARNING: release_page_from_heap(): no page frame associated with v_addr %x\n", v_addr);
+			return 1;
+		}
+
+		kvm_release_page(v_addr);
 		return 0;
 	}
 
+	/*
+	 * Projette la zone physique [phys, phys + size[ (registres d'un
+	 * peripherique, tables du BIOS) dans le heap de pages du noyau, sans
+	 * cache. Les pages physiques restent marquees utilisees.
+	 */
+	/*
+	 * Reserve len octets d'adresses dans le heap de pages du noyau
+	 * (kvm_lock pris). Une zone videe est retournee dans old, a liberer
+	 * hors du verrou.
+	 */
+	static char *kvm_get_area(u32 len, struct vm_area **old)
+	{
+		struct vm_area *area;
+		char *v_addr;
+
+		list_for_each_entry(area, &kern_free_vm, list) {
+			if ((u32) (area->vm_end - area->vm_start) >= len) {
+				v_addr = area->vm_start;
+				area->vm_start += len;
+				if (area->vm_start == area->vm_end) {
+					list_del(&area->list);
+					*old = area;
+				}
+				return v_addr;
+			}
+		}
+		return NULL;
+	}
+
+	char *ioremap(u32 phys, u32 size)
+	{
+		struct vm_area *old_area = NULL;
+		char *v_addr;
+		u32 base = phys & 0xFFFFF000;
+		u32 len = ((phys + size - base) + PAGESIZE - 1) & 0xFFFFF000;
+		u32 off, flags;
+
+		flags = spin_lock_irqsave(&kvm_lock);
+		v_addr = kvm_get_area(len, &old_area);
+		if (v_addr != NULL)
+			for (off = 0; off < len; off += PAGESIZE)
+				pd0_add_page(v_addr + off, (char *) (base + off), PG_PWT | PG_PCD);
+		spin_unlock_irqrestore(&kvm_lock, flags);
+		kfree(old_area);
+
+		if (v_addr == NULL)
+			return NULL;
+		return v_addr + (phys - base);
+	}
+
+	void iounmap(char *v_addr, u32 size)
+	{
+		u32 base = (u32) v_addr & 0xFFFFF000;
+		u32 len = (((u32) v_addr + size - base) + PAGESIZE - 1) & 0xFFFFF000;
+		u32 off;
+
+		for (off = 0; off < len; off += PAGESIZE)
+			kvm_release_page((char *) (base + off));
+	}
+
+	/*
+	 * n pages physiques contigues (anneaux partages avec un peripherique),
+	 * projetees a la suite dans le heap de pages du noyau.
+	 */
+	char *get_contig_pages(u32 n, u32 *p_addr)
+	{
+		struct vm_area *old_area = NULL;
+		char *v_addr;
+		u32 page, run = 0, first = 0, i, flags;
+
+		if (n == 0)
+			return NULL;
+		flags = spin_lock_irqsave(&frame_lock);
+		for (page = 0; page < RAM_MAXPAGE && run < n; page++) {
+			if (mem_bitmap[page / 8] & (1 << (page % 8)))
+				run = 0;
+			else if (run++ == 0)
+				first = page;
+		}
+		if (run < n) {
+			spin_unlock_irqrestore(&frame_lock, flags);
+			return NULL;
+		}
+		for (i = 0; i < n; i++)
+			__set_page_frame_used(first + i);
+		spin_unlock_irqrestore(&frame_lock, flags);
+
+		flags = spin_lock_irqsave(&kvm_lock);
+		v_addr = kvm_get_area(n * PAGESIZE, &old_area);
+		if (v_addr != NULL)
+			for (i = 0; i < n; i++)
+				pd0_add_page(v_addr + i * PAGESIZE, (char *) ((first + i) * PAGESIZE), 0);
+		spin_unlock_irqrestore(&kvm_lock, flags);
+		kfree(old_area);
+
+		if (v_addr == NULL) {
+			for (i = 0; i < n; i++)
+				release_page_frame((char *) ((first + i) * PAGESIZE));
+			return NULL;
+		}
+		*p_addr = first * PAGESIZE;
+		return v_addr;
+	}
+
+	void release_contig_pages(char *v_addr, u32 n)
+	{
+		u32 i;
+
+		for (i = 0; i < n; i++)
+			release_page_from_heap(v_addr + i * PAGESIZE);
+	}
+
+	/*
+	 * Fenetres de projection temporaire, une page par processeur : une
+	 * page physique quelconque y est projetee le temps d'une copie, avec
+	 * les interruptions masquees.
+	 */
+	static char *kmap_base = NULL;
+
+	void kmap_init(void)
+	{
+		struct vm_area *old_area = NULL;
+		u32 flags;
+
+		flags = spin_lock_irqsave(&kvm_lock);
+		kmap_base = kvm_get_area(CPU_MAX * PAGESIZE, &old_area);
+		spin_unlock_irqrestore(&kvm_lock, flags);
+		kfree(old_area);
+	}
+
+	char *kmap_atomic(char *p_addr)
+	{
+		char *v_addr = kmap_base + smp_processor_id() * PAGESIZE;
+		u32 *pte = (u32 *) (0xFFC00000 | (((u32) v_addr & 0xFFFFF000) >> 10));
+
+		*pte = ((u32) p_addr & 0xFFFFF000) | (PG_PRESENT | PG_WRITE);
+		asm("invlpg %0"::"m"(*v_addr));
+		return v_addr + (VADDR_PG_OFFSET((u32) p_addr));
+	}
+
+	void kunmap_atomic(char *v_addr)
+	{
+		u32 *pte = (u32 *) (0xFFC00000 | (((u32) v_addr & 0xFFFFF000) >> 10));
+
+		*pte = 0;
+		asm("invlpg %0"::"m"(*v_addr));
+	}
+
 
 
 
@@ -143,7 +342,6 @@ extern "C" {
 		int pg, pg_limit;
 		unsigned long i;
 		struct vm_area *p;
-		struct vm_area *pm;
 
 		/* Numero de la derniere page */
 		pg_limit = (high_mem * 1024) / PAGESIZE;
@@ -192,6 +390,7 @@ extern "C" {
 		p->vm_end = (char*) KERN_PG_HEAP_LIM;
 		INIT_LIST_HEAD(&kern_free_vm);
 		list_add(&p->list, &kern_free_vm);
+		kmap_init();
 
 		arch.initProc();
 
@@ -229,6 +428,7 @@ extern "C" {
 
 		/* Mise a jour de la liste des tables de pages de l'espace utilisateur */
 		INIT_LIST_HEAD(&pd->pt);
+		spin_lock_init(&pd->lock);
 
 		return pd;
 	}
@@ -275,6 +475,7 @@ extern "C" {
 
 		/* Mise a jour de la liste des tables de pages de l'espace utilisateur */
 		INIT_LIST_HEAD(&pd->pt);
+		spin_lock_init(&pd->lock);
 
 		return pd;
 	}
@@ -322,7 +523,13 @@ extern "C" {
 		/* Modification de l'entree dans la table de page */
 		pte = (u32 *) (0xFFC00000 | (((u32) v_addr & 0xFFFFF000) >> 10));
 		*pte = ((u32) p_addr) | (PG_PRESENT | PG_WRITE | flags);
-		set_page_frame_used(p_addr);
+		set_page_frame_used(PAGE((u32) p_addr));
+
+		/*
+		 * Une ancienne projection de v_addr peut rester dans le TLB de ce
+		 * processeur ; les autres rechargent cr3 a chaque commutation.
+		 */
+		asm("invlpg %0"::"m"(*v_addr));
 		return 0;
 	}
 
@@ -340,6 +547,7 @@ extern "C" {
 		u32 *pt;		/* adresse virtuelle de la table de pages */
 		struct page *pg;
 		int i;
+		u32 irq;
 
 		//// io.print("DEBUG: pd_add_page(%p, %p, %d)\n", v_addr, p_addr, flags); /* DEBUG */
 
@@ -353,6 +561,9 @@ extern "C" {
 		 */
 		pde = (u32 *) (0xFFFFF000 | (((u32) v_addr & 0xFFC00000) >> 20));
 
+		if (pd)
+			irq = spin_lock_irqsave(&pd->lock);
+
 		/* 
 		 * On cree la table de pages correspondante si elle n'est pas presente
 		 */
@@ -379,6 +590,9 @@ extern "C" {
 		pte = (u32 *) (0xFFC00000 | (((u32) v_addr & 0xFFFFF000) >> 10));
 		*pte = ((u32) p_addr) | (PG_PRESENT | PG_WRITE | flags);
 
+		if (pd)
+			spin_unlock_irqrestore(&pd->lock, irq);
+
 		return 0;
 	}
 
@@ -390,7 +604,7 @@ extern "C" {
 			pte = (u32 *) (0xFFC00000 | (((u32) v_addr & 0xFFFFF000) >> 10));
 			*pte = (*pte & (~PG_PRESENT));
 			
-			asm("invlpg %0"::"m"(v_addr));
+			asm("invlpg %0"::"m"(*v_addr));
 		}
 
 		return 0;
@@ -414,6 +628,90 @@ extern "C" {
 
 		return 0;
 	}
+
+	/* Idem dans le repertoire pd, qui n'est pas forcement le courant */
+	char *pd_get_p_addr(struct page_directory *pd, char *v_addr)
+	{
+		u32 *pdir = (u32 *) pd->base->v_addr;
+		u32 pde = pdir[(u32) v_addr >> 22];
+		u32 *pt, pte;
+
+		if ((pde & PG_PRESENT) == 0)
+			return 0;
+		pt = (u32 *) kmap_atomic((char *) (pde & 0xFFFFF000));
+		pte = pt[((u32) v_addr >> 12) & 0x3FF];
+		kunmap_atomic((char *) pt);
+		if ((pte & PG_PRESENT) == 0)
+			return 0;
+		return (char *) ((pte & 0xFFFFF000) + (VADDR_PG_OFFSET((u32) v_addr)));
+	}
+
+	/*
+	 * Copie len octets entre local (espace courant) et remote (espace de
+	 * pd) sans tampon intermediaire, page par page a travers la fenetre
+	 * du processeur. Les pages des deux cotes doivent etre presentes : un
+	 * #PF ici ne peut pas etre servi.
+	 */
+	int pd_copy_user(struct page_directory *pd, char *remote, char *local, u32 len, int to_remote)
+	{
+		char *p, *w;
+		u32 n, flags;
+		int ret = 0;
+
+		flags = spin_lock_irqsave(&pd->lock);
+		while (len > 0) {
+			n = PAGESIZE - (VADDR_PG_OFFSET((u32) remote));
+			if (n > len)
+				n = len;
+			p = pd_get_p_addr(pd, remote);
+			if (p == 0) {
+				ret = -1;
+				break;
+			}
+			w = kmap_atomic(p);
+			if (to_remote)
+				memcpy(w, local, n);
+			else
+				memcpy(local, w, n);
+			kunmap_atomic(w);
+			remote += n;
+			local += n;
+			len -= n;
+		}
+		spin_unlock_irqrestore(&pd->lock, flags);
+		return ret;
+	}
+
+	/*
+	 * Alloue et projette les pages [v_begin, v_end[ de l'espace utilisateur
+	 * de proc, qui doit etre le repertoire courant. Evite de passer par le
+	 * #PF, qui affecte la page au processus courant (pcurrent).
+	 */
+	int pd_alloc_user(process_st *proc, char *v_begin, char *v_end)
+	{
+		struct page *pg;
+		u32 v, flags;
+
+		for (v = (u32) v_begin & 0xFFFFF000; v < (u32) v_end; v += PAGESIZE) {
+			if (get_p_addr((char *) v))
+				continue;
+
+			pg = (struct page *) kmalloc(sizeof(struct page));
+			pg->p_addr = get_page_frame();
+			if ((int)(pg->p_addr) < 0) {
+				kfree(pg);
+				return -1;
+			}
+			pg->v_addr = (char *) v;
+
+			flags = spin_lock_irqsave(&proc->pd->lock);
+			list_add(&pg->list, &proc->pglist);
+			spin_unlock_irqrestore(&proc->pd->lock, flags);
+
+			pd_add_page(pg->v_addr, pg->p_addr, PG_USER, proc->pd);
+		}
+		return 0;
+	}
 }
 
 void Vmm::kmap(u32 phy,u32 virt){
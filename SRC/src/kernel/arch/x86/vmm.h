@@ -5,6 +5,7 @@
 #include <runtime/list.h>
 #include <runtime/alloc.h>
 #include <x86.h>
+#include <spinlock.h>
 
 
 extern "C" {
@@ -18,6 +19,7 @@ struct page {
 struct page_directory {
 		page *base;
 		list_head pt;
+		spinlock_t lock;	/* protege les tables et la liste pglist du processus */
 };
 
 struct vm_area {
@@ -42,9 +44,13 @@ typedef page_directory proc_memory;
 
 
 
-	/* Marque une page comme utilisee / libre dans le bitmap */
-	#define set_page_frame_used(page)	mem_bitmap[((u32) page)/8] |= (1 << (((u32) page)%8))
-	#define release_page_frame(p_addr)	mem_bitmap[((u32) p_addr/PAGESIZE)/8] &= ~(1 << (((u32) p_addr/PAGESIZE)%8))
+	/* Marque une page comme utilisee / libre dans le bitmap (frame_lock pris) */
+	#define __set_page_frame_used(page)	mem_bitmap[((u32) page)/8] |= (1 << (((u32) page)%8))
+	#define __release_page_frame(p_addr)	mem_bitmap[((u32) p_addr/PAGESIZE)/8] &= ~(1 << (((u32) p_addr/PAGESIZE)%8))
+
+	/* Idem en prenant le verrou du bitmap */
+	void set_page_frame_used(u32 page);
+	void release_page_frame(char *p_addr);
 
 	/* Selectionne une page libre dans le bitmap */
 	char *get_page_frame(void);
@@ -70,8 +76,28 @@ typedef page_directory proc_memory;
 	int pd_add_page(char *, char *, int, struct page_directory *);
 	int pd_remove_page(char *);
 
+	/* Projette / enleve une zone physique (peripherique, tables du BIOS) */
+	char *ioremap(u32 phys, u32 size);
+	void iounmap(char *v_addr, u32 size);
+
+	/* Pages physiques contigues pour le DMA d'un peripherique */
+	char *get_contig_pages(u32 n, u32 *p_addr);
+	void release_contig_pages(char *v_addr, u32 n);
+
 	/* Retourne l'adresse physique associee a une adresse virtuelle */
 	char *get_p_addr(char *);
+	char *pd_get_p_addr(struct page_directory *, char *);
+
+	/* Projection temporaire d'une page physique (fenetre du processeur) */
+	void kmap_init(void);
+	char *kmap_atomic(char *p_addr);
+	void kunmap_atomic(char *v_addr);
+
+	/* Copie entre l'espace courant et celui d'un autre repertoire */
+	int pd_copy_user(struct page_directory *pd, char *remote, char *local, u32 len, int to_remote);
+
+	/* Alloue les pages utilisateur [begin, end[ d'un processus (repertoire courant) */
+	int pd_alloc_user(struct process_st *, char *, char *);
 
 	
 	#define KMALLOC_MINSIZE		16
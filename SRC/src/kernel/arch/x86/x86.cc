@@ -1,6 +1,7 @@
 #include <os.h>
 #include <x86.h>
 #include <keyboard.h>
+#include <apic.h>
 
 
 extern "C" {
@@ -51,10 +52,12 @@ void schedule();
 idtdesc 	kidt[IDTSIZE]; 		/* IDT table */
 int_desc 	intt[IDTSIZE]; 		/* Interruptions functions tables */
 gdtdesc 	kgdt[GDTSIZE];		/* GDT */
-tss 		default_tss;
 gdtr 		kgdtr;				/* GDTR */
 idtr 		kidtr; 				/* IDTR registry */
-u32 *		stack_ptr=0;
+
+u32					tsc_khz=0;			/* cycles par milliseconde */
+static u32			fpu_features=0;		/* cpuid(1).edx */
+static char			fpu_clean[FPU_STATE_SIZE + FPU_STATE_ALIGN];	/* state after fninit */
 
 /*
  * 'init_desc' initialize a segment descriptor in gdt or ldt.
@@ -78,12 +81,6 @@ void init_gdt_desc(u32 base, u32 limite, u8 acces, u8 other,struct gdtdesc *desc
  */
 void init_gdt(void)
 {
-
-	default_tss.debug_flag = 0x00;
-	default_tss.io_map = 0x00;
-	default_tss.esp0 = 0x1FFF0;
-	default_tss.ss0 = 0x18;
-
 	/* initialize gdt segments */
 	init_gdt_desc(0x0, 0x0, 0x0, 0x0, &kgdt[0]);
 	init_gdt_desc(0x0, 0xFFFFF, 0x9B, 0x0D, &kgdt[1]);	/* code */
@@ -94,7 +91,14 @@ void init_gdt(void)
 	init_gdt_desc(0x0, 0xFFFFF, 0xF3, 0x0D, &kgdt[5]);	/* udata */
 	init_gdt_desc(0x0, 0x0, 0xF7, 0x0D, &kgdt[6]);		/* ustack */
 
-	init_gdt_desc((u32) & default_tss, 0x67, 0xE9, 0x00, &kgdt[7]);	/* descripteur de tss */
+	/* ordre impose par sysenter/sysexit (SYSENTER_CS) */
+	init_gdt_desc(0x0, 0xFFFFF, 0x9B, 0x0D, &kgdt[8]);	/* sysenter code */
+	init_gdt_desc(0x0, 0xFFFFF, 0x93, 0x0D, &kgdt[9]);	/* sysenter data */
+	init_gdt_desc(0x0, 0xFFFFF, 0xFF, 0x0D, &kgdt[10]);	/* sysexit ucode */
+	init_gdt_desc(0x0, 0xFFFFF, 0xF3, 0x0D, &kgdt[11]);	/* sysexit udata */
+
+	/* tss (kgdt[7]) et segment per-cpu (kgdt[12]) du BSP */
+	cpu_init(&cpus[0], 0, kgdt);
 
 	/* initialize the gdtr structure */
 	kgdtr.limite = GDTSIZE * 8;
@@ -111,10 +115,9 @@ void init_gdt(void)
             movw %ax, %ds	\n \
             movw %ax, %es	\n \
             movw %ax, %fs	\n \
-            movw %ax, %gs	\n \
             ljmp $0x08, $next	\n \
             next:		\n");
-			
+	asm("movw %0, %%ax; movw %%ax, %%gs"::"i"(PERCPU_SEL):"eax");
 }
 
 
@@ -127,38 +130,127 @@ void init_idt_desc(u16 select, u32 offset, u16 type, struct idtdesc *desc)
 	return;
 }
 
-extern void _asm_int_0();
 extern void _asm_int_1();
+extern void _asm_int_2();
+extern void _asm_int_3();
+extern void _asm_int_4();
+extern void _asm_int_5();
+extern void _asm_int_6();
+extern void _asm_int_7();
+extern void _asm_int_8();
+extern void _asm_int_9();
+extern void _asm_int_10();
+extern void _asm_int_11();
+extern void _asm_int_12();
+extern void _asm_int_13();
+extern void _asm_int_14();
+extern void _asm_int_15();
+extern void _asm_int_ignore();
 extern void _asm_syscalls();
+extern void _asm_sysenter();
 extern void _asm_exc_GP(void);
 extern void _asm_exc_PF(void);
+extern void _asm_exc_NM(void);
+extern void _asm_exc_MF(void);
+extern void _asm_exc_XF(void);
 extern void _asm_schedule();
+extern void _asm_yield();
+extern void _asm_apic_timer();
 
-void do_syscalls(int num){
-	 u32 ret,ret1,ret2,ret3,ret4;
-	 asm("mov %%ebx, %0": "=m"(ret):);
-	 asm("mov %%ecx, %0": "=m"(ret1):);
-	 asm("mov %%edx, %0": "=m"(ret2):);
-	 asm("mov %%edi, %0": "=m"(ret3):);
-	 asm("mov %%esi, %0": "=m"(ret4):);
-	 //io.print("syscall %d \n",num);
-	 /*io.print(" ebx : %x  ",ret);
-	 io.print(" ecx : %x \n",ret1);
-	 io.print(" edx : %x  ",ret2);
-	 io.print(" edi : %x \n",ret3);*/
-	   
-	 arch.setParam(ret,ret1,ret2,ret3,ret4);
-	 asm("cli");
-	 asm("mov %%ebp, %0": "=m"(stack_ptr):);
+/*
+ * Comptabilite du temps processeur : le temps ecoule depuis acct_stamp est
+ * impute au mode utilisateur ou au noyau a l'entree et a la sortie des
+ * appels systeme et a chaque commutation (interruptions masquees).
+ */
+static inline void acct_charge(process_st* p, int user, u64 now)
+{
+	if (user)
+		p->utime += now - p->acct_stamp;
+	else
+		p->stime += now - p->acct_stamp;
+	p->acct_stamp = now;
+}
 
-	 
-	 syscall.call(num);
+/*
+ * Common entry of int 0x80 and sysenter : the number is in eax and the
+ * arguments in ebx, ecx, edx, edi, esi of the saved frame.
+ */
+void do_syscalls(syscall_frame* frame){
+	 if (arch.pcurrent==NULL)
+		return;
+	 //io.print("syscall %d \n",frame->eax);
+
+	 /*
+	  * The syscall runs with the interruptions enabled (sysenter clears IF),
+	  * the shared structures are protected by their own spinlocks.
+	  */
+	 process_st* current=(arch.pcurrent)->getPInfo();
+	 u32 nr=frame->eax;
+	 current->sframe=frame;
+	 asm("cli");		/* int 0x80 is a trap gate */
+	 acct_charge(current, 1, cpu_cycles());
+	 trace(TRACE_SYSCALL_ENTER, nr, frame->ebx, frame->ecx);
 	 asm("sti");
+	 syscall.call(nr);
+	 asm("cli");
+	 acct_charge(current, 0, cpu_cycles());
+	 trace(TRACE_SYSCALL_EXIT, nr, frame->eax, 0);
 }
 
+/*
+ * sysenter entry : ebp is the user stack pointing on the return address.
+ * The return eip and esp of the frame are only set from a stack inside
+ * the user space, a process giving another ebp is killed.
+ */
+void do_sysenter(syscall_frame* frame){
+	u32 ustack=frame->user_esp;
+	u32 eip;
+	
+	if (arch.pcurrent==NULL)
+		return;
+	if (ustack<USER_OFFSET || ustack>USER_STACK-4)
+		goto bad;
+	eip=*((u32*)ustack);
+	if (eip<USER_OFFSET || eip>=USER_STACK)
+		goto bad;
+	frame->eip=eip;
+	frame->user_esp=ustack+4;
+	do_syscalls(frame);
+	return;
+	
+bad:
+	io.print("sysenter : bad user stack %p in %s, killed\n",ustack,(arch.pcurrent)->getName());
+	(arch.pcurrent)->exit();
+	schedule();
+}
 
+/*
+ * Configure the sysenter MSRs of the running processor, int 0x80 stays
+ * available for the processors (and programs) without SEP. The entry
+ * stack is the esp0 field of the processor TSS, _asm_sysenter loads the
+ * kernel stack of the current process from it.
+ */
+void init_sysenter(void)
+{
+	regs_t r = cpu_cpuid(0x01);
+	u32 family = (r.eax >> 8) & 0xF;
+	u32 model = (r.eax >> 4) & 0xF;
+	u32 stepping = r.eax & 0xF;
+
+	/* the first Pentium Pro report SEP without supporting it */
+	if (!(r.edx & CPUID_SEP) || (family == 6 && model < 3 && stepping < 3)) {
+		io.print("sysenter not supported, use int 0x80 \n");
+		return;
+	}
+
+	asmv("wrmsr"::"c"(MSR_SYSENTER_CS), "a"(SYSENTER_CS), "d"(0));
+	asmv("wrmsr"::"c"(MSR_SYSENTER_ESP), "a"((u32) &cpu_self()->cpu_tss.esp0), "d"(0));
+	asmv("wrmsr"::"c"(MSR_SYSENTER_EIP), "a"((u32) _asm_sysenter), "d"(0));
+}
 
-void isr_kbd_int(void)
+
+
+void isr_kbd_int(u32 irq, void* data)
 {
 	u8 i;
 	static int lshift_enable;
@@ -236,44 +328,54 @@ void isr_kbd_int(void)
 			break;
 		}
 	}
-	
-		io.outb(0x20,0x20);
-		io.outb(0xA0,0x20); 
 }
 
 
-void isr_default_int(int id)
+void isr_schedule_int()
 {
-	static int tic = 0;
-	static int sec = 0;
-	switch (id){
-		case 1:
-			isr_kbd_int();
-			break;
-			
-			
-		default:
-			return;
-		
-	}
+	/* registres sauves par SAVE_REGS, au-dessus du cadre de la fonction */
+	syscall_frame* f = (syscall_frame*) ((u32*) __builtin_frame_address(0) + 2);
+	cpu_info* c = cpu_self();
+
+	c->irq_regs = f;
+	if (prof_running)
+		prof_tick(f);
+
+	/* handlers de l'IRQ 0, acquittement puis bottom halves */
+	irq_handle(0);
+	irq_eoi(0);
+	irq_exit();
 	
-	io.outb(0x20,0x20);
-	io.outb(0xA0,0x20);
+	/* pas de preemption pendant un softirq */
+	if (!in_softirq())
+		schedule();
 }
 
+/*
+ * Horloge de l'APIC local. Avec l'IOAPIC l'IRQ 0 est masquee : le BSP
+ * appelle ses handlers a chaque tick.
+ */
+void isr_apic_timer()
+{
+	syscall_frame* f = (syscall_frame*) ((u32*) __builtin_frame_address(0) + 2);
+	cpu_info* c = cpu_self();
+	c->ticks++;
+	c->irq_regs = f;
+	if (prof_running)
+		prof_tick(f);
+	if (c->id == 0)
+		irq_handle(0);
+	lapic_eoi();
+	irq_exit();
+	
+	if (!in_softirq())
+		schedule();
+}
 
-void isr_schedule_int()
+/* Abandon volontaire du processeur (processus endormi, thread noyau) */
+void isr_yield()
 {
-	static int tic = 0;
-	static int sec = 0;
-		tic++;
-		if (tic % 100 == 0) {
-		sec++;
-		tic = 0;
-	}
 	schedule();
-	io.outb(0x20,0x20);
-	io.outb(0xA0,0x20);
 }
 
 void isr_GP_exc(void)
@@ -294,7 +396,6 @@ void isr_PF_exc(void)
 {
 	u32 faulting_addr, code;
 	u32 eip;
-	struct page *pg;
 	u32 stack;
  	asm(" 	movl 60(%%ebp), %%eax	\n \
     		mov %%eax, %0		\n \
@@ -305,6 +406,7 @@ void isr_PF_exc(void)
 		: "=m"(eip), "=m"(faulting_addr), "=m"(code));
 	 asm("mov %%ebp, %0": "=m"(stack):);
 	
+	trace(TRACE_PAGE_FAULT, faulting_addr, eip, code);
 	//io.print("#PF : %x \n",faulting_addr);
 	
 	//for (;;);
@@ -314,11 +416,7 @@ void isr_PF_exc(void)
 		process_st* current=arch.pcurrent->getPInfo();
 
 	if (faulting_addr >= USER_OFFSET && faulting_addr <= USER_STACK) {
-		pg = (struct page *) kmalloc(sizeof(struct page));
-		pg->p_addr = get_page_frame();
-		pg->v_addr = (char *) (faulting_addr & 0xFFFFF000);
-		list_add(&pg->list, &current->pglist);
-		pd_add_page(pg->v_addr, pg->p_addr, PG_USER, current->pd);
+		pd_alloc_user(current, (char *) faulting_addr, (char *) faulting_addr + 1);
 	}
 	else {
 		io.print("\n");
@@ -340,6 +438,149 @@ void isr_PF_exc(void)
 
 
 
+/*
+ * Lazy FPU switching: CR0.TS is set when a process which doesn't own the
+ * FPU is scheduled, its first FPU/SSE instruction then raises #NM and the
+ * context is swapped here. Processes which never touch the FPU never pay
+ * for the save/restore.
+ */
+static void fpu_save(char* state)
+{
+	if (fpu_features & CPUID_FXSR)
+		asmv("fxsave (%0)"::"r"(fpu_area(state)):"memory");
+	else
+		asmv("fnsave (%0); fwait"::"r"(fpu_area(state)):"memory");
+}
+
+static void fpu_restore(char* state)
+{
+	if (fpu_features & CPUID_FXSR)
+		asmv("fxrstor (%0)"::"r"(fpu_area(state)):"memory");
+	else
+		asmv("frstor (%0)"::"r"(fpu_area(state)):"memory");
+}
+
+void init_fpu(void)
+{
+	u32 cr;
+	
+	fpu_features = cpu_cpuid(0x01).edx;
+	if (!(fpu_features & CPUID_FPU)) {
+		io.print("No FPU found, floating point is disabled \n");
+		return;
+	}
+
+	asm("mov %%cr0, %0":"=r"(cr));
+	cr = (cr & ~(EM_FLAG | TS_FLAG)) | MP_FLAG | NE_FLAG;
+	asm("mov %0, %%cr0"::"r"(cr));
+
+	if (fpu_features & CPUID_FXSR) {
+		asm("mov %%cr4, %0":"=r"(cr));
+		cr |= OSFXSR_FLAG;
+		if (fpu_features & CPUID_SSE)
+			cr |= OSXMMEXCPT_FLAG;
+		asm("mov %0, %%cr4"::"r"(cr));
+	}
+
+	/* keep a clean context to start new processes from (BSP) */
+	asmv("fninit");
+	if (smp_processor_id() == 0)
+		fpu_save(fpu_clean);
+
+	/* nobody owns the FPU until the first #NM */
+	asm("mov %%cr0, %0":"=r"(cr));
+	asm("mov %0, %%cr0"::"r"(cr | TS_FLAG));
+}
+
+/* Free the FPU context of a destroyed process */
+void fpu_release(process_st* p)
+{
+	u32 i;
+	for (i = 0; i < smp_ncpu; i++)
+		if (cpus[i].fpu_owner == p)
+			cpus[i].fpu_owner = NULL;
+	if (p->fpu_state != NULL)
+		kfree(p->fpu_state);
+	p->fpu_state = NULL;
+}
+
+/* Give a forked process a copy of the father FPU context */
+void fpu_copy(process_st* to, process_st* from)
+{
+	to->fpu_state = NULL;
+	if (from->fpu_state == NULL)
+		return;
+
+	to->fpu_state = (char*) kmalloc(FPU_STATE_SIZE + FPU_STATE_ALIGN);
+	if (cpu_self()->fpu_owner == from) {
+		asmv("clts");
+		fpu_save(from->fpu_state);
+		fpu_restore(from->fpu_state);	/* fnsave reinitialise the FPU */
+	}
+	memcpy(fpu_area(to->fpu_state), fpu_area(from->fpu_state), FPU_STATE_SIZE);
+}
+
+/*
+ * On SMP a process can be resumed by another processor : its context is
+ * saved when it leaves the processor which owns it, the restore stays
+ * lazy.
+ */
+static void fpu_leave(cpu_info* c, process_st* p)
+{
+	if (smp_ncpu < 2 || c->fpu_owner != p)
+		return;
+	asmv("clts");
+	fpu_save(p->fpu_state);
+	c->fpu_owner = NULL;
+}
+
+void isr_NM_exc(void)
+{
+	cpu_info* c = cpu_self();
+	process_st* current;
+
+	if (!(fpu_features & CPUID_FPU) || arch.pcurrent==NULL) {
+		io.print("\n Device not available !\n");
+		if (arch.pcurrent!=NULL) {
+			io.print("The processus %s have to be killed !\n\n",(arch.pcurrent)->getName());
+			(arch.pcurrent)->exit();
+			schedule();
+		}
+		return;
+	}
+
+	asmv("clts");
+	current = arch.pcurrent->getPInfo();
+	if (c->fpu_owner == current)
+		return;
+
+	if (c->fpu_owner != NULL)
+		fpu_save(c->fpu_owner->fpu_state);
+
+	if (current->fpu_state == NULL) {
+		current->fpu_state = (char*) kmalloc(FPU_STATE_SIZE + FPU_STATE_ALIGN);
+		memcpy(fpu_area(current->fpu_state), fpu_area(fpu_clean), FPU_STATE_SIZE);
+	}
+	fpu_restore(current->fpu_state);
+	c->fpu_owner = current;
+}
+
+/* x87 (#MF) and SIMD (#XF) floating point exceptions */
+void isr_FPU_exc(int id)
+{
+	io.print("\n Floating point exception (%s) !\n", (id == 16) ? "x87" : "SIMD");
+	asmv("fnclex");
+	if (arch.pcurrent!=NULL){
+		io.print("The processus %s have to be killed !\n\n",(arch.pcurrent)->getName());
+		(arch.pcurrent)->exit();
+		schedule();
+	}
+	else{
+		io.print("The kernel have to be killed !\n\n");
+		asm("hlt");
+	}
+}
+
 /*
  * Init IDT after kernel is loaded
  */
@@ -347,15 +588,31 @@ void init_idt(void)
 {
 	/* Init irq */
 	int i;
-	for (i = 0; i < IDTSIZE; i++) 
+	static int_desc irq_stubs[NR_IRQS] = {
+		_asm_schedule, _asm_int_1, _asm_int_2, _asm_int_3,
+		_asm_int_4, _asm_int_5, _asm_int_6, _asm_int_7,
+		_asm_int_8, _asm_int_9, _asm_int_10, _asm_int_11,
+		_asm_int_12, _asm_int_13, _asm_int_14, _asm_int_15
+	};
+	
+	for (i = 0; i < 32; i++) 
 		init_idt_desc(0x08, (u32)_asm_schedule, INTGATE, &kidt[i]); // 
+	for (i = 32; i < IDTSIZE; i++) 
+		init_idt_desc(0x08, (u32)_asm_int_ignore, INTGATE, &kidt[i]);
 	
 	/* Vectors  0 -> 31 are for exceptions */
+	init_idt_desc(0x08, (u32) _asm_exc_NM, INTGATE, &kidt[7]);		/* #NM */
+	init_idt_desc(0x08, (u32) _asm_exc_MF, INTGATE, &kidt[16]);		/* #MF */
+	init_idt_desc(0x08, (u32) _asm_exc_XF, INTGATE, &kidt[19]);		/* #XF */
 	init_idt_desc(0x08, (u32) _asm_exc_GP, INTGATE, &kidt[13]);		/* #GP */
 	init_idt_desc(0x08, (u32) _asm_exc_PF, INTGATE, &kidt[14]);     /* #PF */
 	
-	init_idt_desc(0x08, (u32) _asm_schedule, INTGATE, &kidt[32]);
-	init_idt_desc(0x08, (u32) _asm_int_1, INTGATE, &kidt[33]);
+	/* IRQ 0-7 en 0x20, IRQ 8-15 en 0x70 (voir init_pic) */
+	for (i = 0; i < NR_IRQS; i++)
+		init_idt_desc(0x08, (u32) irq_stubs[i], INTGATE, &kidt[IRQ_VECTOR(i)]);
+	
+	init_idt_desc(0x08, (u32) _asm_yield, INTGATE, &kidt[YIELD_VECTOR]);
+	init_idt_desc(0x08, (u32) _asm_apic_timer, INTGATE, &kidt[APIC_TIMER_VECTOR]);
 	
 	init_idt_desc(0x08, (u32) _asm_syscalls, TRAPGATE, &kidt[48]);
 	init_idt_desc(0x08, (u32) _asm_syscalls, TRAPGATE, &kidt[128]); //48
@@ -395,20 +652,45 @@ void init_pic(void)
 	io.outb(0xA1, 0x0);
 }
 
+/* Canal 0 du PIT en generateur de frequence (mode 3) : un tick tous les 1/HZ s */
+void init_pit(void)
+{
+	u32 divisor = PIT_FREQ / HZ;
+
+	io.outb(0x43, 0x36);
+	io.outb(0x40, divisor & 0xFF);
+	io.outb(0x40, (divisor >> 8) & 0xFF);
+}
+
+/* Frequence du compteur rdtsc, mesuree sur 10 ms avec le canal 2 du PIT */
+void init_tsc(void)
+{
+	u64 t0, t1;
+
+	if (!(cpu_cpuid(0x01).edx & CPUID_TSC)) {
+		io.print("No TSC found, cpu time accounting is disabled \n");
+		return;
+	}
+	t0 = rdtsc();
+	udelay(10000);
+	t1 = rdtsc();
+	tsc_khz = ((u32) (t1 - t0)) / 10;
+	io.print("TSC at %d MHz \n", tsc_khz / 1000);
+}
+
 #define DEBUG_REG(a) io.print("  %s : %x",#a,p->regs.a)
 
 void schedule(){
-	Process* pcurrent=arch.pcurrent;
-	Process*plist=arch.plist;
+	cpu_info* c=cpu_self();
+	Process* pcurrent=c->current;
+	Process* prev=pcurrent;
+	u32* stack_ptr;
+	u64 now;
 	if (pcurrent==0)
 		return;
 
-	if (pcurrent->getPNext() == 0 && plist==pcurrent)	//si le proc est seul
-		return;
-
 	process_st* current=pcurrent->getPInfo();
 	process_st *p;
-	int i, newpid;
 
 	/* Stocke dans stack_ptr le pointeur vers les registres sauvegardes */
 	asm("mov (%%ebp), %%eax; mov %%eax, %0": "=m"(stack_ptr):);
@@ -437,22 +719,47 @@ void schedule(){
 		 * au moment de l'interruption. Necessaire car le processeur
 		 * empile ou non ces valeurs selon le contexte de l'interruption.
 		 */
-		if (current->regs.cs != 0x08) {	/* mode utilisateur */
+		if (current->regs.cs & 3) {	/* mode utilisateur */
 			current->regs.esp = stack_ptr[17];
 			current->regs.ss = stack_ptr[18];
 		} else {	/* pendant un appel systeme */
 			current->regs.esp = stack_ptr[9] + 12;	/* vaut : &stack_ptr[17] */
-			current->regs.ss = default_tss.ss0;
+			current->regs.ss = c->cpu_tss.ss0;
 		}
 
 		/* Sauver le TSS de l'ancien processus */
-		current->kstack.ss0 = default_tss.ss0;
-		current->kstack.esp0 = default_tss.esp0;
+		current->kstack.ss0 = c->cpu_tss.ss0;
+		current->kstack.esp0 = c->cpu_tss.esp0;
+
+	/* temps ecoule depuis la derniere imputation, selon le mode interrompu */
+	now = cpu_cycles();
+	acct_charge(current, current->regs.cs & 3, now);
 	
 	//io.print("schedule %s ",pcurrent->getName());
 	pcurrent=pcurrent->schedule();
 	p = pcurrent->getPInfo();
 
+	/* l'ancien processus redevient migrable une fois sa pile quittee (do_switch) */
+	if (pcurrent != prev) {
+		fpu_leave(c, current);
+		c->prev_running = &current->running;
+
+		/* preempte : il attend dans sa run queue, sinon il s'est endormi */
+		if (prev->isRunnable()) {
+			current->nivcsw++;
+			if (prev != c->idle)
+				current->wait_stamp = now;
+		} else
+			current->nvcsw++;
+
+		if (p->wait_stamp != 0 && pcurrent != c->idle)
+			p->wtime += now - p->wait_stamp;
+		p->wait_stamp = 0;
+
+		trace(TRACE_SCHED_SWITCH, prev->getPid(), pcurrent->getPid(), prev->getState());
+	}
+	p->acct_stamp = now;
+
 	//io.print("to %s \n",pcurrent->getName());
 	/*DEBUG_REG(eax);
 	DEBUG_REG(ebx);
@@ -474,7 +781,7 @@ void schedule(){
 	io.print("\n");*/
 	
 	/* Commutation */
-	if (p->regs.cs != 0x08)
+	if (p->regs.cs & 3)
 		switch_to_task(p, USERMODE);
 	else
 		switch_to_task(p, KERNELMODE);
@@ -490,6 +797,7 @@ void schedule(){
 void switch_to_task(process_st* current, int mode)
 {
 
+	cpu_info* c = cpu_self();
 	u32 kesp, eflags;
 	u16 kss, ss, cs;
 	int sig;
@@ -500,8 +808,14 @@ void switch_to_task(process_st* current, int mode)
 			handle_signal(sig);
 	
 	/* Charge le TSS du nouveau processus */
-	default_tss.ss0 = current->kstack.ss0;
-	default_tss.esp0 = current->kstack.esp0;
+	c->cpu_tss.ss0 = current->kstack.ss0;
+	c->cpu_tss.esp0 = current->kstack.esp0;
+
+	/* FPU paresseuse : seul le proprietaire du FPU l'utilise sans #NM */
+	if (current == c->fpu_owner)
+		asmv("clts");
+	else
+		asmv("mov %%cr0, %%eax; or %0, %%eax; mov %%eax, %%cr0"::"i"(TS_FLAG):"eax");
 
 	/* 
 	 * Empile les registres ss, esp, eflags, cs et eip necessaires a la
@@ -590,7 +904,7 @@ int handle_signal(int sig)
 	}
 	else if (current->sigfn[sig] == (void*) SIG_DFL) {
 		switch(sig) {
-			case SIGHUP : case SIGINT : case SIGQUIT : 
+			case SIGHUP : case SIGINT : case SIGQUIT : case SIGKILL : case SIGTERM : 
 				asm("mov %0, %%eax; mov %%eax, %%cr3"::"m"(current->regs.cr3));
 				pcurrent->exit();
 				break;
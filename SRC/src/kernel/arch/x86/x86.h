@@ -9,6 +9,14 @@
 #define IDTBASE		0x00000000	/* addr. physique ou doit resider la IDT */
 #define GDTBASE		0x00000800	/* addr. physique ou doit resider la gdt */
 
+#define NR_IRQS		16		/* lignes des deux PIC 8259 */
+#define IRQ_VECTOR(irq)	((irq) < 8 ? 0x20 + (irq) : 0x70 + (irq) - 8)
+
+#define YIELD_VECTOR	0x81	/* Architecture::yield(), noyau seulement */
+
+#define HZ			100		/* tick du scheduler (PIT canal 0 ou APIC timer) */
+#define PIT_FREQ	1193182
+
 #define INTGATE  0x8E00		/* utilise pour gerer les interruptions */
 #define TRAPGATE 0xEF00		/* utilise pour faire des appels systemes */
 
@@ -34,11 +42,40 @@
 #define	PAGING_FLAG 		0x80000000	/* CR0 - bit 31 */
 #define PSE_FLAG			0x00000010	/* CR4 - bit 4  */
 
+#define MP_FLAG				0x00000002	/* CR0 - bit 1  */
+#define EM_FLAG				0x00000004	/* CR0 - bit 2  */
+#define TS_FLAG				0x00000008	/* CR0 - bit 3  */
+#define NE_FLAG				0x00000020	/* CR0 - bit 5  */
+#define OSFXSR_FLAG			0x00000200	/* CR4 - bit 9  */
+#define OSXMMEXCPT_FLAG		0x00000400	/* CR4 - bit 10 */
+
+#define CPUID_FPU			0x00000001	/* cpuid(1).edx */
+#define CPUID_TSC			0x00000010
+#define CPUID_SEP			0x00000800
+#define CPUID_FXSR			0x01000000
+#define CPUID_SSE			0x02000000
+
+#define FPU_STATE_SIZE		512		/* FXSAVE area */
+#define FPU_STATE_ALIGN		16
+#define fpu_area(p)			((char*) (((u32) (p) + FPU_STATE_ALIGN - 1) & ~(FPU_STATE_ALIGN - 1)))
+
 #define PG_PRESENT			0x00000001	/* page directory / table */
 #define PG_WRITE			0x00000002
 #define PG_USER				0x00000004
+#define PG_PWT				0x00000008
+#define PG_PCD				0x00000010
 #define PG_4MB				0x00000080
 
+#define MSR_SYSENTER_CS		0x174
+#define MSR_SYSENTER_ESP	0x175
+#define MSR_SYSENTER_EIP	0x176
+
+/*
+ * SYSENTER/SYSEXIT use fixed selectors : CS, CS+8 for the kernel and
+ * CS+16, CS+24 for the user. They live after the TSS descriptor.
+ */
+#define SYSENTER_CS			0x40
+
 #define	PAGESIZE 			4096
 #define	RAM_MAXSIZE			0x100000000
 #define	RAM_MAXPAGE			0x100000
@@ -102,18 +139,67 @@ typedef struct
 	u32 eip, cs, eflags, user_esp, user_ss;
 } __attribute__((packed)) regs_t;
 
+/*
+ * Registers saved on the kernel stack at syscall entry (int 0x80 or
+ * sysenter), the syscall arguments are read from and the return value
+ * written to this frame.
+ */
+struct syscall_frame {
+	u32 gs, fs, es, ds;
+	u32 edi, esi, ebp, esp, ebx, edx, ecx, eax;
+	u32 eip, cs, eflags, user_esp, user_ss;
+} __attribute__((packed));
+
 typedef void (*int_desc)(void);
 
+/* Compteur de cycles du processeur (comptabilite du temps, voir x86.cc) */
+static inline u64 rdtsc(void)
+{
+	u32 lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((u64) hi << 32) | lo;
+}
+
+extern "C" u32 tsc_khz;		/* cycles par milliseconde, mesure par init_tsc() */
+
+/* Horloge de la comptabilite : 0 sans TSC (rdtsc leverait #UD) */
+static inline u64 cpu_cycles(void)
+{
+	return (tsc_khz != 0) ? rdtsc() : 0;
+}
+
 extern "C" {
 	void init_gdt_desc(u32, u32, u8, u8, struct gdtdesc *);
 	void init_gdt(void);
 	void init_idt_desc(u16, u32, u16, struct idtdesc *);
 	void init_idt(void);
 	void init_pic(void);
-	int install_irq(unsigned int num,unsigned int irq);
+	void init_pit(void);
+	void init_tsc(void);
+	void init_irq(void);
+	int irq_install(u32 irq, irq_handler h, void* data);
+	int irq_remove(u32 irq, irq_handler h, void* data);
+	void irq_enable_line(u32 irq);
+	void irq_disable_line(u32 irq);
+	void irq_handle(u32 irq);
+	void irq_eoi(u32 irq);
+	u32 irq_count(u32 irq);
+	void do_irq(int irq);
+	void irq_set_override(u32 irq, u32 gsi, u32 mps_flags);
+	void irq_use_ioapic(u32 apic_id);
+	int irq_using_ioapic(void);
+	void isr_kbd_int(u32 irq, void* data);
 	void switch_to_task(process_st* current, int mode);
-	extern tss 		default_tss;
+	regs_t cpu_cpuid(int code);
 	u32 cpu_vendor_name(char *name);
+	void init_fpu(void);
+	void init_sysenter(void);
+	void isr_apic_timer(void);
+	void prof_tick(syscall_frame* f);
+	int prof_start(u32 source);
+	void prof_stop(void);
+	void fpu_release(process_st* p);
+	void fpu_copy(process_st* to, process_st* from);
 	int dequeue_signal(int);
 	int handle_signal(int);
 }
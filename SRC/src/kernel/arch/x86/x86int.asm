@@ -1,5 +1,6 @@
-extern isr_default_int, do_syscalls, isr_schedule_int
+extern do_irq, do_syscalls, do_sysenter, isr_schedule_int, isr_yield, isr_apic_timer
 
+PERCPU_SEL	equ 0x60		; segment per-cpu du noyau (voir smp.h)
 
 %macro	SAVE_REGS 0
 	pushad 
@@ -10,6 +11,8 @@ extern isr_default_int, do_syscalls, isr_schedule_int
 	push ebx
 	mov bx,0x10
 	mov ds,bx
+	mov bx,PERCPU_SEL
+	mov gs,bx
 	pop ebx
 %endmacro
 
@@ -21,31 +24,54 @@ extern isr_default_int, do_syscalls, isr_schedule_int
 	popad
 %endmacro
 
+;; IRQ materielle %1 : do_irq appelle les handlers et acquitte le PIC
 %macro	INTERRUPT 1
 global _asm_int_%1
 _asm_int_%1:
 	SAVE_REGS
 	push %1
-	call isr_default_int
-	pop eax	;;a enlever sinon
-	mov al,0x20
-	out 0x20,al
+	call do_irq
+	pop eax
 	RESTORE_REGS
 	iret
 %endmacro
 
-extern isr_GP_exc, isr_PF_exc 
-global _asm_syscalls, _asm_exc_GP, _asm_exc_PF
+extern isr_GP_exc, isr_PF_exc, isr_NM_exc, isr_FPU_exc
+global _asm_syscalls, _asm_exc_GP, _asm_exc_PF, _asm_exc_NM, _asm_exc_MF, _asm_exc_XF
 _asm_syscalls:
 	SAVE_REGS
-	push eax                 ; transmission du numero d'appel
+	push esp                 ; transmission des registres sauvegardes
 	call do_syscalls
 	pop eax
-	cli
-	sti
 	RESTORE_REGS
 	iret
 
+;; sysenter : eax = numero, ebx, ecx, edx, edi, esi = arguments,
+;; ebp = esp utilisateur qui pointe sur l'adresse de retour.
+;; Au retour eax = valeur de retour, esp = ebp + 4, ecx et edx sont perdus.
+;; MSR_SYSENTER_ESP pointe sur le champ esp0 du TSS du processeur.
+;; ebp vient de l'utilisateur : la memoire n'est lue qu'une fois le cadre
+;; complet, par do_sysenter qui verifie ebp et remplit eip et esp.
+global _asm_sysenter
+_asm_sysenter:
+	mov esp, [esp]			; pile noyau du processus courant
+	push dword 0x5B			; meme cadre qu'une interruption
+	push ebp
+	pushfd
+	or dword [esp], 0x200
+	push dword 0x53
+	push dword 0			; eip, rempli par do_sysenter
+	SAVE_REGS
+	push esp
+	call do_sysenter
+	pop eax
+	cli				; do_syscalls a reactive les interruptions
+	RESTORE_REGS
+	mov edx, [esp]			; eip de retour
+	mov ecx, [esp+12]		; esp utilisateur, adresse de retour depilee
+	sti
+	sysexit
+
 
 _asm_exc_GP:
 	SAVE_REGS
@@ -61,14 +87,68 @@ _asm_exc_PF:
 	add esp,4
 	iret
 
+_asm_exc_NM:
+	SAVE_REGS
+	call isr_NM_exc
+	RESTORE_REGS
+	iret
+
+_asm_exc_MF:
+	SAVE_REGS
+	push 16
+	call isr_FPU_exc
+	pop eax
+	RESTORE_REGS
+	iret
+
+_asm_exc_XF:
+	SAVE_REGS
+	push 19
+	call isr_FPU_exc
+	pop eax
+	RESTORE_REGS
+	iret
+
 global _asm_schedule
 _asm_schedule:
 	SAVE_REGS
-	call isr_schedule_int
-	mov al,0x20
-	out 0x20,al
+	call isr_schedule_int		; l'IRQ 0 est acquittee par isr_schedule_int
 	RESTORE_REGS
 	iret
 
+;; Architecture::yield() : meme cadre que l'horloge pour schedule()
+global _asm_yield
+_asm_yield:
+	SAVE_REGS
+	call isr_yield
+	RESTORE_REGS
+	iret
+
+;; horloge locale des AP (APIC timer), acquittee par isr_apic_timer
+global _asm_apic_timer
+_asm_apic_timer:
+	SAVE_REGS
+	call isr_apic_timer
+	RESTORE_REGS
+	iret
+
+;; vecteur sans handler
+global _asm_int_ignore
+_asm_int_ignore:
+	iret
+
 INTERRUPT 1
 INTERRUPT 2
+INTERRUPT 3
+INTERRUPT 4
+INTERRUPT 5
+INTERRUPT 6
+INTERRUPT 7
+INTERRUPT 8
+INTERRUPT 9
+INTERRUPT 10
+INTERRUPT 11
+INTERRUPT 12
+INTERRUPT 13
+INTERRUPT 14
+INTERRUPT 15
@@ -13,9 +13,24 @@ void call_execv();
 void call_symlink();
 void call_getdents();
 void call_wait();
+void call_kill();
 void call_dup2();
 void call_fork();
 void call_chdir();
 void call_mmap();
+void call_getpid();
+void call_spawn();
+void call_futex();
+void call_create_semaphore();
+void call_delete_semaphore();
+void call_lock_semaphore();
+void call_unlock_semaphore();
+void call_ipc_send();
+void call_ipc_receive();
+void call_ipc_call();
+void call_ipc_reply();
+void call_sync();
+void call_fsync();
+void call_lseek();
 
 #endif
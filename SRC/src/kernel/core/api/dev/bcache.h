@@ -0,0 +1,27 @@
+#ifndef __API_BCACHE__
+#define __API_BCACHE__
+
+/*
+ *	Cache des blocs disque : /sys/bcache se lit comme une bcache_info,
+ *	ioctl pour changer la capacite ou vider le cache.
+ */
+
+struct bcache_info{
+	unsigned int	block_size;		/* octets par bloc */
+	unsigned int	capacity;		/* blocs au plus */
+	unsigned int	blocks;			/* blocs en memoire */
+	unsigned int	hits;
+	unsigned int	misses;
+	unsigned int	evictions;
+	unsigned int	dirty;			/* blocs a ecrire */
+	unsigned int	writebacks;		/* blocs ecrits sur le disque */
+	unsigned int	readahead;		/* blocs lus en avance */
+	unsigned int	ra_waits;		/* lectures arrivees pendant leur lecture en avance */
+};
+
+#define API_BCACHE_GET_INFO		0x5500	/* buffer : bcache_info */
+#define API_BCACHE_SET_CAPACITY	0x5501	/* buffer : unsigned int, en blocs */
+#define API_BCACHE_FLUSH		0x5502	/* ecrit les blocs sales, vide le cache et les compteurs */
+#define API_BCACHE_SYNC			0x5503	/* ecrit les blocs sales */
+
+#endif
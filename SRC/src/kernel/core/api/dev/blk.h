@@ -0,0 +1,36 @@
+#ifndef __API_BLK__
+#define __API_BLK__
+
+/* Statistiques de la file de requetes d'un disque */
+struct blk_stats {
+	unsigned int	requests;		/* requetes recues */
+	unsigned int	merges;			/* requetes chainees a une autre */
+	unsigned int	dispatched;		/* commandes donnees au pilote */
+	unsigned int	sectors;		/* secteurs transferes */
+	unsigned int	expired;		/* lancees hors ordre (date limite) */
+	unsigned int	depth;			/* requetes en attente */
+	unsigned int	max_depth;
+};
+
+/* Description d'un disque (IDENTIFY DEVICE ou equivalent) */
+struct blk_info {
+	unsigned int	sectors;		/* capacite, 32 bits bas */
+	unsigned int	sectors_hi;
+	unsigned int	sector_size;
+	unsigned int	max_sectors;	/* secteurs par commande */
+	unsigned int	flags;
+	unsigned int	multiple;		/* secteurs par IRQ en PIO */
+	unsigned int	udma;			/* masque des modes ultra DMA */
+	unsigned int	mwdma;			/* masque des modes multiword DMA */
+	unsigned int	depth;			/* commandes lancees a la fois */
+	char			model[41];
+};
+
+#define BLK_INFO_LBA48		0x1
+#define BLK_INFO_DMA		0x2
+#define BLK_INFO_NCQ		0x4
+
+#define API_BLK_GET_STATS	0x5600	/* remplit une struct blk_stats */
+#define API_BLK_GET_INFO	0x5601	/* remplit une struct blk_info */
+
+#endif
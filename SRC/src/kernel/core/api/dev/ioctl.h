@@ -5,6 +5,7 @@
 #define DEV_GET_TYPE		0x01	/* Renvoie le type de peripherique */
 #define	DEV_GET_STATE		0x02	/* renvoie l'etat du peripherique */
 #define	DEV_GET_FORMAT		0x03	/* renvoie le format du peripherique */
+#define	DEV_FLUSH_CACHE		0x04	/* vide le cache d'ecriture du disque */
 
 //Type de peripherique :
 #define DEV_TYPE_TTY 0x01
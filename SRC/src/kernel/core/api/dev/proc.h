@@ -8,12 +8,28 @@ struct proc_info{
 	unsigned char		state;
 	unsigned int		vmem;
 	unsigned int		pmem;
+	
+	/* temps processeur en cycles, cpu_khz cycles par milliseconde */
+	unsigned long long	utime;		/* mode utilisateur */
+	unsigned long long	stime;		/* noyau (appels systeme, interruptions) */
+	unsigned long long	wtime;		/* executable, en attente dans une run queue */
+	unsigned int		cpu_khz;	/* 0 : pas de compteur de cycles */
+	unsigned int		cpu;		/* processeur de la derniere execution */
+	unsigned int		nvcsw;		/* commutations volontaires (endormi) */
+	unsigned int		nivcsw;		/* commutations forcees (preempte) */
+	
+	/* systeme : charge moyenne x100 sur 1, 5 et 15 minutes, ticks depuis le boot */
+	unsigned int		loadavg[3];
+	unsigned int		ticks;
+	unsigned int		hz;
 };
 
 enum{
 	PROC_STATE_RUN=0,
 	PROC_STATE_ZOMBIE=1,
 	PROC_STATE_THREAD=2,
+	PROC_STATE_NEW=3,		/* en cours de creation, pas encore executable */
+	PROC_STATE_SLEEP=4,		/* endormi sur une WaitQueue */
 };
 
 #define API_PROC_GET_PID		0x5200
@@ -0,0 +1,47 @@
+#ifndef __API_PROF__
+#define __API_PROF__
+
+/*
+ *	Profileur par echantillonnage : /sys/profile se lit comme un tableau
+ *	de prof_sample, un par pile distincte (pid, mode, adresses). pc[0]
+ *	est l'eip interrompu, pc[1..depth-1] les adresses de retour.
+ */
+
+#define PROF_MAX_DEPTH		8
+
+struct prof_sample{
+	unsigned int		pid;
+	unsigned int		count;		/* echantillons sur cette pile */
+	unsigned char		user;		/* 1 : mode utilisateur (cs & 3) */
+	unsigned char		depth;
+	unsigned short		pad;
+	unsigned int		pc[PROF_MAX_DEPTH];
+} __attribute__ ((packed));
+
+enum{
+	PROF_SRC_TIMER=0,		/* tick du scheduler de chaque processeur (HZ) */
+	PROF_SRC_RTC=1,			/* IRQ 8 du RTC, PROF_RTC_HZ, processeur 0 */
+};
+
+#define PROF_RTC_HZ			1024
+
+struct prof_config{
+	unsigned int		source;		/* PROF_SRC_* */
+	unsigned int		pid;		/* 0 : tous les processus */
+};
+
+struct prof_info{
+	unsigned int		running;
+	unsigned int		source;
+	unsigned int		hz;			/* frequence d'echantillonnage */
+	unsigned int		samples;	/* echantillons enregistres */
+	unsigned int		dropped;	/* table pleine */
+	unsigned int		entries;	/* prof_sample a lire */
+};
+
+#define API_PROF_START			0x5400	/* buffer : prof_config, NULL = timer, tous */
+#define API_PROF_STOP			0x5401
+#define API_PROF_RESET			0x5402
+#define API_PROF_GET_INFO		0x5403	/* buffer : prof_info */
+
+#endif
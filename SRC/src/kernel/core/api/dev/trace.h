@@ -0,0 +1,49 @@
+#ifndef __API_TRACE__
+#define __API_TRACE__
+
+/*
+ *	Traces du noyau : /sys/trace se lit comme un flux binaire de
+ *	trace_event, dans l'ordre de seq. Un trou dans seq indique des
+ *	evenements ecrases avant d'avoir ete lus.
+ */
+
+struct trace_event{
+	unsigned int		seq;		/* numero de l'evenement + 1 */
+	unsigned short		type;
+	unsigned char		cpu;
+	unsigned char		pad;
+	unsigned long long	tsc;		/* rdtsc, cpu_khz cycles par milliseconde */
+	unsigned int		pid;
+	unsigned int		arg[3];
+} __attribute__ ((packed));
+
+/* type : arg[0], arg[1], arg[2] */
+enum{
+	TRACE_SCHED_SWITCH=0,	/* pid precedent, pid suivant, etat precedent */
+	TRACE_SYSCALL_ENTER=1,	/* numero, ebx, ecx */
+	TRACE_SYSCALL_EXIT=2,	/* numero, valeur de retour */
+	TRACE_PAGE_FAULT=3,		/* adresse, eip, code d'erreur */
+	TRACE_IRQ_ENTER=4,		/* ligne */
+	TRACE_IRQ_EXIT=5,		/* ligne */
+	TRACE_IDE_READ=6,		/* disque, position, taille */
+	TRACE_IDE_READ_DONE=7,	/* disque, position, taille */
+	NR_TRACE_EVENTS=8
+};
+
+#define TRACE_ALL		((1 << NR_TRACE_EVENTS) - 1)
+
+struct trace_info{
+	unsigned int		mask;		/* evenements actives (1 << type) */
+	unsigned int		size;		/* evenements dans l'anneau */
+	unsigned int		head;		/* evenements ecrits */
+	unsigned int		tail;		/* evenements lus */
+	unsigned int		lost;		/* ecrases avant lecture */
+	unsigned int		cpu_khz;
+};
+
+#define API_TRACE_SET_MASK		0x5300	/* buffer : unsigned int */
+#define API_TRACE_GET_INFO		0x5301	/* buffer : trace_info */
+#define API_TRACE_CLEAR			0x5302
+#define API_TRACE_DUMP			0x5303	/* vide l'anneau sur /dev/ttyS */
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _OS_FUTEX_H_
+#define _OS_FUTEX_H_
+
+/*
+ *	int futex(int* uaddr, int op, int val, unsigned int arg, int* uaddr2);
+ *
+ *	FUTEX_WAIT		dort si *uaddr == val, arg = timeout en ms (0 : aucun)
+ *	FUTEX_WAKE		reveille au plus val processus, dans l'ordre d'arrivee
+ *	FUTEX_REQUEUE	reveille val processus et deplace au plus arg des
+ *					suivants sur uaddr2
+ *
+ *	La cle est l'adresse physique du mot : un meme mot partage par
+ *	plusieurs espaces d'adressage est une seule file. Le chemin sans
+ *	contention d'un verrou reste en espace utilisateur (lock cmpxchg).
+ */
+
+enum{
+	FUTEX_WAIT=0,
+	FUTEX_WAKE=1,
+	FUTEX_REQUEUE=2,
+};
+
+#define FUTEX_EAGAIN		(-11)	/* *uaddr != val */
+#define FUTEX_ETIMEDOUT		(-110)
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _OS_IPC_H_
+#define _OS_IPC_H_
+
+/*
+ *	Messages synchrones (rendez-vous), sans tampon dans le noyau :
+ *
+ *	int ipc_send(int pid, mr0, mr1, struct ipc_buf* buf);
+ *		bloque jusqu'a ce que pid recoive le message
+ *	int ipc_receive(int from, struct ipc_buf* buf);
+ *		from = IPC_ANY ou un pid, les emetteurs sont servis dans l'ordre
+ *	int ipc_call(int pid, mr0, mr1, struct ipc_buf* buf);
+ *		send puis receive de pid en une operation (client)
+ *	int ipc_reply(int pid, mr0, mr1, struct ipc_buf* buf);
+ *		ne bloque pas, echoue si pid n'attend pas de reponse (serveur)
+ *
+ *	Registres : eax = numero, ebx = pid, edi et esi = mots du message
+ *	(MR0, MR1), ecx = struct ipc_buf* ou NULL. Au retour eax = statut,
+ *	ebx = pid de l'emetteur, edi et esi = mots recus (ebx, edi et esi
+ *	survivent a sysexit). La partie longue est copiee une seule fois,
+ *	directement d'un espace d'adressage a l'autre.
+ */
+
+#define IPC_ANY			0xFFFFFFFF
+#define IPC_MR			2			/* mots en registres */
+#define IPC_MAX_LEN		65536		/* partie longue */
+
+#define IPC_ESRCH		(-3)		/* processus absent ou termine */
+#define IPC_EAGAIN		(-11)		/* reply : pid n'attend pas */
+#define IPC_EFAULT		(-14)		/* tampon invalide */
+#define IPC_EMSGSIZE	(-90)		/* message tronque a recv_max */
+
+struct ipc_buf{
+	void*			send;
+	unsigned int	send_len;
+	void*			recv;
+	unsigned int	recv_max;
+	unsigned int	recv_len;		/* rempli au retour */
+};
+
+#endif
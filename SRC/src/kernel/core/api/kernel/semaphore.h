@@ -0,0 +1,33 @@
+#ifndef _OS_SEMAPHORE_H_
+#define _OS_SEMAPHORE_H_
+
+/*
+ *	int create_semaphore(const char* name, unsigned int value);
+ *		cree /sys/sem/<name> avec la valeur initiale value, ou ouvre le
+ *		semaphore s'il existe deja. Retourne un descripteur.
+ *	int delete_semaphore(const char* name);
+ *		retire le nom, les attentes en cours echouent avec SEM_EIDRM et le
+ *		semaphore est libere au dernier close().
+ *	int lock_semaphore(int fd, unsigned int ms);
+ *		ms = 0 : essai sans attente, SEM_FOREVER : attente sans limite.
+ *	int unlock_semaphore(int fd);
+ *		reveille un seul processus, le plus ancien en attente : le jeton
+ *		lui est donne directement, un nouvel arrivant ne peut pas le voler.
+ *
+ *	read() sur le descripteur retourne une struct sem_info.
+ */
+
+#define SEM_FOREVER			0xFFFFFFFF
+#define SEM_VALUE_MAX		0x7FFFFFFF
+
+#define SEM_EAGAIN			(-11)	/* essai : valeur nulle */
+#define SEM_EIDRM			(-43)	/* semaphore supprime */
+#define SEM_EOVERFLOW		(-75)	/* SEM_VALUE_MAX atteint */
+#define SEM_ETIMEDOUT		(-110)
+
+struct sem_info{
+	unsigned int	value;
+	unsigned int	waiters;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _OS_SPAWN_H_
+#define _OS_SPAWN_H_
+
+/*
+ *	int spawn(const char* path, char** argv, const struct spawn_attr* attr);
+ *
+ *	Cree un processus depuis un executable en un seul appel : les segments
+ *	sont lus directement dans le nouvel espace d'adressage. Le fils herite
+ *	des descripteurs 0, 1 et 2 puis les actions sont appliquees dans
+ *	l'ordre, avant qu'il ne soit executable. attr peut etre NULL.
+ *	Retourne le pid du fils ou une valeur negative.
+ */
+
+enum{
+	SPAWN_DUP2=0,		/* fd du fils = srcfd du pere */
+	SPAWN_CLOSE=1,		/* ferme fd dans le fils */
+	SPAWN_OPEN=2,		/* ouvre path (flags) en fd dans le fils */
+};
+
+#define SPAWN_MAX_ACTIONS	16
+
+struct spawn_action{
+	int				type;
+	int				fd;
+	int				srcfd;
+	char*			path;
+	unsigned int	flags;
+};
+
+struct spawn_attr{
+	unsigned int			nactions;
+	struct spawn_action*	actions;
+};
+
+#endif
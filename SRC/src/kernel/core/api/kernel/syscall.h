@@ -10,4 +10,16 @@ int syscall3( int number, unsigned int p1, unsigned int p2, unsigned int p3 );
 int syscall4( int number, unsigned int p1, unsigned int p2, unsigned int p3, unsigned int p4 );
 int syscall5( int number, unsigned int p1, unsigned int p2, unsigned int p3, unsigned int p4, unsigned int p5 );
 
+/*
+ *	Fast path (cpuid(1).edx bit 11) : same registers as int 0x80 for the
+ *	number and the arguments, ebp points on the return address pushed on
+ *	the user stack. ecx and edx are not preserved.
+ *
+ *		push %ebp
+ *		push $1f
+ *		mov %esp, %ebp
+ *		sysenter
+ *	1:	pop %ebp
+ */
+
 #endif
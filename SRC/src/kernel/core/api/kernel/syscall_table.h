@@ -22,7 +22,7 @@ enum {
 	SYS_getdents			=89,
 	SYS_fchdir				=NOT_DEFINED,
 	SYS_isatty				=NOT_DEFINED,
-	SYS_lseek				=19,
+	SYS_lseek				=19,	//	(fd,offset,whence)
 	SYS_unlink				=17,
 	SYS_link				=18,
 	SYS_readlink			=19,
@@ -53,10 +53,10 @@ enum {
 	SYS_kill				=37,
 	SYS_sigprocmask			=NOT_DEFINED,
 	SYS_dbprintf			=NOT_DEFINED,
-	SYS_create_semaphore	=NOT_DEFINED,
-	SYS_delete_semaphore	=NOT_DEFINED,
-	SYS_lock_semaphore		=NOT_DEFINED,
-	SYS_unlock_semaphore	=NOT_DEFINED,
+	SYS_create_semaphore	=93,	//	(name,value)
+	SYS_delete_semaphore	=94,	//	(name)
+	SYS_lock_semaphore		=95,	//	(fd,ms)
+	SYS_unlock_semaphore	=96,	//	(fd)
 	SYS_create_thread		=101,
 	SYS_wake_up_thread		=NOT_DEFINED,
 	SYS_kill_thread			=NOT_DEFINED,
@@ -65,6 +65,14 @@ enum {
 	SYS_loadmod				=71,
 	SYS_login				=72,
 	SYS_newuser				=73,
+	SYS_spawn				=90,	//	(filename,argv,attr)
+	SYS_futex				=92,	//	(uaddr,op,val,arg,uaddr2)
+	SYS_ipc_send			=97,	//	(pid,buf,-,mr0,mr1)
+	SYS_ipc_receive			=98,	//	(from,buf)
+	SYS_ipc_call			=99,	//	(pid,buf,-,mr0,mr1)
+	SYS_ipc_reply			=100,	//	(pid,buf,-,mr0,mr1)
+	SYS_sync				=36,	//	()
+	SYS_fsync				=118,	//	(fd)
 };
 
 
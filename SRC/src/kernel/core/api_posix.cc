@@ -1,4 +1,5 @@
 #include <os.h>
+#include <api/dev/ioctl.h>
 
 
 /*
@@ -15,6 +16,10 @@ void call_open(){
 	}
 	
 	File* fp=fsm.path(name);
+	if (fp==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
 	fp->open(flag);
 	u32 fd=p->addFile(fp,flag);
 	
@@ -41,6 +46,47 @@ void call_close(){
 	p->deleteFile(fd);
 }
 
+/*
+ *	Les peripheriques blocs sont lus et ecrits a travers le cache des blocs
+ *	(ecriture differee), par un buffer du noyau : le cache copie sous son
+ *	verrou, interruptions coupees.
+ */
+static int is_block_device(File* fp){
+	return fp->getType()==TYPE_DEVICE && fp->ioctl(DEV_GET_FORMAT,NULL)==DEV_FORMAT_BLOCK;
+}
+
+static u32 block_io(File* fp,u32 pos,u8* buf,u32 size,int write){
+	u32 ret;
+	u8* kbuf=(u8*)kmalloc(size);
+	if (kbuf==NULL)
+		return 0;
+	if (write){
+		memcpy((char*)kbuf,(char*)buf,size);
+		ret=bcache_write(fp,pos,kbuf,size);
+	}
+	else {
+		ret=bcache_read(fp,pos,kbuf,size);
+		memcpy((char*)buf,(char*)kbuf,ret);
+	}
+	kfree(kbuf);
+	return ret;
+}
+
+/*
+ *	Lecture en avance de la fenetre suivante d'une lecture sequentielle,
+ *	par le cache pour un peripherique bloc, par le systeme de fichiers
+ *	sinon (voir bcache.h).
+ */
+static void read_ahead(File* fp,openfile* info,u32 size,int block){
+	u32 start,len;
+	if (!file_ra_window(&info->ra,info->ptr,size,&start,&len))
+		return;
+	if (block)
+		bcache_readahead(fp,start,len);
+	else
+		fp->readahead(start,len);
+}
+
 /*
  *	u32 read(u32 fd,char* buf,u32 size);
  */
@@ -61,7 +107,13 @@ void call_read(){
 		return;
 	}
 	openfile* info = p->getFileInfo(fd);
-	u32 ret=fp->read(info->ptr,buf,size);
+	u32 ret;
+	int block=is_block_device(fp);
+	read_ahead(fp,info,size,block);
+	if (block)
+		ret=block_io(fp,info->ptr,buf,size,0);
+	else
+		ret=fp->read(info->ptr,buf,size);
 	info->ptr=info->ptr + ret;
 	arch.setRet(ret);
 }
@@ -86,7 +138,11 @@ void call_write(){
 		return;
 	}
 	openfile* info = p->getFileInfo(fd);
-	u32 ret=fp->write(info->ptr,buf,size);
+	u32 ret;
+	if (is_block_device(fp))
+		ret=block_io(fp,info->ptr,buf,size,1);
+	else
+		ret=fp->write(info->ptr,buf,size);
 	info->ptr=info->ptr + ret;
 	arch.setRet(ret);
 }
@@ -115,6 +171,84 @@ void call_ioctl(){
 	arch.setRet(ret);
 }
 
+/*
+ *	void sync();
+ */
+void call_sync(){
+	arch.setRet(bcache_sync(NULL,1));
+}
+
+/*
+ *	int fsync(u32 fd);
+ */
+void call_fsync(){
+	u32 fd=arch.getArg(0);
+	
+	Process* p=arch.pcurrent;
+	if (p==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+		
+	File* fp=p->getFile(fd);
+	if (fp==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+	
+	if (is_block_device(fp))
+		arch.setRet(bcache_sync(fp,1));
+	else
+		arch.setRet(RETURN_OK);
+}
+
+#define SEEK_SET	0
+#define SEEK_CUR	1
+#define SEEK_END	2
+
+/*
+ *	int lseek(u32 fd,int offset,int whence);
+ */
+void call_lseek(){
+	u32 fd=arch.getArg(0);
+	int offset=(int)arch.getArg(1);
+	u32 whence=arch.getArg(2);
+	u32 base;
+	
+	Process* p=arch.pcurrent;
+	if (p==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+		
+	File* fp=p->getFile(fd);
+	if (fp==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+	openfile* info = p->getFileInfo(fd);
+	switch (whence){
+		case SEEK_SET:
+			base=0;
+			break;
+		case SEEK_CUR:
+			base=info->ptr;
+			break;
+		case SEEK_END:
+			base=fp->getSize();
+			break;
+		default:
+			arch.setRet((u32)-1);
+			return;
+	}
+	if (offset<0 && (u32)(-offset)>base){
+		arch.setRet((u32)-1);
+		return;
+	}
+	info->ptr=base+offset;
+	arch.setRet(info->ptr);
+}
+
 /*
  *	char* sbrk(int size);
  */
@@ -142,7 +276,8 @@ void call_exit(){
 	
 	Process* p=arch.pcurrent;
 	p->exit();
-	return;
+	for (;;)
+		arch.yield();		//never scheduled again
 }
 
 /*
@@ -167,6 +302,251 @@ void call_execv(){
 }
 
 
+/*
+ *	int spawn(char* filename,char** argv,spawn_attr* attr);
+ */
+void call_spawn(){
+	char* filename=(char*)arch.getArg(0);
+	char** argv=(char**)arch.getArg(1);
+	spawn_attr* attr=(spawn_attr*)arch.getArg(2);
+	spawn_action act[SPAWN_MAX_ACTIONS];
+	u32 nact=0,i;
+	int argc=0;
+	
+	Process* p=arch.pcurrent;
+	if (p==NULL || filename==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+	if (argv!=NULL)
+		while (argv[argc])
+			argc++;
+	
+	//the actions are checked before anything is built
+	if (attr!=NULL && attr->nactions>0){
+		nact=attr->nactions;
+		if (nact>SPAWN_MAX_ACTIONS || attr->actions==NULL){
+			arch.setRet((u32)ERROR_PARAM);
+			return;
+		}
+		memcpy((char*)act,(char*)attr->actions,nact*sizeof(spawn_action));
+		for (i=0;i<nact;i++){
+			if (act[i].type<0 || act[i].fd<0 || act[i].fd>=CONFIG_MAX_FILE
+				|| (act[i].type==SPAWN_DUP2 && (act[i].srcfd<0 || act[i].srcfd>=CONFIG_MAX_FILE || p->getFile(act[i].srcfd)==NULL))
+				|| (act[i].type==SPAWN_OPEN && (act[i].path==NULL || fsm.path(act[i].path)==NULL))
+				|| act[i].type>SPAWN_OPEN){
+				arch.setRet((u32)ERROR_PARAM);
+				return;
+			}
+		}
+	}
+	
+	int ret=spawn(filename,argc,argv,act,nact);
+	arch.setRet((u32)ret);
+}
+
+/*
+ *	int futex(u32* uaddr,int op,u32 val,u32 arg,u32* uaddr2);
+ */
+void call_futex(){
+	u32* uaddr=(u32*)arch.getArg(0);
+	u32 op=arch.getArg(1);
+	u32 val=arch.getArg(2);
+	u32 arg=arch.getArg(3);
+	u32* uaddr2=(u32*)arch.getArg(4);
+	int ret;
+	
+	switch (op){
+		case FUTEX_WAIT:
+			ret=futex_wait(uaddr,val,arg);
+			break;
+		case FUTEX_WAKE:
+			ret=futex_wake(uaddr,val);
+			break;
+		case FUTEX_REQUEUE:
+			ret=futex_requeue(uaddr,val,arg,uaddr2);
+			break;
+		default:
+			ret=NOT_DEFINED;
+			break;
+	}
+	arch.setRet((u32)ret);
+}
+
+/*
+ * Message of the syscall registers (see api/kernel/ipc.h). The pages of
+ * the buffers are faulted in here: the copy between the two address
+ * spaces cannot take a #PF.
+ */
+static int ipc_get_msg(ipc_msg* m,ipc_buf* ub){
+	u32 v;
+	
+	m->mr[0]=arch.getArg(3);
+	m->mr[1]=arch.getArg(4);
+	m->sbuf=NULL;
+	m->slen=0;
+	m->rbuf=NULL;
+	m->rmax=0;
+	m->rlen=0;
+	m->sender=0;
+	if (ub==NULL)
+		return RETURN_OK;
+	if ((u32)ub<USER_OFFSET || (u32)ub+sizeof(ipc_buf)>USER_STACK)
+		return IPC_EFAULT;
+	m->sbuf=(char*)ub->send;
+	m->slen=(ub->send!=NULL) ? ub->send_len : 0;
+	m->rbuf=(char*)ub->recv;
+	m->rmax=(ub->recv!=NULL) ? ub->recv_max : 0;
+	if (m->slen>IPC_MAX_LEN || m->rmax>IPC_MAX_LEN
+		|| (m->slen>0 && ((u32)m->sbuf<USER_OFFSET || (u32)m->sbuf+m->slen>USER_STACK))
+		|| (m->rmax>0 && ((u32)m->rbuf<USER_OFFSET || (u32)m->rbuf+m->rmax>USER_STACK)))
+		return IPC_EFAULT;
+	for (v=(u32)m->sbuf & 0xFFFFF000;v<(u32)m->sbuf+m->slen;v+=PAGESIZE)
+		(void)*(volatile char*)v;
+	for (v=(u32)m->rbuf & 0xFFFFF000;v<(u32)m->rbuf+m->rmax;v+=PAGESIZE)
+		(void)*(volatile char*)v;
+	return RETURN_OK;
+}
+
+/* Received message in ebx (sender), edi and esi */
+static void ipc_put_msg(ipc_msg* m,ipc_buf* ub,int ret){
+	arch.setArg(0,m->sender);
+	arch.setArg(3,m->mr[0]);
+	arch.setArg(4,m->mr[1]);
+	if (ub!=NULL)
+		ub->recv_len=m->rlen;
+	arch.setRet((u32)ret);
+}
+
+/*
+ *	int ipc_send(u32 pid,ipc_buf* buf,-,u32 mr0,u32 mr1);
+ */
+void call_ipc_send(){
+	u32 pid=arch.getArg(0);
+	ipc_buf* ub=(ipc_buf*)arch.getArg(1);
+	ipc_msg m;
+	int ret=ipc_get_msg(&m,ub);
+	
+	if (ret==RETURN_OK)
+		ret=ipc_send(pid,&m,0);
+	arch.setRet((u32)ret);
+}
+
+/*
+ *	int ipc_receive(u32 from,ipc_buf* buf);
+ */
+void call_ipc_receive(){
+	u32 from=arch.getArg(0);
+	ipc_buf* ub=(ipc_buf*)arch.getArg(1);
+	ipc_msg m;
+	int ret=ipc_get_msg(&m,ub);
+	
+	if (ret==RETURN_OK)
+		ret=ipc_receive(from,&m);
+	ipc_put_msg(&m,ub,ret);
+}
+
+/*
+ *	int ipc_call(u32 pid,ipc_buf* buf,-,u32 mr0,u32 mr1);
+ */
+void call_ipc_call(){
+	u32 pid=arch.getArg(0);
+	ipc_buf* ub=(ipc_buf*)arch.getArg(1);
+	ipc_msg m;
+	int ret=ipc_get_msg(&m,ub);
+	
+	if (ret==RETURN_OK)
+		ret=ipc_send(pid,&m,1);
+	ipc_put_msg(&m,ub,ret);
+}
+
+/*
+ *	int ipc_reply(u32 pid,ipc_buf* buf,-,u32 mr0,u32 mr1);
+ */
+void call_ipc_reply(){
+	u32 pid=arch.getArg(0);
+	ipc_buf* ub=(ipc_buf*)arch.getArg(1);
+	ipc_msg m;
+	int ret=ipc_get_msg(&m,ub);
+	
+	if (ret==RETURN_OK)
+		ret=ipc_reply(pid,&m);
+	arch.setRet((u32)ret);
+}
+
+/*
+ *	int create_semaphore(char* name,u32 value);
+ */
+void call_create_semaphore(){
+	char* name=(char*)arch.getArg(0);
+	u32 value=arch.getArg(1);
+	Semaphore* s;
+	
+	Process* p=arch.pcurrent;
+	if (p==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+	s=Semaphore::create(name,value);
+	if (s==NULL){
+		arch.setRet((u32)ERROR_PARAM);
+		return;
+	}
+	u32 fd=p->addFile(s,0);
+	if (fd==(u32)-1)
+		s->close();		//reference of create()
+	arch.setRet(fd);
+}
+
+/*
+ *	int delete_semaphore(char* name);
+ */
+void call_delete_semaphore(){
+	char* name=(char*)arch.getArg(0);
+	arch.setRet((u32)Semaphore::unlink(name));
+}
+
+/*
+ *	int lock_semaphore(u32 fd,u32 ms);
+ */
+void call_lock_semaphore(){
+	u32 fd=arch.getArg(0);
+	u32 ms=arch.getArg(1);
+	Semaphore* s;
+	
+	Process* p=arch.pcurrent;
+	if (p==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+	s=Semaphore::get(p->getFile(fd));
+	if (s==NULL){
+		arch.setRet((u32)ERROR_PARAM);
+		return;
+	}
+	arch.setRet((u32)s->acquire(ms));
+}
+
+/*
+ *	int unlock_semaphore(u32 fd);
+ */
+void call_unlock_semaphore(){
+	u32 fd=arch.getArg(0);
+	Semaphore* s;
+	
+	Process* p=arch.pcurrent;
+	if (p==NULL){
+		arch.setRet((u32)-1);
+		return;
+	}
+	s=Semaphore::get(p->getFile(fd));
+	if (s==NULL){
+		arch.setRet((u32)ERROR_PARAM);
+		return;
+	}
+	arch.setRet((u32)s->release());
+}
+
 /*
  *	int symlink(const char* oldpath, const char* newpath);
  */
@@ -226,14 +606,31 @@ void call_getdents(){
 }
 
 /*
- *	int wait(int* status);
+ *	int wait4(int pid,int* status,int options,struct rusage* ru);
  */
 void call_wait(){
+	int pid=(int)arch.getArg(0);
 	u32*status=(u32*)arch.getArg(1);
-	*status=0;
+	if (status!=NULL)
+		*status=0;
 	Process* p=arch.pcurrent;
-	u32 ret=p->wait();
-	//arch.setRet(ret);
+	u32 ret=p->wait(pid);
+	arch.setRet(ret);
+}
+
+/*
+ *	int kill(int pid,int sig);
+ */
+void call_kill(){
+	u32 pid=arch.getArg(0);
+	int sig=(int)arch.getArg(1);
+	Process* p=arch.findProcess(pid);
+	if (p==NULL || sig<=0 || sig>=32){
+		arch.setRet((u32)-1);
+		return;
+	}
+	p->sendSignal(sig);
+	arch.setRet(0);
 }
 
 /*
@@ -277,6 +674,14 @@ void call_chdir(){
 	return;
 }
 
+/*
+ *	int getpid();
+ */
+void call_getpid(){
+	Process* p=arch.pcurrent;
+	arch.setRet(p->getPid());
+}
+
 /*
  *	void * mmap (void *addr,size_t len,int prot,int flags,int fd,off_t offset)
  */
@@ -298,7 +703,6 @@ void call_mmap(){
 		arch.setRet((u32)-1);
 		return;
 	}
-	openfile* info = p->getFileInfo(fd);
 	u32 ret=fp->mmap(size,flags,offset,prot);
 	arch.setRet(ret);
 }
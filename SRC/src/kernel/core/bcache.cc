@@ -0,0 +1,684 @@
+#include <os.h>
+#include <api/dev/ioctl.h>
+
+/* Cache des blocs disque (voir bcache.h) */
+
+static LIST_HEAD(bcache_lru);
+static buffer_head*		bcache_hash[BCACHE_HASH_SIZE];
+static spinlock_t		bcache_lock=SPINLOCK_INIT;	/* jamais garde pendant une E/S */
+static u32				bcache_capacity=BCACHE_DEFAULT;
+static u32				bcache_blocks=0;
+static u32				bcache_hits=0;
+static u32				bcache_misses=0;
+static u32				bcache_evictions=0;
+static u32				bcache_dirty=0;
+static u32				bcache_writebacks=0;
+static LIST_HEAD(bcache_dirty_list);
+
+/* Ecriture periodique : le timer ne peut pas dormir, il passe la main a kworker */
+static ktimer			bcache_wb_timer;
+static work				bcache_wb_work;
+static u32				bcache_wb_armed=0;
+
+/* Lecture en avance : zones demandees, lues par kworker */
+struct bcache_ra_zone {
+	File*	dev;
+	u32		block;
+	u32		count;
+};
+
+static bcache_ra_zone	bcache_ra_queue[BCACHE_RA_QUEUE];
+static u32				bcache_ra_head=0;
+static u32				bcache_ra_len=0;
+static work				bcache_ra_work;
+static WaitQueue*		bcache_ra_wait=NULL;	/* lecteurs d'un bloc en cours de lecture en avance */
+static File*			bcache_ra_dev=NULL;		/* blocs en cours de lecture par kworker */
+static u32				bcache_ra_block=0;
+static u32				bcache_ra_count=0;
+static u32				bcache_ra_blocks=0;
+static u32				bcache_ra_waits=0;
+
+static buffer_head** bcache_bucket(File* dev,u32 block){
+	return &bcache_hash[(((u32)dev>>4) ^ block ^ (block>>8)) & (BCACHE_HASH_SIZE-1)];
+}
+
+/* bcache_lock held */
+static buffer_head* bcache_lookup(File* dev,u32 block){
+	buffer_head* bh=*bcache_bucket(dev,block);
+	while (bh!=NULL && (bh->dev!=dev || bh->block!=block))
+		bh=bh->hnext;
+	return bh;
+}
+
+/* Remove bh from the hash and the LRU (lock held) */
+static void bcache_unlink(buffer_head* bh){
+	buffer_head** pp=bcache_bucket(bh->dev,bh->block);
+	while (*pp!=bh)
+		pp=&(*pp)->hnext;
+	*pp=bh->hnext;
+	list_del(&bh->lru);
+	bcache_blocks--;
+}
+
+/*
+ * Evict the least recently used clean blocks above capacity (lock held),
+ * they are chained by hnext to be freed out of the lock
+ */
+static buffer_head* bcache_shrink(u32 capacity){
+	buffer_head *bh, *freed=NULL;
+	list_head *l=bcache_lru.prev, *prev;
+	while (bcache_blocks>capacity && l!=&bcache_lru){
+		prev=l->prev;
+		bh=list_entry(l,buffer_head,lru);
+		l=prev;
+		if (bh->state & (BH_DIRTY | BH_WRITEBACK))
+			continue;
+		bcache_unlink(bh);
+		bh->hnext=freed;
+		freed=bh;
+		bcache_evictions++;
+	}
+	return freed;
+}
+
+static void bcache_set_dirty(buffer_head* bh){
+	if (bh->state & BH_DIRTY)
+		return;
+	bh->state|=BH_DIRTY;
+	list_add(&bh->dirty,&bcache_dirty_list);
+	bcache_dirty++;
+}
+
+static void bcache_clear_dirty(buffer_head* bh){
+	if (!(bh->state & BH_DIRTY))
+		return;
+	bh->state&=~BH_DIRTY;
+	list_del(&bh->dirty);
+	bcache_dirty--;
+}
+
+static buffer_head* bcache_alloc(File* dev,u32 block){
+	buffer_head* bh=(buffer_head*)kmalloc(sizeof(buffer_head));
+	bh->data=(u8*)kmalloc(BCACHE_BLOCK_SIZE);
+	bh->dev=dev;
+	bh->block=block;
+	bh->state=0;
+	bh->hnext=NULL;
+	return bh;
+}
+
+/* Add bh to the hash and the LRU (lock held, bh not cached) */
+static void bcache_link(buffer_head* bh){
+	buffer_head** b=bcache_bucket(bh->dev,bh->block);
+	bh->hnext=*b;
+	*b=bh;
+	list_add(&bh->lru,&bcache_lru);
+	bcache_blocks++;
+}
+
+static void bcache_free(buffer_head* bh){
+	buffer_head* n;
+	while (bh!=NULL){
+		n=bh->hnext;
+		kfree(bh->data);
+		kfree(bh);
+		bh=n;
+	}
+}
+
+/* Insert the n blocks read in data, a block inserted meanwhile is kept */
+static void bcache_insert(File* dev,u32 block,u32 n,u8* data){
+	buffer_head* bh[BCACHE_MAX_RUN];
+	buffer_head *dup, *freed;
+	u32 i,flags;
+	
+	for (i=0;i<n;i++){
+		bh[i]=bcache_alloc(dev,block+i);
+		memcpy((char*)bh[i]->data,(char*)data+i*BCACHE_BLOCK_SIZE,BCACHE_BLOCK_SIZE);
+	}
+	
+	dup=NULL;
+	flags=spin_lock_irqsave(&bcache_lock);
+	for (i=0;i<n;i++){
+		if (bcache_lookup(dev,block+i)!=NULL){
+			bh[i]->hnext=dup;
+			dup=bh[i];
+			continue;
+		}
+		bcache_link(bh[i]);
+	}
+	freed=bcache_shrink(bcache_capacity);
+	spin_unlock_irqrestore(&bcache_lock,flags);
+	bcache_free(dup);
+	bcache_free(freed);
+}
+
+/* Is block of dev being read ahead by kworker (lock held) */
+static int bcache_ra_busy(File* dev,u32 block){
+	return dev==bcache_ra_dev && block>=bcache_ra_block && block<bcache_ra_block+bcache_ra_count;
+}
+
+/*
+ * Read size bytes at pos of dev through the cache, return the number of
+ * bytes read. A block being read ahead is waited for, not read again.
+ */
+u32 bcache_read(File* dev,u32 pos,u8* buffer,u32 size){
+	buffer_head* bh;
+	u32 done=0,block,last,off,n,run,flags;
+	u8* tmp;
+	
+	if (dev==NULL || buffer==NULL || size==0)
+		return 0;
+	last=(pos+size-1)/BCACHE_BLOCK_SIZE;
+	
+	while (done<size){
+		block=(pos+done)/BCACHE_BLOCK_SIZE;
+		off=(pos+done)%BCACHE_BLOCK_SIZE;
+		
+		flags=spin_lock_irqsave(&bcache_lock);
+		bh=bcache_lookup(dev,block);
+		if (bh!=NULL){
+			list_del(&bh->lru);
+			list_add(&bh->lru,&bcache_lru);
+			n=BCACHE_BLOCK_SIZE-off;
+			if (n>size-done)
+				n=size-done;
+			memcpy((char*)buffer+done,(char*)bh->data+off,n);
+			bcache_hits++;
+			spin_unlock_irqrestore(&bcache_lock,flags);
+			done+=n;
+			continue;
+		}
+		
+		if (bcache_ra_busy(dev,block)){
+			bcache_ra_waits++;
+			spin_unlock_irqrestore(&bcache_lock,flags);
+			wait_event(*bcache_ra_wait,!bcache_ra_busy(dev,block));
+			continue;
+		}
+		
+		//the consecutive missing blocks of the request are read together
+		for (run=1;run<BCACHE_MAX_RUN && block+run<=last;run++)
+			if (bcache_lookup(dev,block+run)!=NULL || bcache_ra_busy(dev,block+run))
+				break;
+		bcache_misses+=run;
+		spin_unlock_irqrestore(&bcache_lock,flags);
+		
+		tmp=(u8*)kmalloc(run*BCACHE_BLOCK_SIZE);
+		if (tmp==NULL)
+			break;
+		if (dev->read(block*BCACHE_BLOCK_SIZE,tmp,run*BCACHE_BLOCK_SIZE)!=run*BCACHE_BLOCK_SIZE){
+			kfree(tmp);
+			break;
+		}
+		bcache_insert(dev,block,run,tmp);
+		n=run*BCACHE_BLOCK_SIZE-off;
+		if (n>size-done)
+			n=size-done;
+		memcpy((char*)buffer+done,(char*)tmp+off,n);
+		kfree(tmp);
+		done+=n;
+	}
+	return done;
+}
+
+/*
+ * kworker : read the queued zones, only their blocks not cached, by
+ * requests of BCACHE_RA_RUN blocks at most
+ */
+static void bcache_ra_work_fn(void* data){
+	bcache_ra_zone* z;
+	File* dev;
+	u32 block,run,i,n,flags,ok;
+	u8* tmp=(u8*)kmalloc(BCACHE_RA_RUN*BCACHE_BLOCK_SIZE);
+	
+	if (tmp==NULL)
+		return;
+	for (;;){
+		flags=spin_lock_irqsave(&bcache_lock);
+		if (bcache_ra_len==0){
+			spin_unlock_irqrestore(&bcache_lock,flags);
+			break;
+		}
+		z=&bcache_ra_queue[bcache_ra_head];
+		while (z->count>0 && bcache_lookup(z->dev,z->block)!=NULL){
+			z->block++;
+			z->count--;
+		}
+		if (z->count==0){
+			bcache_ra_head=(bcache_ra_head+1)%BCACHE_RA_QUEUE;
+			bcache_ra_len--;
+			spin_unlock_irqrestore(&bcache_lock,flags);
+			continue;
+		}
+		dev=z->dev;
+		block=z->block;
+		for (run=1;run<BCACHE_RA_RUN && run<z->count;run++)
+			if (bcache_lookup(dev,block+run)!=NULL)
+				break;
+		z->block+=run;
+		z->count-=run;
+		bcache_ra_dev=dev;
+		bcache_ra_block=block;
+		bcache_ra_count=run;
+		spin_unlock_irqrestore(&bcache_lock,flags);
+		
+		ok=(dev->read(block*BCACHE_BLOCK_SIZE,tmp,run*BCACHE_BLOCK_SIZE)==run*BCACHE_BLOCK_SIZE);
+		if (ok)
+			for (i=0;i<run;i+=n){
+				n=run-i;
+				if (n>BCACHE_MAX_RUN)
+					n=BCACHE_MAX_RUN;
+				bcache_insert(dev,block+i,n,tmp+i*BCACHE_BLOCK_SIZE);
+			}
+		
+		flags=spin_lock_irqsave(&bcache_lock);
+		bcache_ra_dev=NULL;
+		bcache_ra_count=0;
+		if (ok)
+			bcache_ra_blocks+=run;
+		spin_unlock_irqrestore(&bcache_lock,flags);
+		bcache_ra_wait->wakeUp();
+	}
+	kfree(tmp);
+}
+
+static void bcache_ra_init(){
+	WaitQueue* wq;
+	u32 flags;
+	if (bcache_ra_wait!=NULL)
+		return;
+	wq=new WaitQueue();
+	flags=spin_lock_irqsave(&bcache_lock);
+	if (bcache_ra_wait==NULL){
+		init_work(&bcache_ra_work,bcache_ra_work_fn,NULL);
+		bcache_ra_wait=wq;
+		wq=NULL;
+	}
+	spin_unlock_irqrestore(&bcache_lock,flags);
+	if (wq!=NULL)
+		delete wq;
+}
+
+/*
+ * Queue size bytes at pos of dev to be read ahead by kworker, a zone
+ * following the last one queued extends it. Only a hint : return 0 when
+ * the queue is full.
+ */
+int bcache_readahead(File* dev,u32 pos,u32 size){
+	bcache_ra_zone* z;
+	u32 block,count,flags;
+	int ret=1;
+	
+	if (dev==NULL || size==0)
+		return 0;
+	bcache_ra_init();
+	block=pos/BCACHE_BLOCK_SIZE;
+	count=(pos+size-1)/BCACHE_BLOCK_SIZE-block+1;
+	
+	flags=spin_lock_irqsave(&bcache_lock);
+	z=NULL;
+	if (bcache_ra_len>0)
+		z=&bcache_ra_queue[(bcache_ra_head+bcache_ra_len-1)%BCACHE_RA_QUEUE];
+	if (z!=NULL && z->dev==dev && z->block+z->count==block)
+		z->count+=count;
+	else if (bcache_ra_len<BCACHE_RA_QUEUE){
+		z=&bcache_ra_queue[(bcache_ra_head+bcache_ra_len)%BCACHE_RA_QUEUE];
+		z->dev=dev;
+		z->block=block;
+		z->count=count;
+		bcache_ra_len++;
+	}
+	else
+		ret=0;
+	spin_unlock_irqrestore(&bcache_lock,flags);
+	
+	if (ret)
+		queue_work(&bcache_ra_work);
+	return ret;
+}
+
+/* Largest window : BCACHE_RA_MAX, a quarter of the cache at most */
+u32 bcache_ra_max(){
+	u32 max=bcache_capacity*BCACHE_BLOCK_SIZE/BCACHE_RA_DIV;
+	if (max>BCACHE_RA_MAX)
+		max=BCACHE_RA_MAX;
+	if (max<BCACHE_BLOCK_SIZE)
+		max=BCACHE_BLOCK_SIZE;
+	return max;
+}
+
+/*
+ * Called before a read of size bytes at pos of an open file : return 1
+ * with the window to read ahead in start and len, 0 if there is none. A
+ * read which does not follow the previous one stops the readahead, the
+ * next sequential read starts it again with a window of twice its size.
+ */
+int file_ra_window(file_ra* ra,u32 pos,u32 size,u32* start,u32* len){
+	u32 end=pos+size,max,next;
+	int seq=(pos==ra->next);
+	
+	ra->next=end;
+	if (!seq || size==0){
+		ra->size=0;
+		return 0;
+	}
+	max=bcache_ra_max();
+	if (ra->size==0){
+		//start of a sequential stream
+		ra->size=(size>max/2) ? max : 2*size;
+		if (ra->size<BCACHE_RA_MIN)
+			ra->size=BCACHE_RA_MIN;
+		if (ra->size>max)
+			ra->size=max;
+		ra->start=end;
+	}
+	else if (end>ra->start){
+		//the reader has reached the last window, read the next one
+		next=ra->start+ra->size;
+		if (next<end)
+			next=end;
+		ra->size=2*ra->size;
+		if (ra->size>max)
+			ra->size=max;
+		ra->start=next;
+	}
+	else
+		return 0;
+	*start=ra->start;
+	*len=ra->size;
+	return 1;
+}
+
+static void bcache_wb_timer_fn(u32 data){
+	queue_work(&bcache_wb_work);
+}
+
+/* kworker : write the dirty blocks, run again while some remain */
+static void bcache_wb_work_fn(void* data){
+	u32 flags,again;
+	bcache_sync(NULL,0);
+	flags=spin_lock_irqsave(&bcache_lock);
+	again=(bcache_dirty!=0);
+	if (!again)
+		bcache_wb_armed=0;
+	spin_unlock_irqrestore(&bcache_lock,flags);
+	if (again)
+		add_timer(&bcache_wb_timer,arch.getTicks()+ms_to_ticks(BCACHE_WRITEBACK_MS));
+}
+
+/* Start the periodic writeback if it is not running */
+static void bcache_wb_arm(){
+	static u32 init=0;
+	u32 flags,arm;
+	flags=spin_lock_irqsave(&bcache_lock);
+	if (!init){
+		timer_init(&bcache_wb_timer,bcache_wb_timer_fn,0);
+		init_work(&bcache_wb_work,bcache_wb_work_fn,NULL);
+		init=1;
+	}
+	arm=!bcache_wb_armed;
+	bcache_wb_armed=1;
+	spin_unlock_irqrestore(&bcache_lock,flags);
+	if (arm)
+		add_timer(&bcache_wb_timer,arch.getTicks()+ms_to_ticks(BCACHE_WRITEBACK_MS));
+}
+
+/*
+ * Write size bytes at pos of dev in the cache, the blocks are written back
+ * later. A block partially written is read first if it is not cached.
+ */
+u32 bcache_write(File* dev,u32 pos,u8* buffer,u32 size){
+	buffer_head *bh, *nbh, *freed;
+	u32 done=0,block,off,n,flags,dirty=0;
+	
+	if (dev==NULL || buffer==NULL || size==0)
+		return 0;
+	
+	while (done<size){
+		block=(pos+done)/BCACHE_BLOCK_SIZE;
+		off=(pos+done)%BCACHE_BLOCK_SIZE;
+		n=BCACHE_BLOCK_SIZE-off;
+		if (n>size-done)
+			n=size-done;
+		
+		nbh=NULL;
+		flags=spin_lock_irqsave(&bcache_lock);
+		bh=bcache_lookup(dev,block);
+		spin_unlock_irqrestore(&bcache_lock,flags);
+		if (bh==NULL){
+			nbh=bcache_alloc(dev,block);
+			if (n<BCACHE_BLOCK_SIZE
+				&& dev->read(block*BCACHE_BLOCK_SIZE,nbh->data,BCACHE_BLOCK_SIZE)!=BCACHE_BLOCK_SIZE){
+				bcache_free(nbh);
+				break;
+			}
+		}
+		
+		flags=spin_lock_irqsave(&bcache_lock);
+		bh=bcache_lookup(dev,block);
+		if (bh==NULL){
+			if (nbh==NULL){
+				//evicted meanwhile
+				spin_unlock_irqrestore(&bcache_lock,flags);
+				continue;
+			}
+			bh=nbh;
+			nbh=NULL;
+			bcache_link(bh);
+			bcache_misses++;
+		}
+		else {
+			list_del(&bh->lru);
+			list_add(&bh->lru,&bcache_lru);
+			bcache_hits++;
+		}
+		memcpy((char*)bh->data+off,(char*)buffer+done,n);
+		bcache_set_dirty(bh);
+		dirty=bcache_dirty;
+		freed=bcache_shrink(bcache_capacity);
+		spin_unlock_irqrestore(&bcache_lock,flags);
+		bcache_free(nbh);
+		bcache_free(freed);
+		done+=n;
+	}
+	
+	if (done>0)
+		bcache_wb_arm();
+	if (dirty>bcache_capacity/BCACHE_DIRTY_DIV)
+		bcache_sync(dev,0);
+	return done;
+}
+
+/*
+ * Write the dirty blocks of dev (every device if NULL), the consecutive
+ * blocks together, lowest block first. A block being written stays in
+ * the cache (BH_WRITEBACK) : a reader can not get the old data back from
+ * the disk. A block is clean during its write (a new write dirties it
+ * again), a failed write dirties the run again and its device is skipped
+ * until the next sync. flush : empty the write caches of the disks
+ * afterwards.
+ */
+int bcache_sync(File* dev,u32 flush){
+	File* devs[BCACHE_SYNC_DEVS];
+	File* bad[BCACHE_SYNC_DEVS];
+	buffer_head* bhs[BCACHE_MAX_RUN];
+	buffer_head *bh, *first;
+	list_head* l;
+	File* d;
+	u32 block,n,i,flags,ndevs=0,nbad=0,failed;
+	int ret=RETURN_OK;
+	u8* run=(u8*)kmalloc(BCACHE_MAX_RUN*BCACHE_BLOCK_SIZE);
+	
+	if (run==NULL)
+		return ERROR_MEMORY;
+	
+	for (;;){
+		flags=spin_lock_irqsave(&bcache_lock);
+		first=NULL;
+		list_for_each(l,&bcache_dirty_list){
+			bh=list_entry(l,buffer_head,dirty);
+			if (dev!=NULL && bh->dev!=dev)
+				continue;
+			for (i=0;i<nbad && bad[i]!=bh->dev;i++);
+			if (i<nbad)
+				continue;
+			if (first==NULL || (bh->dev==first->dev && bh->block<first->block))
+				first=bh;
+		}
+		if (first==NULL){
+			spin_unlock_irqrestore(&bcache_lock,flags);
+			break;
+		}
+		d=first->dev;
+		block=first->block;
+		for (n=0;n<BCACHE_MAX_RUN;n++){
+			bh=bcache_lookup(d,block+n);
+			if (bh==NULL || !(bh->state & BH_DIRTY))
+				break;
+			memcpy((char*)run+n*BCACHE_BLOCK_SIZE,(char*)bh->data,BCACHE_BLOCK_SIZE);
+			bcache_clear_dirty(bh);
+			bh->state|=BH_WRITEBACK;
+			bhs[n]=bh;
+		}
+		spin_unlock_irqrestore(&bcache_lock,flags);
+		
+		failed=(d->write(block*BCACHE_BLOCK_SIZE,run,n*BCACHE_BLOCK_SIZE)!=n*BCACHE_BLOCK_SIZE);
+		
+		flags=spin_lock_irqsave(&bcache_lock);
+		for (i=0;i<n;i++){
+			bhs[i]->state&=~BH_WRITEBACK;
+			if (failed)
+				bcache_set_dirty(bhs[i]);
+		}
+		if (!failed)
+			bcache_writebacks+=n;
+		spin_unlock_irqrestore(&bcache_lock,flags);
+		
+		if (failed){
+			ret=NOT_DEFINED;
+			if (nbad==BCACHE_SYNC_DEVS)
+				break;
+			bad[nbad++]=d;
+			continue;
+		}
+		
+		for (i=0;i<ndevs && devs[i]!=d;i++);
+		if (i==ndevs && ndevs<BCACHE_SYNC_DEVS)
+			devs[ndevs++]=d;
+	}
+	kfree(run);
+	
+	if (flush){
+		if (dev!=NULL)
+			dev->ioctl(DEV_FLUSH_CACHE,NULL);
+		else
+			for (i=0;i<ndevs;i++)
+				devs[i]->ioctl(DEV_FLUSH_CACHE,NULL);
+	}
+	return ret;
+}
+
+void bcache_set_capacity(u32 blocks){
+	buffer_head* freed;
+	u32 flags=spin_lock_irqsave(&bcache_lock);
+	bcache_capacity=blocks;
+	freed=bcache_shrink(blocks);
+	spin_unlock_irqrestore(&bcache_lock,flags);
+	bcache_free(freed);
+}
+
+void bcache_flush(){
+	buffer_head* freed;
+	u32 flags;
+	bcache_sync(NULL,0);
+	flags=spin_lock_irqsave(&bcache_lock);
+	freed=bcache_shrink(0);
+	bcache_hits=0;
+	bcache_misses=0;
+	bcache_evictions=0;
+	bcache_ra_blocks=0;
+	bcache_ra_waits=0;
+	spin_unlock_irqrestore(&bcache_lock,flags);
+	bcache_free(freed);
+}
+
+void bcache_get_info(bcache_info* info){
+	u32 flags=spin_lock_irqsave(&bcache_lock);
+	info->block_size=BCACHE_BLOCK_SIZE;
+	info->capacity=bcache_capacity;
+	info->blocks=bcache_blocks;
+	info->hits=bcache_hits;
+	info->misses=bcache_misses;
+	info->evictions=bcache_evictions;
+	info->dirty=bcache_dirty;
+	info->writebacks=bcache_writebacks;
+	info->readahead=bcache_ra_blocks;
+	info->ra_waits=bcache_ra_waits;
+	spin_unlock_irqrestore(&bcache_lock,flags);
+}
+
+
+BCache::~BCache(){
+	
+}
+
+BCache::BCache(char* n) : File(n,TYPE_FILE)
+{
+	fsm.addFile("/sys/",this);
+}
+
+u32	BCache::open(u32 flag){
+	return RETURN_OK;
+}
+
+u32	BCache::close(){
+	return RETURN_OK;
+}
+
+/* struct bcache_info */
+u32	BCache::read(u32 pos,u8* buffer,u32 size){
+	if (buffer==NULL || size<sizeof(bcache_info))
+		return ERROR_PARAM;
+	bcache_get_info((bcache_info*)buffer);
+	return sizeof(bcache_info);
+}
+
+u32	BCache::write(u32 pos,u8* buffer,u32 size){
+	return NOT_DEFINED;
+}
+
+u32	BCache::ioctl(u32 id,u8* buffer){
+	switch (id){
+		case API_BCACHE_GET_INFO:
+			if (buffer==NULL)
+				return ERROR_PARAM;
+			bcache_get_info((bcache_info*)buffer);
+			return RETURN_OK;
+			
+		case API_BCACHE_SET_CAPACITY:
+			if (buffer==NULL)
+				return ERROR_PARAM;
+			bcache_set_capacity(*((u32*)buffer));
+			return RETURN_OK;
+			
+		case API_BCACHE_FLUSH:
+			bcache_flush();
+			return RETURN_OK;
+			
+		case API_BCACHE_SYNC:
+			return bcache_sync(NULL,1);
+			
+		default:
+			return NOT_DEFINED;
+	}
+}
+
+u32	BCache::remove(){
+	delete this;
+	return RETURN_OK;
+}
+
+void BCache::scan(){
+
+}
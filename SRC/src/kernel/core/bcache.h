@@ -0,0 +1,88 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <runtime/types.h>
+#include <runtime/list.h>
+#include <core/file.h>
+#include <api/dev/bcache.h>
+
+/*
+ *	Cache des blocs disque entre les systemes de fichiers et les
+ *	pilotes : blocs de BCACHE_BLOCK_SIZE octets indexes par (peripherique,
+ *	numero de bloc) dans une table de hachage, evinces dans l'ordre LRU.
+ *	Le verrou n'est jamais garde pendant une lecture du disque : les blocs
+ *	manquants consecutifs sont lus en une seule requete puis inseres.
+ *
+ *	Ecriture differee : bcache_write() ne modifie que le cache et marque
+ *	les blocs sales. Ils sont ecrits par bcache_sync(), appele toutes les
+ *	BCACHE_WRITEBACK_MS par le thread kworker, par sync/fsync, ou par
+ *	l'ecrivain lui-meme quand trop de blocs sont sales. Les blocs
+ *	sales consecutifs sont ecrits en une seule requete ; un bloc sale
+ *	n'est jamais evince.
+ *
+ *	Lecture en avance : call_read() suit pour chaque fichier ouvert la
+ *	position de la lecture suivante (file_ra). Une lecture sequentielle
+ *	ouvre une fenetre apres elle ; quand le lecteur entre dans la fenetre,
+ *	la suivante, deux fois plus grande (BCACHE_RA_MAX au plus, un quart du
+ *	cache), est demandee. bcache_readahead() ne fait que noter la zone :
+ *	kworker la lit par requetes de BCACHE_RA_RUN blocs pendant que le
+ *	lecteur consomme la precedente. Un lecteur qui arrive sur un bloc en
+ *	cours de lecture en avance attend sa fin au lieu de le relire.
+ */
+
+#define BCACHE_BLOCK_SIZE	1024
+#define BCACHE_HASH_SIZE	256		/* puissance de 2 */
+#define BCACHE_DEFAULT		512		/* blocs, 512 Ko */
+#define BCACHE_MAX_RUN		16		/* blocs lus ou ecrits par requete au plus */
+#define BCACHE_WRITEBACK_MS	5000
+#define BCACHE_DIRTY_DIV	2		/* l'ecrivain vide au-dela de capacite / 2 blocs sales */
+#define BCACHE_SYNC_DEVS	8		/* disques vides par un meme sync() */
+#define BCACHE_RA_MIN		16384	/* premiere fenetre, octets */
+#define BCACHE_RA_MAX		131072	/* fenetre la plus grande, octets */
+#define BCACHE_RA_DIV		4		/* fenetre au plus capacite / 4 */
+#define BCACHE_RA_RUN		64		/* blocs par requete de lecture en avance */
+#define BCACHE_RA_QUEUE		16		/* zones en attente de kworker */
+
+struct buffer_head {
+	list_head		lru;		/* le plus recent en tete */
+	list_head		dirty;		/* blocs sales, le plus ancien en queue */
+	buffer_head*	hnext;		/* chaine de hachage */
+	File*			dev;
+	u32				block;
+	u8*				data;
+	u32				state;
+};
+
+#define BH_DIRTY		0x1
+#define BH_WRITEBACK	0x2		/* en cours d'ecriture, pas evincable */
+
+
+u32		bcache_read(File* dev,u32 pos,u8* buffer,u32 size);
+u32		bcache_write(File* dev,u32 pos,u8* buffer,u32 size);
+int		bcache_sync(File* dev,u32 flush);	/* dev NULL : every device, flush : empty the disk caches */
+void	bcache_set_capacity(u32 blocks);
+void	bcache_flush();
+void	bcache_get_info(bcache_info* info);
+
+int		bcache_readahead(File* dev,u32 pos,u32 size);	/* asynchronous, 0 if the queue is full */
+u32		bcache_ra_max();								/* largest window in bytes */
+int		file_ra_window(file_ra* ra,u32 pos,u32 size,u32* start,u32* len);
+
+
+/* /sys/bcache : statistiques et reglage */
+class BCache : public File
+{
+	public:
+		BCache(char* n);
+		~BCache();
+		
+		u32		open(u32 flag);
+		u32		close();
+		u32		read(u32 pos,u8* buffer,u32 size);
+		u32		write(u32 pos,u8* buffer,u32 size);
+		u32		ioctl(u32 id,u8* buffer);
+		u32		remove();
+		void	scan();
+};
+
+#endif
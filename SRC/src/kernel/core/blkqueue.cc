@@ -0,0 +1,252 @@
+#include <os.h>
+
+/* Files de requetes des disques (voir blkqueue.h) */
+
+int blk_can_sleep(){
+	u32 flags;
+	__asm__ __volatile__("pushfl; popl %0" : "=r"(flags));
+	return (flags & EFLAGS_IF) && arch.pcurrent!=NULL;
+}
+
+/* Buffer of the sector off of the chain r, left = sectors up to the end of its segment */
+char* blk_segment(blk_request* r,u32 off,u32* left){
+	while (r!=NULL && off>=r->count){
+		off-=r->count;
+		r=r->merged;
+	}
+	if (r==NULL){
+		*left=0;
+		return NULL;
+	}
+	*left=r->count-off;
+	return r->buf+off*512;
+}
+
+BlkQueue::BlkQueue(blk_start_fn s,blk_poll_fn p,void* d,u32 max,u32 dp){
+	spin_lock_init(&lock);
+	INIT_LIST_HEAD(&requests);
+	INIT_LIST_HEAD(&dispatched);
+	nr_active=0;
+	depth=(dp>0) ? dp : 1;
+	nr_pending=0;
+	start=s;
+	poll=p;
+	commit=NULL;
+	plugged=0;
+	data=d;
+	max_sectors=max;
+	head_pos=0;
+	memset((char*)&stats,0,sizeof(blk_stats));
+}
+
+/* C-LOOK order : the sectors after the head first, then the ones before it */
+static int blk_before(u32 a,u32 b,u32 pos){
+	if ((a>=pos)!=(b>=pos))
+		return a>=pos;
+	return a<b;
+}
+
+/* Chain r to a waiting request it extends (lock held), 1 if merged */
+u32 BlkQueue::merge(blk_request* r){
+	list_head* l;
+	blk_request *p, *last;
+
+	if (r->dir==BLK_FLUSH)
+		return 0;
+	list_for_each(l,&requests){
+		p=list_entry(l,blk_request,list);
+		if (p->drive!=r->drive || p->dir!=r->dir || p->total+r->count>max_sectors)
+			continue;
+		if (p->sector+p->total==r->sector){
+			for (last=p;last->merged!=NULL;last=last->merged);
+			last->merged=r;
+			p->total+=r->count;
+			return 1;
+		}
+		if (r->sector+r->count==p->sector){
+			r->merged=p;
+			r->total+=p->total;
+			if ((int)(p->expire-r->expire)<0)
+				r->expire=p->expire;
+			list_add(&r->list,p->list.prev);
+			list_del(&p->list);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Insert r in C-LOOK order after the last flush (lock held), a flush is a
+ * barrier : it goes after every waiting request
+ */
+void BlkQueue::insert(blk_request* r){
+	list_head *l, *from=&requests;
+	blk_request* p;
+
+	if (r->dir==BLK_FLUSH){
+		list_add(&r->list,requests.prev);
+		nr_pending++;
+		return;
+	}
+	list_for_each(l,&requests)
+		if ((list_entry(l,blk_request,list))->dir==BLK_FLUSH)
+			from=l;
+	for (l=from->next;l!=&requests;l=l->next){
+		p=list_entry(l,blk_request,list);
+		if (blk_before(r->sector,p->sector,head_pos))
+			break;
+	}
+	list_add(&r->list,l->prev);
+	nr_pending++;
+}
+
+/*
+ * Take the next request for the driver (lock held), NULL if the disk is full,
+ * if the queue is empty or if a flush must wait for an empty disk
+ */
+blk_request* BlkQueue::dispatch(){
+	list_head* l;
+	blk_request *r, *p;
+	u32 now=arch.getTicks();
+	if (nr_active>=depth || list_empty(&requests))
+		return NULL;
+	r=list_first_entry(&requests,blk_request,list);
+	if (nr_active>0 && (r->dir==BLK_FLUSH
+		|| (list_first_entry(&dispatched,blk_request,list))->dir==BLK_FLUSH))
+		return NULL;
+
+	//the oldest expired request goes first, without passing a flush
+	list_for_each(l,&requests){
+		p=list_entry(l,blk_request,list);
+		if (p->dir==BLK_FLUSH)
+			break;
+		if ((int)(now-p->expire)>=0 && (int)(p->expire-r->expire)<0)
+			r=p;
+	}
+	if (r!=list_first_entry(&requests,blk_request,list))
+		stats.expired++;
+
+	list_del(&r->list);
+	list_add(&r->list,dispatched.prev);
+	nr_pending--;
+	nr_active++;
+	head_pos=r->sector+r->total;
+	stats.dispatched++;
+	stats.sectors+=r->total;
+	return r;
+}
+
+/* Give the next requests to the driver while it has room for them */
+void BlkQueue::startNext(){
+	blk_request* r;
+	u32 flags,n=0;
+	for (;;){
+		flags=spin_lock_irqsave(&lock);
+		r=(plugged==0) ? dispatch() : NULL;
+		spin_unlock_irqrestore(&lock,flags);
+		if (r==NULL)
+			break;
+		start(this,r);
+		n++;
+	}
+	if (n>0 && commit!=NULL)
+		commit(this);
+}
+
+void BlkQueue::plug(){
+	u32 flags=spin_lock_irqsave(&lock);
+	plugged++;
+	spin_unlock_irqrestore(&lock,flags);
+}
+
+void BlkQueue::unplug(){
+	u32 flags=spin_lock_irqsave(&lock);
+	plugged--;
+	spin_unlock_irqrestore(&lock,flags);
+	startNext();
+}
+
+void BlkQueue::setCommit(blk_commit_fn c){
+	commit=c;
+}
+
+void BlkQueue::queue(blk_request* r){
+	r->done=0;
+	r->status=RETURN_OK;
+	r->merged=NULL;
+	r->total=r->count;
+	r->expire=arch.getTicks()+ms_to_ticks(BLK_EXPIRE_MS);
+	u32 flags=spin_lock_irqsave(&lock);
+	stats.requests++;
+	if (merge(r))
+		stats.merges++;
+	else
+		insert(r);
+	stats.depth++;
+	if (stats.depth>stats.max_depth)
+		stats.max_depth=stats.depth;
+	spin_unlock_irqrestore(&lock,flags);
+	startNext();
+}
+
+int BlkQueue::wait(blk_request* r){
+	u32 flags;
+	if (blk_can_sleep())
+		wait_event(r->wait,r->done);
+	else
+		while (!r->done){
+			poll(this);
+			__asm__ __volatile__("pause");
+		}
+	/* complete() wakes r up under the lock : r can be freed once it is released */
+	flags=spin_lock_irqsave(&lock);
+	spin_unlock_irqrestore(&lock,flags);
+	return r->status;
+}
+
+int BlkQueue::submit(blk_request* r){
+	queue(r);
+	return wait(r);
+}
+
+/* Called by the driver, usually from its irq handler : ends the whole chain of r */
+void BlkQueue::complete(blk_request* r,int status){
+	blk_request* next;
+	u32 flags=spin_lock_irqsave(&lock);
+	list_del(&r->list);
+	nr_active--;
+	for (;r!=NULL;r=next){
+		next=r->merged;
+		r->status=status;
+		r->done=1;
+		r->wait.wakeUp();
+		stats.depth--;
+	}
+	spin_unlock_irqrestore(&lock,flags);
+	startNext();
+}
+
+blk_request* BlkQueue::active(){
+	if (list_empty(&dispatched))
+		return NULL;
+	return list_first_entry(&dispatched,blk_request,list);
+}
+
+u32 BlkQueue::pending(){
+	return nr_pending;
+}
+
+u32 BlkQueue::inflight(){
+	return nr_active;
+}
+
+void* BlkQueue::getData(){
+	return data;
+}
+
+void BlkQueue::getStats(blk_stats* st){
+	u32 flags=spin_lock_irqsave(&lock);
+	memcpy((char*)st,(char*)&stats,sizeof(blk_stats));
+	spin_unlock_irqrestore(&lock,flags);
+}
@@ -0,0 +1,108 @@
+#ifndef BLKQUEUE_H
+#define BLKQUEUE_H
+
+#include <runtime/types.h>
+#include <runtime/list.h>
+#include <core/waitqueue.h>
+#include <spinlock.h>
+#include <api/dev/blk.h>
+
+/*
+ *	File de requetes d'un controleur de disque. Le demandeur ajoute sa
+ *	requete et dort, le pilote demarre la premiere (start) et l'IRQ de fin
+ *	appelle complete() qui reveille le demandeur et lance la suivante :
+ *	le disque enchaine les requetes des differents processus sans
+ *	attendre qu'ils soient reelus.
+ *
+ *	Tant que les interruptions sont coupees (demarrage) le demandeur
+ *	appelle poll() du pilote au lieu de dormir.
+ *
+ *	Ordonnancement (elevator) : une requete qui prolonge une requete en
+ *	attente (meme disque, meme sens, secteurs contigus) lui est chainee
+ *	et le pilote les transfere en une seule commande. Les autres sont
+ *	triees par secteur en C-LOOK (balayage croissant depuis la position de
+ *	la tete, puis retour au plus petit secteur) ; une requete qui attend
+ *	depuis plus de BLK_EXPIRE_MS passe devant pour eviter la famine.
+ *
+ *	Un controleur a file de commandes (NCQ) recoit jusqu'a depth
+ *	requetes a la fois ; un flush attend que le disque soit vide et rien
+ *	n'est lance tant qu'il n'est pas termine.
+ *
+ *	Les requetes donnees au pilote par un meme passage sont suivies d'un
+ *	appel a commit (si le pilote en a un) : un controleur a anneau ne
+ *	previent le peripherique qu'une fois par lot. plug()/unplug() autour
+ *	d'une serie de queue() retardent le lancement jusqu'a la derniere.
+ */
+
+#define BLK_READ	0
+#define BLK_WRITE	1
+#define BLK_FLUSH	2		/* vide le cache d'ecriture du disque, sans donnees */
+
+#define BLK_EXPIRE_MS	500
+
+struct blk_request {
+	list_head		list;		/* dans la file, puis dans les requetes lancees */
+	u32				drive;
+	u32				sector;
+	u32				count;		/* secteurs */
+	char*			buf;
+	u32				dir;		/* BLK_READ / BLK_WRITE */
+	blk_request*	merged;		/* requete suivante de la meme commande */
+	u32				total;		/* secteurs de la chaine (tete seulement) */
+	u32				expire;		/* tick de la date limite */
+	volatile u32	done;
+	int				status;		/* RETURN_OK ou erreur du pilote */
+	WaitQueue		wait;
+};
+
+class BlkQueue;
+
+typedef void (*blk_start_fn)(BlkQueue* q,blk_request* r);
+typedef void (*blk_poll_fn)(BlkQueue* q);
+typedef void (*blk_commit_fn)(BlkQueue* q);
+
+class BlkQueue
+{
+	public:
+		BlkQueue(blk_start_fn start,blk_poll_fn poll,void* data,u32 max_sectors,u32 depth);
+
+		void			queue(blk_request* r);			/* enqueue r, start it if the disk is idle */
+		int				wait(blk_request* r);			/* sleep until r is done, return its status */
+		int				submit(blk_request* r);			/* queue + wait */
+		void			complete(blk_request* r,int status);	/* end of r (irq), start the next one */
+		void			plug();							/* hold the requests queued from now on */
+		void			unplug();						/* start them */
+		void			setCommit(blk_commit_fn commit);	/* called after a batch of start */
+
+		blk_request*	active();						/* oldest request owned by the disk */
+		u32				pending();						/* requests waiting in the queue */
+		u32				inflight();						/* requests owned by the disk */
+		void*			getData();
+		void			getStats(blk_stats* st);
+
+	private:
+		spinlock_t		lock;
+		list_head		requests;
+		list_head		dispatched;		/* requetes donnees au pilote, la plus ancienne en tete */
+		u32				nr_active;
+		u32				depth;			/* requetes lancees a la fois au plus */
+		u32				nr_pending;
+		blk_start_fn	start;
+		blk_poll_fn		poll;
+		blk_commit_fn	commit;
+		u32				plugged;
+		void*			data;
+		u32				max_sectors;	/* taille maximale d'une chaine */
+		u32				head_pos;		/* secteur suivant la derniere requete lancee */
+		blk_stats		stats;
+
+		u32				merge(blk_request* r);
+		void			insert(blk_request* r);
+		void			startNext();
+		blk_request*	dispatch();
+};
+
+int		blk_can_sleep();		/* interrupts enabled and a current process */
+char*	blk_segment(blk_request* r,u32 off,u32* left);	/* buffer of the sector off of a chain */
+
+#endif
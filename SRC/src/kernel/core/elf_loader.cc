@@ -25,13 +25,51 @@ int is_elf(char *file)
 		return ERROR_PARAM;
 }
 
+/*
+ *	Verifie un segment PT_LOAD, note les zones exec et bss du processus et
+ *	alloue ses pages (sans passer par le #PF)
+ */
+static int load_segment(Elf32_Phdr *p_entry,process_st *proc)
+{
+	u32 v_begin, v_end;
+
+	v_begin = p_entry->p_vaddr;
+	v_end = p_entry->p_vaddr + p_entry->p_memsz;
+	if (v_begin < USER_OFFSET) {
+		io.print ("INFO: load_elf(): can't load executable below %p\n", USER_OFFSET);
+		return ERROR_PARAM;
+	}
+
+	if (v_end > USER_STACK) {
+		io.print ("INFO: load_elf(): can't load executable above %p\n", USER_STACK);
+		return ERROR_PARAM;
+	}
+
+	// Description de la zone exec + rodata 
+	if (p_entry->p_flags == PF_X + PF_R) {	
+		proc->b_exec = (char*) v_begin;
+		proc->e_exec = (char*) v_end;
+	}
+
+	// Description de la zone bss 
+	if (p_entry->p_flags == PF_W + PF_R) {	
+		proc->b_bss = (char*) v_begin;
+		proc->e_bss = (char*) v_end;
+	}
+	
+	if (pd_alloc_user(proc, (char *) v_begin, (char *) v_end) < 0) {
+		io.print ("INFO: load_elf(): no memory left\n");
+		return ERROR_MEMORY;
+	}
+	return RETURN_OK;
+}
+
 /*
  *	Charge le fichier elf dans la memoire virtuelle et renvoie l'adresse de depart
  */
 u32 load_elf(char *file,process_st *proc)
 {
 	char *p;
-	u32 v_begin, v_end;
 	Elf32_Ehdr *hdr;
 	Elf32_Phdr *p_entry;
 	Elf32_Scdr *s_entry;
@@ -50,31 +88,11 @@ u32 load_elf(char *file,process_st *proc)
 	for (pe = 0; pe < hdr->e_phnum; pe++, p_entry++) {	/* Read each entry */
 
 		if (p_entry->p_type == PT_LOAD) {
-			v_begin = p_entry->p_vaddr;
-			v_end = p_entry->p_vaddr + p_entry->p_memsz;
-			if (v_begin < USER_OFFSET) {
-				io.print ("INFO: load_elf(): can't load executable below %p\n", USER_OFFSET);
+			if (load_segment(p_entry, proc) != RETURN_OK)
 				return 0;
-			}
 
-			if (v_end > USER_STACK) {
-				io.print ("INFO: load_elf(): can't load executable above %p\n", USER_STACK);
-				return 0;
-			}
-
-			// Description de la zone exec + rodata 
-			if (p_entry->p_flags == PF_X + PF_R) {	
-				proc->b_exec = (char*) v_begin;
-				proc->e_exec = (char*) v_end;
-			}
-
-			// Description de la zone bss 
-			if (p_entry->p_flags == PF_W + PF_R) {	
-				proc->b_bss = (char*) v_begin;
-				proc->e_bss = (char*) v_end;
-			}
-			//io.print("elf : %x to %x \n",(file + p_entry->p_offset),v_begin);
-			memcpy((char *) v_begin, (char *) (file + p_entry->p_offset), p_entry->p_filesz);
+			//io.print("elf : %x to %x \n",(file + p_entry->p_offset),p_entry->p_vaddr);
+			memcpy((char *) p_entry->p_vaddr, (char *) (file + p_entry->p_offset), p_entry->p_filesz);
 			if (p_entry->p_memsz > p_entry->p_filesz)
 				for (i = p_entry->p_filesz, p = (char *) p_entry->p_vaddr; i < (int)(p_entry->p_memsz); i++)
 					p[i] = 0;
@@ -89,19 +107,46 @@ u32 load_elf(char *file,process_st *proc)
 }
 
 /*
- *	Charge un fichier en creant un nouveau processus
+ *	Charge les segments depuis le fichier ouvert fp dans l'espace d'adressage
+ *	courant : seuls l'en-tete, les program headers et les segments sont lus,
+ *	sans copie intermediaire du fichier entier.
  */
-int execv(char* file,int argc,char** argv){
-	char* map_elf=NULL;
+u32 load_elf_file(File *fp,process_st *proc)
+{
+	Elf32_Ehdr hdr;
+	Elf32_Phdr ph;
+	int pe;
+
+	if (fp->read(0, (u8 *) &hdr, sizeof(hdr)) != sizeof(hdr) || is_elf((char *) &hdr)==ERROR_PARAM) {
+		io.print("INFO: load_elf(): file not in ELF format !\n");
+		return 0;
+	}
+	
+	for (pe = 0; pe < hdr.e_phnum; pe++) {
+		if (fp->read(hdr.e_phoff + pe * hdr.e_phentsize, (u8 *) &ph, sizeof(ph)) != sizeof(ph))
+			return 0;
+		if (ph.p_type != PT_LOAD)
+			continue;
+		if (load_segment(&ph, proc) != RETURN_OK)
+			return 0;
+		if (fp->read(ph.p_offset, (u8 *) ph.p_vaddr, ph.p_filesz) != ph.p_filesz)
+			return 0;
+		if (ph.p_memsz > ph.p_filesz)
+			memset((char *) ph.p_vaddr + ph.p_filesz, 0, ph.p_memsz - ph.p_filesz);
+	}
+	
+	return hdr.e_entry;
+}
+
+/*
+ *	Cree un processus depuis un executable et applique les actions de
+ *	spawn() sur ses descripteurs (verifiees par l'appelant)
+ */
+int spawn(char* file,int argc,char** argv,spawn_action* act,u32 nact){
 	File* fp=fsm.path(file);
-	if (fp==NULL)
+	if (fp==NULL || fp->getType()==TYPE_DIRECTORY)
 		return ERROR_PARAM;
 	
-	map_elf=(char*)kmalloc(fp->getSize());
-	fp->open(NO_FLAG);
-	fp->read(0,(u8*)map_elf,fp->getSize());
-	fp->close();
-	
 	char* name;
 	__default_proc_name[strlen(__default_proc_name)-1]=nb_default;
 	nb_default++;
@@ -109,14 +154,28 @@ int execv(char* file,int argc,char** argv){
 		name=__default_proc_name;
 	else
 		name=argv[0];
-	//io.print("exec %s > %s\n",file,name);
+	//io.print("spawn %s > %s\n",file,name);
 
 	Process* proc=new Process(name);
-	proc->create(map_elf,argc,argv);
-	kfree(map_elf);
+	fp->open(NO_FLAG);
+	if (proc->spawn(fp,argc,argv,act,nact)!=RETURN_OK){
+		fp->close();
+		//jamais executable : detruit tout de suite, personne ne l'attend
+		arch.destroy_process(proc);
+		delete proc;
+		return ERROR_PARAM;
+	}
+	fp->close();
 	return (int)proc->getPid();
 }
 
+/*
+ *	Charge un fichier en creant un nouveau processus
+ */
+int execv(char* file,int argc,char** argv){
+	return spawn(file,argc,argv,NULL,0);
+}
+
 /*
  *	Charge un module
  */
@@ -130,7 +189,10 @@ void execv_module(u32 entry,int argc,char** argv){
 		name=argv[0];
 	
 	Process* proc=new Process(name);
-	proc->create((char*)entry,argc,argv);
+	if (proc->create((char*)entry,argc,argv)!=RETURN_OK){
+		arch.destroy_process(proc);
+		delete proc;
+	}
 }
 
 
@@ -188,8 +188,10 @@ enum {
 
 int is_elf(char *);
 u32 load_elf(char *,process_st *);
+u32 load_elf_file(File *,process_st *);
 
 int execv(char* file,int argc,char** argv);
+int spawn(char* file,int argc,char** argv,spawn_action* act,u32 nact);
 void execv_module(u32 entry,int argc,char** argv);
 
 #endif
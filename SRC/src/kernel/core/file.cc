@@ -46,23 +46,7 @@ File::~File(){
 	kfree(name);
 	
 	//on modifie la liste des frere
-	
-	if (prec==NULL){
-		parent->setChild(next);
-		next->setPrec(NULL);
-	}
-	else if (next==NULL){
-		prec->setNext(NULL);
-	}
-	else if (next==NULL && prec==NULL){
-		parent->setChild(NULL);
-	}
-	else{
-		io.print("prec (%s) next is now %s\n",prec->getName(),next->getName());
-		io.print("next (%s) prec is now %s\n",next->getName(),prec->getName());
-		prec->setNext(next);
-		next->setPrec(prec);
-	}
+	detach();
 	
 	//on supprime les enfant (dossier)
 	File* n=child;
@@ -76,6 +60,21 @@ File::~File(){
 	
 }
 
+/* Retire le fichier de la liste des enfants de son parent */
+void File::detach(){
+	if (parent==NULL)
+		return;
+	if (prec==NULL)
+		parent->setChild(next);
+	else
+		prec->setNext(next);
+	if (next!=NULL)
+		next->setPrec(prec);
+	parent=NULL;
+	prec=NULL;
+	next=NULL;
+}
+
 #define CAR_REPLACE '_'
 
 
@@ -211,6 +210,10 @@ u32	File::read(u32 pos,u8* buffer,u32 size){
 	return NOT_DEFINED;
 }
 
+u32	File::readahead(u32 pos,u32 size){
+	return NOT_DEFINED;
+}
+
 u32	File::write(u32 pos,u8* buffer,u32 size){
 	return NOT_DEFINED;
 }
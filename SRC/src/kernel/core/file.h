@@ -4,6 +4,16 @@
 
 #include <runtime/types.h>
 
+/*
+ *	Etat de la lecture en avance d'un fichier ouvert (voir bcache.h),
+ *	tout a zero a l'ouverture.
+ */
+struct file_ra {
+	u32		next;		/* position de la prochaine lecture sequentielle */
+	u32		start;		/* debut de la derniere fenetre lue en avance */
+	u32		size;		/* taille de la fenetre, 0 : lecture non sequentielle */
+};
+
 enum{
 	TYPE_FILE,
 	TYPE_DIRECTORY,
@@ -26,9 +36,11 @@ class File
 		virtual u32		ioctl(u32 id,u8* buffer);
 		virtual u32		remove();
 		virtual void	scan();
+		virtual u32		readahead(u32 pos,u32 size);	/* asynchronous, a hint */
 		
 		
 		void	checkName();
+		void	detach();
 		
 		u32		addChild(File* n);
 		File*	createChild(char* n,u8 t);
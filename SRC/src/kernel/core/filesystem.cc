@@ -20,6 +20,7 @@ void Filesystem::init(){
 		sysd->createChild("usr",TYPE_DIRECTORY);		//dossier contenant tous les utilisateurs
 		sysd->createChild("mods",TYPE_DIRECTORY);		//dossier contenant tous les modules disponiles
 		sysd->createChild("sockets",TYPE_DIRECTORY);	//dossier contenant tous les sockets actuels
+		sysd->createChild("sem",TYPE_DIRECTORY);		//dossier contenant les semaphores nommes
 }
 
 Filesystem::~Filesystem(){
@@ -97,7 +98,7 @@ File* Filesystem::pivot_root(File* targetdir){
 	  File* newRoot = new File("/",TYPE_DIRECTORY);
 	  File* mainChild = targetdir->getChild();
 	  newRoot->addChild(mainChild);
-	  s8 i, ii = 0;
+	  s8 i;
 	  File* tempChild = mainChild->getPrec(); //Est que File doit tre initialis ? ou pas ?
 	      do
 	      {
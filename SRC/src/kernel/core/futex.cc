@@ -0,0 +1,210 @@
+#include <os.h>
+
+/* Futex (voir futex.h) */
+
+static futex_bucket		futex_table[FUTEX_HASH_SIZE];	/* zero : verrous libres */
+
+/* Physical address of the word, 0 if it is not a user word */
+static u32 futex_key(u32* uaddr){
+	if (((u32)uaddr & 3) || (u32)uaddr<USER_OFFSET || (u32)uaddr>=USER_STACK-4)
+		return 0;
+	(void)*(volatile u32*)uaddr;		//a page never touched is allocated by the #PF
+	return (u32)get_p_addr((char*)uaddr);
+}
+
+static futex_bucket* futex_hash(u32 key){
+	return &futex_table[((key>>2) ^ (key>>12)) & (FUTEX_HASH_SIZE-1)];
+}
+
+/* Append q at the end of fb (lock held) */
+static void futex_enqueue(futex_bucket* fb,futex_q* q){
+	futex_q** pp=&fb->head;
+	while (*pp!=NULL)
+		pp=&(*pp)->next;
+	q->next=NULL;
+	q->fb=fb;
+	*pp=q;
+}
+
+/* Remove q from its bucket (lock held), 0 if it is no more queued */
+static int futex_dequeue(futex_bucket* fb,futex_q* q){
+	futex_q** pp=&fb->head;
+	while (*pp!=NULL && *pp!=q)
+		pp=&(*pp)->next;
+	if (*pp==NULL)
+		return 0;
+	*pp=q->next;
+	q->next=NULL;
+	return 1;
+}
+
+/* Lock the bucket of q, which can be moved by a requeue meanwhile */
+static futex_bucket* futex_lock_q(futex_q* q,u32* flags){
+	futex_bucket* fb;
+	for (;;){
+		fb=q->fb;
+		*flags=spin_lock_irqsave(&fb->lock);
+		if (q->fb==fb)
+			return fb;
+		spin_unlock_irqrestore(&fb->lock,*flags);
+	}
+}
+
+/* Timer of FUTEX_WAIT (softirq) */
+static void futex_timeout(u32 data){
+	futex_q* q=(futex_q*)data;
+	u32 flags;
+	futex_bucket* fb=futex_lock_q(q,&flags);
+	if (futex_dequeue(fb,q)){
+		q->timedout=1;
+		q->p->setState(PROC_STATE_RUN);
+	}
+	spin_unlock_irqrestore(&fb->lock,flags);
+}
+
+int futex_wait(u32* uaddr,u32 val,u32 ms){
+	futex_q q;
+	ktimer timer;
+	futex_bucket* fb;
+	u32 key=futex_key(uaddr);
+	u32 flags,irq;
+	
+	if (key==0)
+		return ERROR_PARAM;
+	fb=futex_hash(key);
+	q.key=key;
+	q.p=arch.pcurrent;
+	q.woken=0;
+	q.timedout=0;
+	
+	//the irqs stay off until SLEEP: no preemption between the timer and the sleep
+	irq=local_irq_save();
+	
+	//the value is checked under the bucket lock: a wake after it is not lost
+	spin_lock(&fb->lock);
+	if (*(volatile u32*)uaddr!=val){
+		spin_unlock(&fb->lock);
+		local_irq_restore(irq);
+		return FUTEX_EAGAIN;
+	}
+	futex_enqueue(fb,&q);
+	spin_unlock(&fb->lock);
+	
+	//armed out of the bucket lock, futex_timeout runs under timer_lock
+	if (ms>0){
+		timer_init(&timer,futex_timeout,(u32)&q);
+		add_timer(&timer,arch.getTicks()+ms_to_ticks(ms));
+	}
+	
+	//a wake or a timeout on another processor meanwhile: no sleep
+	fb=futex_lock_q(&q,&flags);
+	if (!q.woken && !q.timedout)
+		q.p->setState(PROC_STATE_SLEEP);
+	spin_unlock_irqrestore(&fb->lock,flags);
+	local_irq_restore(irq);
+	
+	arch.yield();
+	
+	//woken, timed out or put back on the run queue by someone else
+	fb=futex_lock_q(&q,&flags);
+	futex_dequeue(fb,&q);
+	if (q.p->getState()==PROC_STATE_SLEEP)
+		q.p->setState(PROC_STATE_RUN);
+	spin_unlock_irqrestore(&fb->lock,flags);
+	if (ms>0)
+		del_timer(&timer);
+	
+	if (q.timedout && !q.woken)
+		return FUTEX_ETIMEDOUT;
+	return RETURN_OK;
+}
+
+/* Wake up at most n waiters of key in fb (lock held) */
+static int futex_wake_locked(futex_bucket* fb,u32 key,u32 n){
+	futex_q** pp=&fb->head;
+	futex_q* q;
+	int woken=0;
+	
+	while (*pp!=NULL && (u32)woken<n){
+		q=*pp;
+		if (q->key!=key){
+			pp=&q->next;
+			continue;
+		}
+		*pp=q->next;
+		q->next=NULL;
+		q->woken=1;
+		q->p->setState(PROC_STATE_RUN);		//q is released once the lock is dropped
+		woken++;
+	}
+	return woken;
+}
+
+int futex_wake(u32* uaddr,u32 n){
+	u32 key=futex_key(uaddr);
+	futex_bucket* fb;
+	u32 flags;
+	int woken;
+	
+	if (key==0)
+		return ERROR_PARAM;
+	fb=futex_hash(key);
+	flags=spin_lock_irqsave(&fb->lock);
+	woken=futex_wake_locked(fb,key,n);
+	spin_unlock_irqrestore(&fb->lock,flags);
+	return woken;
+}
+
+/*
+ * Wake up n waiters of uaddr and move at most nrequeue of the next ones
+ * to uaddr2: a condition variable broadcast wakes one waiter and moves
+ * the others on the mutex instead of a thundering herd.
+ */
+int futex_requeue(u32* uaddr,u32 n,u32 nrequeue,u32* uaddr2){
+	u32 key=futex_key(uaddr);
+	u32 key2=futex_key(uaddr2);
+	futex_bucket *fb, *fb2;
+	futex_q** pp;
+	futex_q* q;
+	u32 flags,moved=0;
+	int woken;
+	
+	if (key==0 || key2==0)
+		return ERROR_PARAM;
+	fb=futex_hash(key);
+	fb2=futex_hash(key2);
+	
+	//two buckets are locked in the order of their addresses
+	flags=local_irq_save();
+	if (fb<fb2){
+		spin_lock(&fb->lock);
+		spin_lock(&fb2->lock);
+	}
+	else if (fb>fb2){
+		spin_lock(&fb2->lock);
+		spin_lock(&fb->lock);
+	}
+	else
+		spin_lock(&fb->lock);
+	
+	woken=futex_wake_locked(fb,key,n);
+	
+	pp=&fb->head;
+	while (*pp!=NULL && moved<nrequeue){
+		q=*pp;
+		if (q->key!=key){
+			pp=&q->next;
+			continue;
+		}
+		*pp=q->next;
+		q->key=key2;
+		futex_enqueue(fb2,q);
+		moved++;
+	}
+	
+	if (fb!=fb2)
+		spin_unlock(&fb2->lock);
+	spin_unlock(&fb->lock);
+	local_irq_restore(flags);
+	return woken+moved;
+}
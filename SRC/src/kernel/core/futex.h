@@ -0,0 +1,37 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <runtime/types.h>
+#include <spinlock.h>
+#include <api/kernel/futex.h>
+
+/*
+ *	Futex : files d'attente sur un mot de la memoire utilisateur, rangees
+ *	dans une table de hachage par cle (adresse physique). Chaque attente
+ *	est un futex_q sur la pile noyau du processus endormi.
+ */
+
+#define FUTEX_HASH_SIZE		64		/* puissance de 2 */
+
+class Process;
+struct futex_bucket;
+
+struct futex_q {
+	futex_q*				next;
+	u32						key;
+	Process*				p;
+	futex_bucket* volatile	fb;		/* change par FUTEX_REQUEUE */
+	volatile u32			woken;
+	volatile u32			timedout;
+};
+
+struct futex_bucket {
+	spinlock_t		lock;
+	futex_q*		head;			/* ordre d'arrivee */
+};
+
+int		futex_wait(u32* uaddr,u32 val,u32 ms);
+int		futex_wake(u32* uaddr,u32 n);
+int		futex_requeue(u32* uaddr,u32 n,u32 nrequeue,u32* uaddr2);
+
+#endif
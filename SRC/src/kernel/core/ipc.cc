@@ -0,0 +1,227 @@
+#include <os.h>
+
+/* IPC synchrone (voir ipc.h) */
+
+static spinlock_t		ipc_lock=SPINLOCK_INIT;		/* etat IPC de tous les processus */
+
+/* p can take part in an IPC, a process never started (NEW) is freed without ipc_exit() */
+static int ipc_alive(Process* p){
+	return p->ipcs.state!=IPC_DEAD && p->getState()!=ZOMBIE && p->getState()!=PROC_STATE_NEW
+		&& p->getPInfo()->pd!=NULL;
+}
+
+/*
+ * Find a process which can take part in an IPC (ipc_lock held). It stays
+ * valid until ipc_lock is dropped: it has to go through ipc_exit() before
+ * it becomes a zombie, and only the zombies are freed.
+ */
+static Process* ipc_find(u32 pid){
+	Process* p;
+	spin_lock(&arch.proc_lock);
+	p=arch.pid_lookup(pid);
+	if (p!=NULL && !ipc_alive(p))
+		p=NULL;
+	spin_unlock(&arch.proc_lock);
+	return p;
+}
+
+/*
+ * Message of from to to (ipc_lock held), one of them is the current
+ * process: the long part goes straight from one address space to the
+ * other, the status is the one of the receiver
+ */
+static int ipc_transfer(Process* from,Process* to){
+	ipc_msg* s=from->ipcs.msg;
+	ipc_msg* r=to->ipcs.msg;
+	u32 n=s->slen;
+	int ret=RETURN_OK;
+	int err;
+	
+	r->mr[0]=s->mr[0];
+	r->mr[1]=s->mr[1];
+	r->sender=from->getPid();
+	if (n>r->rmax){
+		n=r->rmax;
+		ret=IPC_EMSGSIZE;
+	}
+	r->rlen=n;
+	if (n==0)
+		return ret;
+	if (from==arch.pcurrent)
+		err=pd_copy_user(to->getPInfo()->pd,r->rbuf,s->sbuf,n,1);
+	else
+		err=pd_copy_user(from->getPInfo()->pd,s->sbuf,r->rbuf,n,0);
+	if (err<0){
+		r->rlen=0;
+		return IPC_EFAULT;
+	}
+	return ret;
+}
+
+/* Status of the sender once its message is taken */
+static int ipc_send_status(int ret){
+	return (ret==IPC_EFAULT) ? IPC_EFAULT : RETURN_OK;
+}
+
+/* End the operation of the blocked process p (ipc_lock held) */
+static void ipc_wake(Process* p,int status){
+	p->ipcs.state=IPC_IDLE;
+	p->ipcs.status=status;
+	p->setState(PROC_STATE_RUN);
+}
+
+/*
+ * Sleep until another process ends the operation (ipc_lock held, it is
+ * released), the processor goes to the pid "to" if it is not 0
+ */
+static int ipc_sleep(Process* p,u32 flags,u32 to){
+	p->setState(PROC_STATE_SLEEP);
+	spin_unlock_irqrestore(&ipc_lock,flags);
+	if (to!=0)
+		arch.yieldTo(to);
+	else
+		arch.yield();
+	for (;;){
+		flags=spin_lock_irqsave(&ipc_lock);
+		if (p->ipcs.status!=IPC_PENDING)
+			break;
+		p->setState(PROC_STATE_SLEEP);		//put back on the run queue by someone else
+		spin_unlock_irqrestore(&ipc_lock,flags);
+		arch.yield();
+	}
+	spin_unlock_irqrestore(&ipc_lock,flags);
+	return p->ipcs.status;
+}
+
+int ipc_send(u32 dest,ipc_msg* m,u32 call){
+	Process* p=arch.pcurrent;
+	Process* d;
+	int ret;
+	u32 flags=spin_lock_irqsave(&ipc_lock);
+	
+	d=ipc_find(dest);
+	if (d==NULL || d==p){
+		spin_unlock_irqrestore(&ipc_lock,flags);
+		return IPC_ESRCH;
+	}
+	p->ipcs.msg=m;
+	p->ipcs.call=call;
+	p->ipcs.peer=dest;
+	p->ipcs.status=IPC_PENDING;
+	
+	//the receiver waits: the message goes now, and the processor with it
+	if (d->ipcs.state==IPC_RECEIVING && (d->ipcs.peer==IPC_ANY || d->ipcs.peer==p->getPid())){
+		ret=ipc_transfer(p,d);
+		ipc_wake(d,ret);
+		if (!call || ret==IPC_EFAULT){
+			spin_unlock_irqrestore(&ipc_lock,flags);
+			arch.yieldTo(dest);		//d is no more used once ipc_lock is dropped
+			return ipc_send_status(ret);
+		}
+		p->ipcs.state=IPC_RECEIVING;
+		return ipc_sleep(p,flags,dest);
+	}
+	
+	//queued on d until it receives
+	p->ipcs.state=IPC_SENDING;
+	p->ipcs.next=NULL;
+	if (d->ipcs.sendq_tail!=NULL)
+		d->ipcs.sendq_tail->ipcs.next=p;
+	else
+		d->ipcs.sendq=p;
+	d->ipcs.sendq_tail=p;
+	return ipc_sleep(p,flags,0);
+}
+
+int ipc_receive(u32 from,ipc_msg* m){
+	Process* p=arch.pcurrent;
+	Process *s, *prev=NULL;
+	int ret;
+	u32 flags=spin_lock_irqsave(&ipc_lock);
+	
+	p->ipcs.msg=m;
+	for (s=p->ipcs.sendq;s!=NULL;prev=s,s=s->ipcs.next)
+		if (from==IPC_ANY || s->getPid()==from)
+			break;
+	
+	//the oldest matching sender is taken, it goes on without a switch
+	if (s!=NULL){
+		if (prev!=NULL)
+			prev->ipcs.next=s->ipcs.next;
+		else
+			p->ipcs.sendq=s->ipcs.next;
+		if (p->ipcs.sendq_tail==s)
+			p->ipcs.sendq_tail=prev;
+		s->ipcs.next=NULL;
+		ret=ipc_transfer(s,p);
+		if (s->ipcs.call && ret!=IPC_EFAULT){
+			s->ipcs.state=IPC_RECEIVING;		//blocked until the reply
+			s->ipcs.peer=p->getPid();
+		}
+		else
+			ipc_wake(s,ipc_send_status(ret));
+		spin_unlock_irqrestore(&ipc_lock,flags);
+		return ret;
+	}
+	
+	if (from!=IPC_ANY){
+		s=ipc_find(from);
+		if (s==NULL || s==p){
+			spin_unlock_irqrestore(&ipc_lock,flags);
+			return IPC_ESRCH;
+		}
+	}
+	p->ipcs.state=IPC_RECEIVING;
+	p->ipcs.peer=from;
+	p->ipcs.status=IPC_PENDING;
+	return ipc_sleep(p,flags,0);
+}
+
+/*
+ * Answer a process blocked in ipc_call, without blocking: the client
+ * runs as soon as the server sleeps again in ipc_receive
+ */
+int ipc_reply(u32 dest,ipc_msg* m){
+	Process* p=arch.pcurrent;
+	Process* d;
+	int ret;
+	u32 flags=spin_lock_irqsave(&ipc_lock);
+	
+	d=ipc_find(dest);
+	if (d==NULL){
+		spin_unlock_irqrestore(&ipc_lock,flags);
+		return IPC_ESRCH;
+	}
+	if (d->ipcs.state!=IPC_RECEIVING || d->ipcs.peer!=p->getPid()){
+		spin_unlock_irqrestore(&ipc_lock,flags);
+		return IPC_EAGAIN;
+	}
+	p->ipcs.msg=m;
+	ret=ipc_transfer(p,d);
+	ipc_wake(d,ret);
+	spin_unlock_irqrestore(&ipc_lock,flags);
+	arch.handoff(dest);
+	return ipc_send_status(ret);
+}
+
+/* p exits: its senders and the processes waiting for it fail */
+void ipc_exit(Process* p){
+	Process* s;
+	u32 flags=spin_lock_irqsave(&ipc_lock);
+	
+	while ((s=p->ipcs.sendq)!=NULL){
+		p->ipcs.sendq=s->ipcs.next;
+		s->ipcs.next=NULL;
+		ipc_wake(s,IPC_ESRCH);
+	}
+	p->ipcs.sendq_tail=NULL;
+	p->ipcs.state=IPC_DEAD;		//ipc_find() does not return it any more
+	
+	spin_lock(&arch.proc_lock);
+	for (s=arch.plist;s!=NULL;s=s->getPNext())
+		if (s->ipcs.state==IPC_RECEIVING && s->ipcs.peer==p->getPid())
+			ipc_wake(s,IPC_ESRCH);
+	spin_unlock(&arch.proc_lock);
+	
+	spin_unlock_irqrestore(&ipc_lock,flags);
+}
@@ -0,0 +1,53 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <runtime/types.h>
+#include <api/kernel/ipc.h>
+
+/*
+ *	IPC synchrone : pas de file de messages, l'emetteur attend le
+ *	recepteur (ou l'inverse) et le message passe directement de l'un a
+ *	l'autre. Les emetteurs bloques sont chaines sur le destinataire dans
+ *	l'ordre d'arrivee. Quand le destinataire attend deja, le processeur
+ *	lui est donne sans passer par la run queue (arch.yieldTo).
+ */
+
+class Process;
+
+enum{
+	IPC_IDLE=0,
+	IPC_SENDING=1,		/* dans la file d'emission de peer */
+	IPC_RECEIVING=2,	/* attend un message de peer ou de IPC_ANY */
+	IPC_DEAD=3,			/* ipc_exit() passe, plus aucune operation */
+};
+
+#define IPC_PENDING		1		/* status tant que l'operation est en cours */
+
+/* Message d'un processus, sur sa pile noyau pendant l'appel */
+struct ipc_msg {
+	u32		mr[IPC_MR];
+	char*	sbuf;		/* partie longue, dans l'espace du proprietaire */
+	u32		slen;
+	char*	rbuf;
+	u32		rmax;
+	u32		rlen;
+	u32		sender;
+};
+
+struct ipc_state {
+	u32				state;
+	u32				peer;
+	u32				call;		/* SENDING : attend ensuite la reponse de peer */
+	volatile int	status;
+	ipc_msg*		msg;
+	Process*		next;		/* file d'emission du destinataire */
+	Process*		sendq;		/* emetteurs bloques sur ce processus */
+	Process*		sendq_tail;
+};
+
+int		ipc_send(u32 dest,ipc_msg* m,u32 call);
+int		ipc_receive(u32 from,ipc_msg* m);
+int		ipc_reply(u32 dest,ipc_msg* m);
+void	ipc_exit(Process* p);		/* the IPC waiting on p fail */
+
+#endif
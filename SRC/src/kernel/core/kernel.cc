@@ -35,6 +35,8 @@ extern "C" void kmain(multiboot_info* mbi){
 	
 	io.print("%s \n",KERNEL_LICENCE);
 	arch.init();
+	init_softirq();
+	init_timers();
 	
 	io.print("Loading Virtual Memory Management \n");
 	vmm.init(mbi->high_mem);
@@ -61,6 +63,12 @@ extern "C" void kmain(multiboot_info* mbi){
 
 	arch.initProc();
 	
+	io.print("Loading kernel workers \n");
+	init_workqueue();
+	
+	io.print("Starting processors \n");
+	arch.initSmp();
+	
 	io.print("Loading binary modules \n");
 	load_modules(mbi);
 	
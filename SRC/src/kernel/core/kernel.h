@@ -17,6 +17,14 @@
 #include <core/device.h>
 #include <core/socket.h>
 #include <core/system.h>
+#include <core/softirq.h>
+#include <core/trace.h>
+#include <core/profile.h>
+#include <core/timer.h>
+#include <core/futex.h>
+#include <core/semaphore.h>
+#include <core/bcache.h>
+#include <core/blkqueue.h>
 
 
 #include <module.h>
@@ -23,9 +23,15 @@ Process::Process(char* n) : File(n,TYPE_PROCESS)
 		cdir=pparent->getCurrentDir();
 	else
 		cdir=fsm.getRoot();
-		
-	arch.addProcess(this);
+	
+	state=PROC_STATE_NEW;	//ignored by the scheduler until create()
+	pwait=NULL;
+	released=0;
+	init_work(&reapwork,Process::reap,this);
+	memset((char*)&info,0,sizeof(process_st));
+	memset((char*)&ipcs,0,sizeof(ipc_state));
 	info.vinfo=(void*)this;
+	arch.addProcess(this);
 	int i;
 	for (i=0;i<CONFIG_MAX_FILE;i++){	//open files
 		openfp[i].fp=NULL;
@@ -51,11 +57,8 @@ void Process::setPParent(Process*p){
 
 u32	Process::read(u32 pos,u8* buffer,u32 sizee){
 	u32 ret=RETURN_OK;
-	arch.enable_interrupt();
 	while (ipc->isEmpty());
 	ret=ipc->get(buffer,sizee);
-	
-	arch.disable_interrupt();
 	return ret;
 }
 
@@ -93,13 +96,22 @@ int	Process::fork(){
 	return 0;
 }
 
-u32	Process::wait(){
-	arch.enable_interrupt();
-	while (is_signal(info.signal, SIGCHLD)==0);
-	clear_signal(&(info.signal), SIGCHLD);
-	arch.destroy_all_zombie();
-	arch.disable_interrupt();
-	return 1;
+/* Wait for the child wpid (any child if wpid<=0) to exit and return its pid */
+u32	Process::wait(int wpid){
+	u32 ret;
+	Process* p;
+	
+	if (pchild==NULL)
+		return (u32)-1;
+	if (wpid>0){
+		p=arch.findProcess(wpid);
+		if (p==NULL || p->getPParent()!=this)
+			return (u32)-1;
+	}
+	
+	//the zombies are only unlinked here, kworker frees them
+	wait_event(childwait,(ret=arch.reap_zombies(this,wpid))!=0);
+	return ret;
 }
 
 u32	Process::remove(){
@@ -111,16 +123,95 @@ void Process::scan(){
 
 }
 
+/*
+ * The father is notified under proc_lock (it can not change meanwhile) and
+ * the process becomes a zombie last : a preemption in the middle can not
+ * leave an unnotified zombie that will never be scheduled again.
+ */
 void Process::exit(){
-	setState(ZOMBIE);
-	if (pparent!=NULL)
+	ipc_exit(this);
+	u32 flags=spin_lock_irqsave(&arch.proc_lock);
+	if (pparent==NULL || pparent==arch.getKernelProc())
+		release();		//nobody will wait for it
+	else {
 		pparent->sendSignal(SIGCHLD);
+		pparent->childwait.wakeUp();
+	}
+	setState(ZOMBIE);
+	spin_unlock_irqrestore(&arch.proc_lock,flags);
+}
+
+/* Teardown of a zombie, run by kworker */
+void Process::reap(void* data){
+	Process* p=(Process*)data;
+	
+	//a zombie can still be on the stack of another processor
+	while (p->getPInfo()->running)
+		arch.yield();
+	arch.destroy_process(p);
+	delete p;
+}
+
+/* Queue the teardown once, proc_lock held by the caller */
+void Process::release(){
+	if (released)
+		return;
+	released=1;
+	queue_work(&reapwork);
 }
 
 void Process::setPNext(Process* p){
 	pnext=p;
 }
 
+void Process::setPPrev(Process* p){
+	pprev=p;
+}
+
+void Process::setPChild(Process* p){
+	pchild=p;
+}
+
+void Process::setPSibling(Process* p){
+	psibling=p;
+}
+
+void Process::setPHash(Process* p){
+	phash=p;
+}
+
+Process* Process::getPPrev(){
+	return pprev;
+}
+
+Process* Process::getPChild(){
+	return pchild;
+}
+
+Process* Process::getPSibling(){
+	return psibling;
+}
+
+Process* Process::getPHash(){
+	return phash;
+}
+
+Process** Process::getPHashRef(){
+	return &phash;
+}
+
+void Process::setPWait(Process* p){
+	pwait=p;
+}
+
+Process* Process::getPWait(){
+	return pwait;
+}
+
+Process** Process::getPWaitRef(){
+	return &pwait;
+}
+
 process_st* Process::getPInfo(){
 	return &info;
 }
@@ -130,12 +221,27 @@ Process* Process::getPNext(){
 }
 
 u32 Process::create(char* file, int argc, char **argv){
-	int ret=arch.createProc(&info,file,argc,argv);
-	if (ret==1)
-		setState(CHILD);
-	else
-		setState(ZOMBIE);
-		
+	int ret=arch.createProc(&info,file,NULL,argc,argv);
+	return start(ret,NULL,0);
+}
+
+/* Load an executable file without a copy of the whole file, see spawn() */
+u32 Process::spawn(File* fp, int argc, char **argv, spawn_action* act, u32 nact){
+	int ret=arch.createProc(&info,NULL,fp,argc,argv);
+	return start(ret,act,nact);
+}
+
+/*
+ * Descriptors of the new process then first schedule: stdin, stdout and
+ * stderr of the father, changed by the spawn actions (already checked).
+ * A path to open which has disappeared or can not be opened since the check
+ * fails the spawn like a child which could not be loaded: the process is
+ * never runnable and the caller destroys it.
+ */
+u32 Process::start(int loaded, spawn_action* act, u32 nact){
+	File* f;
+	u32 i;
+	
 	//stdin stdout et stderr du parent
 	if (pparent!=NULL){
 		memcpy((char*)&openfp[0],(char*)pparent->getFileInfo(0),sizeof(openfile));
@@ -150,15 +256,52 @@ u32 Process::create(char* file, int argc, char **argv){
 		
 	}
 	
+	for (i=0;i<nact && loaded==1;i++){
+		switch (act[i].type){
+			case SPAWN_DUP2:
+				memcpy((char*)&openfp[act[i].fd],(char*)pparent->getFileInfo(act[i].srcfd),sizeof(openfile));
+				break;
+			case SPAWN_CLOSE:
+				openfp[act[i].fd].fp=NULL;
+				break;
+			case SPAWN_OPEN:
+				f=fsm.path(act[i].path);
+				if (f==NULL || f->open(act[i].flags)!=RETURN_OK){
+					loaded=0;
+					break;
+				}
+				setFile(act[i].fd,f,0,act[i].flags);
+				break;
+		}
+	}
+	
+	//runnable only once completely initialised
+	if (loaded!=1)
+		return ERROR_PARAM;
+	setState(CHILD);
+	return RETURN_OK;
+}
+
+u32 Process::kcreate(kthread_fn fn, void* arg){
+	arch.createKThread(&info,fn,arg);
+	setState(CHILD);
 	return RETURN_OK;
 }
 
+Process* kthread_create(char* name, kthread_fn fn, void* arg){
+	Process* p=new Process(name);
+	p->kcreate(fn,arg);
+	return p;
+}
+
 void Process::setFile(u32 fd,File* fp,u32 ptr, u32 mode){
 	if (fd<0 || fd>CONFIG_MAX_FILE)
 		return;
 	openfp[fd].fp=fp;
 	openfp[fd].ptr=ptr;
 	openfp[fd].mode=mode;
+	memset((char*)&openfp[fd].ra,0,sizeof(file_ra));
+	openfp[fd].ra.next=ptr;
 }
 
 u32 Process::addFile(File* f,u32 m){
@@ -169,9 +312,11 @@ u32 Process::addFile(File* f,u32 m){
 			openfp[i].fp=f;
 			openfp[i].mode=m;
 			openfp[i].ptr=0;
+			memset((char*)&openfp[i].ra,0,sizeof(file_ra));
 			return i;
 		}
 	}
+	return (u32)-1;		//no free descriptor
 }
 
 File* Process::getFile(u32 fd){
@@ -192,32 +337,15 @@ void Process::deleteFile(u32 fd){
 	openfp[fd].fp=NULL;
 	openfp[fd].mode=0;
 	openfp[fd].ptr=0;
+	memset((char*)&openfp[fd].ra,0,sizeof(file_ra));
 }
 
+/*
+ * Round robin in the run queue of the processor, the idle thread only
+ * runs when no process is runnable (see Architecture::pickNext)
+ */
 Process* Process::schedule(){
-	Process* n=this;
-	int out=1;
-	n=n->getPNext();
-	while (out){
-		
-		if (n==NULL){
-			n=arch.plist;
-		}
-		//io.print("testing %s\n",n->getName());
-		
-		
-		if (n->getState() !=ZOMBIE){
-			out=0;
-		}
-		else{
-			n=n->getPNext();
-		}
-		
-	}
-	
-	arch.pcurrent=n;
-	
-	return n;
+	return arch.pickNext(this);
 }
 
 
@@ -232,13 +360,21 @@ void Process::setCurrentDir(File* f){
 
 
 void Process::setState(u8 st){
+	u32 was=isRunnable();
 	state=st;
+	//start of the run queue wait, ended by the scheduler
+	if (!was && isRunnable() && info.wait_stamp==0)
+		info.wait_stamp=arch.getCycles();
 }
 
 u8	Process::getState(){
 	return state;
 }
 
+u32	Process::isRunnable(){
+	return state==CHILD || state==PROC_STATE_THREAD;
+}
+
 
 void Process::setPid(u32 st){
 	pid=st;
@@ -259,5 +395,17 @@ void Process::reset_pinfo(){
 	ppinfo.state=state;
 	ppinfo.vmem=10*1024*1024;
 	ppinfo.pmem=10*1024*1024;
+	
+	ppinfo.utime=info.utime;
+	ppinfo.stime=info.stime;
+	ppinfo.wtime=info.wtime;
+	ppinfo.cpu_khz=arch.getCyclesKhz();
+	ppinfo.cpu=info.cpu;
+	ppinfo.nvcsw=info.nvcsw;
+	ppinfo.nivcsw=info.nivcsw;
+	for (int i=0;i<3;i++)
+		ppinfo.loadavg[i]=arch.getLoadAvg(i);
+	ppinfo.ticks=arch.getTicks();
+	ppinfo.hz=HZ;
 }
 
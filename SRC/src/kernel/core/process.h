@@ -10,16 +10,24 @@
 
 #include <runtime/buffer.h>
 
+#include <core/waitqueue.h>
+#include <core/workqueue.h>
+#include <core/ipc.h>
+
 #include <api/dev/proc.h>
+#include <api/kernel/spawn.h>
 
 #define ZOMBIE	PROC_STATE_ZOMBIE
 #define CHILD	PROC_STATE_RUN
 
+typedef void (*kthread_fn)(void* arg);
+
 struct openfile
 {
 	u32				mode;	/* Mode d'ouverture */
 	u32				ptr;	/* Pointeur de lecture/ecriture */
 	File*			fp;		/* Fichier ouvert */
+	file_ra			ra;		/* Lecture en avance */
 };
 
 class Process : public File
@@ -38,8 +46,10 @@ class Process : public File
 		
 		
 		u32		create(char* file, int argc, char **argv);
+		u32		spawn(File* fp, int argc, char **argv, spawn_action* act, u32 nact);	/* from an executable file */
+		u32		kcreate(kthread_fn fn, void* arg);	/* kernel thread */
 		void	sendSignal(int sig);
-		u32		wait();
+		u32		wait(int wpid);
 		
 		u32 	addFile(File* fp,u32 m);
 		File*	getFile(u32 fd);
@@ -52,21 +62,36 @@ class Process : public File
 		
 		void	setState(u8 st);
 		u8		getState();
+		u32		isRunnable();
 		void	setFile(u32 fd,File* fp,u32 ptr, u32 mode);
 		void	setPid(u32 st);
 		u32		getPid();
 		
 		void			setPNext(Process* p);
+		void			setPPrev(Process* p);
+		void			setPChild(Process* p);
+		void			setPSibling(Process* p);
+		void			setPHash(Process* p);
+		void			setPWait(Process* p);
 		
 		Process* 		schedule();
 		Process*		getPNext();
+		Process*		getPPrev();
+		Process*		getPChild();
+		Process*		getPSibling();
+		Process*		getPHash();
+		Process**		getPHashRef();
+		Process*		getPWait();
+		Process**		getPWaitRef();
 		Process*		getPParent();
 		process_st* 	getPInfo();
 		void			setPParent(Process*p);
 		
 		void			reset_pinfo();
+		void			release();		/* queue the teardown of the zombie to kworker (proc_lock held) */
 		
 		process_st		info;
+		ipc_state		ipcs;		/* synchronous IPC, under ipc_lock (ipc.cc) */
 		
 		File*	getCurrentDir();
 		void	setCurrentDir(File* f);
@@ -77,7 +102,15 @@ class Process : public File
 		u32 		pid;
 		u8			state;
 		Process*	pparent;
-		Process*	pnext;
+		Process*	pnext;		/* scheduler list */
+		Process*	pprev;
+		Process*	pchild;		/* first child */
+		Process*	psibling;	/* next child of pparent */
+		Process*	phash;		/* next in the pid hash bucket */
+		Process*	pwait;		/* next in the WaitQueue */
+		WaitQueue	childwait;	/* wait() sleeps here until a child exits */
+		work		reapwork;	/* teardown run by kworker */
+		u8			released;	/* reapwork already queued, under proc_lock */
 		openfile	openfp[CONFIG_MAX_FILE];
 		proc_info	ppinfo;
 		File*		cdir;
@@ -85,8 +118,14 @@ class Process : public File
 		Buffer*		ipc;
 		
 		static char*	default_tty;
+		
+		static void		reap(void* data);
+		u32				start(int loaded, spawn_action* act, u32 nact);
 
 };
 
+/* Create and start a kernel thread, scheduled as a process without user space */
+Process*	kthread_create(char* name, kthread_fn fn, void* arg);
+
 
 #endif
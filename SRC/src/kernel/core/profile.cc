@@ -0,0 +1,198 @@
+#include <os.h>
+
+/*
+ *	Profileur par echantillonnage : les echantillons sont comptes par pile
+ *	distincte. La table se lit apres API_PROF_STOP (l'ordre des entrees
+ *	change tant que des piles nouvelles arrivent).
+ */
+
+volatile u32			prof_running=0;
+
+static prof_sample		prof_table[PROF_SLOTS];
+static u32				prof_source=PROF_SRC_TIMER;
+static u32				prof_pid=0;
+static u32				prof_hz=0;
+static u32				prof_samples=0;
+static u32				prof_dropped=0;
+static u32				prof_entries=0;
+static spinlock_t		prof_lock=SPINLOCK_INIT;
+
+static u32 prof_hash(u32 pid,u32 user,u32* pc,u32 depth){
+	u32 h=pid*31+user;
+	u32 i;
+	for (i=0;i<depth;i++)
+		h=h*31+pc[i];
+	return h^(h>>16);
+}
+
+static u32 prof_match(prof_sample* s,u32 pid,u32 user,u32* pc,u32 depth){
+	u32 i;
+	if (s->pid!=pid || s->user!=user || s->depth!=depth)
+		return 0;
+	for (i=0;i<depth;i++)
+		if (s->pc[i]!=pc[i])
+			return 0;
+	return 1;
+}
+
+u32 prof_wanted(u32 pid){
+	return prof_pid==0 || prof_pid==pid;
+}
+
+/* Compte un echantillon (contexte IRQ, interruptions masquees) */
+void prof_record(u32 pid,u32 user,u32* pc,u32 depth){
+	prof_sample* s;
+	u32 h,i,probe;
+	
+	if (depth>PROF_MAX_DEPTH)
+		depth=PROF_MAX_DEPTH;
+	h=prof_hash(pid,user,pc,depth);
+	
+	spin_lock(&prof_lock);
+	if (!prof_running){
+		spin_unlock(&prof_lock);
+		return;
+	}
+	for (probe=0;probe<PROF_PROBES;probe++){
+		s=&prof_table[(h+probe) & (PROF_SLOTS-1)];
+		if (s->count==0){
+			s->pid=pid;
+			s->user=user;
+			s->depth=depth;
+			for (i=0;i<depth;i++)
+				s->pc[i]=pc[i];
+			s->count=1;
+			prof_entries++;
+			prof_samples++;
+			spin_unlock(&prof_lock);
+			return;
+		}
+		if (prof_match(s,pid,user,pc,depth)){
+			s->count++;
+			prof_samples++;
+			spin_unlock(&prof_lock);
+			return;
+		}
+	}
+	prof_dropped++;
+	spin_unlock(&prof_lock);
+}
+
+
+Profile::~Profile(){
+	
+}
+
+Profile::Profile(char* n) : File(n,TYPE_FILE)
+{
+	fsm.addFile("/sys/",this);
+}
+
+u32	Profile::open(u32 flag){
+	return RETURN_OK;
+}
+
+u32	Profile::close(){
+	return RETURN_OK;
+}
+
+/*
+ * Les entrees occupees de la table, pos compte en octets depuis la premiere.
+ * Copiees sous le verrou dans un buffer du noyau : le buffer de
+ * l'utilisateur peut provoquer un defaut de page.
+ */
+u32	Profile::read(u32 pos,u8* buffer,u32 size){
+	prof_sample* out;
+	u32 skip=pos/sizeof(prof_sample);
+	u32 n=size/sizeof(prof_sample);
+	u32 done=0,i,flags;
+	
+	if (buffer==NULL)
+		return ERROR_PARAM;
+	if (n>PROF_SLOTS)
+		n=PROF_SLOTS;
+	if (n==0)
+		return 0;
+	out=(prof_sample*)kmalloc(n*sizeof(prof_sample));
+	if (out==NULL)
+		return ERROR_MEMORY;
+	flags=spin_lock_irqsave(&prof_lock);
+	for (i=0;i<PROF_SLOTS && done<n;i++){
+		if (prof_table[i].count==0)
+			continue;
+		if (skip>0){
+			skip--;
+			continue;
+		}
+		memcpy((char*)&out[done],(char*)&prof_table[i],sizeof(prof_sample));
+		done++;
+	}
+	spin_unlock_irqrestore(&prof_lock,flags);
+	memcpy((char*)buffer,(char*)out,done*sizeof(prof_sample));
+	kfree(out);
+	return done*sizeof(prof_sample);
+}
+
+u32	Profile::write(u32 pos,u8* buffer,u32 size){
+	return NOT_DEFINED;
+}
+
+u32	Profile::ioctl(u32 id,u8* buffer){
+	prof_config* cfg=(prof_config*)buffer;
+	prof_info* info=(prof_info*)buffer;
+	u32 flags;
+	int hz;
+	
+	switch (id){
+		case API_PROF_START:
+			if (prof_running)
+				arch.stopProfiler();
+			prof_running=0;
+			prof_source=(cfg!=NULL) ? cfg->source : (u32)PROF_SRC_TIMER;
+			prof_pid=(cfg!=NULL) ? cfg->pid : 0;
+			hz=arch.startProfiler(prof_source);
+			if (hz<=0)
+				return ERROR_PARAM;
+			prof_hz=hz;
+			prof_running=1;
+			return RETURN_OK;
+			
+		case API_PROF_STOP:
+			if (prof_running)
+				arch.stopProfiler();
+			prof_running=0;
+			return RETURN_OK;
+			
+		case API_PROF_RESET:
+			flags=spin_lock_irqsave(&prof_lock);
+			memset((char*)prof_table,0,sizeof(prof_table));
+			prof_samples=0;
+			prof_dropped=0;
+			prof_entries=0;
+			spin_unlock_irqrestore(&prof_lock,flags);
+			return RETURN_OK;
+			
+		case API_PROF_GET_INFO:
+			if (info==NULL)
+				return ERROR_PARAM;
+			info->running=prof_running;
+			info->source=prof_source;
+			info->hz=prof_hz;
+			info->samples=prof_samples;
+			info->dropped=prof_dropped;
+			info->entries=prof_entries;
+			return RETURN_OK;
+			
+		default:
+			return NOT_DEFINED;
+	}
+}
+
+u32	Profile::remove(){
+	delete this;
+	return RETURN_OK;
+}
+
+void Profile::scan(){
+
+}
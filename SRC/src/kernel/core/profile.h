@@ -0,0 +1,39 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <runtime/types.h>
+#include <core/file.h>
+#include <api/dev/prof.h>
+
+/*
+ *	Histogrammes du profileur : une entree par (pid, mode, pile),
+ *	table a adressage ouvert remplie en contexte IRQ. L'architecture
+ *	preleve les echantillons (voir prof_tick) et les passe a prof_record.
+ */
+
+#define PROF_SLOTS		1024		/* puissance de 2 */
+#define PROF_PROBES		16
+
+extern volatile u32	prof_running;
+
+void	prof_record(u32 pid,u32 user,u32* pc,u32 depth);
+u32		prof_wanted(u32 pid);		/* filtre de pid de la session en cours */
+
+
+/* /sys/profile : lecture du tableau de prof_sample, ioctl de controle */
+class Profile : public File
+{
+	public:
+		Profile(char* n);
+		~Profile();
+		
+		u32		open(u32 flag);
+		u32		close();
+		u32		read(u32 pos,u8* buffer,u32 size);
+		u32		write(u32 pos,u8* buffer,u32 size);
+		u32		ioctl(u32 id,u8* buffer);
+		u32		remove();
+		void	scan();
+};
+
+#endif
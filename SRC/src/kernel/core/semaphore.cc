@@ -0,0 +1,302 @@
+#include <os.h>
+
+/* Semaphores nommes (voir semaphore.h) */
+
+static LIST_HEAD(sem_list);
+static spinlock_t		sem_list_lock=SPINLOCK_INIT;	/* sem_list et /sys/sem, avant sem->lock */
+
+/* sem_list_lock held */
+Semaphore::Semaphore(char* n,u32 v) : File(n,TYPE_FILE)
+{
+	spin_lock_init(&lock);
+	value=v;
+	nwaiters=0;
+	head=NULL;
+	tail=NULL;
+	refs=0;
+	removed=0;
+	list_add(&list,&sem_list);
+	fsm.addFile("/sys/sem/",this);
+}
+
+/* Freed by put() once removed and unreferenced */
+Semaphore::~Semaphore(){
+	
+}
+
+/* Valid semaphore name: one path component */
+static int sem_name_ok(char* n){
+	char* s=n;
+	if (n==NULL || *n==0)
+		return 0;
+	while (*s){
+		if (*s=='/')
+			return 0;
+		s++;
+	}
+	return 1;
+}
+
+Semaphore* Semaphore::create(char* n,u32 value){
+	File* dir;
+	Semaphore* s;
+	u32 flags;
+	
+	if (!sem_name_ok(n) || value>SEM_VALUE_MAX)
+		return NULL;
+	flags=spin_lock_irqsave(&sem_list_lock);
+	dir=fsm.path("/sys/sem/");
+	if (dir==NULL){
+		spin_unlock_irqrestore(&sem_list_lock,flags);
+		return NULL;
+	}
+	s=(Semaphore*)dir->find(n);		//only semaphores in /sys/sem
+	if (s==NULL)
+		s=new Semaphore(n,value);
+	s->open(0);
+	spin_unlock_irqrestore(&sem_list_lock,flags);
+	return s;
+}
+
+/*
+ * Remove the name: the waiters fail with SEM_EIDRM and the semaphore is
+ * freed by the last close
+ */
+int Semaphore::unlink(char* n){
+	File* dir;
+	Semaphore* s;
+	sem_waiter* w;
+	u32 flags;
+	int freed;
+	
+	if (!sem_name_ok(n))
+		return ERROR_PARAM;
+	flags=spin_lock_irqsave(&sem_list_lock);
+	dir=fsm.path("/sys/sem/");
+	s=(dir!=NULL) ? (Semaphore*)dir->find(n) : NULL;
+	if (s==NULL){
+		spin_unlock_irqrestore(&sem_list_lock,flags);
+		return ERROR_PARAM;
+	}
+	s->detach();
+	spin_lock(&s->lock);
+	s->removed=1;
+	while ((w=s->head)!=NULL){
+		s->dequeue(w);
+		w->status=SEM_EIDRM;
+		w->p->setState(PROC_STATE_RUN);
+	}
+	freed=(s->refs==0);
+	if (freed)
+		list_del(&s->list);
+	spin_unlock(&s->lock);
+	spin_unlock_irqrestore(&sem_list_lock,flags);
+	if (freed)
+		delete s;
+	return RETURN_OK;
+}
+
+Semaphore* Semaphore::get(File* fp){
+	list_head* p;
+	Semaphore* s=NULL;
+	u32 flags;
+	
+	if (fp==NULL)
+		return NULL;
+	flags=spin_lock_irqsave(&sem_list_lock);
+	list_for_each(p,&sem_list){
+		if ((File*)list_entry(p,Semaphore,list)==fp){
+			s=(Semaphore*)fp;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&sem_list_lock,flags);
+	return s;
+}
+
+/* Drop a reference, the last one frees a removed semaphore */
+void Semaphore::put(){
+	u32 flags=spin_lock_irqsave(&sem_list_lock);
+	int freed;
+	
+	spin_lock(&lock);
+	refs--;
+	freed=(removed && refs==0);
+	if (freed)
+		list_del(&list);
+	spin_unlock(&lock);
+	spin_unlock_irqrestore(&sem_list_lock,flags);
+	if (freed)
+		delete this;
+}
+
+/* Append w at the end of the queue (lock held) */
+void Semaphore::enqueue(sem_waiter* w){
+	w->next=NULL;
+	if (tail!=NULL)
+		tail->next=w;
+	else
+		head=w;
+	tail=w;
+}
+
+/* Remove w from the queue (lock held), 0 if it is no more queued */
+int Semaphore::dequeue(sem_waiter* w){
+	sem_waiter** pp=&head;
+	sem_waiter* prev=NULL;
+	
+	while (*pp!=NULL && *pp!=w){
+		prev=*pp;
+		pp=&prev->next;
+	}
+	if (*pp==NULL)
+		return 0;
+	*pp=w->next;
+	if (tail==w)
+		tail=prev;
+	w->next=NULL;
+	return 1;
+}
+
+/* Timer of a timed lock (softirq) */
+void Semaphore::timeout(u32 data){
+	sem_waiter* w=(sem_waiter*)data;
+	Semaphore* s=w->sem;
+	u32 flags=spin_lock_irqsave(&s->lock);
+	if (s->dequeue(w)){
+		w->status=SEM_ETIMEDOUT;
+		w->p->setState(PROC_STATE_RUN);
+	}
+	spin_unlock_irqrestore(&s->lock,flags);
+}
+
+/*
+ * Take a token, ms = 0 only tries and SEM_FOREVER waits without limit.
+ * A waiter sleeps until release() gives it a token: it is never woken
+ * to find the semaphore taken again.
+ */
+int Semaphore::acquire(u32 ms){
+	sem_waiter w;
+	ktimer timer;
+	u32 flags;
+	
+	//the irqs stay off until SLEEP: no preemption between the timer and the sleep
+	u32 irq=local_irq_save();
+	spin_lock(&lock);
+	if (removed){
+		spin_unlock(&lock);
+		local_irq_restore(irq);
+		return SEM_EIDRM;
+	}
+	if (value>0){
+		value--;
+		spin_unlock(&lock);
+		local_irq_restore(irq);
+		return RETURN_OK;
+	}
+	if (ms==0){
+		spin_unlock(&lock);
+		local_irq_restore(irq);
+		return SEM_EAGAIN;
+	}
+	
+	w.p=arch.pcurrent;
+	w.sem=this;
+	w.status=SEM_PENDING;
+	enqueue(&w);
+	nwaiters++;
+	refs++;
+	spin_unlock(&lock);
+	
+	//armed out of the lock, timeout() runs under timer_lock
+	if (ms!=SEM_FOREVER){
+		timer_init(&timer,timeout,(u32)&w);
+		add_timer(&timer,arch.getTicks()+ms_to_ticks(ms));
+	}
+	
+	//a token, a timeout or an unlink on another processor meanwhile: no sleep
+	spin_lock(&lock);
+	if (w.status==SEM_PENDING)
+		w.p->setState(PROC_STATE_SLEEP);
+	spin_unlock(&lock);
+	local_irq_restore(irq);
+	
+	for (;;){
+		arch.yield();
+		flags=spin_lock_irqsave(&lock);
+		if (w.status!=SEM_PENDING)
+			break;
+		w.p->setState(PROC_STATE_SLEEP);		//put back on the run queue by someone else
+		spin_unlock_irqrestore(&lock,flags);
+	}
+	nwaiters--;
+	spin_unlock_irqrestore(&lock,flags);
+	if (ms!=SEM_FOREVER)
+		del_timer(&timer);
+	put();
+	return w.status;
+}
+
+/* Give a token to the oldest waiter, or increment the value */
+int Semaphore::release(){
+	sem_waiter* w;
+	u32 flags=spin_lock_irqsave(&lock);
+	int ret=RETURN_OK;
+	
+	if (removed)
+		ret=SEM_EIDRM;
+	else if ((w=head)!=NULL){
+		dequeue(w);
+		w->status=RETURN_OK;
+		w->p->setState(PROC_STATE_RUN);		//w is released once the lock is dropped
+	}
+	else if (value>=SEM_VALUE_MAX)
+		ret=SEM_EOVERFLOW;
+	else
+		value++;
+	spin_unlock_irqrestore(&lock,flags);
+	return ret;
+}
+
+u32	Semaphore::open(u32 flag){
+	u32 flags=spin_lock_irqsave(&lock);
+	refs++;
+	spin_unlock_irqrestore(&lock,flags);
+	return RETURN_OK;
+}
+
+u32	Semaphore::close(){
+	put();
+	return RETURN_OK;
+}
+
+/* struct sem_info */
+u32	Semaphore::read(u32 pos,u8* buffer,u32 size){
+	sem_info info;
+	u32 flags;
+	
+	if (buffer==NULL || size<sizeof(sem_info))
+		return ERROR_PARAM;
+	flags=spin_lock_irqsave(&lock);
+	info.value=value;
+	info.waiters=nwaiters;
+	spin_unlock_irqrestore(&lock,flags);
+	memcpy((char*)buffer,(char*)&info,sizeof(sem_info));	//the user buffer can fault
+	return sizeof(sem_info);
+}
+
+u32	Semaphore::write(u32 pos,u8* buffer,u32 size){
+	return NOT_DEFINED;
+}
+
+u32	Semaphore::ioctl(u32 id,u8* buffer){
+	return NOT_DEFINED;
+}
+
+u32	Semaphore::remove(){
+	return unlink(name);
+}
+
+void Semaphore::scan(){
+
+}
@@ -0,0 +1,67 @@
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include <runtime/types.h>
+#include <runtime/list.h>
+#include <spinlock.h>
+#include <core/file.h>
+#include <api/kernel/semaphore.h>
+
+/*
+ *	Semaphores nommes (/sys/sem/). Les processus en attente dorment dans
+ *	une file dans l'ordre d'arrivee, chaque attente est un sem_waiter sur
+ *	la pile noyau du processus. unlock donne le jeton au premier de la
+ *	file sans incrementer la valeur.
+ */
+
+class Process;
+class Semaphore;
+
+struct sem_waiter {
+	sem_waiter*		next;
+	Process*		p;
+	Semaphore*		sem;
+	volatile int	status;		/* SEM_PENDING tant qu'il attend */
+};
+
+#define SEM_PENDING		1
+
+class Semaphore : public File
+{
+	public:
+		Semaphore(char* n,u32 value);
+		~Semaphore();
+		
+		u32		open(u32 flag);
+		u32		close();
+		u32		read(u32 pos,u8* buffer,u32 size);
+		u32		write(u32 pos,u8* buffer,u32 size);
+		u32		ioctl(u32 id,u8* buffer);
+		u32		remove();
+		void	scan();
+		
+		int		acquire(u32 ms);
+		int		release();
+		
+		static Semaphore*	create(char* n,u32 value);	/* or the existing one */
+		static int			unlink(char* n);
+		static Semaphore*	get(File* fp);		/* NULL if fp is not a semaphore */
+		
+	private:
+		spinlock_t		lock;
+		u32				value;
+		u32				nwaiters;
+		sem_waiter*		head;		/* ordre d'arrivee */
+		sem_waiter*		tail;
+		u32				refs;		/* descripteurs ouverts et attentes */
+		u32				removed;
+		list_head		list;		/* tous les semaphores */
+		
+		void	enqueue(sem_waiter* w);
+		int		dequeue(sem_waiter* w);
+		void	put();
+		
+		static void		timeout(u32 data);
+};
+
+#endif
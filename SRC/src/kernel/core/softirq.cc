@@ -0,0 +1,114 @@
+#include <os.h>
+
+/* Softirqs et tasklets (voir softirq.h) */
+
+static softirq_handler	softirq_vec[NR_SOFTIRQS];
+static volatile u32		softirq_pending=0;
+static volatile u32		softirq_active=0;	/* processor running the softirqs + 1 */
+static spinlock_t		softirq_lock=SPINLOCK_INIT;
+
+static tasklet*			tasklet_head=NULL;
+static tasklet**		tasklet_tail=&tasklet_head;
+
+/* Run the scheduled tasklets, a tasklet can be scheduled again by its func */
+static void tasklet_action(){
+	tasklet* t;
+	u32 flags=spin_lock_irqsave(&softirq_lock);
+	t=tasklet_head;
+	tasklet_head=NULL;
+	tasklet_tail=&tasklet_head;
+	spin_unlock_irqrestore(&softirq_lock,flags);
+
+	while (t!=NULL){
+		tasklet* next=t->next;
+		t->state&=~TASKLET_SCHED;
+		t->func(t->data);
+		t=next;
+	}
+}
+
+void init_softirq(){
+	int i;
+	for (i=0;i<NR_SOFTIRQS;i++)
+		softirq_vec[i]=NULL;
+	open_softirq(SOFTIRQ_TASKLET,tasklet_action);
+}
+
+void open_softirq(u32 nr,softirq_handler h){
+	if (nr<NR_SOFTIRQS)
+		softirq_vec[nr]=h;
+}
+
+void raise_softirq(u32 nr){
+	u32 flags=spin_lock_irqsave(&softirq_lock);
+	softirq_pending|=(1<<nr);
+	spin_unlock_irqrestore(&softirq_lock,flags);
+}
+
+/* The softirqs run on one processor at a time */
+int in_softirq(){
+	return softirq_active==smp_processor_id()+1;
+}
+
+/*
+ * Run the pending softirqs with the interruptions enabled. The hard irqs
+ * arriving meanwhile only raise new softirqs, picked up by the next pass.
+ * After SOFTIRQ_RESTART passes the rest waits for the next irq exit.
+ */
+void do_softirq(){
+	u32 pending;
+	u32 flags=local_irq_save();
+	int restart=SOFTIRQ_RESTART;
+	int i;
+
+	spin_lock(&softirq_lock);
+	if (softirq_active || softirq_pending==0){
+		spin_unlock(&softirq_lock);
+		local_irq_restore(flags);
+		return;
+	}
+	softirq_active=smp_processor_id()+1;
+	spin_unlock(&softirq_lock);
+
+	do{
+		spin_lock(&softirq_lock);
+		pending=softirq_pending;
+		softirq_pending=0;
+		spin_unlock(&softirq_lock);
+
+		asm("sti");
+		for (i=0;i<NR_SOFTIRQS;i++)
+			if ((pending & (1<<i)) && softirq_vec[i]!=NULL)
+				softirq_vec[i]();
+		asm("cli");
+	} while (softirq_pending && --restart);
+
+	softirq_active=0;
+	local_irq_restore(flags);
+}
+
+void irq_exit(){
+	if (softirq_pending)
+		do_softirq();
+}
+
+void tasklet_init(tasklet* t,void (*func)(u32),u32 data){
+	t->next=NULL;
+	t->func=func;
+	t->data=data;
+	t->state=0;
+}
+
+void tasklet_schedule(tasklet* t){
+	u32 flags=spin_lock_irqsave(&softirq_lock);
+	if (!(t->state & TASKLET_SCHED)){
+		t->state|=TASKLET_SCHED;
+		t->next=NULL;
+		*tasklet_tail=t;
+		tasklet_tail=&t->next;
+		spin_unlock_irqrestore(&softirq_lock,flags);
+		raise_softirq(SOFTIRQ_TASKLET);
+		return;
+	}
+	spin_unlock_irqrestore(&softirq_lock,flags);
+}
@@ -0,0 +1,47 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <runtime/types.h>
+
+/*
+ *	Bottom halves : travail differe demande par un handler d'IRQ et
+ *	execute en sortie d'interruption, interruptions actives.
+ *	Un softirq n'est jamais preempte par le scheduler et ne doit pas
+ *	bloquer.
+ */
+
+enum{
+	SOFTIRQ_TIMER=0,
+	SOFTIRQ_BLOCK=1,
+	SOFTIRQ_NET=2,
+	SOFTIRQ_SERIAL=3,
+	SOFTIRQ_TASKLET=4,
+	NR_SOFTIRQS=8
+};
+
+#define SOFTIRQ_RESTART		10		/* passes max. par sortie d'IRQ */
+
+typedef void (*softirq_handler)(void);
+
+/* Tache differee executee par SOFTIRQ_TASKLET, jamais en parallele avec elle-meme */
+struct tasklet {
+	tasklet*	next;
+	void		(*func)(u32 data);
+	u32			data;
+	u32			state;
+};
+
+#define TASKLET_SCHED		0x1		/* dans la liste des tasklets a executer */
+
+
+void	init_softirq();
+void	open_softirq(u32 nr,softirq_handler h);		/* install the handler of a softirq */
+void	raise_softirq(u32 nr);						/* mark a softirq pending */
+void	do_softirq();								/* run the pending softirqs */
+void	irq_exit();									/* end of a hard irq */
+int		in_softirq();								/* inside do_softirq ? */
+
+void	tasklet_init(tasklet* t,void (*func)(u32),u32 data);
+void	tasklet_schedule(tasklet* t);
+
+#endif
@@ -21,18 +21,34 @@ void Syscalls::init(){
 	sysc(SYS_symlink,	&call_symlink);
 	sysc(SYS_getdents,	&call_getdents);
 	sysc(SYS_wait4,		&call_wait);
+	sysc(SYS_kill,		&call_kill);
 	sysc(SYS_dup2,		&call_dup2);
 	sysc(SYS_fork,		&call_fork);
 	sysc(SYS_chdir,		&call_chdir);
 	sysc(SYS_mmap,		&call_mmap);
+	sysc(SYS_getpid,	&call_getpid);
+	sysc(SYS_spawn,		&call_spawn);
+	sysc(SYS_futex,		&call_futex);
+	sysc(SYS_create_semaphore,	&call_create_semaphore);
+	sysc(SYS_delete_semaphore,	&call_delete_semaphore);
+	sysc(SYS_lock_semaphore,	&call_lock_semaphore);
+	sysc(SYS_unlock_semaphore,	&call_unlock_semaphore);
+	sysc(SYS_ipc_send,		&call_ipc_send);
+	sysc(SYS_ipc_receive,	&call_ipc_receive);
+	sysc(SYS_ipc_call,		&call_ipc_call);
+	sysc(SYS_ipc_reply,		&call_ipc_reply);
+	sysc(SYS_sync,			&call_sync);
+	sysc(SYS_fsync,			&call_fsync);
+	sysc(SYS_lseek,			&call_lseek);
 }
 
 
 void Syscalls::add(u32 num,syscall_handler h){
-	calls[num]=h;
+	if (num<NB_SYSCALLS)
+		calls[num]=h;
 }
 
 void Syscalls::call(u32 num){
-	if (calls[num]!=NULL)
+	if (num<NB_SYSCALLS && calls[num]!=NULL)
 		calls[num]();
 }
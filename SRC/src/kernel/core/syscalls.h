@@ -6,7 +6,7 @@
 #include <runtime/list.h>
 
 
-#define NB_SYSCALLS	100
+#define NB_SYSCALLS	128
 
 
 typedef void (*syscall_handler)(void);
@@ -44,6 +44,13 @@ void System::init(){
 	new Variable("PROCESSOR_NAME",arch.detect());
 	new Variable("PATH","/bin/");
 	new Variable("SHELL","/bin/sh");
+	
+	/** Kernel traces **/
+	new Trace("trace");
+	new Profile("profile");
+	
+	/** Disk block cache **/
+	new BCache("bcache");
 }
 
 //fonction de login
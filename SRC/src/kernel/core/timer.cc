@@ -0,0 +1,65 @@
+#include <os.h>
+
+/* Timers du noyau (voir timer.h) */
+
+static LIST_HEAD(timer_list);
+static spinlock_t		timer_lock=SPINLOCK_INIT;	/* pris aussi pendant les fonctions */
+
+/* Call the expired timers, the lock is kept so del_timer waits for them */
+static void run_timers(){
+	ktimer* t;
+	list_head *p, *n;
+	u32 now=arch.getTicks();
+	u32 flags=spin_lock_irqsave(&timer_lock);
+	
+	list_for_each_safe(p,n,&timer_list){
+		t=list_entry(p,ktimer,list);
+		if ((s32)(now-t->expires)<0)
+			continue;
+		list_del(&t->list);
+		t->pending=0;
+		t->func(t->data);
+	}
+	spin_unlock_irqrestore(&timer_lock,flags);
+}
+
+void init_timers(){
+	open_softirq(SOFTIRQ_TIMER,run_timers);
+}
+
+void timer_init(ktimer* t,void (*func)(u32),u32 data){
+	t->func=func;
+	t->data=data;
+	t->pending=0;
+}
+
+void add_timer(ktimer* t,u32 expires){
+	u32 flags=spin_lock_irqsave(&timer_lock);
+	if (t->pending)
+		list_del(&t->list);
+	t->expires=expires;
+	list_add(&t->list,&timer_list);
+	t->pending=1;
+	spin_unlock_irqrestore(&timer_lock,flags);
+}
+
+int del_timer(ktimer* t){
+	int ret;
+	u32 flags=spin_lock_irqsave(&timer_lock);
+	ret=t->pending;
+	if (t->pending)
+		list_del(&t->list);
+	t->pending=0;
+	spin_unlock_irqrestore(&timer_lock,flags);
+	return ret;
+}
+
+void timer_tick(){
+	if (!list_empty(&timer_list))
+		raise_softirq(SOFTIRQ_TIMER);
+}
+
+/* Rounded up, at least one tick */
+u32 ms_to_ticks(u32 ms){
+	return (ms*HZ+999)/1000+1;
+}
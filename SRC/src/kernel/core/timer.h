@@ -0,0 +1,29 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <runtime/types.h>
+#include <runtime/list.h>
+
+/*
+ *	Timers du noyau en ticks de l'horloge systeme (arch.getTicks(), HZ
+ *	par seconde). Les fonctions expirees sont appelees par le softirq
+ *	SOFTIRQ_TIMER : elles ne dorment pas et ne touchent pas aux timers.
+ *	Quand del_timer() retourne, la fonction du timer ne s'execute plus.
+ */
+
+struct ktimer {
+	list_head	list;
+	u32			expires;	/* tick d'expiration */
+	void		(*func)(u32 data);
+	u32			data;
+	u32			pending;	/* dans la liste des timers */
+};
+
+void	init_timers();
+void	timer_init(ktimer* t,void (*func)(u32),u32 data);
+void	add_timer(ktimer* t,u32 expires);
+int		del_timer(ktimer* t);		/* 1 if the timer was pending */
+void	timer_tick();				/* system clock tick (BSP, hard irq) */
+u32		ms_to_ticks(u32 ms);
+
+#endif
@@ -0,0 +1,179 @@
+#include <os.h>
+
+/*
+ *	Anneau de traces : les ecrivains reservent une entree avec trace_head
+ *	(lock xadd) et la publient en ecrivant seq en dernier. Les anciennes
+ *	entrees sont ecrasees sans attendre le lecteur, qui detecte la perte
+ *	avec seq.
+ */
+
+volatile u32			trace_mask=0;
+
+static trace_event		trace_buf[TRACE_SIZE];
+static volatile u32		trace_head=0;		/* prochain evenement a ecrire */
+static u32				trace_tail=0;		/* prochain evenement a lire */
+static u32				trace_lost=0;
+static spinlock_t		trace_lock=SPINLOCK_INIT;	/* lecteurs */
+
+void trace_write(u32 type,u32 a,u32 b,u32 c){
+	u32 seq=atomic_xadd(&trace_head,1);
+	trace_event* e=&trace_buf[seq & (TRACE_SIZE-1)];
+	Process* p=arch.pcurrent;
+	
+	e->seq=0;		//entree en cours d'ecriture
+	asmv("" ::: "memory");
+	e->type=type;
+	e->cpu=smp_processor_id();
+	e->tsc=arch.getCycles();
+	e->pid=(p!=NULL) ? p->getPid() : 0;
+	e->arg[0]=a;
+	e->arg[1]=b;
+	e->arg[2]=c;
+	asmv("" ::: "memory");
+	e->seq=seq+1;
+}
+
+/* Copie au plus n evenements publies a partir de trace_tail (trace_lock pris) */
+static u32 trace_consume(trace_event* out,u32 n){
+	u32 head=trace_head;
+	u32 done=0;
+	trace_event* e;
+	
+	if (head-trace_tail > TRACE_SIZE){
+		trace_lost+=head-trace_tail-TRACE_SIZE;
+		trace_tail=head-TRACE_SIZE;
+	}
+	while (done<n && trace_tail!=head){
+		e=&trace_buf[trace_tail & (TRACE_SIZE-1)];
+		if (e->seq!=trace_tail+1){
+			if (e->seq==0 || e->seq<trace_tail+1)
+				break;			//pas encore publie
+			trace_lost++;		//deja ecrase
+			trace_tail++;
+			continue;
+		}
+		memcpy((char*)&out[done],(char*)e,sizeof(trace_event));
+		asmv("" ::: "memory");
+		if (e->seq!=trace_tail+1){	//ecrase pendant la copie
+			trace_lost++;
+			trace_tail++;
+			continue;
+		}
+		done++;
+		trace_tail++;
+	}
+	return done;
+}
+
+/* Vide l'anneau sur le port serie, utilisable depuis un chemin d'erreur */
+void trace_dump(){
+	trace_event ev[16];
+	File* serial=fsm.path("/dev/ttyS");
+	u32 n,flags;
+	
+	if (serial==NULL)
+		return;
+	serial->open(0);
+	for (;;){
+		flags=spin_lock_irqsave(&trace_lock);
+		n=trace_consume(ev,16);
+		spin_unlock_irqrestore(&trace_lock,flags);
+		if (n==0)
+			break;
+		serial->write(0,(u8*)ev,n*sizeof(trace_event));	//interruptions actives
+	}
+}
+
+
+Trace::~Trace(){
+	
+}
+
+Trace::Trace(char* n) : File(n,TYPE_FILE)
+{
+	fsm.addFile("/sys/",this);
+}
+
+u32	Trace::open(u32 flag){
+	return RETURN_OK;
+}
+
+u32	Trace::close(){
+	return RETURN_OK;
+}
+
+/* Flux binaire de trace_event, chaque lecture consomme les evenements lus */
+u32	Trace::read(u32 pos,u8* buffer,u32 size){
+	trace_event* out;
+	u32 n=size/sizeof(trace_event);
+	u32 flags;
+	
+	if (buffer==NULL)
+		return ERROR_PARAM;
+	if (n>TRACE_SIZE)
+		n=TRACE_SIZE;
+	if (n==0)
+		return 0;
+	//le buffer utilisateur peut fauter : copie apres le lock
+	out=(trace_event*)kmalloc(n*sizeof(trace_event));
+	if (out==NULL)
+		return ERROR_MEMORY;
+	flags=spin_lock_irqsave(&trace_lock);
+	n=trace_consume(out,n);
+	spin_unlock_irqrestore(&trace_lock,flags);
+	memcpy((char*)buffer,(char*)out,n*sizeof(trace_event));
+	kfree(out);
+	return n*sizeof(trace_event);
+}
+
+u32	Trace::write(u32 pos,u8* buffer,u32 size){
+	return NOT_DEFINED;
+}
+
+u32	Trace::ioctl(u32 id,u8* buffer){
+	trace_info* info;
+	u32 flags;
+	
+	switch (id){
+		case API_TRACE_SET_MASK:
+			if (buffer==NULL)
+				return ERROR_PARAM;
+			trace_mask=*((u32*)buffer) & TRACE_ALL;
+			return RETURN_OK;
+			
+		case API_TRACE_GET_INFO:
+			if (buffer==NULL)
+				return ERROR_PARAM;
+			info=(trace_info*)buffer;
+			info->mask=trace_mask;
+			info->size=TRACE_SIZE;
+			info->head=trace_head;
+			info->tail=trace_tail;
+			info->lost=trace_lost;
+			info->cpu_khz=arch.getCyclesKhz();
+			return RETURN_OK;
+			
+		case API_TRACE_CLEAR:
+			flags=spin_lock_irqsave(&trace_lock);
+			trace_tail=trace_head;
+			trace_lost=0;
+			spin_unlock_irqrestore(&trace_lock,flags);
+			return RETURN_OK;
+			
+		case API_TRACE_DUMP:
+			trace_dump();
+			return RETURN_OK;
+			
+		default:
+			return NOT_DEFINED;
+	}
+}
+
+u32	Trace::remove(){
+	delete this;
+	return RETURN_OK;
+}
+
+void Trace::scan(){
+
+}
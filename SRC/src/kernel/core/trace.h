@@ -0,0 +1,43 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <runtime/types.h>
+#include <core/file.h>
+#include <api/dev/trace.h>
+
+/*
+ *	Points de trace statiques : un test du masque quand l'evenement est
+ *	desactive, sinon une entree reservee sans verrou (lock xadd) dans un
+ *	anneau global, horodatee avec rdtsc. Utilisable en contexte IRQ.
+ */
+
+#define TRACE_SIZE		4096		/* evenements, puissance de 2 */
+
+extern volatile u32	trace_mask;
+
+#define trace(type,a,b,c)	do { \
+		if (trace_mask & (1 << (type))) \
+			trace_write((type),(u32)(a),(u32)(b),(u32)(c)); \
+	} while (0)
+
+void	trace_write(u32 type,u32 a,u32 b,u32 c);
+void	trace_dump();			/* vide l'anneau sur le port serie */
+
+
+/* /sys/trace : lecture consommatrice de l'anneau */
+class Trace : public File
+{
+	public:
+		Trace(char* n);
+		~Trace();
+		
+		u32		open(u32 flag);
+		u32		close();
+		u32		read(u32 pos,u8* buffer,u32 size);
+		u32		write(u32 pos,u8* buffer,u32 size);
+		u32		ioctl(u32 id,u8* buffer);
+		u32		remove();
+		void	scan();
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include <os.h>
+
+/* Files d'attente (voir waitqueue.h) */
+
+WaitQueue::WaitQueue(){
+	spin_lock_init(&lock);
+	head=NULL;
+}
+
+/* Remove p from the queue (lock held) */
+void WaitQueue::remove(Process* p){
+	Process** pp=&head;
+	while (*pp!=NULL && *pp!=p)
+		pp=(*pp)->getPWaitRef();
+	if (*pp!=NULL)
+		*pp=p->getPWait();
+	p->setPWait(NULL);
+}
+
+void WaitQueue::prepare(){
+	Process* p=arch.pcurrent;
+	u32 flags=spin_lock_irqsave(&lock);
+	remove(p);
+	p->setPWait(head);
+	head=p;
+	p->setState(PROC_STATE_SLEEP);
+	spin_unlock_irqrestore(&lock,flags);
+}
+
+void WaitQueue::finish(){
+	Process* p=arch.pcurrent;
+	u32 flags=spin_lock_irqsave(&lock);
+	remove(p);
+	if (p->getState()==PROC_STATE_SLEEP)
+		p->setState(PROC_STATE_RUN);
+	spin_unlock_irqrestore(&lock,flags);
+}
+
+void WaitQueue::sleep(){
+	prepare();
+	arch.yield();
+	finish();
+}
+
+/* Can be called from any context, including the hard irqs */
+void WaitQueue::wakeUp(){
+	Process* p;
+	u32 flags=spin_lock_irqsave(&lock);
+	while (head!=NULL){
+		p=head;
+		head=p->getPWait();
+		p->setPWait(NULL);
+		if (p->getState()==PROC_STATE_SLEEP)
+			p->setState(PROC_STATE_RUN);
+	}
+	spin_unlock_irqrestore(&lock,flags);
+}
+
+u32 WaitQueue::isEmpty(){
+	return head==NULL;
+}
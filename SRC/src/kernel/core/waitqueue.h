@@ -0,0 +1,45 @@
+#ifndef WAITQUEUE_H
+#define WAITQUEUE_H
+
+#include <runtime/types.h>
+#include <spinlock.h>
+
+class Process;
+
+/*
+ *	File d'attente de processus endormis (PROC_STATE_SLEEP) sur un
+ *	evenement. Un processus n'attend que sur une file a la fois.
+ *
+ *	L'attente d'une condition se fait avec wait_event() : le processus
+ *	s'inscrit avant de tester la condition, un wakeUp() arrivant entre le
+ *	test et le yield n'est donc pas perdu.
+ */
+class WaitQueue
+{
+	public:
+		WaitQueue();
+		
+		void	prepare();		/* enqueue the current process, state SLEEP */
+		void	finish();		/* dequeue the current process, state RUN */
+		void	sleep();		/* sleep until the next wakeUp */
+		void	wakeUp();		/* wake up all the waiting processes */
+		u32		isEmpty();
+		
+	private:
+		spinlock_t	lock;
+		Process*	head;
+		
+		void	remove(Process* p);
+};
+
+#define wait_event(wq,cond)	do{				\
+		for (;;){							\
+			(wq).prepare();					\
+			if (cond)						\
+				break;						\
+			arch.yield();					\
+		}									\
+		(wq).finish();						\
+	} while (0)
+
+#endif
@@ -0,0 +1,104 @@
+#include <os.h>
+
+/* Files de travaux des threads noyau (voir workqueue.h) */
+
+static workqueue	kworker_wq={NULL,&kworker_wq.head,SPINLOCK_INIT,NULL,"kworker",NULL};
+static workqueue*	wq_pending=&kworker_wq;		/* files sans thread */
+static u32			wq_started=0;
+static spinlock_t	wq_lock=SPINLOCK_INIT;		/* wq_pending et wq_started */
+
+void init_work(work* w,work_func func,void* data){
+	w->next=NULL;
+	w->func=func;
+	w->data=data;
+	w->pending=0;
+}
+
+int queue_work_on(workqueue* wq,work* w){
+	u32 flags=spin_lock_irqsave(&wq->lock);
+	if (w->pending){
+		spin_unlock_irqrestore(&wq->lock,flags);
+		return 0;
+	}
+	w->pending=1;
+	w->next=NULL;
+	*wq->tail=w;
+	wq->tail=&w->next;
+	spin_unlock_irqrestore(&wq->lock,flags);
+	
+	if (wq->wait!=NULL)
+		wq->wait->wakeUp();
+	return 1;
+}
+
+int queue_work(work* w){
+	return queue_work_on(&kworker_wq,w);
+}
+
+/* Take the whole list, the works are run without the lock */
+static work* dequeue_works(workqueue* wq){
+	work* w;
+	u32 flags=spin_lock_irqsave(&wq->lock);
+	w=wq->head;
+	wq->head=NULL;
+	wq->tail=&wq->head;
+	spin_unlock_irqrestore(&wq->lock,flags);
+	return w;
+}
+
+static void worker(void* data){
+	workqueue* wq=(workqueue*)data;
+	work* w;
+	work* next;
+	for (;;){
+		wait_event(*wq->wait,wq->head!=NULL);
+		w=dequeue_works(wq);
+		while (w!=NULL){
+			next=w->next;
+			w->pending=0;		//can be queued again by its func
+			w->func(w->data);
+			w=next;
+		}
+	}
+}
+
+/* The works queued before the thread stay in the queue until it starts */
+workqueue* create_workqueue(char* name){
+	workqueue* wq=(workqueue*)kmalloc(sizeof(workqueue));
+	u32 flags,start;
+	
+	if (wq==NULL)
+		return NULL;
+	wq->head=NULL;
+	wq->tail=&wq->head;
+	spin_lock_init(&wq->lock);
+	wq->wait=new WaitQueue();
+	wq->name=name;
+	
+	flags=spin_lock_irqsave(&wq_lock);
+	start=wq_started;
+	if (!start){
+		wq->next=wq_pending;
+		wq_pending=wq;
+	}
+	spin_unlock_irqrestore(&wq_lock,flags);
+	if (start)
+		kthread_create(name,worker,wq);
+	return wq;
+}
+
+/* After initProc: the threads of the queues created meanwhile start too */
+void init_workqueue(){
+	workqueue* wq;
+	u32 flags;
+	
+	if (kworker_wq.wait==NULL)
+		kworker_wq.wait=new WaitQueue();
+	flags=spin_lock_irqsave(&wq_lock);
+	wq=wq_pending;
+	wq_pending=NULL;
+	wq_started=1;
+	spin_unlock_irqrestore(&wq_lock,flags);
+	for (;wq!=NULL;wq=wq->next)
+		kthread_create(wq->name,worker,wq);
+}
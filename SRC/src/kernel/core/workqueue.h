@@ -0,0 +1,43 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <runtime/types.h>
+#include <spinlock.h>
+
+/*
+ *	Travail differe execute par un thread noyau, dans un contexte qui
+ *	peut dormir. queue_work() utilise la file commune "kworker" ; un
+ *	pilote dont les travaux ne doivent pas attendre derriere les autres
+ *	(reprise d'un port dont les E/S de kworker dependent) cree sa propre
+ *	file avec create_workqueue(). queue_work() et queue_work_on() peuvent
+ *	etre appeles depuis n'importe quel contexte (IRQ, softirq, appel
+ *	systeme).
+ */
+
+class WaitQueue;
+
+typedef void (*work_func)(void* data);
+
+struct work {
+	work*		next;
+	work_func	func;
+	void*		data;
+	u32			pending;	/* deja dans une file */
+};
+
+struct workqueue {
+	work*		head;
+	work**		tail;
+	spinlock_t	lock;
+	WaitQueue*	wait;
+	char*		name;		/* nom du thread */
+	workqueue*	next;		/* files a demarrer par init_workqueue() */
+};
+
+void		init_work(work* w,work_func func,void* data);
+int			queue_work(work* w);	/* on kworker, 0 if the work was already queued */
+int			queue_work_on(workqueue* wq,work* w);
+workqueue*	create_workqueue(char* name);	/* its thread starts with init_workqueue() at the latest */
+void		init_workqueue();		/* start the kworker thread and the queues created before */
+
+#endif
@@ -0,0 +1,754 @@
+
+#include <os.h>
+#include <apic.h>
+#include <ahci.h>
+
+#include <api/dev/ioctl.h>
+
+/*
+ *	Controleur SATA AHCI : chaque port avec un disque a sa file de
+ *	requetes (core/blkqueue.h). Un disque NCQ recoit jusqu'a 32 commandes
+ *	READ/WRITE FPDMA QUEUED a la fois, une par emplacement de la liste de
+ *	commandes ; les autres recoivent des READ/WRITE DMA une par une.
+ *	L'IRQ (ligne INTx du BIOS, MSI quand l'IOAPIC est actif, voir
+ *	pci_install_irq) termine les emplacements dont le bit de PxSACT / PxCI
+ *	est retombe.
+ *
+ *	Memoire d'un port : une page pour la liste de commandes (1 Ko), les
+ *	FIS recus (256 octets) et la reponse a IDENTIFY, puis une page par
+ *	emplacement pour la table de commande et sa PRDT.
+ *
+ *	Avant que les interruptions soient actives la file appelle
+ *	ahci_poll() qui lit les memes registres.
+ */
+static char*		ahci_abar = NULL;
+static pci_dev*		ahci_pdev = NULL;
+static u32			ahci_cap = 0;
+static u32			ahci_probed = 0;
+
+static ahci_port*	ahci_disks[AHCI_MAX_PORTS];	/* ports avec un disque, dans l'ordre */
+static u32			ahci_ndisks = 0;
+static workqueue*	ahci_wq = NULL;		/* reprise des ports, hors de kworker */
+
+static inline u32 hba_read(u32 reg)
+{
+	return *(volatile u32*) (ahci_abar + reg);
+}
+
+static inline void hba_write(u32 reg, u32 v)
+{
+	*(volatile u32*) (ahci_abar + reg) = v;
+}
+
+static inline u32 px_read(ahci_port* p, u32 reg)
+{
+	return *(volatile u32*) (p->regs + reg);
+}
+
+static inline void px_write(ahci_port* p, u32 reg, u32 v)
+{
+	*(volatile u32*) (p->regs + reg) = v;
+}
+
+/* Attend que (registre & mask) == value, AHCI_TIMEOUT_MS au plus */
+static int ahci_wait(char* reg, u32 mask, u32 value)
+{
+	u32 n;
+
+	for (n = 0; n < AHCI_TIMEOUT_MS; n++) {
+		if ((*(volatile u32*) reg & mask) == value)
+			return RETURN_OK;
+		udelay(1000);
+	}
+	return NOT_DEFINED;
+}
+
+/* Arrete le moteur de commandes puis la reception des FIS */
+static int ahci_port_stop(ahci_port* p)
+{
+	px_write(p, PX_CMD, px_read(p, PX_CMD) & ~PX_CMD_ST);
+	if (ahci_wait(p->regs + PX_CMD, PX_CMD_CR, 0) != RETURN_OK)
+		return NOT_DEFINED;
+	px_write(p, PX_CMD, px_read(p, PX_CMD) & ~PX_CMD_FRE);
+	return ahci_wait(p->regs + PX_CMD, PX_CMD_FR, 0);
+}
+
+static int ahci_port_start(ahci_port* p)
+{
+	if (ahci_wait(p->regs + PX_TFD, ATA_SR_BSY | ATA_SR_DRQ, 0) != RETURN_OK)
+		return NOT_DEFINED;
+	px_write(p, PX_CMD, px_read(p, PX_CMD) | PX_CMD_FRE);
+	px_write(p, PX_CMD, px_read(p, PX_CMD) | PX_CMD_ST);
+	return RETURN_OK;
+}
+
+/*
+ *	Ajoute un buffer du noyau a une PRDT : une entree par page, les pages
+ *	voisines en memoire physique sont fusionnees.
+ */
+static int ahci_add_prd(ahci_prd* prdt, u32* nprd, char* buf, u32 len)
+{
+	u32 n = *nprd, chunk, phys;
+
+	if ((u32) buf & 1)
+		return ERROR_PARAM;
+	while (len > 0) {
+		chunk = PAGESIZE - ((u32) buf & (PAGESIZE - 1));
+		if (chunk > len)
+			chunk = len;
+		phys = (u32) get_p_addr(buf);
+		if (phys == 0)
+			return ERROR_PARAM;
+		if (n > 0 && prdt[n - 1].dba + prdt[n - 1].dbc + 1 == phys
+			&& prdt[n - 1].dbc + 1 + chunk <= PRD_DBC_MAX)
+			prdt[n - 1].dbc += chunk;
+		else {
+			if (n == AHCI_PRD_MAX)
+				return ERROR_PARAM;
+			prdt[n].dba = phys;
+			prdt[n].dbau = 0;
+			prdt[n].rsv = 0;
+			prdt[n].dbc = chunk - 1;
+			n++;
+		}
+		buf += chunk;
+		len -= chunk;
+	}
+	*nprd = n;
+	return RETURN_OK;
+}
+
+/* FIS d'une commande ATA sur 48 bits (le noyau adresse en 32 bits) */
+static void ahci_set_fis(ahci_cmd_table* t, u8 cmd, u32 lba, u32 count)
+{
+	fis_reg_h2d* fis = (fis_reg_h2d*) t->cfis;
+
+	memset((char*) fis, 0, sizeof(fis_reg_h2d));
+	fis->type = FIS_TYPE_REG_H2D;
+	fis->flags = FIS_H2D_COMMAND;
+	fis->command = cmd;
+	fis->device = 0x40;		/* LBA */
+	fis->lba0 = lba;
+	fis->lba1 = lba >> 8;
+	fis->lba2 = lba >> 16;
+	fis->lba3 = lba >> 24;
+	fis->countl = count;
+	fis->counth = count >> 8;
+}
+
+/*
+ *	Prepare la commande de r dans l'emplacement slot (verrou du port pris).
+ *	En NCQ le nombre de secteurs passe dans les registres feature et le
+ *	compteur porte le numero d'emplacement.
+ */
+static int ahci_build(ahci_port* p, u32 slot, blk_request* r)
+{
+	ahci_cmd_header* h = &p->clb[slot];
+	ahci_cmd_table* t = p->tables[slot];
+	ahci_prd* prdt = (ahci_prd*) ((char*) t + sizeof(ahci_cmd_table));
+	fis_reg_h2d* fis = (fis_reg_h2d*) t->cfis;
+	int write = (r->dir == BLK_WRITE);
+	blk_request* s;
+	u32 nprd = 0;
+
+	if (r->dir == BLK_FLUSH) {
+		ahci_set_fis(t, p->lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE, 0, 0);
+		fis->device = 0;
+	}
+	else {
+		for (s = r; s != NULL; s = s->merged)
+			if (ahci_add_prd(prdt, &nprd, s->buf, s->count * AHCI_SECTOR_SIZE) != RETURN_OK)
+				return ERROR_PARAM;
+		if (p->ncq) {
+			ahci_set_fis(t, write ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA, r->sector, slot << 3);
+			fis->featurel = r->total;
+			fis->featureh = r->total >> 8;
+		}
+		else if (p->lba48)
+			ahci_set_fis(t, write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT, r->sector, r->total);
+		else {
+			ahci_set_fis(t, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA, r->sector, r->total);
+			fis->device = 0x40 | ((r->sector >> 24) & 0x0F);
+			fis->lba3 = 0;
+		}
+	}
+
+	h->flags = CMD_HDR_CFL(fis_reg_h2d) | (write ? CMD_HDR_WRITE : 0);
+	h->prdtl = nprd;
+	h->prdbc = 0;
+	h->ctba = p->tables_phys[slot];
+	h->ctbau = 0;
+	return RETURN_OK;
+}
+
+/* Lance la requete r dans un emplacement libre du port */
+static void ahci_start(BlkQueue* q, blk_request* r)
+{
+	ahci_port* p = (ahci_port*) q->getData();
+	u32 slot, flags;
+	int ret;
+
+	flags = spin_lock_irqsave(&p->lock);
+	if (p->recovering == AHCI_RECOVER_PENDING || p->recovering == AHCI_RECOVER_RUNNING) {
+		//lancee a la fin de la reprise
+		p->held[p->nheld++] = r;
+		spin_unlock_irqrestore(&p->lock, flags);
+		return;
+	}
+	for (slot = 0; slot < p->depth; slot++)
+		if (!(p->issued & (1 << slot)))
+			break;
+	if (p->recovering == AHCI_RECOVER_FAILED)
+		ret = NOT_DEFINED;
+	else
+		ret = (slot < p->depth) ? ahci_build(p, slot, r) : ERROR_PARAM;
+	if (ret == RETURN_OK) {
+		p->slots[slot] = r;
+		p->issued |= 1 << slot;
+		if (p->ncq && r->dir != BLK_FLUSH)
+			px_write(p, PX_SACT, 1 << slot);
+		px_write(p, PX_CI, 1 << slot);
+	}
+	spin_unlock_irqrestore(&p->lock, flags);
+
+	if (ret != RETURN_OK)
+		q->complete(r, ret);
+}
+
+/*
+ *	Fin de commandes d'un port (IRQ ou ahci_poll) : les emplacements dont
+ *	le bit est retombe dans PxSACT et PxCI sont termines. Sur une erreur
+ *	toutes les commandes en cours echouent et le moteur est arrete ; le
+ *	redemarrage attend le port, il est fait par le thread "ahci"
+ *	(ahci_port_recover) : sur kworker il attendrait derriere les E/S de
+ *	l'ecriture differee et de la lecture en avance qu'il debloque.
+ */
+static void ahci_port_intr(ahci_port* p)
+{
+	blk_request* done[AHCI_MAX_SLOTS];
+	u32 is, busy, finished, slot, n = 0, flags, recover = 0;
+	int status = RETURN_OK;
+
+	flags = spin_lock_irqsave(&p->lock);
+	is = px_read(p, PX_IS);
+	px_write(p, PX_IS, is);
+	hba_write(HBA_IS, 1 << p->num);
+
+	if (is & PX_IS_ERROR) {
+		status = NOT_DEFINED;
+		p->errors++;
+		finished = p->issued;
+		px_write(p, PX_CMD, px_read(p, PX_CMD) & ~PX_CMD_ST);
+		if (p->recovering == AHCI_RECOVER_NONE) {
+			p->recovering = AHCI_RECOVER_PENDING;
+			recover = 1;
+		}
+	}
+	else {
+		busy = px_read(p, PX_SACT) | px_read(p, PX_CI);
+		finished = p->issued & ~busy;
+	}
+
+	for (slot = 0; slot < p->depth; slot++)
+		if (finished & (1 << slot)) {
+			done[n++] = p->slots[slot];
+			p->slots[slot] = NULL;
+		}
+	p->issued &= ~finished;
+	spin_unlock_irqrestore(&p->lock, flags);
+
+	if (recover)
+		queue_work_on(ahci_wq, &p->recover);
+	for (slot = 0; slot < n; slot++)
+		p->queue->complete(done[slot], status);
+}
+
+/*
+ *	Redemarre un port arrete par une erreur (thread "ahci", ou ahci_poll
+ *	quand il ne peut pas tourner) puis lance les requetes mises de cote.
+ */
+static void ahci_port_recover(ahci_port* p)
+{
+	blk_request* held[AHCI_MAX_SLOTS];
+	u32 n, i, flags;
+	int ret;
+
+	flags = spin_lock_irqsave(&p->lock);
+	if (p->recovering != AHCI_RECOVER_PENDING) {
+		spin_unlock_irqrestore(&p->lock, flags);
+		return;
+	}
+	p->recovering = AHCI_RECOVER_RUNNING;
+	spin_unlock_irqrestore(&p->lock, flags);
+
+	ret = ahci_port_stop(p);
+	px_write(p, PX_SERR, 0xFFFFFFFF);
+	px_write(p, PX_IS, 0xFFFFFFFF);
+	if (ret == RETURN_OK)
+		ret = ahci_port_start(p);
+	if (ret != RETURN_OK)
+		io.print("ahci: port %d does not restart \n", p->num);
+
+	flags = spin_lock_irqsave(&p->lock);
+	n = p->nheld;
+	for (i = 0; i < n; i++)
+		held[i] = p->held[i];
+	p->nheld = 0;
+	p->recovering = (ret == RETURN_OK) ? AHCI_RECOVER_NONE : AHCI_RECOVER_FAILED;
+	spin_unlock_irqrestore(&p->lock, flags);
+
+	for (i = 0; i < n; i++)
+		ahci_start(p->queue, held[i]);
+}
+
+static void ahci_recover_work(void* data)
+{
+	ahci_port_recover((ahci_port*) data);
+}
+
+static void ahci_irq(u32 irq, void* data)
+{
+	u32 is, i;
+
+	if (ahci_abar == NULL)
+		return;
+	is = hba_read(HBA_IS);
+	for (i = 0; i < ahci_ndisks; i++)
+		if (is & (1 << ahci_disks[i]->num))
+			ahci_port_intr(ahci_disks[i]);
+}
+
+static void ahci_poll(BlkQueue* q)
+{
+	ahci_port* p = (ahci_port*) q->getData();
+
+	ahci_port_intr(p);
+	ahci_port_recover(p);
+}
+
+/*
+ *	Alimente et fait tourner le disque si le controleur le demande
+ *	(CAP.SSS) puis attend le lien : DET=3, AHCI_TIMEOUT_MS au plus, ou
+ *	AHCI_NODEV_MS si rien n'est branche.
+ */
+static int ahci_link_up(ahci_port* p)
+{
+	u32 n, det;
+
+	if (ahci_cap & HBA_CAP_SSS)
+		px_write(p, PX_CMD, px_read(p, PX_CMD) | PX_CMD_SUD | PX_CMD_POD);
+	for (n = 0; n < AHCI_TIMEOUT_MS; n++) {
+		det = PX_SSTS_DET(px_read(p, PX_SSTS));
+		if (det == SSTS_DET_PRESENT)
+			return RETURN_OK;
+		if (det == SSTS_DET_NONE && n >= AHCI_NODEV_MS)
+			break;
+		udelay(1000);
+	}
+	return NOT_DEFINED;
+}
+
+/* IDENTIFY DEVICE dans l'emplacement 0, par attente active */
+static int ahci_identify(ahci_port* p)
+{
+	ahci_prd* prdt = (ahci_prd*) ((char*) p->tables[0] + sizeof(ahci_cmd_table));
+	u16* id = (u16*) p->ident;
+	u32 nprd = 0, n;
+	int i;
+
+	ahci_set_fis(p->tables[0], ATA_CMD_IDENTIFY, 0, 0);
+	((fis_reg_h2d*) p->tables[0]->cfis)->device = 0;
+	ahci_add_prd(prdt, &nprd, p->ident, AHCI_SECTOR_SIZE);
+	p->clb[0].flags = CMD_HDR_CFL(fis_reg_h2d);
+	p->clb[0].prdtl = nprd;
+	p->clb[0].prdbc = 0;
+	p->clb[0].ctba = p->tables_phys[0];
+	p->clb[0].ctbau = 0;
+
+	px_write(p, PX_IS, 0xFFFFFFFF);
+	px_write(p, PX_CI, 1);
+	for (n = 0; n < AHCI_TIMEOUT_MS; n++) {
+		if (!(px_read(p, PX_CI) & 1) || (px_read(p, PX_IS) & PX_IS_TFES))
+			break;
+		udelay(1000);
+	}
+	if ((px_read(p, PX_CI) & 1) || (px_read(p, PX_IS) & PX_IS_TFES))
+		return NOT_DEFINED;
+	px_write(p, PX_IS, 0xFFFFFFFF);
+
+	p->lba48 = (id[ID_COMMAND_SET_2] & ID_CMD_LBA48) ? 1 : 0;
+	if (p->lba48) {
+		p->sectors = id[ID_LBA48_SECTORS] | ((u32) id[ID_LBA48_SECTORS + 1] << 16);
+		p->sectors_hi = id[ID_LBA48_SECTORS + 2] | ((u32) id[ID_LBA48_SECTORS + 3] << 16);
+	}
+	else
+		p->sectors = id[ID_LBA_SECTORS] | ((u32) id[ID_LBA_SECTORS + 1] << 16);
+	p->udma = (id[ID_FIELD_VALID] & ID_VALID_88) ? id[ID_UDMA] & 0x7F : 0;
+	if ((ahci_cap & HBA_CAP_SNCQ) && (id[ID_SATA_CAP] & ID_SATA_NCQ)) {
+		p->ncq = 1;
+		if (p->depth > (u32) (id[ID_QUEUE_DEPTH] & 0x1F) + 1)
+			p->depth = (id[ID_QUEUE_DEPTH] & 0x1F) + 1;
+	}
+	else
+		p->depth = 1;
+	for (i = 0; i < ID_MODEL_LEN / 2; i++) {
+		p->model[2 * i] = id[ID_MODEL + i] >> 8;
+		p->model[2 * i + 1] = id[ID_MODEL + i] & 0xFF;
+	}
+	for (i = ID_MODEL_LEN; i > 0 && (p->model[i - 1] == ' ' || p->model[i - 1] == 0); i--);
+	p->model[i] = 0;
+	return RETURN_OK;
+}
+
+static void ahci_port_free(ahci_port* p)
+{
+	u32 i;
+
+	for (i = 0; i < AHCI_MAX_SLOTS; i++)
+		if (p->tables[i] != NULL)
+			release_page_from_heap((char*) p->tables[i]);
+	if (p->clb != NULL)
+		release_page_from_heap((char*) p->clb);
+	kfree(p);
+}
+
+static char* ahci_alloc_page(u32* phys)
+{
+	page* pg = get_page_from_heap();
+	char* v;
+
+	if (pg == NULL)
+		return NULL;
+	v = pg->v_addr;
+	*phys = (u32) pg->p_addr;
+	kfree(pg);
+	memset(v, 0, PAGESIZE);
+	return v;
+}
+
+/*
+ *	Prepare le port num s'il porte un disque SATA : memoire, demarrage,
+ *	IDENTIFY puis file de requetes de la profondeur NCQ du disque.
+ */
+static ahci_port* ahci_port_init(u32 num)
+{
+	ahci_port* p;
+	u32 ssts, phys, i;
+
+	p = (ahci_port*) kmalloc(sizeof(ahci_port));
+	if (p == NULL)
+		return NULL;
+	memset((char*) p, 0, sizeof(ahci_port));
+	p->num = num;
+	p->regs = ahci_abar + HBA_PORT(num);
+	spin_lock_init(&p->lock);
+	init_work(&p->recover, ahci_recover_work, p);
+
+	if (ahci_link_up(p) != RETURN_OK) {
+		kfree(p);
+		return NULL;
+	}
+	ssts = px_read(p, PX_SSTS);
+	if (PX_SSTS_IPM(ssts) != SSTS_IPM_ACTIVE
+		|| ahci_port_stop(p) != RETURN_OK) {
+		kfree(p);
+		return NULL;
+	}
+
+	p->depth = HBA_CAP_NCS(ahci_cap);
+	p->clb = (ahci_cmd_header*) ahci_alloc_page(&phys);
+	if (p->clb == NULL) {
+		ahci_port_free(p);
+		return NULL;
+	}
+	p->fis = (char*) p->clb + 1024;
+	p->ident = (char*) p->clb + 2048;
+	px_write(p, PX_CLB, phys);
+	px_write(p, PX_CLBU, 0);
+	px_write(p, PX_FB, phys + 1024);
+	px_write(p, PX_FBU, 0);
+	for (i = 0; i < p->depth; i++) {
+		p->tables[i] = (ahci_cmd_table*) ahci_alloc_page(&p->tables_phys[i]);
+		if (p->tables[i] == NULL) {
+			ahci_port_free(p);
+			return NULL;
+		}
+	}
+
+	px_write(p, PX_SERR, 0xFFFFFFFF);
+	px_write(p, PX_IS, 0xFFFFFFFF);
+	if (ahci_port_start(p) != RETURN_OK || px_read(p, PX_SIG) != SATA_SIG_ATA
+		|| ahci_identify(p) != RETURN_OK) {
+		ahci_port_stop(p);
+		ahci_port_free(p);
+		return NULL;
+	}
+	for (i = p->depth; i < AHCI_MAX_SLOTS; i++)
+		if (p->tables[i] != NULL) {
+			release_page_from_heap((char*) p->tables[i]);
+			p->tables[i] = NULL;
+		}
+
+	p->queue = new BlkQueue(ahci_start, ahci_poll, p, AHCI_MAX_SECTORS, p->depth);
+	px_write(p, PX_IE, PX_IE_DEFAULT);
+	return p;
+}
+
+/* Cherche le controleur AHCI, le remet a zero et prepare ses ports */
+static void ahci_init()
+{
+	pci_dev* d;
+	u32 abar, pi, i, idx;
+	ahci_port* p;
+
+	ahci_probed = 1;
+	for (idx = 0; (d = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, idx)) != NULL; idx++)
+		if (d->prog_if == PCI_PROGIF_AHCI)
+			break;
+	if (d == NULL || pci_bar_is_io(d, AHCI_ABAR_BAR) || d->irq >= NR_IRQS)
+		return;
+	abar = pci_bar(d, AHCI_ABAR_BAR);
+	if (abar == 0)
+		return;
+	ahci_wq = create_workqueue("ahci");
+	if (ahci_wq == NULL)
+		return;
+
+	pci_set_command(d, PCI_COMMAND_MEMORY | PCI_COMMAND_MASTER);
+	ahci_abar = ioremap(abar, AHCI_ABAR_SIZE);
+	if (ahci_abar == NULL)
+		return;
+	ahci_pdev = d;
+
+	hba_write(HBA_GHC, hba_read(HBA_GHC) | HBA_GHC_AE);
+	hba_write(HBA_GHC, hba_read(HBA_GHC) | HBA_GHC_HR);
+	if (ahci_wait(ahci_abar + HBA_GHC, HBA_GHC_HR, 0) != RETURN_OK) {
+		io.print("ahci: controller reset failed \n");
+		iounmap(ahci_abar, AHCI_ABAR_SIZE);
+		ahci_abar = NULL;
+		return;
+	}
+	hba_write(HBA_GHC, hba_read(HBA_GHC) | HBA_GHC_AE);
+	ahci_cap = hba_read(HBA_CAP);
+
+	pi = hba_read(HBA_PI);
+	for (i = 0; i < AHCI_MAX_PORTS; i++)
+		if ((pi & (1 << i)) && (p = ahci_port_init(i)) != NULL)
+			ahci_disks[ahci_ndisks++] = p;
+
+	pci_install_irq(d, ahci_irq, NULL, NULL);
+	hba_write(HBA_IS, 0xFFFFFFFF);
+	hba_write(HBA_GHC, hba_read(HBA_GHC) | HBA_GHC_IE);
+	io.print("ahci: controller at %x, %d slots, %d disks, irq %d \n", abar,
+			HBA_CAP_NCS(ahci_cap), ahci_ndisks, d->irq);
+}
+
+
+/* flag : numero du disque parmi les ports occupes */
+File* ahci_mknod(char* name,u32 flag,File* dev){
+	ahci_port* p;
+	if (!ahci_probed)
+		ahci_init();
+	if (flag>=ahci_ndisks)
+		return NULL;
+	p=ahci_disks[flag];
+	io.print("ahci: %s %s, %d MB, port %d, %s %d \n",name,p->model,
+			(p->sectors>>11)|(p->sectors_hi<<21),p->num,
+			p->ncq ? "ncq" : "dma",p->depth);
+	Ahci* disk=new Ahci(name);
+	disk->setPort(p);
+	return disk;
+}
+
+module("module.ahci",MODULE_DEVICE,Ahci,ahci_mknod)
+
+Ahci::~Ahci(){
+
+}
+
+Ahci::Ahci(char* n) : Device(n)
+{
+	port=NULL;
+}
+
+void Ahci::setPort(ahci_port* p){
+	port=p;
+}
+
+u32	Ahci::open(u32 flag){
+	return RETURN_OK;
+}
+
+u32	Ahci::close(){
+	return RETURN_OK;
+}
+
+void Ahci::scan(){
+
+}
+
+/*
+ *	Decoupe le transfert en requetes de AHCI_MAX_SECTORS au plus, toutes
+ *	mises en file avant d'attendre : un disque NCQ les recoit ensemble.
+ */
+int Ahci::rw(u32 sector,u32 count,char* buf,u32 dir){
+	blk_request* reqs;
+	u32 n,i,c;
+	int ret=RETURN_OK,st;
+
+	if (port->sectors_hi==0 && (sector>=port->sectors || count>port->sectors-sector))
+		return ERROR_PARAM;
+	n=(count+AHCI_MAX_SECTORS-1)/AHCI_MAX_SECTORS;
+	reqs=new blk_request[n];
+	if (reqs==NULL)
+		return ERROR_MEMORY;
+	port->queue->plug();
+	for (i=0;i<n;i++){
+		c=(count>AHCI_MAX_SECTORS) ? AHCI_MAX_SECTORS : count;
+		reqs[i].drive=port->num;
+		reqs[i].sector=sector;
+		reqs[i].count=c;
+		reqs[i].buf=buf;
+		reqs[i].dir=dir;
+		port->queue->queue(&reqs[i]);
+		sector+=c;
+		count-=c;
+		buf+=c*AHCI_SECTOR_SIZE;
+	}
+	port->queue->unplug();
+	for (i=0;i<n;i++){
+		st=port->queue->wait(&reqs[i]);
+		if (st!=RETURN_OK)
+			ret=st;
+	}
+	delete[] reqs;
+	return ret;
+}
+
+/*
+ *	Les secteurs entiers d'un buffer du noyau sont transferes directement,
+ *	sinon par un buffer du noyau aligne : l'IRQ de fin peut arriver dans
+ *	un autre espace d'adressage. Une ecriture partielle relit ses
+ *	secteurs de bord.
+ */
+u32	Ahci::transfer(u32 pos,u8* buffer,u32 size,u32 dir){
+	u32 first,n,off;
+	char* kbuf;
+	int ret;
+
+	if (buffer==NULL)
+		return -1;
+	if (size==0)
+		return 0;
+	first=pos/AHCI_SECTOR_SIZE;
+	off=pos%AHCI_SECTOR_SIZE;
+	n=(off+size+AHCI_SECTOR_SIZE-1)/AHCI_SECTOR_SIZE;
+
+	if (off==0 && size%AHCI_SECTOR_SIZE==0 && (u32)buffer<USER_OFFSET && !((u32)buffer & 1)){
+		ret=rw(first,n,(char*)buffer,dir);
+		return (ret<0) ? ret : size;
+	}
+
+	kbuf=(char*)kmalloc(n*AHCI_SECTOR_SIZE);
+	if (kbuf==NULL)
+		return ERROR_MEMORY;
+	ret=RETURN_OK;
+	if (dir==BLK_READ){
+		ret=rw(first,n,kbuf,BLK_READ);
+		if (ret==RETURN_OK)
+			memcpy((char*)buffer,kbuf+off,size);
+	}
+	else {
+		if (off!=0)
+			ret=rw(first,1,kbuf,BLK_READ);
+		if (ret==RETURN_OK && (off+size)%AHCI_SECTOR_SIZE!=0 && (n>1 || off==0))
+			ret=rw(first+n-1,1,kbuf+(n-1)*AHCI_SECTOR_SIZE,BLK_READ);
+		if (ret==RETURN_OK){
+			memcpy(kbuf+off,(char*)buffer,size);
+			ret=rw(first,n,kbuf,BLK_WRITE);
+		}
+	}
+	kfree(kbuf);
+	return (ret<0) ? ret : size;
+}
+
+u32	Ahci::read(u32 pos,u8* buffer,u32 size){
+	return transfer(pos,buffer,size,BLK_READ);
+}
+
+u32	Ahci::write(u32 pos,u8* buffer,u32 size){
+	return transfer(pos,buffer,size,BLK_WRITE);
+}
+
+/* FLUSH CACHE, apres les requetes en attente */
+int Ahci::flush(){
+	blk_request r;
+	r.drive=port->num;
+	r.sector=0;
+	r.count=0;
+	r.buf=NULL;
+	r.dir=BLK_FLUSH;
+	return port->queue->submit(&r);
+}
+
+void Ahci::getInfo(blk_info* info){
+	memset((char*)info,0,sizeof(blk_info));
+	info->sectors=port->sectors;
+	info->sectors_hi=port->sectors_hi;
+	info->sector_size=AHCI_SECTOR_SIZE;
+	info->max_sectors=AHCI_MAX_SECTORS;
+	info->flags=BLK_INFO_DMA;
+	if (port->lba48)
+		info->flags|=BLK_INFO_LBA48;
+	if (port->ncq)
+		info->flags|=BLK_INFO_NCQ;
+	info->multiple=1;
+	info->udma=port->udma;
+	info->depth=port->depth;
+	memcpy(info->model,port->model,sizeof(info->model));
+}
+
+u32	Ahci::ioctl(u32 id,u8* buffer){
+	u32 ret=0;
+	switch (id){
+		case DEV_GET_TYPE:
+			ret=DEV_TYPE_DISK;
+			break;
+
+		case DEV_GET_STATE:
+			ret=DEV_STATE_OK;
+			break;
+
+		case DEV_GET_FORMAT:
+			ret=DEV_FORMAT_BLOCK;
+			break;
+
+		case DEV_FLUSH_CACHE:
+			ret=flush();
+			break;
+
+		case API_BLK_GET_STATS:
+			if (buffer==NULL)
+				return PARAM_NULL;
+			port->queue->getStats((blk_stats*)buffer);
+			ret=RETURN_OK;
+			break;
+
+		case API_BLK_GET_INFO:
+			if (buffer==NULL)
+				return PARAM_NULL;
+			getInfo((blk_info*)buffer);
+			ret=RETURN_OK;
+			break;
+
+		default:
+			ret=NOT_DEFINED;
+			break;
+	}
+	return ret;
+}
+
+u32	Ahci::remove(){
+	delete this;
+	return RETURN_OK;
+}
@@ -0,0 +1,220 @@
+#ifndef __AHCI__
+#define __AHCI__
+
+#include <runtime/types.h>
+#include <core/device.h>
+#include <io.h>
+#include <pci.h>
+#include <api/dev/blk.h>
+#include <core/workqueue.h>
+
+#define AHCI_MAX_PORTS		32
+#define AHCI_MAX_SLOTS		32
+#define AHCI_ABAR_BAR		5
+#define AHCI_ABAR_SIZE		0x1100		/* registres generaux + 32 ports */
+#define AHCI_SECTOR_SIZE	512
+#define AHCI_PRD_MAX		((PAGESIZE - sizeof(ahci_cmd_table)) / sizeof(ahci_prd))	/* une page par commande */
+#define AHCI_MAX_SECTORS	(AHCI_PRD_MAX / 2)	/* 2 entrees par secteur au pire */
+#define AHCI_TIMEOUT_MS		1000
+#define AHCI_NODEV_MS		20			/* lien sans peripherique (DET=0) apres ce delai */
+
+/* Registres generaux (ABAR) */
+#define HBA_CAP				0x00
+#define HBA_GHC				0x04
+#define HBA_IS				0x08
+#define HBA_PI				0x0C
+#define HBA_VS				0x10
+
+#define HBA_CAP_NCS(cap)	((((cap) >> 8) & 0x1F) + 1)	/* emplacements de commande */
+#define HBA_CAP_SNCQ		0x40000000
+#define HBA_CAP_SSS			0x08000000	/* staggered spin-up */
+#define HBA_GHC_HR			0x00000001
+#define HBA_GHC_IE			0x00000002
+#define HBA_GHC_AE			0x80000000
+
+/* Registres d'un port, a 0x100 + 0x80 * port */
+#define HBA_PORT(n)			(0x100 + 0x80 * (n))
+#define PX_CLB				0x00
+#define PX_CLBU				0x04
+#define PX_FB				0x08
+#define PX_FBU				0x0C
+#define PX_IS				0x10
+#define PX_IE				0x14
+#define PX_CMD				0x18
+#define PX_TFD				0x20
+#define PX_SIG				0x24
+#define PX_SSTS				0x28
+#define PX_SERR				0x30
+#define PX_SACT				0x34
+#define PX_CI				0x38
+
+#define PX_CMD_ST			0x0001
+#define PX_CMD_SUD			0x0002		/* spin-up device */
+#define PX_CMD_POD			0x0004		/* power on device */
+#define PX_CMD_FRE			0x0010
+#define PX_CMD_FR			0x4000
+#define PX_CMD_CR			0x8000
+
+#define PX_IS_DHRS			0x00000001	/* D2H register FIS */
+#define PX_IS_PSS			0x00000002	/* PIO setup FIS */
+#define PX_IS_SDBS			0x00000008	/* set device bits FIS (fin NCQ) */
+#define PX_IS_IFS			0x08000000
+#define PX_IS_HBDS			0x10000000
+#define PX_IS_HBFS			0x20000000
+#define PX_IS_TFES			0x40000000
+#define PX_IS_ERROR			(PX_IS_TFES | PX_IS_HBFS | PX_IS_HBDS | PX_IS_IFS)
+#define PX_IE_DEFAULT		(PX_IS_DHRS | PX_IS_PSS | PX_IS_SDBS | PX_IS_ERROR)
+
+#define PX_SSTS_DET(s)		((s) & 0xF)
+#define PX_SSTS_IPM(s)		(((s) >> 8) & 0xF)
+#define SSTS_DET_NONE		0
+#define SSTS_DET_PRESENT	3
+#define SSTS_IPM_ACTIVE		1
+
+#define SATA_SIG_ATA		0x00000101
+
+#define ATA_SR_ERR			0x01
+#define ATA_SR_DRQ			0x08
+#define ATA_SR_BSY			0x80
+
+#define ATA_CMD_READ_DMA		0xC8
+#define ATA_CMD_WRITE_DMA		0xCA
+#define ATA_CMD_READ_DMA_EXT	0x25
+#define ATA_CMD_WRITE_DMA_EXT	0x35
+#define ATA_CMD_READ_FPDMA		0x60	/* READ FPDMA QUEUED (NCQ) */
+#define ATA_CMD_WRITE_FPDMA		0x61
+#define ATA_CMD_FLUSH_CACHE		0xE7
+#define ATA_CMD_FLUSH_CACHE_EXT	0xEA
+#define ATA_CMD_IDENTIFY		0xEC
+
+/* Mots de la reponse a IDENTIFY DEVICE */
+#define ID_MODEL			27
+#define ID_MODEL_LEN		40
+#define ID_QUEUE_DEPTH		75		/* bits 0-4 : profondeur - 1 */
+#define ID_SATA_CAP			76
+#define ID_SATA_NCQ			0x0100
+#define ID_LBA_SECTORS		60
+#define ID_COMMAND_SET_2	83
+#define ID_CMD_LBA48		0x0400
+#define ID_FIELD_VALID		53
+#define ID_VALID_88			0x0004
+#define ID_UDMA				88
+#define ID_LBA48_SECTORS	100
+
+#define FIS_TYPE_REG_H2D	0x27
+#define FIS_H2D_COMMAND		0x80
+
+/* FIS registre hote vers disque (20 octets) */
+struct fis_reg_h2d {
+	u8		type;
+	u8		flags;			/* FIS_H2D_COMMAND */
+	u8		command;
+	u8		featurel;
+	u8		lba0;
+	u8		lba1;
+	u8		lba2;
+	u8		device;
+	u8		lba3;
+	u8		lba4;
+	u8		lba5;
+	u8		featureh;
+	u8		countl;
+	u8		counth;
+	u8		icc;
+	u8		control;
+	u8		rsv[4];
+} __attribute__ ((packed));
+
+/* Entree de la liste de commandes (32 par port) */
+struct ahci_cmd_header {
+	u16		flags;			/* CFL bits 0-4 (dwords du FIS), W bit 6 */
+	u16		prdtl;			/* entrees de la PRDT */
+	u32		prdbc;			/* octets transferes */
+	u32		ctba;
+	u32		ctbau;
+	u32		rsv[4];
+} __attribute__ ((packed));
+
+#define CMD_HDR_CFL(fis)	(sizeof(fis) / 4)
+#define CMD_HDR_WRITE		0x0040
+
+/* Entree de la PRDT : une zone physique, 4 Mo au plus */
+struct ahci_prd {
+	u32		dba;
+	u32		dbau;
+	u32		rsv;
+	u32		dbc;			/* octets - 1, bit 31 : interruption */
+} __attribute__ ((packed));
+
+#define PRD_DBC_MAX			0x400000
+
+/* Table d'une commande, suivie de sa PRDT (alignee sur 128 octets) */
+struct ahci_cmd_table {
+	u8		cfis[64];
+	u8		acmd[16];
+	u8		rsv[48];
+} __attribute__ ((packed));
+
+class BlkQueue;
+struct blk_request;
+
+/* Port avec un disque SATA */
+struct ahci_port {
+	u32					num;
+	char*				regs;
+	ahci_cmd_header*	clb;			/* liste de commandes, 1 Ko */
+	char*				fis;			/* FIS recus, 256 octets */
+	char*				ident;			/* reponse a IDENTIFY */
+	ahci_cmd_table*		tables[AHCI_MAX_SLOTS];
+	u32					tables_phys[AHCI_MAX_SLOTS];
+	blk_request*		slots[AHCI_MAX_SLOTS];	/* requete de chaque emplacement lance */
+	u32					issued;			/* emplacements lances */
+	u32					depth;			/* emplacements utilises */
+	u32					ncq;
+	u32					lba48;
+	u32					sectors;
+	u32					sectors_hi;
+	u32					udma;
+	char				model[ID_MODEL_LEN + 1];
+	spinlock_t			lock;
+	BlkQueue*			queue;
+	u32					errors;
+
+	/* reprise apres une erreur, par le thread "ahci" (ahci_port_recover) */
+	u32					recovering;		/* AHCI_RECOVER_* */
+	blk_request*		held[AHCI_MAX_SLOTS];	/* requetes arrivees pendant la reprise */
+	u32					nheld;
+	work				recover;
+};
+
+#define AHCI_RECOVER_NONE		0
+#define AHCI_RECOVER_PENDING	1
+#define AHCI_RECOVER_RUNNING	2
+#define AHCI_RECOVER_FAILED		3		/* le port ne redemarre pas, les requetes echouent */
+
+class Ahci : public Device
+{
+	public:
+		Ahci(char* n);
+		~Ahci();
+
+		u32		open(u32 flag);
+		u32		close();
+		u32		read(u32 pos,u8* buffer,u32 size);
+		u32		write(u32 pos,u8* buffer,u32 size);
+		u32		ioctl(u32 id,u8* buffer);
+		u32		remove();
+		void	scan();
+
+		void	setPort(ahci_port* p);
+
+	private:
+		ahci_port*	port;
+
+		int		rw(u32 sector,u32 count,char* buf,u32 dir);
+		u32		transfer(u32 pos,u8* buffer,u32 size,u32 dir);
+		int		flush();
+		void	getInfo(blk_info* info);
+};
+
+#endif
@@ -22,7 +22,7 @@ DosPartition::DosPartition(char* n,File* dev,u32 num) : Device(n)
 	partition_info=NULL;
 	if (device!=NULL){
 		partition_info=(dos_partition*)kmalloc(sizeof(dos_partition));
-		device->read((u32)(DOS_PART_1+(u32)(numpart*sizeof(dos_partition))),
+		bcache_read(device,(u32)(DOS_PART_1+(u32)(numpart*sizeof(dos_partition))),
 					 (u8*)partition_info,
 					 sizeof(dos_partition));	
 	}
@@ -23,12 +23,20 @@ File* ext2_mount(char* name,u32 flag,File* dev){
 module("module.ext2",MODULE_FILESYSTEM,Ext2,ext2_mount)
 
 Ext2::~Ext2(){
-	
+	if (inode!=NULL)
+		kfree(inode);
 }
 
 Ext2::Ext2(char* n) : File(n,TYPE_DIRECTORY)
 {
 	map=NULL;
+	inode=NULL;
+}
+
+static ext2_inode* ext2_file_inode(Ext2* fp){
+	if (fp->inode==NULL)
+		fp->inode=ext2_read_inode(fp->disk,fp->ext2inode);
+	return fp->inode;
 }
 
 void Ext2::scan(){
@@ -40,18 +48,87 @@ u32	Ext2::close(){
 }
 
 u32	Ext2::open(u32 flag){
-	ext2_inode *inodee=ext2_read_inode(disk,ext2inode);
-	map=ext2_read_file(disk,inodee);
-	kfree(inodee);
+	if (ext2_file_inode(this)==NULL)
+		return ERROR_MEMORY;
 	return RETURN_OK;
 }
 
+/*
+ *	Lecture par blocs a travers le cache, les blocs contigus sur le disque
+ *	en une seule lecture, par un buffer du noyau (le cache copie sous son
+ *	verrou). Une grande lecture (chargement d'un executable) garde une
+ *	fenetre de lecture en avance devant elle : kworker lit la suite
+ *	pendant qu'elle lit le debut.
+ */
 u32	Ext2::read(u32 pos,u8* buffer,u32 sizee){
-	u32 bufsize=sizee;
-	if ((pos + bufsize) > (size))
-		bufsize = (u32)(size) - pos;
-	memcpy((char*)buffer, (char *) (map + pos), bufsize);
-	return bufsize;
+	ext2_inode *in=ext2_file_inode(this);
+	u32 bufsize,done,bs,fblock,off,dblock,run,n,ra,max,tmpsize;
+	u8 *tmp;
+	
+	if (in==NULL || buffer==NULL || pos>=size)
+		return 0;
+	bufsize=sizee;
+	if (bufsize > size - pos)
+		bufsize = size - pos;
+	
+	//buffer a la taille de la lecture : n ne depasse jamais bufsize
+	bs=disk->blocksize;
+	tmpsize=(bufsize < EXT2_READ_RUN) ? ((bufsize + bs - 1) / bs) * bs : EXT2_READ_RUN;
+	tmp=(u8*)kmalloc(tmpsize);
+	if (tmp==NULL)
+		return 0;
+	max=bcache_ra_max();
+	ra=pos + EXT2_READ_RUN;		//fin de la zone deja demandee
+	for (done = 0; done < bufsize; done += n) {
+		if (bufsize > 2 * EXT2_READ_RUN && ra < pos + bufsize && pos + done + max > ra) {
+			readahead(ra, max);
+			ra += max;
+		}
+		fblock = (pos + done) / bs;
+		off = (pos + done) % bs;
+		dblock = ext2_bmap(disk, in, fblock);
+		n = bs - off;
+		for (run = 1; dblock && n < bufsize - done && n < EXT2_READ_RUN
+				&& ext2_bmap(disk, in, fblock + run) == dblock + run; run++)
+			n += bs;
+		if (n > bufsize - done)
+			n = bufsize - done;
+		if (n > EXT2_READ_RUN)
+			n = EXT2_READ_RUN;
+		if (dblock == 0) {
+			//trou : des zeros
+			memset((char*)buffer + done, 0, n);
+			continue;
+		}
+		if (bcache_read(disk->dev, dblock * bs + off, tmp, n) != n)
+			break;
+		memcpy((char*)buffer + done, (char*)tmp, n);
+	}
+	kfree(tmp);
+	return done;
+}
+
+/* Demande la lecture en avance des blocs du fichier, par suites contigues */
+u32	Ext2::readahead(u32 pos,u32 sizee){
+	ext2_inode *in=ext2_file_inode(this);
+	u32 bs,fblock,last,dblock,run;
+	
+	if (in==NULL || pos>=size || sizee==0)
+		return NOT_DEFINED;
+	if (sizee > size - pos)
+		sizee = size - pos;
+	if (sizee > bcache_ra_max())
+		sizee = bcache_ra_max();
+	bs=disk->blocksize;
+	last = (pos + sizee - 1) / bs;
+	for (fblock = pos / bs; fblock <= last; fblock += run) {
+		dblock = ext2_bmap(disk, in, fblock);
+		for (run = 1; dblock && fblock + run <= last
+				&& ext2_bmap(disk, in, fblock + run) == dblock + run; run++);
+		if (dblock)
+			bcache_readahead(disk->dev, dblock * bs, run * bs);
+	}
+	return RETURN_OK;
 }
 
 u32	Ext2::write(u32 pos,u8* buffer,u32 sizee){
@@ -75,7 +152,7 @@ u32	Ext2::remove(){
 int ext2_read_sb(File* dev,ext2_super_block *sb)
 {
 	if (dev!=NULL){
-		dev->read((u32)1024,(u8 *) sb,sizeof(ext2_super_block));
+		bcache_read(dev,(u32)1024,(u8 *) sb,sizeof(ext2_super_block));
 		return RETURN_OK;
 	}
 	else
@@ -88,7 +165,7 @@ int ext2_read_gd(File* fdev,ext2_group_desc *gd,ext2_disk* info)
 		u32 offset;
 		offset = ((info->blocksize == 1024) ? 2048 : info->blocksize);
 		int gd_size = (info->groups * ((int)sizeof(struct ext2_group_desc)));
-		fdev->read(offset,(u8*) gd,gd_size);
+		bcache_read(fdev,offset,(u8*) gd,gd_size);
 		return RETURN_OK;
 	}
 	else
@@ -137,7 +214,7 @@ ext2_inode *ext2_read_inode(ext2_disk* hd, int i_num)
 	index = (i_num - 1) % ((hd->sb)->s_inodes_per_group);
 	offset = (info[gr_num].bg_inode_table * (hd->blocksize)) + (index * ((hd->sb)->s_inode_size));
 	if ((hd->dev)!=NULL){
-		(hd->dev)->read(offset,(u8*) inode,(hd->sb)->s_inode_size);
+		bcache_read(hd->dev,offset,(u8*) inode,(hd->sb)->s_inode_size);
 	}
 	return inode;
 }
@@ -148,75 +225,111 @@ int ext2_is_directory(Ext2 *fp)
 	kfree(inod);
 	return ret;
 }
+/*
+ *	Copie les blocs de la liste blocks (nb au plus, arret au premier bloc
+ *	nul) dans le fichier projete : une suite de blocs contigus sur le
+ *	disque est lue en une seule requete, directement a sa place. Seul le
+ *	dernier bloc incomplet passe par buf.
+ */
+static char *ext2_copy_blocks(ext2_disk *hd,u32 *blocks,int nb,char *mmap_head,int *size,char *buf)
+{
+	int i, run, n, full;
+
+	for (i = 0; i < nb && blocks[i] && *size > 0; i += run) {
+		for (run = 1; i + run < nb && blocks[i + run] == blocks[i] + run; run++);
+		n = run * hd->blocksize;
+		if (n > *size) {
+			full = *size / hd->blocksize;
+			run = full + 1;
+			n = full * hd->blocksize;
+			if (n > 0)
+				bcache_read(hd->dev,(u32)(blocks[i] * hd->blocksize),(u8*) mmap_head,n);
+			bcache_read(hd->dev,(u32)((blocks[i] + full) * hd->blocksize),(u8*) buf,hd->blocksize);
+			memcpy(mmap_head + n, buf, *size - n);
+			n = *size;
+		}
+		else
+			bcache_read(hd->dev,(u32)(blocks[i] * hd->blocksize),(u8*) mmap_head,n);
+		mmap_head += n;
+		*size -= n;
+	}
+	return mmap_head;
+}
+
+static u32 ext2_indirect(ext2_disk *hd,u32 block,u32 i)
+{
+	u32 b = 0;
+	if (block)
+		bcache_read(hd->dev, block * hd->blocksize + i * 4, (u8*) &b, 4);
+	return b;
+}
+
+/*
+ *	Numero sur le disque du bloc n du fichier, 0 pour un trou. Les blocs
+ *	d'indirection sont lus a travers le cache.
+ */
+u32 ext2_bmap(ext2_disk *hd,ext2_inode *inode,u32 n)
+{
+	u32 nb = hd->blocksize / 4;
+	
+	if (n < 12)
+		return inode->i_block[n];
+	n -= 12;
+	if (n < nb)
+		return ext2_indirect(hd, inode->i_block[12], n);
+	n -= nb;
+	if (n < nb * nb)
+		return ext2_indirect(hd, ext2_indirect(hd, inode->i_block[13], n / nb), n % nb);
+	n -= nb * nb;
+	return ext2_indirect(hd, ext2_indirect(hd, ext2_indirect(hd, inode->i_block[14],
+			n / (nb * nb)), (n / nb) % nb), n % nb);
+}
+
 char *ext2_read_file(ext2_disk *hd,ext2_inode *inode)
 {
 	File *dev=hd->dev;
 	
 	char *mmap_base, *mmap_head, *buf;
 
-	int *p, *pp, *ppp;
-	int i, j, k;
-	int n, size;
+	u32 *p, *pp, *ppp;
+	int i, j;
+	int nb, size;
 
 	buf = (char *) kmalloc(hd->blocksize);
-	p = (int *) kmalloc(hd->blocksize);
-	pp = (int *) kmalloc(hd->blocksize);
-	ppp = (int *) kmalloc(hd->blocksize);
+	p = (u32 *) kmalloc(hd->blocksize);
+	pp = (u32 *) kmalloc(hd->blocksize);
+	ppp = (u32 *) kmalloc(hd->blocksize);
+	nb = hd->blocksize / 4;
 
 	/* taille totale du fichier */
 	size = inode->i_size;
 	mmap_head = mmap_base = (char*)kmalloc(size);
 	/* direct block number */
-	for (i = 0; i < 12 && inode->i_block[i]; i++) {
-        dev->read((u32)(inode->i_block[i] * hd->blocksize),(u8*) buf, (hd->blocksize));
-		n = ((size > (int)hd->blocksize) ? (int)hd->blocksize : size);
-		memcpy(mmap_head, buf, n);
-		mmap_head += n;
-		size -= n;
-	}
-	/* indirect block number */
-	if (inode->i_block[12]) {
-	    dev->read((u32)(inode->i_block[12] * hd->blocksize), (u8*) p, (hd->blocksize));
-
+	mmap_head = ext2_copy_blocks(hd, inode->i_block, 12, mmap_head, &size, buf);
 
-		for (i = 0; i < (int)hd->blocksize / 4 && p[i]; i++) {
-            dev->read((u32)(p[i] * hd->blocksize),(u8*)buf, (hd->blocksize));
-			n = ((size > (int)hd->blocksize) ? (int)hd->blocksize : size);
-			memcpy(mmap_head, buf, n);
-			mmap_head += n;
-			size -= n;
-		}
+	/* indirect block number */
+	if (inode->i_block[12] && size > 0) {
+	    bcache_read(dev,(u32)(inode->i_block[12] * hd->blocksize), (u8*) p, (hd->blocksize));
+		mmap_head = ext2_copy_blocks(hd, p, nb, mmap_head, &size, buf);
 	}
 
 	/* bi-indirect block number */
-	if (inode->i_block[13]) {
-	    dev->read((u32)(inode->i_block[13] * hd->blocksize), (u8*) p, (hd->blocksize));
+	if (inode->i_block[13] && size > 0) {
+	    bcache_read(dev,(u32)(inode->i_block[13] * hd->blocksize), (u8*) p, (hd->blocksize));
 
-		for (i = 0; i < (int)hd->blocksize / 4 && p[i]; i++) {
-            dev->read((u32)(p[i] * (int)hd->blocksize), (u8*) pp,(hd->blocksize));
-			for (j = 0; j < (int)hd->blocksize / 4 && pp[j]; j++) {
-                dev->read((u32)(pp[j] * hd->blocksize),(u8*)buf,(hd->blocksize));
-				n = ((size > (int)hd-> blocksize) ? (int)hd->blocksize : size);
-				memcpy(mmap_head, buf, n);
-				mmap_head += n;
-				size -= n;
-			}
+		for (i = 0; i < nb && p[i] && size > 0; i++) {
+            bcache_read(dev,(u32)(p[i] * (int)hd->blocksize), (u8*) pp,(hd->blocksize));
+			mmap_head = ext2_copy_blocks(hd, pp, nb, mmap_head, &size, buf);
 		}
 	}
 	/* tri-indirect block number */
-	if (inode->i_block[14]) {
-        dev->read((u32)(inode->i_block[14] * hd->blocksize), (u8*) p,(hd->blocksize));
-		for (i = 0; i < (int)hd->blocksize / 4 && p[i]; i++) {
-            dev->read((u32)(p[i] * hd->blocksize), (u8*) pp,(hd->blocksize));
-			for (j = 0; j < (int)hd->blocksize / 4 && pp[j]; j++) {
-                dev->read((u32)(pp[j] * hd->blocksize), (u8*) ppp,(hd->blocksize));
-				for (k = 0; k < (int)hd->blocksize / 4 && ppp[k]; k++) {
-                    dev->read((u32)(ppp[k] * hd->blocksize),(u8*)buf,(hd->blocksize));
-					n = ((size > (int)hd->blocksize) ? (int)hd->blocksize : size);
-					memcpy(mmap_head, buf, n);
-					mmap_head += n;
-					size -= n;
-				}
+	if (inode->i_block[14] && size > 0) {
+        bcache_read(dev,(u32)(inode->i_block[14] * hd->blocksize), (u8*) p,(hd->blocksize));
+		for (i = 0; i < nb && p[i] && size > 0; i++) {
+            bcache_read(dev,(u32)(p[i] * hd->blocksize), (u8*) pp,(hd->blocksize));
+			for (j = 0; j < nb && pp[j] && size > 0; j++) {
+                bcache_read(dev,(u32)(pp[j] * hd->blocksize), (u8*) ppp,(hd->blocksize));
+				mmap_head = ext2_copy_blocks(hd, ppp, nb, mmap_head, &size, buf);
 			}
 		}
 	}
@@ -256,15 +369,15 @@ int ext2_scan(Ext2 *dir)
 						leaf= new Ext2(filename);
 						leaf->ext2inode = dentry->inode;
 						leaf->disk=dir->disk;
-						if (ext2_is_directory(leaf))
+						ext2_inode *inod=ext2_read_inode((ext2_disk*)leaf->disk,leaf->ext2inode);
+						if (inod->i_mode & EXT2_S_IFDIR)	//une seule lecture de l'inode
 							leaf->setType(TYPE_DIRECTORY);
 						else
 							leaf->setType(TYPE_FILE);
-						dir->addChild(leaf);
-						leaf->map = 0;
-						ext2_inode *inod=ext2_read_inode((ext2_disk*)leaf->disk,leaf->ext2inode);
 						leaf->setSize(inod->i_size);
 						kfree(inod);
+						dir->addChild(leaf);
+						leaf->map = 0;
 					}
 				}
 				kfree(filename);
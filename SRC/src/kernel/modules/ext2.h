@@ -140,6 +140,8 @@ struct ext2_disk {
 #define	EXT2_S_IXOTH	0x0001	/* execute */
 
 #define EXT2_INUM_ROOT	2
+
+#define EXT2_READ_RUN	65536	/* octets lus par requete au cache au plus */
  
 /*
  *	Driver class
@@ -158,8 +160,10 @@ class Ext2 : public File
 		u32		ioctl(u32 id,u8* buffer);
 		u32		remove();
 		void	scan();
+		u32		readahead(u32 pos,u32 sizee);
 		
-		char*		map;
+		char*		map;		/* repertoire en cours de lecture par ext2_scan */
+		ext2_inode*	inode;		/* lu a la premiere lecture */
 		ext2_disk*	disk;
 		int 		ext2inode;
 	private:
@@ -174,5 +178,6 @@ ext2_inode*		ext2_read_inode(ext2_disk* hd, int i_num);
 int 			ext2_is_directory(Ext2 *fp);
 int 			ext2_scan(Ext2 *dir);
 char *			ext2_read_file(ext2_disk *hd,ext2_inode *inode);
+u32				ext2_bmap(ext2_disk *hd,ext2_inode *inode,u32 n);
 
 #endif
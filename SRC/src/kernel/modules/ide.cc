@@ -4,6 +4,37 @@
 
 #include <api/dev/ioctl.h>
 
+/*
+ *	Le canal primaire est servi par une file de requetes (core/blkqueue.h) :
+ *	un processus ajoute sa requete et dort, l'IRQ 14 termine la commande
+ *	en cours, enchaine la suivante et reveille le demandeur. Les
+ *	transferts passent par le bus master DMA quand il existe et que le
+ *	disque le supporte, sinon en PIO pilote par interruption (une IRQ par
+ *	bloc de READ/WRITE MULTIPLE).
+ *
+ *	Chaque disque est identifie (IDENTIFY DEVICE) a sa creation : un
+ *	disque absent n'a pas de noeud dans /dev, un disque LBA48 recoit des
+ *	commandes EXT de 65536 secteurs au plus.
+ *
+ *	Avant que les interruptions soient actives (montage de la racine),
+ *	la file appelle ide_poll() qui execute le meme automate.
+ */
+static spinlock_t	ide_lock = SPINLOCK_INIT;	/* automate et registres du canal */
+static BlkQueue*	ide_queue = NULL;
+
+/* Bus master DMA du canal primaire (PCI IDE), ide_bm=0 : PIO seulement */
+static u32			ide_bm = 0;
+static ide_prd*		ide_prdt = NULL;	/* une page : jamais a cheval sur 64 Ko */
+static u32			ide_prdt_phys = 0;
+
+/* Commande en cours sur le canal */
+static u32			ide_phase = IDE_IDLE;
+static u32			ide_done = 0;		/* secteurs termines de la requete active */
+static u32			ide_cmd_count = 0;	/* secteurs de la commande en cours */
+static u32			ide_left = 0;		/* secteurs PIO restant a transferer */
+static u32			ide_block = 1;		/* secteurs PIO par IRQ */
+
+static ide_drive	ide_drives[IDE_NR_DRIVES];
 
 /*
  *	Cette fonction attend que le disque soit pret avant une operation
@@ -14,14 +45,36 @@ int bl_wait(unsigned short base)
 	return 0;	
 }
 
+/* Le registre d'etat n'est valide que 400 ns apres une commande */
+static void ide_delay400()
+{
+	int i;
+	for (i = 0; i < 4; i++)
+		io.inb(0x3F6);
+}
+
 /*
- *	Cette fonction permet de ce deplacer sur le disque
+ *	Cette fonction permet de ce deplacer sur le disque. En LBA48 (ext) les
+ *	registres sont ecrits deux fois, octets de poids fort d'abord, et le
+ *	compteur a 16 bits (0 = 65536).
  */
-int bl_common(int drive, int numblock, int count)
+int bl_common(int drive, u32 numblock, u32 count, int ext)
 {
 	bl_wait(0x1F0);
 	
 	io.outb(0x1F1, 0x00);	/* NULL byte to port 0x1F1 */
+	if (ext) {
+		io.outb(0x1F2, (unsigned char) (count >> 8));
+		io.outb(0x1F3, (unsigned char) (numblock >> 24));
+		io.outb(0x1F4, 0);	/* bits 32-47, le noyau adresse en 32 bits */
+		io.outb(0x1F5, 0);
+		io.outb(0x1F2, (unsigned char) count);
+		io.outb(0x1F3, (unsigned char) numblock);
+		io.outb(0x1F4, (unsigned char) (numblock >> 8));
+		io.outb(0x1F5, (unsigned char) (numblock >> 16));
+		io.outb(0x1F6, 0x40 | (drive << 4));
+		return 0;
+	}
 	io.outb(0x1F2, count);	/* Sector count */
 	io.outb(0x1F3, (unsigned char) numblock);	/* Low 8 bits of the block address */
 	io.outb(0x1F4, (unsigned char) (numblock >> 8));	/* Next 8 bits of the block address */
@@ -33,54 +86,467 @@ int bl_common(int drive, int numblock, int count)
 	return 0;
 }
 
+/* Attend la fin de BSY avec une limite (disque absent ou bloque) */
+static u8 ide_wait_status(u32 mask)
+{
+	u32 n;
+	u8 st = 0;
+
+	for (n = 0; n < IDE_TIMEOUT; n++) {
+		st = io.inb(0x1F7);
+		if (!(st & ATA_SR_BSY) && (st & mask))
+			break;
+		if (!(st & ATA_SR_BSY) && mask == 0)
+			break;
+	}
+	return st;
+}
+
 /*
- *	Cette fonction permet de lire un buffer sur le disque
+ *	IDENTIFY DEVICE par attente active (a la creation du noeud, avant
+ *	toute requete) puis SET MULTIPLE MODE. Retourne NOT_DEFINED si le
+ *	disque est absent ou n'est pas un disque ATA (ATAPI, SATA).
  */
-int bl_read(int drive, int numblock, int count, char *buf)
+static int ide_identify(u32 drive, ide_drive* d)
 {
-	u16 tmpword;
-	int idx;
+	u16 id[256];
+	u8 st;
+	int i;
+
+	memset((char*) d, 0, sizeof(ide_drive));
+	io.outb(0x1F6, 0xA0 | (drive << 4));
+	ide_delay400();
+	io.outb(0x1F2, 0);
+	io.outb(0x1F3, 0);
+	io.outb(0x1F4, 0);
+	io.outb(0x1F5, 0);
+	io.outb(0x1F7, ATA_CMD_IDENTIFY);
+	ide_delay400();
+
+	st = io.inb(0x1F7);
+	if (st == 0 || st == 0xFF)
+		return NOT_DEFINED;
+	st = ide_wait_status(0);
+	if (st & ATA_SR_BSY)
+		return NOT_DEFINED;
+	if (io.inb(0x1F4) != 0 || io.inb(0x1F5) != 0)
+		return NOT_DEFINED;
+	st = ide_wait_status(ATA_SR_DRQ | ATA_SR_ERR);
+	if (!(st & ATA_SR_DRQ) || (st & ATA_SR_ERR))
+		return NOT_DEFINED;
+	io.insw(0x1F0, id, 256);
+
+	d->present = 1;
+	d->dma = (id[ID_CAPABILITIES] & ID_CAP_DMA) ? 1 : 0;
+	d->lba48 = (id[ID_COMMAND_SET_2] & ID_CMD_LBA48) ? 1 : 0;
+	if (d->lba48) {
+		d->sectors = id[ID_LBA48_SECTORS] | ((u32) id[ID_LBA48_SECTORS + 1] << 16);
+		d->sectors_hi = id[ID_LBA48_SECTORS + 2] | ((u32) id[ID_LBA48_SECTORS + 3] << 16);
+	}
+	else
+		d->sectors = id[ID_LBA_SECTORS] | ((u32) id[ID_LBA_SECTORS + 1] << 16);
+	d->mwdma = id[ID_MWDMA] & 0x7;
+	d->udma = (id[ID_FIELD_VALID] & ID_VALID_88) ? id[ID_UDMA] & 0x7F : 0;
+	for (i = 0; i < ID_MODEL_LEN / 2; i++) {
+		d->model[2 * i] = id[ID_MODEL + i] >> 8;
+		d->model[2 * i + 1] = id[ID_MODEL + i] & 0xFF;
+	}
+	for (i = ID_MODEL_LEN; i > 0 && (d->model[i - 1] == ' ' || d->model[i - 1] == 0); i--);
+	d->model[i] = 0;
+
+	/* READ/WRITE MULTIPLE : une IRQ par bloc de secteurs */
+	d->multiple = 1;
+	if ((id[ID_MAX_MULTIPLE] & 0xFF) > 1) {
+		u32 m = id[ID_MAX_MULTIPLE] & 0xFF;
+		if (m > IDE_MULTIPLE_MAX)
+			m = IDE_MULTIPLE_MAX;
+		io.outb(0x1F6, 0xE0 | (drive << 4));
+		io.outb(0x1F2, m);
+		io.outb(0x1F7, ATA_CMD_SET_MULTIPLE);
+		ide_delay400();
+		st = ide_wait_status(0);
+		if (!(st & (ATA_SR_BSY | ATA_SR_ERR)))
+			d->multiple = m;
+	}
+	return RETURN_OK;
+}
 
-	bl_common(drive, numblock, count);
-	io.outb(0x1F7, 0x20);
+/*
+ *	Ajoute un buffer du noyau a la table PRD : une entree par page, les
+ *	pages voisines en memoire physique sont fusionnees tant qu'elles ne
+ *	franchissent pas une limite de 64 Ko.
+ */
+static int ide_add_prd(u32* nprd, u32* bytes, char* buf, u32 len)
+{
+	u32 n = *nprd, chunk, phys;
+
+	if ((u32) buf & 1)
+		return ERROR_PARAM;
+	while (len > 0) {
+		chunk = PAGESIZE - ((u32) buf & (PAGESIZE - 1));
+		if (chunk > len)
+			chunk = len;
+		phys = (u32) get_p_addr(buf);
+		if (phys == 0)
+			return ERROR_PARAM;
+		if (n > 0 && ide_prdt[n - 1].addr + ide_prdt[n - 1].count == phys
+			&& (phys & 0xFFFF0000) == (ide_prdt[n - 1].addr & 0xFFFF0000)
+			&& ide_prdt[n - 1].count + chunk < 0x10000)
+			ide_prdt[n - 1].count += chunk;
+		else {
+			if (n == IDE_PRD_MAX)
+				return ERROR_PARAM;
+			ide_prdt[n].addr = phys;
+			ide_prdt[n].count = chunk;
+			ide_prdt[n].flags = 0;
+			n++;
+		}
+		*nprd = n;
+		*bytes += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+	return RETURN_OK;
+}
 
-	bl_wait(0x1F0);
-	while (!(io.inb(0x1F7) & 0x08));
+/*
+ *	Table PRD d'au plus count secteurs de la chaine r a partir du secteur
+ *	off. Quand la table est pleine la commande est raccourcie aux secteurs
+ *	entiers decrits ; retourne le nombre de secteurs, 0 si le DMA est
+ *	impossible.
+ */
+static u32 ide_build_prd(blk_request* r, u32 off, u32 count)
+{
+	u32 nprd = 0, bytes = 0, left, excess;
+	char* buf;
+
+	while (count > 0) {
+		buf = blk_segment(r, off, &left);
+		if (left > count)
+			left = count;
+		if (buf == NULL || ide_add_prd(&nprd, &bytes, buf, left * 512) != RETURN_OK)
+			break;
+		off += left;
+		count -= left;
+	}
 
-	for (idx = 0; idx < 256 * count; idx++) {
-		tmpword = io.inw(0x1F0);
-		buf[idx * 2] = (unsigned char) tmpword;
-		buf[idx * 2 + 1] = (unsigned char) (tmpword >> 8);
+	excess = bytes % 512;
+	bytes -= excess;
+	while (excess > 0) {
+		if (ide_prdt[nprd - 1].count <= excess) {
+			excess -= ide_prdt[nprd - 1].count;
+			nprd--;
+		}
+		else {
+			ide_prdt[nprd - 1].count -= excess;
+			excess = 0;
+		}
 	}
-	return count;
+	if (nprd == 0 || bytes == 0)
+		return 0;
+	ide_prdt[nprd - 1].flags = PRD_EOT;
+	return bytes / 512;
+}
+
+/* Buffer du prochain secteur PIO de la commande en cours */
+static char* ide_pio_buf(blk_request* r)
+{
+	u32 left;
+	return blk_segment(r, ide_done + ide_cmd_count - ide_left, &left);
 }
 
 /*
- *	Cette fonction permet d'ecrire un buffer sur le disque
+ *	Un bloc DRQ : min(ide_block, ide_left) secteurs, chacun en une
+ *	instruction rep outsw / rep insw (ils peuvent etre dans des requetes
+ *	differentes de la chaine).
  */
-int bl_write(int drive, int numblock, int count, char *buf)
+static void ide_pio_out(blk_request* r)
 {
-	u16 tmpword;
-	int idx;
+	u32 n = (ide_left < ide_block) ? ide_left : ide_block;
 
-	bl_common(drive, numblock, count);
-	io.outb(0x1F7, 0x30);
-	bl_wait(0x1F0);
-	/* Wait for the drive to signal that it's ready: */
-	while (!(io.inb(0x1F7) & 0x08));
+	for (; n > 0; n--, ide_left--)
+		io.outsw(0x1F0, ide_pio_buf(r), 256);
+}
+
+static void ide_pio_in(blk_request* r)
+{
+	u32 n = (ide_left < ide_block) ? ide_left : ide_block;
+
+	for (; n > 0; n--, ide_left--)
+		io.insw(0x1F0, ide_pio_buf(r), 256);
+}
+
+/*
+ *	Lance la commande suivante de la chaine r (ide_lock pris) : au plus
+ *	IDE_MAX_SECTORS secteurs (compteur de 8 bits), IDE_MAX_SECTORS_EXT
+ *	sur un disque LBA48. Les commandes EXT ne servent que quand elles sont
+ *	necessaires (grande commande ou secteur au-dela de 28 bits).
+ */
+static void ide_issue(blk_request* r, int pio)
+{
+	ide_drive* dv = &ide_drives[r->drive];
+	u32 lba = r->sector + ide_done;
+	int write = (r->dir == BLK_WRITE);
+	int ext;
+	u8 cmd;
+
+	ide_cmd_count = r->total - ide_done;
+	if (ide_cmd_count > (dv->lba48 ? IDE_MAX_SECTORS_EXT : IDE_MAX_SECTORS))
+		ide_cmd_count = dv->lba48 ? IDE_MAX_SECTORS_EXT : IDE_MAX_SECTORS;
+
+	if (r->dir == BLK_FLUSH) {
+		ide_phase = IDE_FLUSH;
+		bl_wait(0x1F0);
+		io.outb(0x1F6, 0xE0 | (r->drive << 4));
+		io.outb(0x1F7, dv->lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE);
+		ide_delay400();
+		return;
+	}
+
+	if (!pio && ide_bm != 0 && dv->dma) {
+		u32 n = ide_build_prd(r, ide_done, ide_cmd_count);
+		if (n > 0) {
+			ide_cmd_count = n;
+			ext = dv->lba48 && (ide_cmd_count > IDE_MAX_SECTORS || lba + ide_cmd_count > IDE_LBA28_MAX);
+			io.outl(ide_bm + BM_PRDT, ide_prdt_phys);
+			io.outb(ide_bm + BM_COMMAND, write ? 0 : BM_CMD_READ);
+			io.outb(ide_bm + BM_STATUS, BM_STATUS_IRQ | BM_STATUS_ERR);
+			ide_phase = IDE_DMA;
+			bl_common(r->drive, lba, ide_cmd_count, ext);
+			if (ext)
+				cmd = write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+			else
+				cmd = write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA;
+			io.outb(0x1F7, cmd);
+			io.outb(ide_bm + BM_COMMAND, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+			return;
+		}
+	}
+
+	ext = dv->lba48 && (ide_cmd_count > IDE_MAX_SECTORS || lba + ide_cmd_count > IDE_LBA28_MAX);
+	ide_left = ide_cmd_count;
+	ide_block = dv->multiple;
+	ide_phase = write ? IDE_PIO_WRITE : IDE_PIO_READ;
+	bl_common(r->drive, lba, ide_cmd_count, ext);
+	if (ide_block > 1)
+		cmd = write ? (ext ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE)
+					: (ext ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE);
+	else
+		cmd = write ? (ext ? ATA_CMD_WRITE_EXT : ATA_CMD_WRITE)
+					: (ext ? ATA_CMD_READ_EXT : ATA_CMD_READ);
+	io.outb(0x1F7, cmd);
+	ide_delay400();
+	if (write) {
+		/* le premier bloc n'est pas precede d'une IRQ */
+		bl_wait(0x1F0);
+		while (!(io.inb(0x3F6) & ATA_SR_DRQ));
+		ide_pio_out(r);
+		ide_delay400();
+	}
+}
+
+static void ide_start(BlkQueue* q, blk_request* r)
+{
+	u32 flags = spin_lock_irqsave(&ide_lock);
+	ide_done = 0;
+	ide_issue(r, 0);
+	spin_unlock_irqrestore(&ide_lock, flags);
+}
 
-	for (idx = 0; idx < 256 * count; idx++) {
-		tmpword = (buf[idx * 2 + 1] << 8) | buf[idx * 2];
-		io.outw(0x1F0, tmpword);
+/*
+ *	Automate du canal, appele par l'IRQ 14 ou par ide_poll() : fait
+ *	avancer la commande en cours et termine la requete a la fin de sa
+ *	derniere commande.
+ */
+static void ide_intr()
+{
+	blk_request* r;
+	int err = RETURN_OK;
+	u8 st, bst;
+	u32 flags = spin_lock_irqsave(&ide_lock);
+
+	r = (ide_queue != NULL) ? ide_queue->active() : NULL;
+	if (r == NULL || ide_phase == IDE_IDLE) {
+		io.inb(0x1F7);		/* acquitte une interruption inattendue */
+		spin_unlock_irqrestore(&ide_lock, flags);
+		return;
 	}
 
+	switch (ide_phase) {
+		case IDE_DMA:
+			bst = io.inb(ide_bm + BM_STATUS);
+			if (!(bst & (BM_STATUS_IRQ | BM_STATUS_ERR))) {
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			io.outb(ide_bm + BM_COMMAND, 0);
+			io.outb(ide_bm + BM_STATUS, bst | BM_STATUS_IRQ | BM_STATUS_ERR);
+			st = io.inb(0x1F7);
+			if ((bst & BM_STATUS_ERR) || (st & (ATA_SR_ERR | ATA_SR_DF))) {
+				ide_issue(r, 1);	/* la commande est refaite en PIO */
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			break;
+
+		case IDE_PIO_READ:
+			st = io.inb(0x1F7);
+			if (st & ATA_SR_BSY) {
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			if (st & (ATA_SR_ERR | ATA_SR_DF)) {
+				err = NOT_DEFINED;
+				break;
+			}
+			if (!(st & ATA_SR_DRQ)) {
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			ide_pio_in(r);
+			if (ide_left > 0) {
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			break;
+
+		case IDE_FLUSH:
+			st = io.inb(0x1F7);
+			if (st & ATA_SR_BSY) {
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			if (st & (ATA_SR_ERR | ATA_SR_DF))
+				err = NOT_DEFINED;
+			break;
+
+		case IDE_PIO_WRITE:
+			st = io.inb(0x1F7);
+			if (st & ATA_SR_BSY) {
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			if (st & (ATA_SR_ERR | ATA_SR_DF)) {
+				err = NOT_DEFINED;
+				break;
+			}
+			if (ide_left > 0) {
+				if (st & ATA_SR_DRQ) {
+					ide_pio_out(r);
+					ide_delay400();
+				}
+				spin_unlock_irqrestore(&ide_lock, flags);
+				return;
+			}
+			break;
+	}
+
+	if (err == RETURN_OK) {
+		ide_done += ide_cmd_count;
+		if (ide_done < r->total) {
+			ide_issue(r, 0);
+			spin_unlock_irqrestore(&ide_lock, flags);
+			return;
+		}
+	}
+	ide_phase = IDE_IDLE;
+	spin_unlock_irqrestore(&ide_lock, flags);
+	ide_queue->complete(r, err);
+}
+
+static void ide_irq(u32 irq, void* data)
+{
+	ide_intr();
+}
+
+static void ide_poll(BlkQueue* q)
+{
+	ide_intr();
+}
+
+/*
+ *	Cree la file du canal primaire et installe l'IRQ 14, puis cherche le
+ *	controleur IDE PCI et son bus master (BAR 4, les 8 premiers ports
+ *	sont ceux du canal primaire).
+ */
+static void ide_init()
+{
+	pci_dev* d;
+	page* pg;
+	u32 bm;
+
+	ide_queue = new BlkQueue(ide_start, ide_poll, NULL, IDE_MAX_SECTORS_EXT, 1);
+	arch.install_irq(IDE_IRQ_PRIMARY, ide_irq, NULL);
+
+	d = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0);
+	if (d == NULL || !(d->prog_if & IDE_PROGIF_BUSMASTER) || !pci_bar_is_io(d, 4))
+		return;
+	bm = pci_bar(d, 4);
+	if (bm == 0)
+		return;
+	pg = get_page_from_heap();
+	if (pg == NULL)
+		return;
+
+	pci_set_master(d);
+	ide_prdt = (ide_prd*) pg->v_addr;
+	ide_prdt_phys = (u32) pg->p_addr;
+	io.outb(bm + BM_COMMAND, 0);
+	io.outb(bm + BM_STATUS, BM_STATUS_IRQ | BM_STATUS_ERR);
+	ide_bm = bm;
+	io.print("ide: bus master DMA at port %x \n", bm);
+}
+
+static int bl_submit(int drive, int numblock, int count, char *buf, u32 dir)
+{
+	blk_request r;
+	int ret;
+
+	r.drive = drive;
+	r.sector = numblock;
+	r.count = count;
+	r.buf = buf;
+	r.dir = dir;
+	ret = ide_queue->submit(&r);
+	if (ret != RETURN_OK)
+		return ret;
 	return count;
 }
 
+/*
+ *	Cette fonction permet de lire un buffer sur le disque
+ */
+int bl_read(int drive, int numblock, int count, char *buf)
+{
+	return bl_submit(drive, numblock, count, buf, BLK_READ);
+}
+
+/*
+ *	Cette fonction permet d'ecrire un buffer sur le disque
+ */
+int bl_write(int drive, int numblock, int count, char *buf)
+{
+	return bl_submit(drive, numblock, count, buf, BLK_WRITE);
+}
+
 
 
 
+/* Pas de noeud pour un disque absent ou qui n'est pas ATA */
 File* ide_mknod(char* name,u32 flag,File* dev){
+	ide_drive* d;
+	if (flag>=IDE_NR_DRIVES)
+		return NULL;
+	if (ide_queue==NULL)
+		ide_init();
+	d=&ide_drives[flag];
+	if (ide_identify(flag,d)!=RETURN_OK){
+		io.print("ide: no disk %s \n",name);
+		return NULL;
+	}
+	io.print("ide: %s %s, %d MB, %s, multiple %d, %s \n",name,d->model,
+			(d->sectors>>11)|(d->sectors_hi<<21),d->lba48 ? "lba48" : "lba28",
+			d->multiple,(d->dma && ide_bm!=0) ? "dma" : "pio");
 	Ide* disk=new Ide(name);
 	disk->setId(flag);
 	return disk;
@@ -89,12 +555,14 @@ File* ide_mknod(char* name,u32 flag,File* dev){
 module("module.ide",MODULE_DEVICE,Ide,ide_mknod)
 
 Ide::~Ide(){
-	
+	kfree(scratch);
 }
 
 Ide::Ide(char* n) : Device(n)
 {
-	
+	scratch=(char*)kmalloc(IDE_SECTOR_SIZE);
+	spin_lock_init(&scratch_lock);
+	scratch_busy=0;
 }
 
 u32	Ide::close(){
@@ -109,28 +577,165 @@ u32	Ide::open(u32 flag){
 	return RETURN_OK;
 }
 
+u32 Ide::tryLockScratch(){
+	u32 ret;
+	u32 flags=spin_lock_irqsave(&scratch_lock);
+	ret=!scratch_busy;
+	if (ret)
+		scratch_busy=1;
+	spin_unlock_irqrestore(&scratch_lock,flags);
+	return ret;
+}
+
+void Ide::lockScratch(){
+	if (blk_can_sleep())
+		wait_event(scratch_wait,tryLockScratch());
+	else
+		while (!tryLockScratch());
+}
+
+void Ide::unlockScratch(){
+	u32 flags=spin_lock_irqsave(&scratch_lock);
+	scratch_busy=0;
+	spin_unlock_irqrestore(&scratch_lock,flags);
+	scratch_wait.wakeUp();
+}
+
+/* Read size bytes at offset of a sector through the scratch sector */
+int Ide::readPartial(u32 sector,u32 offset,u8* buffer,u32 size){
+	int ret;
+	lockScratch();
+	ret=bl_read(id,sector,1,scratch);
+	if (ret>=0)
+		memcpy((char*)buffer,scratch+offset,size);
+	unlockScratch();
+	return ret;
+}
+
+/*
+ *	Les secteurs entiers sont lus directement dans le buffer de l'appelant,
+ *	seuls le debut et la fin non alignes passent par le secteur de travail.
+ *	Un buffer utilisateur passe par un buffer du noyau : la fin du
+ *	transfert peut etre traitee par une IRQ dans un autre espace d'adressage.
+ */
 u32	Ide::read(u32 pos,u8* buffer,u32 sizee){
-	int count=(int)sizee;
+	u32 sector,offset,n,done=0;
+	int ret=0;
 	
 	if (buffer==NULL)
 		return -1;
+	if (sizee==0)
+		return 0;
 	
-	int offset=(int)pos;
-	int bl_begin, bl_end, blocks;
-
-	bl_begin = (offset/512);
-	bl_end = ((offset + count)/512);
-	blocks = bl_end - bl_begin + 1;
-	//io.print("%s> read at %d - %d  size=%d begin=%d blocks=%d\n",getName(),offset,offset/512,count,bl_begin,blocks);
-	char*bl_buffer = (char *) kmalloc(blocks * 512);
-	bl_read(id, bl_begin, blocks,bl_buffer);
-	memcpy((char*)buffer, (char *) ((int)bl_buffer + ((int)offset % (int)(512))), count);
-	kfree(bl_buffer);
-	return count;
+	if ((u32)buffer>=USER_OFFSET){
+		u8* kbuf=(u8*)kmalloc(sizee);
+		ret=read(pos,kbuf,sizee);
+		if ((int)ret>0)
+			memcpy((char*)buffer,(char*)kbuf,sizee);
+		kfree(kbuf);
+		return ret;
+	}
+	
+	trace(TRACE_IDE_READ, id, pos, sizee);
+	sector=pos/IDE_SECTOR_SIZE;
+	offset=pos%IDE_SECTOR_SIZE;
+	
+	if (offset!=0 || sizee<IDE_SECTOR_SIZE){
+		n=IDE_SECTOR_SIZE-offset;
+		if (n>sizee)
+			n=sizee;
+		ret=readPartial(sector,offset,buffer,n);
+		done+=n;
+		sector++;
+	}
+	
+	n=(sizee-done)/IDE_SECTOR_SIZE;
+	if (ret>=0 && n>0){
+		ret=bl_read(id,sector,n,(char*)buffer+done);
+		done+=n*IDE_SECTOR_SIZE;
+		sector+=n;
+	}
+	
+	if (ret>=0 && done<sizee)
+		ret=readPartial(sector,0,buffer+done,sizee-done);
+	trace(TRACE_IDE_READ_DONE, id, pos, sizee);
+	
+	if (ret<0)
+		return ret;
+	return sizee;
 }
 
+/* Read-modify-write of a part of a sector through the scratch sector */
+int Ide::writePartial(u32 sector,u32 offset,u8* buffer,u32 size){
+	int ret;
+	lockScratch();
+	ret=bl_read(id,sector,1,scratch);
+	if (ret>=0){
+		memcpy(scratch+offset,(char*)buffer,size);
+		ret=bl_write(id,sector,1,scratch);
+	}
+	unlockScratch();
+	return ret;
+}
+
+/*
+ *	Ecriture directe (le cache des blocs appelle write() pour vider ses
+ *	blocs sales) : meme decoupage que read(), les secteurs partiels sont
+ *	relus puis reecrits.
+ */
 u32	Ide::write(u32 pos,u8* buffer,u32 sizee){
-	return NOT_DEFINED;
+	u32 sector,offset,n,done=0;
+	int ret=0;
+	
+	if (buffer==NULL)
+		return -1;
+	if (sizee==0)
+		return 0;
+	
+	if ((u32)buffer>=USER_OFFSET){
+		u8* kbuf=(u8*)kmalloc(sizee);
+		memcpy((char*)kbuf,(char*)buffer,sizee);
+		ret=write(pos,kbuf,sizee);
+		kfree(kbuf);
+		return ret;
+	}
+	
+	sector=pos/IDE_SECTOR_SIZE;
+	offset=pos%IDE_SECTOR_SIZE;
+	
+	if (offset!=0 || sizee<IDE_SECTOR_SIZE){
+		n=IDE_SECTOR_SIZE-offset;
+		if (n>sizee)
+			n=sizee;
+		ret=writePartial(sector,offset,buffer,n);
+		done+=n;
+		sector++;
+	}
+	
+	n=(sizee-done)/IDE_SECTOR_SIZE;
+	if (ret>=0 && n>0){
+		ret=bl_write(id,sector,n,(char*)buffer+done);
+		done+=n*IDE_SECTOR_SIZE;
+		sector+=n;
+	}
+	
+	if (ret>=0 && done<sizee)
+		ret=writePartial(sector,0,buffer+done,sizee-done);
+	
+	if (ret<0)
+		return ret;
+	return sizee;
+}
+
+/* ATA FLUSH CACHE, queued after the waiting requests */
+int Ide::flush(){
+	blk_request r;
+	r.drive=id;
+	r.sector=0;
+	r.count=0;
+	r.buf=NULL;
+	r.dir=BLK_FLUSH;
+	return ide_queue->submit(&r);
 }
 
 u32	Ide::ioctl(u32 idd,u8* buffer){
@@ -148,6 +753,24 @@ u32	Ide::ioctl(u32 idd,u8* buffer){
 			ret=DEV_FORMAT_BLOCK;
 			break;
 			
+		case DEV_FLUSH_CACHE:
+			ret=flush();
+			break;
+			
+		case API_BLK_GET_STATS:
+			if (buffer==NULL)
+				return PARAM_NULL;
+			ide_queue->getStats((blk_stats*)buffer);
+			ret=RETURN_OK;
+			break;
+			
+		case API_BLK_GET_INFO:
+			if (buffer==NULL)
+				return PARAM_NULL;
+			getInfo((blk_info*)buffer);
+			ret=RETURN_OK;
+			break;
+			
 		default:
 			ret=NOT_DEFINED;
 			break;
@@ -162,6 +785,24 @@ u32	Ide::remove(){
 	return RETURN_OK;
 }
 
+void Ide::getInfo(blk_info* info){
+	ide_drive* d=&ide_drives[id];
+	memset((char*)info,0,sizeof(blk_info));
+	info->sectors=d->sectors;
+	info->sectors_hi=d->sectors_hi;
+	info->sector_size=IDE_SECTOR_SIZE;
+	info->max_sectors=d->lba48 ? IDE_MAX_SECTORS_EXT : IDE_MAX_SECTORS;
+	if (d->lba48)
+		info->flags|=BLK_INFO_LBA48;
+	if (d->dma && ide_bm!=0)
+		info->flags|=BLK_INFO_DMA;
+	info->multiple=d->multiple;
+	info->udma=d->udma;
+	info->mwdma=d->mwdma;
+	info->depth=1;
+	memcpy(info->model,d->model,sizeof(info->model));
+}
+
 void Ide::setId(u32 flag){
 	id=flag;
 }
@@ -5,6 +5,96 @@
 #include <runtime/types.h>
 #include <core/device.h>
 #include <io.h>
+#include <pci.h>
+#include <api/dev/blk.h>
+
+#define IDE_IRQ_PRIMARY		14
+#define IDE_NR_DRIVES		2		/* maitre et esclave du canal primaire */
+#define IDE_MAX_SECTORS		256		/* secteurs par commande (compteur 0 = 256) */
+#define IDE_MAX_SECTORS_EXT	65536	/* en LBA48 (compteur de 16 bits) */
+#define IDE_LBA28_MAX		0x0FFFFFFF
+#define IDE_MULTIPLE_MAX	16		/* secteurs par IRQ en READ/WRITE MULTIPLE */
+#define IDE_TIMEOUT			100000	/* lectures du registre d'etat a l'identification */
+#define IDE_PRD_MAX			(PAGESIZE / sizeof(ide_prd))	/* 2 par secteur au pire */
+#define IDE_SECTOR_SIZE		512
+
+#define IDE_PROGIF_BUSMASTER	0x80
+
+/* Registres du bus master (PCI IDE, BAR 4), canal primaire */
+#define BM_COMMAND			0x0
+#define BM_STATUS			0x2
+#define BM_PRDT				0x4
+
+#define BM_CMD_START		0x01
+#define BM_CMD_READ			0x08	/* disque vers memoire */
+#define BM_STATUS_ACTIVE	0x01
+#define BM_STATUS_ERR		0x02
+#define BM_STATUS_IRQ		0x04
+
+#define ATA_CMD_READ		0x20
+#define ATA_CMD_WRITE		0x30
+#define ATA_CMD_READ_DMA	0xC8
+#define ATA_CMD_WRITE_DMA	0xCA
+#define ATA_CMD_FLUSH_CACHE	0xE7
+#define ATA_CMD_READ_EXT		0x24
+#define ATA_CMD_READ_DMA_EXT	0x25
+#define ATA_CMD_READ_MULTIPLE_EXT	0x29
+#define ATA_CMD_WRITE_EXT		0x34
+#define ATA_CMD_WRITE_DMA_EXT	0x35
+#define ATA_CMD_WRITE_MULTIPLE_EXT	0x39
+#define ATA_CMD_READ_MULTIPLE	0xC4
+#define ATA_CMD_WRITE_MULTIPLE	0xC5
+#define ATA_CMD_SET_MULTIPLE	0xC6
+#define ATA_CMD_FLUSH_CACHE_EXT	0xEA
+#define ATA_CMD_IDENTIFY	0xEC
+#define ATA_SR_ERR			0x01
+#define ATA_SR_DRQ			0x08
+#define ATA_SR_DF			0x20
+#define ATA_SR_BSY			0x80
+
+/* Etat du canal (automate de l'IRQ) */
+#define IDE_IDLE			0
+#define IDE_DMA				1
+#define IDE_PIO_READ		2
+#define IDE_PIO_WRITE		3
+#define IDE_FLUSH			4
+
+#define PRD_EOT				0x8000
+
+/* Mots de la reponse a IDENTIFY DEVICE */
+#define ID_MODEL			27		/* 20 mots, octets inverses */
+#define ID_MODEL_LEN		40
+#define ID_MAX_MULTIPLE		47		/* octet bas */
+#define ID_CAPABILITIES		49
+#define ID_CAP_DMA			0x0100
+#define ID_FIELD_VALID		53
+#define ID_VALID_88			0x0004
+#define ID_LBA_SECTORS		60		/* 2 mots */
+#define ID_MWDMA			63
+#define ID_COMMAND_SET_2	83
+#define ID_CMD_LBA48		0x0400
+#define ID_UDMA				88
+#define ID_LBA48_SECTORS	100		/* 4 mots */
+
+/* Disque du canal, rempli par IDENTIFY DEVICE */
+struct ide_drive {
+	u32		present;
+	u32		lba48;
+	u32		dma;
+	u32		sectors;		/* capacite, 32 bits bas */
+	u32		sectors_hi;
+	u32		multiple;		/* secteurs par IRQ en PIO */
+	u32		mwdma;			/* modes multiword DMA supportes */
+	u32		udma;			/* modes ultra DMA supportes */
+	char	model[ID_MODEL_LEN + 1];
+};
+
+/* Entree de la table PRD : une zone physique du transfert */
+struct ide_prd {
+	u32		addr;
+	u16		count;		/* octets, 0 = 64 Ko */
+	u16		flags;
+} __attribute__ ((packed));
 
 class Ide : public Device
 {
@@ -22,9 +112,23 @@ class Ide : public Device
 		void	scan();
 		
 		void	setId(u32 flag);
+		void	getInfo(blk_info* info);
 		
 	private:
 		u32 id;
+		
+		/* secteur de travail des debuts et fins de lecture non alignes */
+		char*			scratch;
+		spinlock_t		scratch_lock;
+		volatile u32	scratch_busy;
+		WaitQueue		scratch_wait;
+		
+		u32		tryLockScratch();
+		void	lockScratch();
+		void	unlockScratch();
+		int		readPartial(u32 sector,u32 offset,u8* buffer,u32 size);
+		int		writePartial(u32 sector,u32 offset,u8* buffer,u32 size);
+		int		flush();
 
 };
 
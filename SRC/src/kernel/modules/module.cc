@@ -71,7 +71,6 @@ File* Module::install(char* dir,char* module,u32 flag,char* dev){
 	if (fdev==NULL)
 		return NULL;
 	int i=0;
-	File* fp;
 	while (module_builder[i] != 0){
 		if (!strcmp(module_builder[i]->module_name,module)){
 			if (module_builder[i]->module_type==MODULE_FILESYSTEM){
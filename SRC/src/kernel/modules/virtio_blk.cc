@@ -0,0 +1,538 @@
+
+#include <os.h>
+#include <virtio_blk.h>
+
+#include <api/dev/ioctl.h>
+
+/*
+ *	Disque virtio-blk (interface PCI legacy) : une seule virtqueue dont
+ *	l'anneau est partage avec l'hote. Chaque requete de la file
+ *	(core/blkqueue.h) occupe un emplacement : une table de descripteurs
+ *	indirecte (en-tete, zones du buffer, octet d'etat) referencee par un
+ *	seul descripteur de l'anneau, jusqu'a VBLK_MAX_DEPTH requetes a la fois.
+ *	Sans descripteurs indirects la chaine est construite dans l'anneau et
+ *	une seule requete est lancee a la fois.
+ *
+ *	Les requetes d'un meme lot sont publiees dans l'anneau disponible puis
+ *	l'hote est prevenu une fois (vblk_commit). L'IRQ parcourt l'anneau
+ *	des requetes terminees.
+ */
+static vblk_dev*	vblk_devs[VBLK_MAX_DEVICES];
+static u32			vblk_ndevs = 0;
+static u32			vblk_probed = 0;
+
+/* Les ecritures dans l'anneau sont visibles avant l'index qui les publie */
+static inline void vblk_wmb()
+{
+	__asm__ __volatile__("" : : : "memory");
+}
+
+/* Publication de l'index avant la lecture des drapeaux de l'hote */
+static inline void vblk_mb()
+{
+	__asm__ __volatile__("lock; addl $0, 0(%%esp)" : : : "memory");
+}
+
+/* Taille de l'anneau legacy : descripteurs et anneau disponible, puis anneau utilise aligne */
+static u32 vring_used_offset(u32 num)
+{
+	u32 off = num * sizeof(vring_desc) + sizeof(u16) * (3 + num);
+	return (off + VIRTIO_PCI_QUEUE_ALIGN - 1) & ~(VIRTIO_PCI_QUEUE_ALIGN - 1);
+}
+
+static u32 vring_size(u32 num)
+{
+	u32 used = sizeof(u16) * 3 + sizeof(vring_used_elem) * num;
+	return vring_used_offset(num) + ((used + VIRTIO_PCI_QUEUE_ALIGN - 1) & ~(VIRTIO_PCI_QUEUE_ALIGN - 1));
+}
+
+/*
+ *	Ajoute un buffer du noyau a une chaine de descripteurs : une entree
+ *	par page, les pages voisines en memoire physique sont fusionnees.
+ */
+static int vblk_add_desc(vring_desc* t, u32* n, u32 max, char* buf, u32 len, u16 flags)
+{
+	u32 i = *n, chunk, phys;
+
+	while (len > 0) {
+		chunk = PAGESIZE - ((u32) buf & (PAGESIZE - 1));
+		if (chunk > len)
+			chunk = len;
+		phys = (u32) get_p_addr(buf);
+		if (phys == 0)
+			return ERROR_PARAM;
+		if (i > 1 && t[i - 1].addr + t[i - 1].len == phys && t[i - 1].flags == (flags | VRING_DESC_F_NEXT))
+			t[i - 1].len += chunk;
+		else {
+			if (i == max)
+				return ERROR_PARAM;
+			t[i].addr = phys;
+			t[i].addr_hi = 0;
+			t[i].len = chunk;
+			t[i].flags = flags | VRING_DESC_F_NEXT;
+			t[i].next = i + 1;
+			i++;
+		}
+		buf += chunk;
+		len -= chunk;
+	}
+	*n = i;
+	return RETURN_OK;
+}
+
+/*
+ *	Chaine en-tete, donnees, etat de la requete r dans la table t
+ *	(verrou pris), retourne le nombre de descripteurs ou une erreur.
+ */
+static int vblk_build(vblk_dev* v, vblk_slot* s, vring_desc* t, u32 max, blk_request* r)
+{
+	u32 n = 0, base = (u32) get_p_addr((char*) s->hdr);
+	u16 flags = (r->dir == BLK_READ) ? VRING_DESC_F_WRITE : 0;
+	blk_request* m;
+
+	s->hdr->type = (r->dir == BLK_FLUSH) ? VIRTIO_BLK_T_FLUSH
+				 : (r->dir == BLK_WRITE) ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+	s->hdr->ioprio = 0;
+	s->hdr->sector = (r->dir == BLK_FLUSH) ? 0 : r->sector;
+	s->hdr->sector_hi = 0;
+	*s->status = 0xFF;
+
+	t[n].addr = base;
+	t[n].addr_hi = 0;
+	t[n].len = sizeof(vblk_req_hdr);
+	t[n].flags = VRING_DESC_F_NEXT;
+	t[n].next = 1;
+	n++;
+	if (r->dir != BLK_FLUSH)
+		for (m = r; m != NULL; m = m->merged)
+			if (vblk_add_desc(t, &n, max - 1, m->buf, m->count * VBLK_SECTOR_SIZE, flags) != RETURN_OK)
+				return ERROR_PARAM;
+	t[n].addr = base + sizeof(vblk_req_hdr);
+	t[n].addr_hi = 0;
+	t[n].len = 1;
+	t[n].flags = VRING_DESC_F_WRITE;
+	t[n].next = 0;
+	return n + 1;
+}
+
+/* Publie r dans l'anneau disponible, l'hote est prevenu par vblk_commit */
+static void vblk_start(BlkQueue* q, blk_request* r)
+{
+	vblk_dev* v = (vblk_dev*) q->getData();
+	vblk_slot* s;
+	u32 slot, head, flags;
+	int n;
+
+	flags = spin_lock_irqsave(&v->lock);
+	for (slot = 0; slot < v->depth; slot++)
+		if (!(v->busy & (1 << slot)))
+			break;
+	if (slot == v->depth) {
+		spin_unlock_irqrestore(&v->lock, flags);
+		q->complete(r, ERROR_PARAM);
+		return;
+	}
+	s = &v->slots[slot];
+	if (v->indirect) {
+		n = vblk_build(v, s, s->table, VBLK_INDIRECT_MAX, r);
+		head = slot;
+		if (n > 0) {
+			v->desc[head].addr = s->table_phys;
+			v->desc[head].addr_hi = 0;
+			v->desc[head].len = n * sizeof(vring_desc);
+			v->desc[head].flags = VRING_DESC_F_INDIRECT;
+			v->desc[head].next = 0;
+		}
+	}
+	else {
+		n = vblk_build(v, s, v->desc, v->num, r);
+		head = 0;
+	}
+	if (n < 0) {
+		spin_unlock_irqrestore(&v->lock, flags);
+		q->complete(r, n);
+		return;
+	}
+
+	s->req = r;
+	v->busy |= 1 << slot;
+	v->avail->ring[v->avail->idx % v->num] = head;
+	vblk_wmb();
+	v->avail->idx++;
+	v->kicks++;
+	spin_unlock_irqrestore(&v->lock, flags);
+}
+
+/* Une notification pour toutes les requetes publiees par le lot */
+static void vblk_commit(BlkQueue* q)
+{
+	vblk_dev* v = (vblk_dev*) q->getData();
+	u32 flags = spin_lock_irqsave(&v->lock);
+
+	vblk_mb();
+	if (v->kicks > 0 && !(v->used->flags & VRING_USED_F_NO_NOTIFY))
+		io.outw(v->iobase + VIRTIO_QUEUE_NOTIFY, 0);
+	v->kicks = 0;
+	spin_unlock_irqrestore(&v->lock, flags);
+}
+
+/* Termine les requetes rendues par l'hote dans l'anneau utilise */
+static void vblk_intr(vblk_dev* v)
+{
+	blk_request* done[VBLK_MAX_DEPTH];
+	int status[VBLK_MAX_DEPTH];
+	vring_used_elem* e;
+	u32 slot, n = 0, i, flags;
+
+	if (!v->msix)
+		io.inb(v->iobase + VIRTIO_ISR);		/* acquitte la ligne INTx */
+
+	flags = spin_lock_irqsave(&v->lock);
+	while (v->last_used != *(volatile u16*) &v->used->idx) {
+		e = &v->used->ring[v->last_used % v->num];
+		slot = v->indirect ? e->id : 0;
+		if (slot < v->depth && (v->busy & (1 << slot))) {
+			done[n] = v->slots[slot].req;
+			status[n++] = (*v->slots[slot].status == VIRTIO_BLK_S_OK) ? RETURN_OK : NOT_DEFINED;
+			v->slots[slot].req = NULL;
+			v->busy &= ~(1 << slot);
+		}
+		v->last_used++;
+	}
+	spin_unlock_irqrestore(&v->lock, flags);
+
+	for (i = 0; i < n; i++)
+		v->queue->complete(done[i], status[i]);
+}
+
+static void vblk_irq(u32 irq, void* data)
+{
+	vblk_intr((vblk_dev*) data);
+}
+
+static void vblk_poll(BlkQueue* q)
+{
+	vblk_intr((vblk_dev*) q->getData());
+}
+
+/* Avec MSI-X l'anneau 0 utilise l'entree 0, pas de message de configuration */
+static void vblk_msi_setup(pci_dev* d, u32 mode, void* data)
+{
+	vblk_dev* v = (vblk_dev*) data;
+
+	if (mode != PCI_IRQ_MSIX)
+		return;
+	io.outw(v->iobase + VIRTIO_MSI_CONFIG_VECTOR, VIRTIO_MSI_NO_VECTOR);
+	io.outw(v->iobase + VIRTIO_QUEUE_SEL, 0);
+	io.outw(v->iobase + VIRTIO_MSI_QUEUE_VECTOR, 0);
+	if (io.inw(v->iobase + VIRTIO_MSI_QUEUE_VECTOR) != 0) {
+		io.print("virtio-blk: no msi-x vector for the queue \n");
+		return;
+	}
+	v->msix = 1;
+}
+
+/*
+ *	Negociation (descripteurs indirects, flush), anneau de la virtqueue 0
+ *	et emplacements des requetes.
+ */
+static vblk_dev* vblk_setup(pci_dev* d)
+{
+	vblk_dev* v;
+	vblk_slot* s;
+	page* pg;
+	u32 io_base, phys, i, maxd;
+
+	if (!pci_bar_is_io(d, 0) || (io_base = pci_bar(d, 0)) == 0)
+		return NULL;
+	v = (vblk_dev*) kmalloc(sizeof(vblk_dev));
+	if (v == NULL)
+		return NULL;
+	memset((char*) v, 0, sizeof(vblk_dev));
+	spin_lock_init(&v->lock);
+	v->pdev = d;
+	v->iobase = io_base;
+	pci_set_command(d, PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+	io.outb(io_base + VIRTIO_STATUS, 0);
+	io.outb(io_base + VIRTIO_STATUS, VIRTIO_STATUS_ACK);
+	io.outb(io_base + VIRTIO_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+	v->features = io.inl(io_base + VIRTIO_HOST_FEATURES)
+				& (VIRTIO_BLK_F_RO | VIRTIO_BLK_F_FLUSH | VIRTIO_RING_F_INDIRECT_DESC);
+	io.outl(io_base + VIRTIO_GUEST_FEATURES, v->features);
+	v->sectors = io.inl(io_base + VIRTIO_CONFIG + VBLK_CONFIG_CAPACITY);
+	v->sectors_hi = io.inl(io_base + VIRTIO_CONFIG + VBLK_CONFIG_CAPACITY + 4);
+	v->indirect = (v->features & VIRTIO_RING_F_INDIRECT_DESC) ? 1 : 0;
+
+	io.outw(io_base + VIRTIO_QUEUE_SEL, 0);
+	v->num = io.inw(io_base + VIRTIO_QUEUE_NUM);
+	if (v->num == 0)
+		goto fail;
+	v->ring_pages = vring_size(v->num) / PAGESIZE;
+	v->ring = get_contig_pages(v->ring_pages, &phys);
+	if (v->ring == NULL)
+		goto fail;
+	memset(v->ring, 0, v->ring_pages * PAGESIZE);
+	v->desc = (vring_desc*) v->ring;
+	v->avail = (vring_avail*) (v->ring + v->num * sizeof(vring_desc));
+	v->used = (vring_used*) (v->ring + vring_used_offset(v->num));
+	v->avail->flags = 0;
+
+	v->depth = v->indirect ? VBLK_MAX_DEPTH : 1;
+	if (v->depth > v->num)
+		v->depth = v->num;
+	for (i = 0; i < v->depth; i++) {
+		s = &v->slots[i];
+		pg = get_page_from_heap();
+		if (pg == NULL)
+			goto fail;
+		s->table = (vring_desc*) pg->v_addr;
+		s->table_phys = (u32) pg->p_addr;
+		s->hdr = (vblk_req_hdr*) (pg->v_addr + VBLK_INDIRECT_MAX * sizeof(vring_desc));
+		s->status = (u8*) s->hdr + sizeof(vblk_req_hdr);
+		kfree(pg);
+	}
+
+	/* en-tete et etat, puis 2 descripteurs par secteur au pire */
+	maxd = (v->indirect ? VBLK_INDIRECT_MAX : v->num) - 2;
+	v->max_sectors = maxd / 2;
+	if (v->max_sectors == 0)
+		goto fail;
+
+	io.outl(io_base + VIRTIO_QUEUE_PFN, phys / VIRTIO_PCI_QUEUE_ALIGN);
+	v->queue = new BlkQueue(vblk_start, vblk_poll, v, v->max_sectors, v->depth);
+	v->queue->setCommit(vblk_commit);
+	if (pci_install_irq(d, vblk_irq, v, vblk_msi_setup) != RETURN_OK)
+		io.print("virtio-blk: no irq line, completions are polled \n");
+	io.outb(io_base + VIRTIO_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+	return v;
+
+fail:
+	io.outb(io_base + VIRTIO_STATUS, VIRTIO_STATUS_FAILED);
+	for (i = 0; i < VBLK_MAX_DEPTH; i++)
+		if (v->slots[i].table != NULL)
+			release_page_from_heap((char*) v->slots[i].table);
+	if (v->ring != NULL)
+		release_contig_pages(v->ring, v->ring_pages);
+	kfree(v);
+	return NULL;
+}
+
+static void vblk_init()
+{
+	pci_dev* d;
+	vblk_dev* v;
+	u32 i;
+
+	vblk_probed = 1;
+	for (i = 0; vblk_ndevs < VBLK_MAX_DEVICES && (d = pci_find_device(VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, i)) != NULL; i++)
+		if ((v = vblk_setup(d)) != NULL)
+			vblk_devs[vblk_ndevs++] = v;
+}
+
+
+/* flag : numero du disque virtio */
+File* vblk_mknod(char* name,u32 flag,File* dev){
+	vblk_dev* v;
+	if (!vblk_probed)
+		vblk_init();
+	if (flag>=vblk_ndevs)
+		return NULL;
+	v=vblk_devs[flag];
+	io.print("virtio-blk: %s %d MB, ring %d, %s %d, irq %d \n",name,
+			(v->sectors>>11)|(v->sectors_hi<<21),v->num,
+			v->indirect ? "indirect" : "direct",v->depth,v->pdev->irq);
+	VirtioBlk* disk=new VirtioBlk(name);
+	disk->setDev(v);
+	return disk;
+}
+
+module("module.virtio_blk",MODULE_DEVICE,VirtioBlk,vblk_mknod)
+
+VirtioBlk::~VirtioBlk(){
+
+}
+
+VirtioBlk::VirtioBlk(char* n) : Device(n)
+{
+	dev=NULL;
+}
+
+void VirtioBlk::setDev(vblk_dev* d){
+	dev=d;
+}
+
+u32	VirtioBlk::open(u32 flag){
+	return RETURN_OK;
+}
+
+u32	VirtioBlk::close(){
+	return RETURN_OK;
+}
+
+void VirtioBlk::scan(){
+
+}
+
+/* Requetes de max_sectors au plus, publiees en un seul lot */
+int VirtioBlk::rw(u32 sector,u32 count,char* buf,u32 dir){
+	blk_request* reqs;
+	u32 n,i,c;
+	int ret=RETURN_OK,st;
+
+	if (dir==BLK_WRITE && (dev->features & VIRTIO_BLK_F_RO))
+		return ERROR_PARAM;
+	if (dev->sectors_hi==0 && (sector>=dev->sectors || count>dev->sectors-sector))
+		return ERROR_PARAM;
+	n=(count+dev->max_sectors-1)/dev->max_sectors;
+	reqs=new blk_request[n];
+	if (reqs==NULL)
+		return ERROR_MEMORY;
+	dev->queue->plug();
+	for (i=0;i<n;i++){
+		c=(count>dev->max_sectors) ? dev->max_sectors : count;
+		reqs[i].drive=0;
+		reqs[i].sector=sector;
+		reqs[i].count=c;
+		reqs[i].buf=buf;
+		reqs[i].dir=dir;
+		dev->queue->queue(&reqs[i]);
+		sector+=c;
+		count-=c;
+		buf+=c*VBLK_SECTOR_SIZE;
+	}
+	dev->queue->unplug();
+	for (i=0;i<n;i++){
+		st=dev->queue->wait(&reqs[i]);
+		if (st!=RETURN_OK)
+			ret=st;
+	}
+	delete[] reqs;
+	return ret;
+}
+
+/*
+ *	Les secteurs entiers d'un buffer du noyau sont transferes directement,
+ *	sinon par un buffer du noyau : l'IRQ de fin peut arriver dans un autre
+ *	espace d'adressage. Une ecriture partielle relit ses secteurs de bord.
+ */
+u32	VirtioBlk::transfer(u32 pos,u8* buffer,u32 size,u32 dir){
+	u32 first,n,off;
+	char* kbuf;
+	int ret;
+
+	if (buffer==NULL)
+		return -1;
+	if (size==0)
+		return 0;
+	first=pos/VBLK_SECTOR_SIZE;
+	off=pos%VBLK_SECTOR_SIZE;
+	n=(off+size+VBLK_SECTOR_SIZE-1)/VBLK_SECTOR_SIZE;
+
+	if (off==0 && size%VBLK_SECTOR_SIZE==0 && (u32)buffer<USER_OFFSET){
+		ret=rw(first,n,(char*)buffer,dir);
+		return (ret<0) ? ret : size;
+	}
+
+	kbuf=(char*)kmalloc(n*VBLK_SECTOR_SIZE);
+	if (kbuf==NULL)
+		return ERROR_MEMORY;
+	ret=RETURN_OK;
+	if (dir==BLK_READ){
+		ret=rw(first,n,kbuf,BLK_READ);
+		if (ret==RETURN_OK)
+			memcpy((char*)buffer,kbuf+off,size);
+	}
+	else {
+		if (off!=0)
+			ret=rw(first,1,kbuf,BLK_READ);
+		if (ret==RETURN_OK && (off+size)%VBLK_SECTOR_SIZE!=0 && (n>1 || off==0))
+			ret=rw(first+n-1,1,kbuf+(n-1)*VBLK_SECTOR_SIZE,BLK_READ);
+		if (ret==RETURN_OK){
+			memcpy(kbuf+off,(char*)buffer,size);
+			ret=rw(first,n,kbuf,BLK_WRITE);
+		}
+	}
+	kfree(kbuf);
+	return (ret<0) ? ret : size;
+}
+
+u32	VirtioBlk::read(u32 pos,u8* buffer,u32 size){
+	return transfer(pos,buffer,size,BLK_READ);
+}
+
+u32	VirtioBlk::write(u32 pos,u8* buffer,u32 size){
+	return transfer(pos,buffer,size,BLK_WRITE);
+}
+
+/* VIRTIO_BLK_T_FLUSH quand l'hote le propose, rien a vider sinon */
+int VirtioBlk::flush(){
+	blk_request r;
+	if (!(dev->features & VIRTIO_BLK_F_FLUSH))
+		return RETURN_OK;
+	r.drive=0;
+	r.sector=0;
+	r.count=0;
+	r.buf=NULL;
+	r.dir=BLK_FLUSH;
+	return dev->queue->submit(&r);
+}
+
+void VirtioBlk::getInfo(blk_info* info){
+	memset((char*)info,0,sizeof(blk_info));
+	info->sectors=dev->sectors;
+	info->sectors_hi=dev->sectors_hi;
+	info->sector_size=VBLK_SECTOR_SIZE;
+	info->max_sectors=dev->max_sectors;
+	info->flags=BLK_INFO_DMA | BLK_INFO_LBA48;
+	if (dev->depth>1)
+		info->flags|=BLK_INFO_NCQ;
+	info->multiple=1;
+	info->depth=dev->depth;
+	memcpy(info->model,"virtio-blk",11);
+}
+
+u32	VirtioBlk::ioctl(u32 id,u8* buffer){
+	u32 ret=0;
+	switch (id){
+		case DEV_GET_TYPE:
+			ret=DEV_TYPE_DISK;
+			break;
+
+		case DEV_GET_STATE:
+			ret=DEV_STATE_OK;
+			break;
+
+		case DEV_GET_FORMAT:
+			ret=DEV_FORMAT_BLOCK;
+			break;
+
+		case DEV_FLUSH_CACHE:
+			ret=flush();
+			break;
+
+		case API_BLK_GET_STATS:
+			if (buffer==NULL)
+				return PARAM_NULL;
+			dev->queue->getStats((blk_stats*)buffer);
+			ret=RETURN_OK;
+			break;
+
+		case API_BLK_GET_INFO:
+			if (buffer==NULL)
+				return PARAM_NULL;
+			getInfo((blk_info*)buffer);
+			ret=RETURN_OK;
+			break;
+
+		default:
+			ret=NOT_DEFINED;
+			break;
+	}
+	return ret;
+}
+
+u32	VirtioBlk::remove(){
+	delete this;
+	return RETURN_OK;
+}
@@ -0,0 +1,162 @@
+#ifndef __VIRTIO_BLK__
+#define __VIRTIO_BLK__
+
+#include <runtime/types.h>
+#include <core/device.h>
+#include <io.h>
+#include <pci.h>
+#include <api/dev/blk.h>
+
+#define VIRTIO_VENDOR			0x1AF4
+#define VIRTIO_BLK_DEVICE		0x1001		/* legacy (transitional) */
+#define VBLK_MAX_DEVICES		4
+#define VBLK_SECTOR_SIZE		512
+#define VBLK_MAX_DEPTH			32			/* requetes lancees a la fois */
+#define VBLK_INDIRECT_MAX		240			/* descripteurs d'une table indirecte */
+
+/* Registres de l'interface PCI legacy (BAR 0, ports d'entree/sortie) */
+#define VIRTIO_HOST_FEATURES	0x00
+#define VIRTIO_GUEST_FEATURES	0x04
+#define VIRTIO_QUEUE_PFN		0x08
+#define VIRTIO_QUEUE_NUM		0x0C
+#define VIRTIO_QUEUE_SEL		0x0E
+#define VIRTIO_QUEUE_NOTIFY		0x10
+#define VIRTIO_STATUS			0x12
+#define VIRTIO_ISR				0x13
+#define VIRTIO_MSI_CONFIG_VECTOR	0x14	/* MSI-X actif seulement */
+#define VIRTIO_MSI_QUEUE_VECTOR		0x16
+#define VIRTIO_CONFIG			0x14	/* configuration du peripherique, 0x18 avec MSI-X */
+#define VIRTIO_MSI_NO_VECTOR	0xFFFF
+
+#define VIRTIO_STATUS_ACK		0x01
+#define VIRTIO_STATUS_DRIVER	0x02
+#define VIRTIO_STATUS_DRIVER_OK	0x04
+#define VIRTIO_STATUS_FAILED	0x80
+
+#define VIRTIO_ISR_QUEUE		0x01
+
+#define VIRTIO_PCI_QUEUE_ALIGN	4096
+
+/* Configuration virtio-blk */
+#define VBLK_CONFIG_CAPACITY	0x00	/* u64, secteurs de 512 octets */
+#define VBLK_CONFIG_SEG_MAX		0x0C
+
+#define VIRTIO_BLK_F_RO			(1 << 5)
+#define VIRTIO_BLK_F_FLUSH		(1 << 9)
+#define VIRTIO_RING_F_INDIRECT_DESC	(1 << 28)
+
+#define VIRTIO_BLK_T_IN			0
+#define VIRTIO_BLK_T_OUT		1
+#define VIRTIO_BLK_T_FLUSH		4
+
+#define VIRTIO_BLK_S_OK			0
+
+/* Anneau virtio */
+#define VRING_DESC_F_NEXT		1
+#define VRING_DESC_F_WRITE		2	/* ecrit par le peripherique */
+#define VRING_DESC_F_INDIRECT	4
+#define VRING_USED_F_NO_NOTIFY	1
+#define VRING_AVAIL_F_NO_INTERRUPT	1
+
+struct vring_desc {
+	u32		addr;
+	u32		addr_hi;
+	u32		len;
+	u16		flags;
+	u16		next;
+} __attribute__ ((packed));
+
+struct vring_avail {
+	u16		flags;
+	u16		idx;
+	u16		ring[];
+} __attribute__ ((packed));
+
+struct vring_used_elem {
+	u32		id;
+	u32		len;
+} __attribute__ ((packed));
+
+struct vring_used {
+	u16				flags;
+	u16				idx;
+	vring_used_elem	ring[];
+} __attribute__ ((packed));
+
+/* En-tete d'une requete, lu par le peripherique */
+struct vblk_req_hdr {
+	u32		type;
+	u32		ioprio;
+	u32		sector;
+	u32		sector_hi;
+} __attribute__ ((packed));
+
+class BlkQueue;
+struct blk_request;
+
+/*
+ *	Un emplacement par requete lancee : une page avec la table de
+ *	descripteurs indirecte, l'en-tete et l'octet d'etat de la requete.
+ */
+struct vblk_slot {
+	vring_desc*		table;
+	u32				table_phys;
+	vblk_req_hdr*	hdr;
+	u8*				status;
+	blk_request*	req;
+};
+
+struct vblk_dev {
+	pci_dev*		pdev;
+	u32				iobase;
+	u32				features;
+	u32				sectors;
+	u32				sectors_hi;
+	u32				seg_max;
+
+	/* virtqueue 0 */
+	char*			ring;
+	u32				ring_pages;
+	u32				num;			/* descripteurs de l'anneau */
+	vring_desc*		desc;
+	vring_avail*	avail;
+	vring_used*		used;
+	u16				last_used;
+	u16				kicks;			/* requetes publiees depuis la derniere notification */
+
+	vblk_slot		slots[VBLK_MAX_DEPTH];
+	u32				busy;			/* emplacements lances */
+	u32				depth;
+	u32				max_sectors;
+	u32				indirect;
+	u32				msix;
+	spinlock_t		lock;
+	BlkQueue*		queue;
+};
+
+class VirtioBlk : public Device
+{
+	public:
+		VirtioBlk(char* n);
+		~VirtioBlk();
+
+		u32		open(u32 flag);
+		u32		close();
+		u32		read(u32 pos,u8* buffer,u32 size);
+		u32		write(u32 pos,u8* buffer,u32 size);
+		u32		ioctl(u32 id,u8* buffer);
+		u32		remove();
+		void	scan();
+
+		void	setDev(vblk_dev* d);
+
+	private:
+		vblk_dev*	dev;
+
+		int		rw(u32 sector,u32 count,char* buf,u32 dir);
+		u32		transfer(u32 pos,u8* buffer,u32 size,u32 dir);
+		int		flush();
+		void	getInfo(blk_info* info);
+};
+
+#endif
@@ -7,6 +7,9 @@
 
 
 u8 X86Serial::init_serial=0;
+u8 X86Serial::rx_buf[SERIAL_RX_SIZE];
+volatile u32 X86Serial::rx_head=0;
+volatile u32 X86Serial::rx_tail=0;
 
 File* x86serial_mknod(char* name,u32 flag,File* dev){
 	X86Serial* cons=new X86Serial(name);
@@ -26,13 +29,27 @@ X86Serial::X86Serial(char* n) : Device(n)
 
 
 void X86Serial::putc(char c){
-	while(io.inb(COM1 + 5) & 0x20 == 0 );
+	while((io.inb(COM1 + 5) & 0x20) == 0 );
 		io.outb(COM1,c);
 }
 
+/* Vide le FIFO de l'UART dans le tampon de reception */
+void X86Serial::irq(u32 irq,void* data){
+	while (io.inb(COM1 + 5) & 0x1){
+		u8 c=io.inb(COM1);
+		if (rx_head - rx_tail < SERIAL_RX_SIZE){
+			rx_buf[rx_head & (SERIAL_RX_SIZE-1)]=c;
+			rx_head++;
+		}
+	}
+}
+
 char X86Serial::getc(){
-	while(io.inb(COM1 + 5) & 0x1 == 0 );
-	return (char)io.inb(COM1);
+	char c;
+	while (rx_head == rx_tail);
+	c=(char)rx_buf[rx_tail & (SERIAL_RX_SIZE-1)];
+	rx_tail++;
+	return c;
 }
 
 u32	X86Serial::open(u32 flag){
@@ -43,7 +60,9 @@ u32	X86Serial::open(u32 flag){
 		io.outb( COM1 + 1,	0x00 ); 
 		io.outb( COM1 + 3, 0x03 );	
 		io.outb( COM1 + 2, 0xC7 );	
-		io.outb( COM1 + 4, 0x0B );	
+		io.outb( COM1 + 4, 0x0B );	/* DTR, RTS et OUT2 (ligne IRQ) */
+		arch.install_irq(IRQ_COM1,X86Serial::irq,NULL);
+		io.outb( COM1 + 1, 0x01 );	/* interruption en reception */
 		init_serial=1;
 	}
 	return RETURN_OK;
@@ -15,6 +15,8 @@
 #define COM4 	   2E8 	
 #define IRQ_COM4   3
 
+#define SERIAL_RX_SIZE	256		/* tampon de reception (puissance de 2) */
+
 
 class X86Serial : public Device
 {
@@ -33,8 +35,13 @@ class X86Serial : public Device
 		u32		remove();
 		void	scan();
 		
+		static void	irq(u32 irq,void* data);	/* reception, en contexte IRQ */
+		
 	private:
 		static u8 init_serial;
+		static u8 rx_buf[SERIAL_RX_SIZE];
+		static volatile u32 rx_head;
+		static volatile u32 rx_tail;
 };
 
 #endif
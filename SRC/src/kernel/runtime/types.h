@@ -67,6 +67,11 @@ enum{
  */
 typedef void (*int_handler)(void);
 
+/*
+ *	IRQ handler : numero de la ligne et donnee passee a l'installation
+ */
+typedef void (*irq_handler)(u32 irq,void* data);
+
 
 #define NULL 0
 #define true 1
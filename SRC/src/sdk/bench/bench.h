@@ -0,0 +1,125 @@
+#ifndef __BENCH__
+#define __BENCH__
+
+/*
+ *	Minimal freestanding runtime for the benchmarks : raw syscalls,
+ *	rdtsc and decimal output on stdout.
+ */
+
+#define SYS_exit	1
+#define SYS_read	3
+#define SYS_write	4
+#define SYS_open	5
+#define SYS_close	6
+#define SYS_wait4	7
+#define SYS_execve	11
+#define SYS_getpid	20
+#define SYS_ioctl	54
+
+typedef unsigned int		u32;
+typedef unsigned long long	u64;
+
+static inline u64 rdtsc(void)
+{
+	u32 lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((u64) hi << 32) | lo;
+}
+
+static inline int sys_int80(int num, u32 a, u32 b, u32 c)
+{
+	int ret;
+	asm volatile("int $0x80"
+		: "=a"(ret)
+		: "a"(num), "b"(a), "c"(b), "d"(c)
+		: "memory");
+	return ret;
+}
+
+/* see api/kernel/syscall.h for the sysenter convention */
+static inline int sys_sysenter(int num, u32 a, u32 b, u32 c)
+{
+	int ret;
+	asm volatile("push %%ebp\n\t"
+		"push $1f\n\t"
+		"mov %%esp, %%ebp\n\t"
+		"sysenter\n"
+		"1:\n\t"
+		"pop %%ebp"
+		: "=a"(ret), "+c"(b), "+d"(c)
+		: "a"(num), "b"(a)
+		: "memory");
+	return ret;
+}
+
+/* 64 bits division without libgcc, returns the remainder */
+static u32 divmod64(u64* n, u32 d)
+{
+	u64 q = 0, r = 0;
+	int i;
+
+	for (i = 63; i >= 0; i--) {
+		r = (r << 1) | ((*n >> i) & 1);
+		if (r >= d) {
+			r -= d;
+			q |= (u64) 1 << i;
+		}
+	}
+	*n = q;
+	return (u32) r;
+}
+
+static inline int has_sysenter(void)
+{
+	u32 a, b, c, d;
+	asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(1));
+	return (d >> 11) & 1;
+}
+
+static int bench_strlen(const char* s)
+{
+	int n = 0;
+	while (s[n])
+		n++;
+	return n;
+}
+
+static void bench_puts(const char* s)
+{
+	sys_int80(SYS_write, 1, (u32) s, bench_strlen(s));
+}
+
+static void bench_putu(u64 v)
+{
+	char buf[24];
+	int i = sizeof(buf) - 1;
+
+	buf[i] = 0;
+	do {
+		buf[--i] = '0' + (char) divmod64(&v, 10);
+	} while (v && i > 0);
+	bench_puts(&buf[i]);
+}
+
+static void bench_putx(u32 v)
+{
+	char buf[11];
+	int i;
+
+	buf[0] = '0';
+	buf[1] = 'x';
+	for (i = 0; i < 8; i++)
+		buf[2 + i] = "0123456789abcdef"[(v >> (28 - 4 * i)) & 0xF];
+	buf[10] = 0;
+	bench_puts(buf);
+}
+
+int main(int argc, char** argv);
+
+void _start(int argc, char** argv)
+{
+	sys_int80(SYS_exit, main(argc, argv), 0, 0);
+	for (;;);
+}
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ *	blkbench : read throughput of the block devices through read(), the
+ *	block cache being emptied before each test. Sequential reads of 64 KB
+ *	from the start of the disk, then random 4 KB reads over the disk (2 GB
+ *	at most, file positions are 32 bits). The cpu frequency is measured
+ *	against the seconds of /dev/clock to give KB/s.
+ *
+ *	usage : blkbench [seq MB] [random reads] [device...]
+ *	        blkbench 16 1000 /dev/hda /dev/vda
+ */
+
+#include "bench.h"
+#include "../../kernel/core/api/dev/blk.h"
+#include "../../kernel/core/api/dev/bcache.h"
+#include "../../kernel/core/api/dev/clock.h"
+
+#define SYS_lseek		19
+
+#define DEFAULT_SEQ_MB	16
+#define DEFAULT_RAND	1000
+#define SEQ_CHUNK		65536
+#define RAND_CHUNK		4096
+#define MAX_SPAN		0x7FFFF000
+
+static char buf[SEQ_CHUNK];
+static u32 khz;
+
+static u32 atou(const char* s)
+{
+	u32 v = 0;
+	while (*s >= '0' && *s <= '9')
+		v = v * 10 + (*s++ - '0');
+	return v;
+}
+
+static u32 clock_seconds(int fd)
+{
+	struct clock_info c;
+	sys_int80(SYS_ioctl, fd, API_CLOCK_GET_INFO, (u32) &c);
+	return c.s;
+}
+
+/* tsc cycles between two changes of the rtc second */
+static u32 calibrate(void)
+{
+	int fd = sys_int80(SYS_open, (u32) "/dev/clock", 0, 0);
+	u32 s;
+	u64 t;
+
+	if (fd < 0)
+		return 0;
+	s = clock_seconds(fd);
+	while (clock_seconds(fd) == s);
+	s = clock_seconds(fd);
+	t = rdtsc();
+	while (clock_seconds(fd) == s);
+	t = rdtsc() - t;
+	sys_int80(SYS_close, fd, 0, 0);
+	divmod64(&t, 1000);
+	return (u32) t;
+}
+
+static void drop_cache(void)
+{
+	int fd = sys_int80(SYS_open, (u32) "/sys/bcache", 0, 0);
+	if (fd < 0)
+		return;
+	sys_int80(SYS_ioctl, fd, API_BCACHE_FLUSH, 0);
+	sys_int80(SYS_close, fd, 0, 0);
+}
+
+static u32 elapsed_ms(u64 cycles)
+{
+	divmod64(&cycles, khz);
+	return cycles ? (u32) cycles : 1;
+}
+
+static void report(const char* dev, const char* test, u32 kb, u32 ops, u64 cycles, struct blk_stats* a, struct blk_stats* b)
+{
+	u32 ms = elapsed_ms(cycles);
+	u64 v;
+
+	bench_puts(dev);
+	bench_puts(test);
+	bench_putu(kb);
+	bench_puts(" KB  ");
+	bench_putu(ms);
+	bench_puts(" ms  ");
+	v = (u64) kb * 1000;
+	divmod64(&v, ms);
+	bench_putu(v);
+	bench_puts(" KB/s  ");
+	v = (u64) ops * 1000;
+	divmod64(&v, ms);
+	bench_putu(v);
+	bench_puts(" ops/s  cmds ");
+	bench_putu(b->dispatched - a->dispatched);
+	bench_puts(" merges ");
+	bench_putu(b->merges - a->merges);
+	bench_puts(" max depth ");
+	bench_putu(b->max_depth);
+	bench_puts("\n");
+}
+
+static void run(const char* dev, u32 seq_mb, u32 nrand)
+{
+	struct blk_info info;
+	struct blk_stats a, b;
+	u32 span, i, n, seed = 0x12345678;
+	int fd;
+	u64 t;
+
+	fd = sys_int80(SYS_open, (u32) dev, 0, 0);
+	if (fd < 0 || sys_int80(SYS_ioctl, fd, API_BLK_GET_INFO, (u32) &info) != 0) {
+		bench_puts(dev);
+		bench_puts(" : not a block device\n");
+		if (fd >= 0)
+			sys_int80(SYS_close, fd, 0, 0);
+		return;
+	}
+	span = (info.sectors_hi != 0 || info.sectors > MAX_SPAN / 512) ? MAX_SPAN : info.sectors * 512;
+	span &= ~(SEQ_CHUNK - 1);
+	if (seq_mb * 1024 * 1024 > span)
+		seq_mb = span / (1024 * 1024);
+
+	drop_cache();
+	sys_int80(SYS_ioctl, fd, API_BLK_GET_STATS, (u32) &a);
+	sys_int80(SYS_lseek, fd, 0, 0);
+	n = seq_mb * (1024 * 1024 / SEQ_CHUNK);
+	t = rdtsc();
+	for (i = 0; i < n; i++)
+		if (sys_int80(SYS_read, fd, (u32) buf, SEQ_CHUNK) != SEQ_CHUNK)
+			break;
+	t = rdtsc() - t;
+	sys_int80(SYS_ioctl, fd, API_BLK_GET_STATS, (u32) &b);
+	report(dev, "  seq   ", i * (SEQ_CHUNK / 1024), i, t, &a, &b);
+
+	drop_cache();
+	sys_int80(SYS_ioctl, fd, API_BLK_GET_STATS, (u32) &a);
+	t = rdtsc();
+	for (i = 0; i < nrand; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		sys_int80(SYS_lseek, fd, (seed % (span / RAND_CHUNK)) * RAND_CHUNK, 0);
+		if (sys_int80(SYS_read, fd, (u32) buf, RAND_CHUNK) != RAND_CHUNK)
+			break;
+	}
+	t = rdtsc() - t;
+	sys_int80(SYS_ioctl, fd, API_BLK_GET_STATS, (u32) &b);
+	report(dev, "  rand  ", i * (RAND_CHUNK / 1024), i, t, &a, &b);
+
+	sys_int80(SYS_close, fd, 0, 0);
+}
+
+int main(int argc, char** argv)
+{
+	u32 seq_mb = DEFAULT_SEQ_MB, nrand = DEFAULT_RAND;
+	int i;
+
+	if (argc > 1 && atou(argv[1]) > 0)
+		seq_mb = atou(argv[1]);
+	if (argc > 2 && atou(argv[2]) > 0)
+		nrand = atou(argv[2]);
+
+	khz = calibrate();
+	if (khz == 0) {
+		bench_puts("blkbench : no /dev/clock\n");
+		return 1;
+	}
+	bench_puts("cpu ");
+	bench_putu(khz / 1000);
+	bench_puts(" MHz\n");
+
+	if (argc > 3)
+		for (i = 3; i < argc; i++)
+			run(argv[i], seq_mb, nrand);
+	else {
+		run("/dev/hda", seq_mb, nrand);
+		run("/dev/vda", seq_mb, nrand);
+	}
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *	ipcbench : round trip of the synchronous IPC. The parent starts a
+ *	server (itself with -s) answering every ipc_call, then measures the
+ *	call/reply round trip with register-only messages and with a long
+ *	part copied from one address space to the other.
+ *
+ *	usage : ipcbench [iterations]
+ */
+
+#include "bench.h"
+
+#define SYS_ipc_receive	98
+#define SYS_ipc_call	99
+#define SYS_ipc_reply	100
+
+#define IPC_ANY			0xFFFFFFFF
+#define MSG_QUIT		0xFFFFFFFF
+
+#define DEFAULT_LOOPS	20000
+#define MAX_LEN			4096
+
+/* see api/kernel/ipc.h */
+struct ipc_buf {
+	void*	send;
+	u32		send_len;
+	void*	recv;
+	u32		recv_max;
+	u32		recv_len;
+};
+
+static char* self = "/bin/ipcbench";
+static char sbuf[MAX_LEN], rbuf[MAX_LEN];
+
+/* pid in ebx, message words in edi and esi, all three are returned */
+static inline int sys_ipc(int num, u32* pid, struct ipc_buf* buf, u32* mr)
+{
+	int ret;
+	asm volatile("int $0x80"
+		: "=a"(ret), "+b"(*pid), "+D"(mr[0]), "+S"(mr[1])
+		: "a"(num), "c"(buf)
+		: "edx", "memory");
+	return ret;
+}
+
+static u32 atou(const char* s)
+{
+	u32 v = 0;
+	while (*s >= '0' && *s <= '9')
+		v = v * 10 + (*s++ - '0');
+	return v;
+}
+
+/* echo server : the reply carries the request back */
+static int server(void)
+{
+	struct ipc_buf b;
+	u32 pid, mr[2];
+
+	for (;;) {
+		b.send = 0;
+		b.send_len = 0;
+		b.recv = rbuf;
+		b.recv_max = MAX_LEN;
+		pid = IPC_ANY;
+		if (sys_ipc(SYS_ipc_receive, &pid, &b, mr) < 0)
+			return 1;
+		b.send = rbuf;
+		b.send_len = b.recv_len;
+		b.recv = 0;
+		b.recv_max = 0;
+		sys_ipc(SYS_ipc_reply, &pid, &b, mr);
+		if (mr[0] == MSG_QUIT)
+			return 0;
+	}
+}
+
+static u64 run(u32 srv, u32 len, u32 loops)
+{
+	struct ipc_buf b;
+	u64 start, best = (u64) -1;
+	u32 i, pass, pid, mr[2];
+
+	b.send = sbuf;
+	b.send_len = len;
+	b.recv = rbuf;
+	b.recv_max = MAX_LEN;
+
+	/* best of 3 to filter the timer interrupts */
+	for (pass = 0; pass < 3; pass++) {
+		start = rdtsc();
+		for (i = 0; i < loops; i++) {
+			pid = srv;
+			mr[0] = i;
+			mr[1] = 0;
+			if (sys_ipc(SYS_ipc_call, &pid, &b, mr) < 0)
+				return 0;
+		}
+		start = rdtsc() - start;
+		if (start < best)
+			best = start;
+	}
+	divmod64(&best, loops);
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	char* sargv[3] = { "ipcbench", "-s", 0 };
+	char* envp[1] = { 0 };
+	static const u32 lens[] = { 0, 64, 1024, 4096 };
+	u32 loops = DEFAULT_LOOPS, srv, pid, mr[2], i;
+	struct ipc_buf b;
+	u64 t;
+
+	if (argc > 1 && argv[1][0] == '-' && argv[1][1] == 's')
+		return server();
+	if (argc > 1 && atou(argv[1]) > 0)
+		loops = atou(argv[1]);
+
+	srv = sys_int80(SYS_execve, (u32) self, (u32) sargv, (u32) envp);
+	if ((int) srv <= 0) {
+		bench_puts("ipcbench : cannot start the server\n");
+		return 1;
+	}
+
+	bench_puts("bytes  cycles/round trip\n");
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		t = run(srv, lens[i], loops);
+		bench_putu(lens[i]);
+		bench_puts("      ");
+		bench_putu(t);
+		bench_puts("\n");
+	}
+
+	b.send = 0;
+	b.send_len = 0;
+	b.recv = 0;
+	b.recv_max = 0;
+	pid = srv;
+	mr[0] = MSG_QUIT;
+	mr[1] = 0;
+	sys_ipc(SYS_ipc_call, &pid, &b, mr);
+	sys_int80(SYS_wait4, srv, 0, 0);
+	return 0;
+}
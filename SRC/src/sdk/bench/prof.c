@@ -0,0 +1,110 @@
+/*
+ *	prof : control of the kernel sampling profiler (/sys/profile).
+ *
+ *	usage : prof start [rtc] [pid] | stop | reset | info | dump
+ *
+ *	dump prints one line per distinct stack :
+ *		pid count k|u pc0 pc1 ...
+ *	pc0 is the interrupted eip, then the return addresses. The output is
+ *	symbolised on the host with sdk/prof/profsym.
+ */
+
+#include "bench.h"
+#include "../../kernel/core/api/dev/prof.h"
+
+#define CHUNK	32
+
+static struct prof_sample samples[CHUNK];
+
+static u32 atou(const char* s)
+{
+	u32 v = 0;
+	while (*s >= '0' && *s <= '9')
+		v = v * 10 + (*s++ - '0');
+	return v;
+}
+
+static int streq(const char* a, const char* b)
+{
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+static void dump(int fd)
+{
+	int n, i, j;
+
+	while ((n = sys_int80(SYS_read, fd, (u32) samples, sizeof(samples))) > 0) {
+		n /= sizeof(struct prof_sample);
+		for (i = 0; i < n; i++) {
+			bench_putu(samples[i].pid);
+			bench_puts(" ");
+			bench_putu(samples[i].count);
+			bench_puts(samples[i].user ? " u" : " k");
+			for (j = 0; j < samples[i].depth; j++) {
+				bench_puts(" ");
+				bench_putx(samples[i].pc[j]);
+			}
+			bench_puts("\n");
+		}
+	}
+}
+
+static void info(int fd)
+{
+	struct prof_info pi;
+
+	sys_int80(SYS_ioctl, fd, API_PROF_GET_INFO, (u32) &pi);
+	bench_puts(pi.running ? "running" : "stopped");
+	bench_puts(pi.source == PROF_SRC_RTC ? ", rtc " : ", timer ");
+	bench_putu(pi.hz);
+	bench_puts(" Hz, samples ");
+	bench_putu(pi.samples);
+	bench_puts(", dropped ");
+	bench_putu(pi.dropped);
+	bench_puts(", stacks ");
+	bench_putu(pi.entries);
+	bench_puts("\n");
+}
+
+int main(int argc, char** argv)
+{
+	struct prof_config cfg;
+	int fd, i;
+
+	if (argc < 2) {
+		bench_puts("usage: prof start [rtc] [pid] | stop | reset | info | dump\n");
+		return 1;
+	}
+	fd = sys_int80(SYS_open, (u32) "/sys/profile", 0, 0);
+	if (fd < 0) {
+		bench_puts("prof: no /sys/profile\n");
+		return 1;
+	}
+
+	if (streq(argv[1], "start")) {
+		cfg.source = PROF_SRC_TIMER;
+		cfg.pid = 0;
+		for (i = 2; i < argc; i++) {
+			if (streq(argv[i], "rtc"))
+				cfg.source = PROF_SRC_RTC;
+			else
+				cfg.pid = atou(argv[i]);
+		}
+		if (sys_int80(SYS_ioctl, fd, API_PROF_START, (u32) &cfg) != 0)
+			bench_puts("prof: cannot start\n");
+	} else if (streq(argv[1], "stop"))
+		sys_int80(SYS_ioctl, fd, API_PROF_STOP, 0);
+	else if (streq(argv[1], "reset"))
+		sys_int80(SYS_ioctl, fd, API_PROF_RESET, 0);
+	else if (streq(argv[1], "info"))
+		info(fd);
+	else if (streq(argv[1], "dump"))
+		dump(fd);
+
+	sys_int80(SYS_close, fd, 0, 0);
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ *	smpbench : scaling of N cpu-bound processes. For N = 1 .. max the
+ *	parent starts N workers (itself with -w) doing the same amount of
+ *	work each and waits for them ; with N processors the elapsed time
+ *	should stay close to the time of one worker.
+ *
+ *	usage : smpbench [max] [work]
+ *	        qemu -smp 4 ... then smpbench 4
+ */
+
+#include "bench.h"
+
+#define DEFAULT_MAX		4
+#define DEFAULT_WORK	"50000000"
+#define MAX_WORKERS		16
+
+static char* self = "/bin/smpbench";
+
+static u32 atou(const char* s)
+{
+	u32 v = 0;
+	while (*s >= '0' && *s <= '9')
+		v = v * 10 + (*s++ - '0');
+	return v;
+}
+
+/* pure integer work, no syscall */
+static u32 spin(u32 work)
+{
+	volatile u32 acc = 0;
+	u32 i;
+
+	for (i = 0; i < work; i++)
+		acc += i ^ (acc >> 3);
+	return acc;
+}
+
+static u64 run(u32 n, char* work)
+{
+	char* argv[4] = { "smpbench", "-w", work, 0 };
+	char* envp[1] = { 0 };
+	int pids[MAX_WORKERS];
+	u64 start;
+	u32 i;
+
+	start = rdtsc();
+	for (i = 0; i < n; i++)
+		pids[i] = sys_int80(SYS_execve, (u32) self, (u32) argv, (u32) envp);
+	for (i = 0; i < n; i++)
+		if (pids[i] > 0)
+			sys_int80(SYS_wait4, pids[i], 0, 0);
+	return rdtsc() - start;
+}
+
+int main(int argc, char** argv)
+{
+	u32 max = DEFAULT_MAX, n, frac;
+	char* work = DEFAULT_WORK;
+	u64 t, t1 = 0, s;
+
+	if (argc > 2 && argv[1][0] == '-' && argv[1][1] == 'w') {
+		spin(atou(argv[2]));
+		return 0;
+	}
+
+	if (argc > 1 && atou(argv[1]) > 0)
+		max = atou(argv[1]);
+	if (max > MAX_WORKERS)
+		max = MAX_WORKERS;
+	if (argc > 2 && atou(argv[2]) > 0)
+		work = argv[2];
+
+	bench_puts("workers  Mcycles  speedup\n");
+	for (n = 1; n <= max; n++) {
+		t = run(n, work);
+		divmod64(&t, 1000000);		/* Mcycles */
+		if (n == 1)
+			t1 = t;
+
+		bench_putu(n);
+		bench_puts("        ");
+		bench_putu(t);
+		bench_puts("      ");
+
+		/* speedup = n * t1 / t, in hundredths */
+		if (t) {
+			s = t1 * n * 100;
+			divmod64(&s, (u32) t);
+			frac = divmod64(&s, 100);
+			bench_putu(s);
+			bench_puts(frac < 10 ? ".0" : ".");
+			bench_putu(frac);
+		}
+		bench_puts("\n");
+	}
+	return 0;
+}
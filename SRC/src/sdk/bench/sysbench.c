@@ -0,0 +1,73 @@
+/*
+ *	sysbench : round-trip latency of a null syscall (getpid) through
+ *	int 0x80 and through sysenter/sysexit.
+ *
+ *	usage : sysbench [iterations]
+ */
+
+#include "bench.h"
+
+#define DEFAULT_LOOPS	100000
+
+static u32 atou(const char* s)
+{
+	u32 v = 0;
+	while (*s >= '0' && *s <= '9')
+		v = v * 10 + (*s++ - '0');
+	return v;
+}
+
+static u64 run(int fast, u32 loops)
+{
+	u64 start, best = (u64) -1;
+	u32 i, pass;
+
+	/* best of 3 to filter the timer interrupts */
+	for (pass = 0; pass < 3; pass++) {
+		start = rdtsc();
+		if (fast)
+			for (i = 0; i < loops; i++)
+				sys_sysenter(SYS_getpid, 0, 0, 0);
+		else
+			for (i = 0; i < loops; i++)
+				sys_int80(SYS_getpid, 0, 0, 0);
+		start = rdtsc() - start;
+		if (start < best)
+			best = start;
+	}
+	divmod64(&best, loops);
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	u32 loops = DEFAULT_LOOPS;
+	u64 slow, fast;
+
+	if (argc > 1 && atou(argv[1]) > 0)
+		loops = atou(argv[1]);
+
+	slow = run(0, loops);
+	bench_puts("int 0x80 : ");
+	bench_putu(slow);
+	bench_puts(" cycles/call\n");
+
+	if (!has_sysenter()) {
+		bench_puts("sysenter : not supported by this cpu\n");
+		return 0;
+	}
+
+	fast = run(1, loops);
+	bench_puts("sysenter : ");
+	bench_putu(fast);
+	bench_puts(" cycles/call\n");
+
+	if (fast) {
+		bench_puts("speedup  : ");
+		slow *= 100;
+		divmod64(&slow, (u32) fast);
+		bench_putu(slow);
+		bench_puts("%\n");
+	}
+	return 0;
+}
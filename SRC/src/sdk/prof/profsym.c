@@ -0,0 +1,202 @@
+/*
+ *	profsym : symbolise a dump of the kernel profiler (prof dump) on the
+ *	host, against the symbol lists printed by nm -n.
+ *
+ *	usage : profsym [-f] [-u user.sym] kernel.sym dump.txt
+ *
+ *		kernel.sym	`make debug` in the kernel tree (nm -n kernel.elf)
+ *		-u user.sym	nm -n of the program for the user mode addresses
+ *		-f			folded stacks (flamegraph.pl input) instead of the
+ *					flat profile
+ *
+ *	The flat profile counts the samples per pid and per function of the
+ *	interrupted eip (self time).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH	8
+
+struct symbol {
+	unsigned int	addr;
+	char*			name;
+};
+
+struct symtab {
+	struct symbol*	syms;
+	int				count;
+};
+
+struct flat {
+	unsigned int	pid;
+	const char*		name;
+	unsigned int	count;
+};
+
+static struct symtab	ksyms, usyms;
+static struct flat*		flat;
+static int				nflat, maxflat;
+static unsigned int		total;
+
+static int load_symbols(const char* file, struct symtab* t)
+{
+	char line[512], type, name[400];
+	unsigned int addr;
+	int max = 0;
+	FILE* f = fopen(file, "r");
+
+	if (f == NULL) {
+		perror(file);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%x %c %399s", &addr, &type, name) != 3)
+			continue;
+		if (type != 'T' && type != 't' && type != 'W' && type != 'w')
+			continue;
+		if (t->count == max) {
+			max = max ? max * 2 : 1024;
+			t->syms = realloc(t->syms, max * sizeof(struct symbol));
+		}
+		t->syms[t->count].addr = addr;
+		t->syms[t->count].name = strdup(name);
+		t->count++;
+	}
+	fclose(f);
+	return 0;
+}
+
+/* nm -n sorts by address : the last symbol at or below addr */
+static const char* lookup(struct symtab* t, unsigned int addr)
+{
+	int lo = 0, hi = t->count - 1, mid, found = -1;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (t->syms[mid].addr <= addr) {
+			found = mid;
+			lo = mid + 1;
+		} else
+			hi = mid - 1;
+	}
+	return (found < 0) ? NULL : t->syms[found].name;
+}
+
+static const char* symbolise(unsigned int addr, int user, char* buf)
+{
+	const char* s = lookup(user ? &usyms : &ksyms, addr);
+
+	if (s != NULL)
+		return s;
+	sprintf(buf, "0x%08x", addr);
+	return buf;
+}
+
+static void flat_add(unsigned int pid, const char* name, unsigned int count)
+{
+	int i;
+
+	for (i = 0; i < nflat; i++)
+		if (flat[i].pid == pid && strcmp(flat[i].name, name) == 0) {
+			flat[i].count += count;
+			return;
+		}
+	if (nflat == maxflat) {
+		maxflat = maxflat ? maxflat * 2 : 256;
+		flat = realloc(flat, maxflat * sizeof(struct flat));
+	}
+	flat[nflat].pid = pid;
+	flat[nflat].name = strdup(name);
+	flat[nflat].count = count;
+	nflat++;
+}
+
+static int flat_cmp(const void* a, const void* b)
+{
+	const struct flat* x = a;
+	const struct flat* y = b;
+
+	if (x->pid != y->pid)
+		return (x->pid < y->pid) ? -1 : 1;
+	return (int) y->count - (int) x->count;
+}
+
+static void print_flat(void)
+{
+	int i;
+
+	qsort(flat, nflat, sizeof(struct flat), flat_cmp);
+	printf("%6s %8s %7s  %s\n", "pid", "samples", "%", "function");
+	for (i = 0; i < nflat; i++)
+		printf("%6u %8u %6.2f%%  %s\n", flat[i].pid, flat[i].count,
+			total ? 100.0 * flat[i].count / total : 0.0, flat[i].name);
+	printf("%u samples\n", total);
+}
+
+int main(int argc, char** argv)
+{
+	char line[1024], mode, buf[MAX_DEPTH][16];
+	const char* names[MAX_DEPTH];
+	unsigned int pid, count, pc[MAX_DEPTH];
+	int folded = 0, depth, off, n, i;
+	const char* user_file = NULL;
+	FILE* dump;
+
+	while (argc > 1 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-f") == 0)
+			folded = 1;
+		else if (strcmp(argv[1], "-u") == 0 && argc > 2) {
+			user_file = argv[2];
+			argv++;
+			argc--;
+		} else
+			break;
+		argv++;
+		argc--;
+	}
+	if (argc != 3) {
+		fprintf(stderr, "usage: profsym [-f] [-u user.sym] kernel.sym dump.txt\n");
+		return 1;
+	}
+	if (load_symbols(argv[1], &ksyms) < 0)
+		return 1;
+	if (user_file != NULL && load_symbols(user_file, &usyms) < 0)
+		return 1;
+	dump = fopen(argv[2], "r");
+	if (dump == NULL) {
+		perror(argv[2]);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), dump)) {
+		if (sscanf(line, "%u %u %c%n", &pid, &count, &mode, &off) != 3)
+			continue;		/* console noise around the dump */
+		if (mode != 'k' && mode != 'u')
+			continue;
+		depth = 0;
+		while (depth < MAX_DEPTH && sscanf(line + off, "%x%n", &pc[depth], &n) == 1) {
+			off += n;
+			depth++;
+		}
+		if (depth == 0)
+			continue;
+		for (i = 0; i < depth; i++)
+			names[i] = symbolise(pc[i], mode == 'u', buf[i]);
+		total += count;
+
+		if (folded) {
+			printf("%u;%s", pid, mode == 'u' ? "[user]" : "[kernel]");
+			for (i = depth - 1; i >= 0; i--)
+				printf(";%s", names[i]);
+			printf(" %u\n", count);
+		} else
+			flat_add(pid, names[0], count);
+	}
+	fclose(dump);
+
+	if (!folded)
+		print_flat();
+	return 0;
+}
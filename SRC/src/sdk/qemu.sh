@@ -1,2 +1,2 @@
 #!/bin/bash
-qemu -m 1024 -s -hda ./c.img  -curses -serial /dev/tty  -redir tcp:2323::23
+qemu -m 1024 -smp ${SMP:-1} -s -hda ./c.img ${VDA:+-drive file=$VDA,if=virtio,format=raw} -curses -serial /dev/tty  -redir tcp:2323::23